@@ -1,5 +1,7 @@
 #include "app.h"
 
+#include <chrono>
+
 #include <GLFW/glfw3.h>
 #include "lib/imgui/imgui.h"
 #include "lib/imgui/examples/imgui_impl_glfw.h"
@@ -7,6 +9,8 @@
 
 #include "assets.h"
 #include "containers.hpp"
+#include "cpu_profiler.h"
+#include "jobs.h"
 #include "renderer.h"
 #include "scene.h"
 
@@ -21,6 +25,8 @@ namespace vxgi
 
 		bool create_window(const Application_Config& config);
 		void destroy_window();
+		double get_startup_time_ms();
+		bool run_benchmark();
 		void GLFW_error_callback(int error, const char* description);
 		void render_ui();
 	}
@@ -31,48 +37,90 @@ namespace vxgi
 		{
 			LOG("app", "initializing");
 			Application& app = get_app();
+			cpuprofiler::set_thread_name("main");
+			CPU_ZONE("application::init");
+			int startup_phase = startup_phase_begin("startup");
 
+			// a benchmark renders in a hidden window at its own resolution, see benchmark.h
 			Application_Config default_config;
+			vec2 render_resolution = internal_render_resolution;
+			app.is_benchmark = benchmark::is_requested(argc, argv);
+			if (app.is_benchmark) {
+				if (!benchmark::parse_args(app.benchmark, argc, argv) || !benchmark::init(app.benchmark))
+					return false;
+				default_config.window_size = render_resolution = app.benchmark.resolution;
+				default_config.vsync_mode = 0;
+				default_config.is_visible = false;
+			}
+
+			int window_phase = startup_phase_begin("window");
 			if (!create_window(default_config))
 				return false;
+			startup_phase_end(window_phase);
 
-			resolution_set(default_config.window_size, internal_render_resolution);
+			resolution_set(default_config.window_size, render_resolution);
 			resolution_scale_with_black_bars();
 
+			jobs::init();
+
+			// the shaders compile while the scene loads, they're needed from the first frame on
 			renderer::init(app.window);
 			flycamera::attach(app.camera_controls, &renderer::get_camera());
 
 			if (app.input_state == APPLICATION_INPUT_FPS)
 				glfwSetInputMode(app.window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
+			int scene_phase = startup_phase_begin("scene");
 			assets::init();
-			if (argc == 2)
+			if (app.is_benchmark)
+				scenes::init(app.benchmark.scene);
+			else if (argc == 2)
 				scenes::init(argv[1]);
 			else
 				scenes::init();
+			startup_phase_end(scene_phase);
+
+			if (app.is_benchmark)
+				benchmark::apply_settings(app.benchmark, scenes::get_current());
 
+			if (!renderer::resolve_shaders())
+				return false;
+
+			startup_phase_end(startup_phase);
+			log_startup_timeline();
 			return true;
 		}
 		void uninit()
 		{
 			LOG("app", "uninitializing");
+			Application& app = get_app();
+			benchmark::uninit(app.benchmark);
+			array::uninit(app.startup_phases);
+			if (!app.window)
+				return; // init stopped before there was a window, e.g. at wrong benchmark arguments
+
 			scenes::uninit();
 			assets::uninit();
 			renderer::uninit();
+			jobs::uninit();
+			cpuprofiler::uninit();
 			destroy_window();
 		}
 
-		void run()
+		bool run()
 		{
 			LOG("app", "starting loop");
 			Application& app = get_app();
+			if (app.is_benchmark)
+				return run_benchmark();
 
 			bool is_exit_queued = false;
 			bool was_f1_pressed = false;
 
 			while (!glfwWindowShouldClose(app.window) && !is_exit_queued)
 			{
-				float dt = 1.0f / 60.0f;
+				CPU_ZONE("frame");
+				float dt = frameclock::begin_frame(app.frame_clock);
 
 				ImGui_ImplOpenGL3_NewFrame();
 				ImGui_ImplGlfw_NewFrame();
@@ -100,20 +148,42 @@ namespace vxgi
 						flycamera::update(app.camera_controls, app.window, dt);
 						break;
 					case APPLICATION_INPUT_UI:
+					{
+						CPU_ZONE("ui");
 						render_ui();
-						break;
+					}
+					break;
 				};
+				renderer::render_overlay();
 
 				renderer::render(app.window, scenes::get_current(), dt);
 
-				ImGui::Render();
-				ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+				{
+					CPU_ZONE("imgui");
+					ImGui::Render();
+					ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+				}
+
+				Gpu_Profiler::Scope* gpu_frame = gpuprofiler::find(renderer::get_gpu_profiler(), "frame");
+				if (gpu_frame)
+					frameclock::add_gpu_samples(app.frame_clock, gpu_frame->samples, GPU_PROFILER_HISTORY, gpu_frame->next_sample);
+				frameclock::end_cpu(app.frame_clock);
 
-				glfwSwapBuffers(app.window);
-				glfwPollEvents();
+				{
+					CPU_ZONE("swap");
+					glfwSwapBuffers(app.window);
+					glfwPollEvents();
+				}
+				frameclock::end_frame(app.frame_clock);
 			}
 
 			LOG("app", "ending loop");
+			return true;
+		}
+
+		Frame_Clock& get_frame_clock()
+		{
+			return get_app().frame_clock;
 		}
 
 		Application_Resolution& resolution_get()
@@ -188,10 +258,90 @@ namespace vxgi
 			file.close();
 			return result;
 		}
+
+		int startup_phase_begin(const char* name)
+		{
+			Application& app = get_app();
+			array::add(app.startup_phases, Startup_Phase { name, get_startup_time_ms(), -1.0 });
+			return array::size(app.startup_phases) - 1;
+		}
+		void startup_phase_end(int phase)
+		{
+			Application& app = get_app();
+			app.startup_phases[phase].end_ms = get_startup_time_ms();
+		}
+		void log_startup_timeline()
+		{
+			Application& app = get_app();
+			if (array::size(app.startup_phases) == 0)
+				return;
+
+			double total_ms = 0.0;
+			for (Startup_Phase& phase : app.startup_phases)
+				total_ms = glm::max(total_ms, phase.end_ms);
+
+			// one row per phase, overlapping phases ran at the same time
+			const int TIMELINE_WIDTH = 48;
+			LOG("app", "startup timeline, %.1f ms", total_ms);
+			for (Startup_Phase& phase : app.startup_phases)
+			{
+				double end_ms = (phase.end_ms < 0.0) ? total_ms : phase.end_ms;
+				int first = int(TIMELINE_WIDTH * phase.start_ms / glm::max(total_ms, 1e-3));
+				int last = glm::max(int(TIMELINE_WIDTH * end_ms / glm::max(total_ms, 1e-3)), first + 1);
+
+				char bar[TIMELINE_WIDTH + 1];
+				for (int i = 0; i < TIMELINE_WIDTH; i++)
+					bar[i] = (i >= first && i < last) ? '#' : '.';
+				bar[TIMELINE_WIDTH] = 0;
+
+				LOG("app", "  %-16s %8.1f %8.1f ms  |%s|", phase.name, phase.start_ms, end_ms, bar);
+			}
+		}
 	}
 
 	namespace
 	{
+		double get_startup_time_ms()
+		{
+			static std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+			return elapsed.count();
+		}
+
+		bool run_benchmark()
+		{
+			Application& app = get_app();
+			Benchmark& bench = app.benchmark;
+			Gpu_Profiler& profiler = renderer::get_gpu_profiler();
+			profiler.is_enabled = true;
+
+			// like run without the ui and the input, the camera follows the path
+			int total_frames = bench.warmup_frames + bench.total_frames;
+			for (int frame = 0; frame < total_frames && !glfwWindowShouldClose(app.window); frame++)
+			{
+				CPU_ZONE("frame");
+				if (frame == bench.warmup_frames)
+					benchmark::begin_measuring(bench, profiler, app.frame_clock);
+
+				float dt = frameclock::begin_frame(app.frame_clock);
+				benchmark::set_camera(bench, renderer::get_camera(), frame);
+				renderer::render(app.window, scenes::get_current(), dt);
+				frameclock::end_cpu(app.frame_clock);
+
+				{
+					CPU_ZONE("swap");
+					glfwSwapBuffers(app.window);
+					glfwPollEvents();
+				}
+				frameclock::end_frame(app.frame_clock);
+				benchmark::end_frame(bench, profiler, app.frame_clock);
+			}
+
+			if (bench.trace_path)
+				cpuprofiler::export_chrome_trace(bench.trace_path);
+			return benchmark::write_report(bench, profiler);
+		}
+
 		bool create_window(const Application_Config& config)
 		{
 			LOG("app", "initializing opengl context");
@@ -214,6 +364,7 @@ namespace vxgi
 				glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, config.gl_minor_version);
 				glfwWindowHint(GLFW_CENTER_CURSOR, GLFW_TRUE); // note: disabled for windowed mode windows
 				glfwWindowHint(GLFW_SAMPLES, config.msaa_samples);
+				glfwWindowHint(GLFW_VISIBLE, config.is_visible ? GLFW_TRUE : GLFW_FALSE);
 			}
 
 			// init window
@@ -320,11 +471,21 @@ namespace vxgi
 			{
 				renderer::render_ui();
 
+				if (TreeNode("Frame timing")) {
+					frameclock::render_ui(get_app().frame_clock);
+					TreePop();
+				}
+
+				if (TreeNode("CPU profiler")) {
+					cpuprofiler::render_ui();
+					TreePop();
+				}
+
 				if (TreeNode("Lights"))
 				{
 					Scene_Lights& lights = scene.lights;
 
-					SliderFloat3("ambient light", (float*) &lights.ambient_light, 0.0f, 1.0f);
+					if (SliderFloat3("ambient light", (float*) &lights.ambient_light, 0.0f, 1.0f)) lights.is_dirty = true;
 
 					if (TreeNode("Directional lights"))
 					{
@@ -332,15 +493,21 @@ namespace vxgi
 						{
 							PushID(&p);
 
-							SliderFloat("strength", &p.strength, 0.0f, 10.0f);
-							if (SliderFloat3("direction", (float*) &p.direction, -1.0f, 1.0f)) p.is_dirty = true;
-							SliderFloat3("color", (float*) &p.color, 0.0f, 1.0f);
-							SliderFloat3("attenuation", (float*) &p.attenuation, 0.0f, 1.0f);
+							if (SliderFloat("strength", &p.strength, 0.0f, 10.0f)) lights.is_dirty = true;
+							if (SliderFloat3("direction", (float*) &p.direction, -1.0f, 1.0f)) p.is_dirty = lights.is_dirty = true;
+							if (SliderFloat3("color", (float*) &p.color, 0.0f, 1.0f)) lights.is_dirty = true;
+							if (SliderFloat3("attenuation", (float*) &p.attenuation, 0.0f, 1.0f)) lights.is_dirty = true;
 
 							if (TreeNode("shadow map")) {
 								if (SliderFloat("ortho size", &p.shadow_map.config.ortho,         1.0f, 100.0f)) p.is_dirty = true;
 								if (SliderFloat("near plane", &p.shadow_map.config.near_plane, -100.0f, 100.0f)) p.is_dirty = true;
 								if (SliderFloat("far plane",  &p.shadow_map.config.far_plane,     0.0f, 100.0f)) p.is_dirty = true;
+								if (SliderFloat("split lambda", &p.shadow_map.config.split_lambda, 0.0f, 1.0f)) p.is_dirty = true;
+								if (IsItemHovered()) SetTooltip("0 = cascades split the view distance evenly, 1 = logarithmically");
+								Text("%d cascades + whole scene, %dx%d each", p.shadow_map.config.total_cascades, p.shadow_map.config.resolution, p.shadow_map.config.resolution);
+								for (int i = 0; i < p.shadow_map.config.total_cascades; i++)
+									Text("cascade %d: %.2f ... %.2f", i, p.shadow_map.cascade_splits[i], p.shadow_map.cascade_splits[i + 1]);
+								Text("atlas layers %d ... %d", p.shadow_map.first_layer, p.shadow_map.first_layer + p.shadow_map.total_layers - 1);
 								TreePop();
 							}
 
@@ -354,6 +521,51 @@ namespace vxgi
 						TreePop();
 					}
 
+					// the voxel grid only picks up changes to these when it's voxelized again
+					int total_local_lights = int(array::size(lights.point_lights) + array::size(lights.spot_lights));
+					Camera& camera = renderer::get_camera();
+
+					if (TreeNode("Point lights"))
+					{
+						for (Point_Light& p : lights.point_lights)
+						{
+							PushID(&p);
+							if (DragFloat3("position", (float*) &p.position, 0.01f)) lights.is_dirty = true;
+							if (SliderFloat3("color", (float*) &p.color, 0.0f, 1.0f)) lights.is_dirty = true;
+							if (SliderFloat("strength", &p.strength, 0.0f, 10.0f)) lights.is_dirty = true;
+							if (SliderFloat("radius", &p.radius, 0.01f, 20.0f)) lights.is_dirty = true;
+							Separator();
+							PopID();
+						}
+
+						if (total_local_lights < MAX_LOCAL_LIGHTS && Button("add at the camera"))
+							scene::add_point_light(scene, camera.position, vec3(1.0f), 1.0f, 2.0f);
+
+						TreePop();
+					}
+
+					if (TreeNode("Spot lights"))
+					{
+						for (Spot_Light& p : lights.spot_lights)
+						{
+							PushID(&p);
+							if (DragFloat3("position", (float*) &p.position, 0.01f)) lights.is_dirty = true;
+							if (SliderFloat3("direction", (float*) &p.direction, -1.0f, 1.0f)) lights.is_dirty = true;
+							if (SliderFloat3("color", (float*) &p.color, 0.0f, 1.0f)) lights.is_dirty = true;
+							if (SliderFloat("strength", &p.strength, 0.0f, 10.0f)) lights.is_dirty = true;
+							if (SliderFloat("radius", &p.radius, 0.01f, 20.0f)) lights.is_dirty = true;
+							if (SliderFloat("inner angle", &p.inner_angle, 0.0f, p.outer_angle)) lights.is_dirty = true;
+							if (SliderFloat("outer angle", &p.outer_angle, p.inner_angle, 90.0f)) lights.is_dirty = true;
+							Separator();
+							PopID();
+						}
+
+						if (total_local_lights < MAX_LOCAL_LIGHTS && Button("add at the camera"))
+							scene::add_spot_light(scene, camera.position, camera.direction, vec3(1.0f), 1.0f, 4.0f, 15.0f, 25.0f);
+
+						TreePop();
+					}
+
 					TreePop();
 				}
 			}
@@ -1,7 +1,10 @@
 #pragma once
 
 #include "types.h"
+#include "benchmark.h"
 #include "camera.h"
+#include "containers.hpp"
+#include "frame_clock.h"
 
 namespace vxgi
 {
@@ -28,6 +31,7 @@ namespace vxgi
 		int gl_minor_version = 5;
 		int msaa_samples = 0;
 		int vsync_mode = 1; // -1, 0, 1, https://www.glfw.org/docs/3.3/window_guide.html#buffer_swap
+		bool is_visible = true; // hidden for benchmarks
 	};
 
 	struct Application_Resolution
@@ -42,12 +46,25 @@ namespace vxgi
 		vec2 position1;
 	};
 
+	struct Startup_Phase // see application::startup_phase_begin
+	{
+		const char* name = "";
+		double start_ms = 0.0; // since the application started
+		double end_ms = -1.0;
+	};
+
 	struct Application
 	{
 		GLFWwindow* window = nullptr;
 		Application_Resolution resolution;
 		Camera_Controls_Fly camera_controls;
 		APPLICATION_INPUT_MODE input_state = APPLICATION_INPUT_FPS;
+		Frame_Clock frame_clock;
+
+		Benchmark benchmark; // see benchmark.h
+		bool is_benchmark = false;
+
+		Array<Startup_Phase> startup_phases; // phases can overlap, logged at the end of init
 	};
 
 	namespace application
@@ -55,7 +72,8 @@ namespace vxgi
 		bool init(int argc, const char* argv[], const vec2& internal_render_resolution = vec2(1920, 1080));
 		void uninit();
 
-		void run();
+		bool run(); // false if a benchmark couldn't write its report
+		Frame_Clock& get_frame_clock(); // frame times of the run loop, for benchmarks
 
 		Application_Resolution& resolution_get();
 		void resolution_set(vec2 windowResolution, vec2 internalRenderResolution);
@@ -63,5 +81,10 @@ namespace vxgi
 		void resolution_window_size_changed(int width, int height);
 
 		std::string read_file(const char* filepath);
+
+		// startup timeline (main thread only)
+		int  startup_phase_begin(const char* name); // returns the phase for startup_phase_end
+		void startup_phase_end(int phase);
+		void log_startup_timeline();
 	}
 }
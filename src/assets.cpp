@@ -1,5 +1,10 @@
 #include "assets.h"
 
+#include "app.h"
+#include "cpu_profiler.h"
+#include "jobs.h"
+#include "mesh_lod.h"
+#include "meshlet_culling.h"
 #include "lib/lodepng/lodepng.h"
 #include "lib/tinyobjloader/tiny_obj_loader.h"
 
@@ -12,9 +17,20 @@ namespace vxgi
 			return mgr;
 		}
 
+		struct Texture_Decode // png decoded on a job, uploaded on the main thread
+		{
+			Texture2D* texture = nullptr;
+			u8* data = nullptr; // rgba8
+			u32 width = 0;
+			u32 height = 0;
+			u32 error = 0;
+		};
+
 		void       upload_mesh_to_gpu(Mesh& mesh, Array<Vertex>& vertex_buffer);
 		bool       load_texture(Texture2D& out, const char* png_file, bool generate_mipmaps = false); // uploads to gpu aswell
-		Texture2D* get_or_load_material_texture(const char* name, Hashmap<const char*, Texture2D*>& loaded_textures, const char* path_to_textures);
+		void       decode_texture(Texture_Decode& decode); // no gl calls, safe on the job threads
+		bool       upload_texture(Texture_Decode& decode, bool generate_mipmaps); // frees the decoded data
+		Texture2D* get_or_queue_material_texture(const char* name, Hashmap<const char*, Texture2D*>& loaded_textures, Array<Texture_Decode>& decodes, const char* path_to_textures);
 		void       set_material_from(Material& m, tinyobj::material_t& mat);
 	}
 
@@ -35,9 +51,13 @@ namespace vxgi
 			ASSERT(index < array::size(get_asset_manager().materials), "assets", "index %d < %d", index, array::size(get_asset_manager().materials));
 			return *get_asset_manager().materials[index];
 		}
+		int get_total_materials() {
+			return array::size(get_asset_manager().materials);
+		}
 
 		bool load(Array<Model*>& output_models, Bounding_Box& output_aabb, const char* path, const char* path_to_textures)
 		{
+			CPU_ZONE("assets::load");
 			LOG("assets", "loading obj file");
 			Asset_Manager& assetmgr = get_asset_manager();
 
@@ -45,6 +65,7 @@ namespace vxgi
 			std::vector<tinyobj::shape_t> shapes;
 			std::vector<tinyobj::material_t> obj_materials;
 			{
+				CPU_ZONE("parse obj");
 				std::string warn, error;
 				bool ret = tinyobj::LoadObj(&attrib, &shapes, &obj_materials, &warn, &error, path, ""); // note: triangulates
 				if (!warn.empty())  
@@ -60,6 +81,7 @@ namespace vxgi
 			LOG("assets", "loading textures");
 			Hashmap<const char*, Material*> material_map;
 			Hashmap<const char*, Texture2D*> textures;
+			Array<Texture_Decode> texture_decodes;
 			{
 				array::ensure_capacity(assetmgr.materials, obj_materials.size());
 				int material_index = array::size(get_asset_manager().materials);
@@ -74,17 +96,29 @@ namespace vxgi
 					material_index++;
 
 					set_material_from(*material, obj_material);
-					material->map_Ka   = get_or_load_material_texture(obj_material.ambient_texname.c_str(), textures, path_to_textures);
-					material->map_Kd   = get_or_load_material_texture(obj_material.diffuse_texname.c_str(), textures, path_to_textures);
-					material->map_Ks   = get_or_load_material_texture(obj_material.specular_texname.c_str(), textures, path_to_textures);
-					material->map_Ke   = get_or_load_material_texture(obj_material.emissive_texname.c_str(), textures, path_to_textures);
-					material->map_bump = get_or_load_material_texture(obj_material.bump_texname.c_str(), textures, path_to_textures);
+					material->map_Ka   = get_or_queue_material_texture(obj_material.ambient_texname.c_str(), textures, texture_decodes, path_to_textures);
+					material->map_Kd   = get_or_queue_material_texture(obj_material.diffuse_texname.c_str(), textures, texture_decodes, path_to_textures);
+					material->map_Ks   = get_or_queue_material_texture(obj_material.specular_texname.c_str(), textures, texture_decodes, path_to_textures);
+					material->map_Ke   = get_or_queue_material_texture(obj_material.emissive_texname.c_str(), textures, texture_decodes, path_to_textures);
+					material->map_bump = get_or_queue_material_texture(obj_material.bump_texname.c_str(), textures, texture_decodes, path_to_textures);
 				}
 			}
 
+			// pngs are decoded on the job threads while the meshes are processed and uploaded here
+			int decode_phase = application::startup_phase_begin("texture decode");
+			Job_Batch decode_batch;
+			jobs::run(decode_batch, [](void* data, int index) { decode_texture(((Texture_Decode*) data)[index]); }, texture_decodes.data, array::size(texture_decodes));
+
 			LOG("assets", "processing meshes");
+			int mesh_phase = application::startup_phase_begin("mesh upload");
 			vec3 scene_min_point = vec3(MAX_FLOAT_VALUE, MAX_FLOAT_VALUE, MAX_FLOAT_VALUE);
 			vec3 scene_max_point = vec3(MIN_FLOAT_VALUE, MIN_FLOAT_VALUE, MIN_FLOAT_VALUE);
+			Array<Mesh*> loaded_meshes;
+			Array<Array<Vertex>> loaded_vertices; // per loaded mesh, until uploaded
+			defer {
+				array::uninit(loaded_meshes);
+				array::uninit(loaded_vertices);
+			};
 			{
 				array::ensure_capacity(assetmgr.models, shapes.size());
 				array::ensure_capacity(assetmgr.meshes, shapes.size());
@@ -112,6 +146,7 @@ namespace vxgi
 					Sub_Mesh& first_submesh = mesh->sub_meshes[0];
 					first_submesh.index = 0;
 					first_submesh.material_index = current_material_index;
+					first_submesh.bounding_box = { vec3(MAX_FLOAT_VALUE), vec3(MIN_FLOAT_VALUE) };
 
 					Array<Vertex> vertex_buffer;
 					for (int i=0; i < shapes[s].mesh.indices.size(); i += 3)
@@ -127,6 +162,7 @@ namespace vxgi
 							current_submesh_index++;
 							Sub_Mesh& new_submesh = mesh->sub_meshes[current_submesh_index];
 							new_submesh.index = i;
+							new_submesh.bounding_box = { vec3(MAX_FLOAT_VALUE), vec3(MIN_FLOAT_VALUE) };
 
 							// note: indices to vector::obj_materials don't map directly to Asset_Manager::materials
 							// because there could be other unrelated materials too, so we fetch the correct index
@@ -154,6 +190,9 @@ namespace vxgi
 							scene_max_point.x = fmax(vx, scene_max_point.x);
 							scene_max_point.y = fmax(vy, scene_max_point.y);
 							scene_max_point.z = fmax(vz, scene_max_point.z);
+							Bounding_Box& submesh_aabb = mesh->sub_meshes[current_submesh_index].bounding_box;
+							submesh_aabb.min_point = glm::min(submesh_aabb.min_point, vec3(vx, vy, vz));
+							submesh_aabb.max_point = glm::max(submesh_aabb.max_point, vec3(vx, vy, vz));
 
 							if (attrib.normals.size() > 0) {
 								nx = attrib.normals[3 * idx.normal_index+0];
@@ -249,11 +288,54 @@ namespace vxgi
 						current_submesh.length += 3;
 					}
 
-					upload_mesh_to_gpu(*mesh, vertex_buffer);
-					array::clear(vertex_buffer);
+					array::add(loaded_meshes, mesh);
+					array::add(loaded_vertices, vertex_buffer);
+					vertex_buffer.data = 0; // loaded_vertices owns it
+
+					// model space, the scene positions and scales the models after loading
+					model->bounding_box = { vec3(MAX_FLOAT_VALUE), vec3(MIN_FLOAT_VALUE) };
+					for (Sub_Mesh& sub_mesh : mesh->sub_meshes) {
+						boundingbox::update(sub_mesh.bounding_box);
+						model->bounding_box.min_point = glm::min(model->bounding_box.min_point, sub_mesh.bounding_box.min_point);
+						model->bounding_box.max_point = glm::max(model->bounding_box.max_point, sub_mesh.bounding_box.max_point);
+					}
+					boundingbox::update(model->bounding_box);
 				}
 			}
 
+			// the meshlets and lods of every mesh on the job threads. the meshlets reorder the full detail vertices, the lods' go after them
+			int lod_phase = application::startup_phase_begin("meshlets and lods");
+			jobs::parallel_for(array::size(loaded_meshes), [&](int i) {
+				CPU_ZONE("meshlets and lods");
+				meshletculling::generate(*loaded_meshes[i], loaded_vertices[i]);
+				meshlod::generate(*loaded_meshes[i], loaded_vertices[i]);
+			});
+			application::startup_phase_end(lod_phase);
+
+			int total_meshlets = 0, total_lods = 0, total_lod_triangles = 0;
+			for (int i = 0; i < int(array::size(loaded_meshes)); i++) {
+				Mesh& mesh = *loaded_meshes[i];
+				total_meshlets += array::size(mesh.meshlets);
+				for (int l = 0; l < mesh.total_lods; l++)
+					total_lod_triangles += mesh.lods[l].total_triangles;
+				total_lods += mesh.total_lods;
+
+				upload_mesh_to_gpu(mesh, loaded_vertices[i]);
+				array::uninit(loaded_vertices[i]);
+			}
+			LOG("assets", "%d meshlets, %d mesh lods, %d triangles", total_meshlets, total_lods, total_lod_triangles);
+
+			application::startup_phase_end(mesh_phase);
+
+			jobs::wait(decode_batch);
+			application::startup_phase_end(decode_phase);
+
+			int upload_phase = application::startup_phase_begin("texture upload");
+			for (Texture_Decode& decode : texture_decodes)
+				upload_texture(decode, false);
+			application::startup_phase_end(upload_phase);
+			LOG("assets", "loaded %d textures (decoded on %d threads)", int(array::size(texture_decodes)), jobs::get_total_workers() + 1);
+
 			{
 				output_aabb.min_point = scene_min_point;
 				output_aabb.max_point = scene_max_point;
@@ -266,6 +348,7 @@ namespace vxgi
 
 			hashmap::uninit(material_map);
 			hashmap::uninit(textures);
+			array::uninit(texture_decodes);
 			LOG("assets", "scene loaded");
 			return true;
 		}
@@ -312,7 +395,7 @@ namespace vxgi
 			}
 
 			mesh.vao_size = array::size(vertexBuffer);
-			array::add(mesh.sub_meshes, { 0, mesh.vao_size, 0 });
+			array::add(mesh.sub_meshes, { 0, mesh.vao_size, 0, { vec3(-1.0f), vec3(1.0f), vec3(0.0f) } });
 			mesh.is_loaded = true;
 
 			upload_mesh_to_gpu(mesh, vertexBuffer);
@@ -330,7 +413,7 @@ namespace vxgi
 			array::add(vertexBuffer, Vertex { { -1,  1,  1 }, { 0, 0, 1 }, {0,0,0}, { 0, 1 }, {0,0,0}, {0,0,0} } );
 
 			mesh.vao_size = array::size(vertexBuffer);
-			array::add(mesh.sub_meshes, { 0, mesh.vao_size, 0 });
+			array::add(mesh.sub_meshes, { 0, mesh.vao_size, 0, { vec3(-1.0f, -1.0f, 1.0f), vec3(1.0f, 1.0f, 1.0f), vec3(0.0f, 0.0f, 1.0f) } }); // flat at z = 1
 			mesh.is_loaded = true;
 
 			upload_mesh_to_gpu(mesh, vertexBuffer);
@@ -343,18 +426,29 @@ namespace vxgi
 		{
 			out.path = png_file;
 
-			u32 error = 0;
-			u32 w = 0;
-			u32 h = 0;
-			u8* data = NULL;
+			Texture_Decode decode;
+			decode.texture = &out;
+			decode_texture(decode);
+			return upload_texture(decode, generate_mipmaps);
+		}
 
-			error = lodepng_decode32_file(&data, &w, &h, png_file);
-			defer { free(data); };
+		void decode_texture(Texture_Decode& decode)
+		{
+			CPU_ZONE("decode texture");
+			decode.error = lodepng_decode32_file(&decode.data, &decode.width, &decode.height, decode.texture->path.c_str());
+		}
+
+		bool upload_texture(Texture_Decode& decode, bool generate_mipmaps)
+		{
+			CPU_ZONE("upload texture");
+			Texture2D& out = *decode.texture;
+			const char* png_file = out.path.c_str();
+			defer { free(decode.data); decode.data = NULL; };
 
-			ASSERT(error == 0, "assets", "error %u loading img '%s': %s", error, png_file, lodepng_error_text(error));
+			ASSERT(decode.error == 0, "assets", "error %u loading img '%s': %s", decode.error, png_file, lodepng_error_text(decode.error));
 
-			if (!error && data) {
-				texture::init(out, data, int(w),int(h), GL_RGBA,GL_RGBA,GL_UNSIGNED_BYTE, (generate_mipmaps ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR),GL_LINEAR, GL_REPEAT,GL_REPEAT, generate_mipmaps, false);
+			if (!decode.error && decode.data) {
+				texture::init(out, decode.data, int(decode.width),int(decode.height), GL_RGBA8,GL_RGBA,GL_UNSIGNED_BYTE, (generate_mipmaps ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR),GL_LINEAR, GL_REPEAT,GL_REPEAT, generate_mipmaps, false);
 				LOG("assets", "loaded texture %s (id %u)", png_file, out.id);
 				return true;
 			} else {
@@ -363,7 +457,7 @@ namespace vxgi
 			}
 		}
 
-		Texture2D* get_or_load_material_texture(const char* name, Hashmap<const char*, Texture2D*>& loaded_textures, const char* path_to_textures)
+		Texture2D* get_or_queue_material_texture(const char* name, Hashmap<const char*, Texture2D*>& loaded_textures, Array<Texture_Decode>& decodes, const char* path_to_textures)
 		{
 			if (name && strlen(name) > 0) {
 				Texture2D* tex = NULL;
@@ -372,7 +466,8 @@ namespace vxgi
 					tex = hashmap::get(loaded_textures, name);
 				} else {
 					tex = new Texture2D; // @Cleanup @Malloc
-					load_texture(*tex, name, false);
+					tex->path = name;
+					array::add(decodes, Texture_Decode { tex }); // decoded and uploaded after the materials are set up
 					hashmap::insert(loaded_textures, name, tex);
 					array::add(get_asset_manager().textures, tex);
 				}
@@ -386,6 +481,7 @@ namespace vxgi
 
 		void upload_mesh_to_gpu(Mesh& mesh, Array<Vertex>& vertex_buffer)
 		{
+			CPU_ZONE("upload mesh");
 			glGenVertexArrays(1, &mesh.vao);
 			glGenBuffers(1, &mesh.vbo);
 			glBindVertexArray(mesh.vao);
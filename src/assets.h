@@ -26,6 +26,7 @@ namespace vxgi
 		bool load(Array<Model*>& output_models, Bounding_Box& output_aabb, const char* path_to_obj, const char* path_to_textures);
 
 		Material& get_material(int index);
+		int get_total_materials();
 		Texture2D& get_white_texture();
 
 		Mesh& get_unit_cube();
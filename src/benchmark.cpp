@@ -0,0 +1,312 @@
+#include "benchmark.h"
+
+#include "cpu_profiler.h"
+#include "frame_clock.h"
+#include "gpu_profiler.h"
+#include "renderer.h"
+#include "scene.h"
+
+namespace vxgi
+{
+	namespace
+	{
+		struct Benchmark_Preset
+		{
+			const char* name;
+			const char* description;
+			void (*apply)(Cone_Tracing_Shader_Settings&);
+		};
+
+		const Benchmark_Preset BENCHMARK_PRESETS[] =
+		{
+			{ "low", "3 diffuse cones, no specular or soft shadow cones", [](Cone_Tracing_Shader_Settings& s) {
+				s.diffuse_cone_set = DIFFUSE_CONE_SET_3;
+				s.specular_settings.is_enabled = false;
+				s.soft_shadows_settings.is_enabled = false;
+			}},
+			{ "default", "the scene's settings", [](Cone_Tracing_Shader_Settings&) {
+			}},
+			{ "high", "16 diffuse cones, separate ao cones and shadow mapped direct light", [](Cone_Tracing_Shader_Settings& s) {
+				s.diffuse_cone_set = DIFFUSE_CONE_SET_16;
+				s.trace_ao_separately = true;
+				s.enable_hard_shadows = true;
+			}},
+		};
+
+		const Benchmark_Preset* find_preset(const char* name)
+		{
+			for (const Benchmark_Preset& preset : BENCHMARK_PRESETS)
+				if (strcmp(preset.name, name) == 0)
+					return &preset;
+			return NULL;
+		}
+
+		int find_voxel_resolution(int voxels) // index of VOXELGRID_RESOLUTIONS, -1 if it isn't one
+		{
+			for (int i = 0; i < TOTAL_VOXELGRID_RESOLUTIONS; i++)
+				if (VOXELGRID_RESOLUTIONS[i] == voxels)
+					return i;
+			return -1;
+		}
+
+		void log_usage()
+		{
+			LOG("benchmark", "usage: vxgi --benchmark <scene> [options]");
+			LOG("benchmark", "  --voxels <n>        voxel grid resolution, 64, 128, 256 or 512");
+			LOG("benchmark", "  --preset <name>     cone tracing settings:");
+			for (const Benchmark_Preset& preset : BENCHMARK_PRESETS)
+				LOG("benchmark", "                        %-8s %s", preset.name, preset.description);
+			LOG("benchmark", "  --camera <path>     camera path, a \"px py pz dx dy dz\" keyframe per line");
+			LOG("benchmark", "  --frames <n>        measured frames");
+			LOG("benchmark", "  --warmup <n>        frames before them");
+			LOG("benchmark", "  --resolution <wxh>  of the window and the render target");
+			LOG("benchmark", "  --output <path>     json report");
+			LOG("benchmark", "  --trace <path>      cpu profiler trace of the run");
+		}
+
+		// new samples of the gpu profiler's scopes since the last time, kept if measuring
+		void take_gpu_samples(Benchmark& b, Gpu_Profiler& profiler)
+		{
+			while (array::size(b.passes) < array::size(profiler.scopes))
+				array::add(b.passes, Benchmark::Pass {});
+
+			for (int i = 0; i < int(array::size(profiler.scopes)); i++) {
+				Gpu_Profiler::Scope& scope = profiler.scopes[i];
+				Benchmark::Pass& pass = b.passes[i];
+				for (; pass.next_sample != scope.next_sample; pass.next_sample = (pass.next_sample + 1) % GPU_PROFILER_HISTORY) // at most GPU_PROFILER_FRAMES a frame
+					if (b.is_measuring)
+						array::add(pass.samples_ms, scope.samples[pass.next_sample]);
+			}
+		}
+
+		void write_json_stats(FILE* file, Array<float>& samples)
+		{
+			Timing_Stats stats = frameclock::get_timing_stats(samples.data, array::size(samples));
+			fprintf(file, "{ \"samples\": %d, \"min_ms\": %.4f, \"average_ms\": %.4f, \"p50_ms\": %.4f, \"p95_ms\": %.4f, \"p99_ms\": %.4f, \"max_ms\": %.4f }",
+				stats.total_samples, stats.min_ms, stats.average_ms, stats.p50_ms, stats.p95_ms, stats.p99_ms, stats.max_ms);
+		}
+	}
+
+	namespace benchmark
+	{
+		bool is_requested(int argc, const char* argv[])
+		{
+			return argc >= 2 && strcmp(argv[1], "--benchmark") == 0;
+		}
+
+		bool parse_args(Benchmark& b, int argc, const char* argv[])
+		{
+			if (argc < 3 || argv[2][0] == '-') {
+				log_usage();
+				return false;
+			}
+			b.scene = argv[2];
+
+			for (int i = 3; i < argc; i++) {
+				const char* option = argv[i];
+				const char* value = (i + 1 < argc) ? argv[i + 1] : NULL;
+				if (!value) {
+					LOG("benchmark", "%s needs a value", option);
+					log_usage();
+					return false;
+				}
+				i++;
+
+				bool is_valid = true;
+				if      (strcmp(option, "--voxels") == 0)     is_valid = sscanf(value, "%d", &b.voxel_resolution) == 1 && find_voxel_resolution(b.voxel_resolution) >= 0;
+				else if (strcmp(option, "--preset") == 0) {
+					b.preset = value;
+					is_valid = find_preset(value) != NULL;
+				}
+				else if (strcmp(option, "--camera") == 0)     b.camera_path = value;
+				else if (strcmp(option, "--frames") == 0)     is_valid = sscanf(value, "%d", &b.total_frames) == 1 && b.total_frames > 0;
+				else if (strcmp(option, "--warmup") == 0)     is_valid = sscanf(value, "%d", &b.warmup_frames) == 1 && b.warmup_frames >= 0;
+				else if (strcmp(option, "--resolution") == 0) {
+					int w = 0, h = 0;
+					is_valid = sscanf(value, "%dx%d", &w, &h) == 2 && w > 0 && h > 0;
+					b.resolution = vec2(w, h);
+				}
+				else if (strcmp(option, "--output") == 0)     b.output_path = value;
+				else if (strcmp(option, "--trace") == 0)      b.trace_path = value;
+				else {
+					LOG("benchmark", "unknown option %s", option);
+					log_usage();
+					return false;
+				}
+
+				if (!is_valid) {
+					LOG("benchmark", "invalid value for %s: %s", option, value);
+					log_usage();
+					return false;
+				}
+			}
+			return true;
+		}
+
+		bool init(Benchmark& b)
+		{
+			if (!b.camera_path)
+				return true;
+
+			FILE* file = fopen(b.camera_path, "r");
+			if (!file) {
+				LOG("benchmark", "couldn't open the camera path %s", b.camera_path);
+				return false;
+			}
+			defer { fclose(file); };
+
+			char line[256];
+			int line_number = 0;
+			while (fgets(line, sizeof(line), file)) {
+				line_number++;
+				char* comment = strchr(line, '#');
+				if (comment)
+					*comment = 0;
+
+				Benchmark_Keyframe k;
+				int total_read = sscanf(line, "%f %f %f %f %f %f", &k.position.x, &k.position.y, &k.position.z, &k.direction.x, &k.direction.y, &k.direction.z);
+				if (total_read <= 0)
+					continue; // empty
+				if (total_read != 6 || glm::length(k.direction) < 1e-6f) {
+					LOG("benchmark", "%s:%d isn't \"px py pz dx dy dz\"", b.camera_path, line_number);
+					return false;
+				}
+				k.direction = glm::normalize(k.direction);
+				array::add(b.keyframes, k);
+			}
+
+			if (array::size(b.keyframes) == 0) {
+				LOG("benchmark", "no keyframes in %s", b.camera_path);
+				return false;
+			}
+			LOG("benchmark", "%d keyframes in %s", int(array::size(b.keyframes)), b.camera_path);
+			return true;
+		}
+
+		void uninit(Benchmark& b)
+		{
+			for (Benchmark::Pass& pass : b.passes)
+				array::uninit(pass.samples_ms);
+			array::uninit(b.passes);
+			array::uninit(b.keyframes);
+			array::uninit(b.cpu_ms);
+			array::uninit(b.present_ms);
+		}
+
+		void apply_settings(Benchmark& b, Scene& scene)
+		{
+			const Benchmark_Preset* preset = find_preset(b.preset);
+			ASSERT(preset, "benchmark", "unknown preset %s", b.preset);
+			preset->apply(scene.vct_settings);
+			scene.vct_settings.is_dirty = true;
+
+			renderer::voxel_grid_resolution_changed(find_voxel_resolution(b.voxel_resolution));
+			LOG("benchmark", "%s, %d^3 voxels, preset %s, %d + %d frames at %.0fx%.0f", b.scene, b.voxel_resolution, b.preset, b.warmup_frames, b.total_frames, b.resolution.x, b.resolution.y);
+		}
+
+		void set_camera(Benchmark& b, Camera& camera, int frame)
+		{
+			int total_keyframes = array::size(b.keyframes);
+			if (total_keyframes == 0)
+				return;
+
+			int measured_frame = glm::max(frame - b.warmup_frames, 0);
+			float t = (b.total_frames > 1) ? float(measured_frame) / float(b.total_frames - 1) * float(total_keyframes - 1) : 0.0f;
+			int first = glm::min(int(t), total_keyframes - 1);
+			int second = glm::min(first + 1, total_keyframes - 1);
+			float blend = t - float(first);
+
+			Benchmark_Keyframe& k0 = b.keyframes[first];
+			Benchmark_Keyframe& k1 = b.keyframes[second];
+			camera.position = glm::mix(k0.position, k1.position, blend);
+			vec3 direction = glm::mix(k0.direction, k1.direction, blend);
+			camera.direction = (glm::length(direction) > 1e-6f) ? glm::normalize(direction) : k1.direction; // opposite keyframes
+		}
+
+		void begin_measuring(Benchmark& b, Gpu_Profiler& profiler, Frame_Clock& clock)
+		{
+			// the warm up frames still in flight aren't measured
+			gpuprofiler::flush(profiler);
+			take_gpu_samples(b, profiler);
+			Gpu_Profiler::Scope* gpu_frame = gpuprofiler::find(profiler, "frame");
+			frameclock::reset(clock, gpu_frame ? gpu_frame->next_sample : 0);
+			b.is_measuring = true;
+		}
+
+		void end_frame(Benchmark& b, Gpu_Profiler& profiler, Frame_Clock& clock)
+		{
+			take_gpu_samples(b, profiler);
+			if (!b.is_measuring)
+				return;
+
+			array::add(b.cpu_ms, frameclock::get_latest(clock, FRAME_TIMING_CPU));
+			if (clock.histories[FRAME_TIMING_PRESENT].total_samples > 0) // none for the first measured frame
+				array::add(b.present_ms, frameclock::get_latest(clock, FRAME_TIMING_PRESENT));
+		}
+
+		bool write_report(Benchmark& b, Gpu_Profiler& profiler)
+		{
+			gpuprofiler::flush(profiler);
+			take_gpu_samples(b, profiler);
+
+			FILE* file = fopen(b.output_path, "w");
+			if (!file) {
+				LOG("benchmark", "couldn't open %s for writing", b.output_path);
+				return false;
+			}
+			defer { fclose(file); };
+
+			Array<float> no_samples;
+			int frame_scope = -1;
+			for (int i = 0; i < int(array::size(profiler.scopes)); i++)
+				if (profiler.scopes[i].parent < 0 && strcmp(profiler.scopes[i].name, "frame") == 0)
+					frame_scope = i;
+
+			fprintf(file, "{\n");
+			fprintf(file, "\t\"scene\": ");
+			cpuprofiler::write_json_string(file, b.scene);
+			fprintf(file, ",\n\t\"scene_name\": ");
+			cpuprofiler::write_json_string(file, scenes::get_current().name);
+			fprintf(file, ",\n\t\"preset\": ");
+			cpuprofiler::write_json_string(file, b.preset);
+			fprintf(file, ",\n\t\"camera_path\": ");
+			if (b.camera_path)
+				cpuprofiler::write_json_string(file, b.camera_path);
+			else
+				fprintf(file, "null");
+			fprintf(file, ",\n\t\"voxel_resolution\": %d,\n", b.voxel_resolution);
+			fprintf(file, "\t\"resolution\": [%d, %d],\n", int(b.resolution.x), int(b.resolution.y));
+			fprintf(file, "\t\"frames\": %d,\n", int(array::size(b.cpu_ms)));
+			fprintf(file, "\t\"warmup_frames\": %d,\n", b.warmup_frames);
+			fprintf(file, "\t\"gl_renderer\": ");
+			cpuprofiler::write_json_string(file, (const char*) glGetString(GL_RENDERER));
+			fprintf(file, ",\n\t\"gl_version\": ");
+			cpuprofiler::write_json_string(file, (const char*) glGetString(GL_VERSION));
+
+			fprintf(file, ",\n\t\"frame\": {\n\t\t\"cpu\": ");
+			write_json_stats(file, b.cpu_ms);
+			fprintf(file, ",\n\t\t\"gpu\": ");
+			write_json_stats(file, frame_scope >= 0 ? b.passes[frame_scope].samples_ms : no_samples);
+			fprintf(file, ",\n\t\t\"present\": ");
+			write_json_stats(file, b.present_ms);
+			fprintf(file, "\n\t},\n");
+
+			// gpu time per pass, parents before their children
+			fprintf(file, "\t\"passes\": [");
+			for (int i = 0; i < int(array::size(b.passes)); i++) {
+				char path[256];
+				gpuprofiler::get_path(profiler, i, path, sizeof(path));
+				fprintf(file, "%s\n\t\t{ \"pass\": ", i > 0 ? "," : "");
+				cpuprofiler::write_json_string(file, path);
+				fprintf(file, ", \"depth\": %d, \"gpu\": ", profiler.scopes[i].depth);
+				write_json_stats(file, b.passes[i].samples_ms);
+				fprintf(file, " }");
+			}
+			fprintf(file, "\n\t]\n}\n");
+
+			Timing_Stats present = frameclock::get_timing_stats(b.present_ms.data, array::size(b.present_ms));
+			LOG("benchmark", "wrote %s, %d frames, %.3f ms average, %.3f ms p99 between presents", b.output_path, int(array::size(b.cpu_ms)), present.average_ms, present.p99_ms);
+			return true;
+		}
+	}
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "types.h"
+#include "containers.hpp"
+
+// Scripted runs without the ui: `vxgi --benchmark <scene> [options]` renders warm up frames and then the measured
+// frames in a hidden window with vsync off, the camera moving along a path file, and writes a json report of the frame
+// times and of every pass of the gpu profiler. Every measured frame is kept, the averages and percentiles are over all
+// of them. The window is made by GLFW, build with VXGI_OSMESA for machines without a display (Mesa llvmpipe).
+//
+// A camera path has a keyframe per line, "px py pz dx dy dz" (position and direction), # starts a comment. The measured
+// frames are spread evenly from the first keyframe to the last, the warm up frames stay at the first.
+
+namespace vxgi
+{
+	struct Camera;
+	struct Frame_Clock;
+	struct Gpu_Profiler;
+	struct Scene;
+
+	struct Benchmark_Keyframe
+	{
+		vec3 position;
+		vec3 direction;
+	};
+
+	struct Benchmark
+	{
+		struct Pass // of Gpu_Profiler::scopes, same index
+		{
+			Array<float> samples_ms; // every measured frame it ran in
+			int next_sample = 0; // of the scope's ring, taken up to here
+		};
+
+		// from the command line
+		const char* scene = "cornell";
+		const char* preset = "default"; // see BENCHMARK_PRESETS in benchmark.cpp
+		const char* camera_path = NULL; // NULL = the scene's camera
+		const char* output_path = "benchmark.json";
+		const char* trace_path = NULL; // a cpu profiler trace of the run, see cpu_profiler.h
+		int voxel_resolution = 256; // one of VOXELGRID_RESOLUTIONS
+		int total_frames = 100; // measured
+		int warmup_frames = 5; // the scene is voxelized in the first one
+		vec2 resolution = vec2(1280, 720); // of the window and the internal render target
+
+		Array<Benchmark_Keyframe> keyframes;
+		Array<float> cpu_ms; // per measured frame
+		Array<float> present_ms;
+		Array<Pass> passes;
+		bool is_measuring = false;
+	};
+
+	namespace benchmark
+	{
+		bool is_requested(int argc, const char* argv[]); // argv[1] is --benchmark
+		bool parse_args(Benchmark&, int argc, const char* argv[]); // logs the usage if they're wrong
+		bool init(Benchmark&); // reads the camera path
+		void uninit(Benchmark&);
+
+		void apply_settings(Benchmark&, Scene&); // the preset and the voxel resolution, once the scene is loaded
+		void set_camera(Benchmark&, Camera&, int frame); // of warmup_frames + total_frames
+
+		void begin_measuring(Benchmark&, Gpu_Profiler&, Frame_Clock&); // after the warm up, waits for the gpu
+		void end_frame(Benchmark&, Gpu_Profiler&, Frame_Clock&); // after the swap
+		bool write_report(Benchmark&, Gpu_Profiler&); // waits for the gpu, false if the report couldn't be written
+	}
+}
@@ -21,6 +21,10 @@ namespace vxgi
 
 		void set_to_perspective(Camera& c, float aspect_ratio, float fov, float near_plane, float far_plane) {
 			c.projection = glm::perspective(DEGREES_TO_RADIANS * fov, aspect_ratio, near_plane, far_plane);
+			c.fov = fov;
+			c.aspect_ratio = aspect_ratio;
+			c.near_plane = near_plane;
+			c.far_plane = far_plane;
 		}
 
 		void set_to_ortho(Camera& c) {
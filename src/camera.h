@@ -13,7 +13,22 @@ namespace vxgi
 		mat4 view = mat4(1.0f);
 		mat4 projection = mat4(1.0f);
 		mat4 VP = mat4(1.0f);
+
+		// set_to_perspective, shadow cascades are fitted to these
+		float fov = 45.0f; // vertical, degrees
+		float aspect_ratio = 1.0f;
+		float near_plane = 0.1f;
+		float far_plane = 1000.0f;
+	};
+
+	struct Camera_Std140 // mirrors Camera_Block in the shaders
+	{
+		mat4 VP;
+		vec3 position;
+		float _pad0;
+		mat4 inverse_VP; // world position from depth, see reconstruct_world_pos in gbuffer_encoding.glsl
 	};
+	static_assert(sizeof(Camera_Std140) == 144, "Camera_Std140 doesn't match the std140 layout");
 
 	struct Camera_Controls_Fly
 	{
@@ -256,7 +256,9 @@ namespace vxgi
 			return stbds_hmgeti(hashmap.data, key);
 		}
 		template<typename K, typename V> auto* get_entry(Hashmap<K,V>& hashmap, K key) {
-			return stbds_hmgetp_null(hashmap.data, key);
+			// @Note not stbds_hmgetp_null, it reads the index from the wrong header
+			ptrdiff_t index = stbds_hmgeti(hashmap.data, key);
+			return (index == -1) ? NULL : &hashmap.data[index];
 		}
 		template<typename K, typename V> auto* get_entry_or_default(Hashmap<K,V>& hashmap, K key) {
 			return stbds_hmgetp(hashmap.data, key);
@@ -300,7 +302,9 @@ namespace vxgi
 			return stbds_shgeti(hashmap.data, key);
 		}
 		template<typename V> auto* get_entry(Hashmap<const char*,V>& hashmap, const char* key) {
-			return stbds_shgetp_null(hashmap.data, key);
+			// @Note not stbds_shgetp_null, same as above
+			ptrdiff_t index = stbds_shgeti(hashmap.data, key);
+			return (index == -1) ? NULL : &hashmap.data[index];
 		}
 		template<typename V> auto* get_entry_or_default(Hashmap<const char*,V>& hashmap, const char* key) {
 			return stbds_shgetp(hashmap.data, key);
@@ -0,0 +1,598 @@
+#include "cpu_cone_tracing.h"
+
+#include <chrono>
+#include <cstdio>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "jobs.h"
+
+namespace vxgi
+{
+	namespace
+	{
+		const u32 VOXEL_GRID_DUMP_MAGIC = 0x58565856; // "VXVX"
+		const u32 G_BUFFER_DUMP_MAGIC   = 0x42475856; // "VXGB"
+		const u32 DUMP_VERSION = 2; // 2: Cone_Tracing_Settings_Std140::diffuse_cone_set
+
+		//
+		// PACKETS
+		// gcc/clang vector extensions, one ymm register per value when built with -mavx2 (see VXGI_AVX2 in CMakeLists.txt)
+		// comparisons give -1 / 0 per lane
+		//
+		typedef float f32x8 __attribute__((vector_size(32)));
+		typedef s32   s32x8 __attribute__((vector_size(32)));
+		typedef u32   u32x8 __attribute__((vector_size(32)));
+		static_assert(sizeof(f32x8) == CPU_PACKET_SIZE * sizeof(float), "packet types don't match CPU_PACKET_SIZE");
+
+		struct V3 { f32x8 x, y, z; };
+		struct V4 { f32x8 r, g, b, a; };
+
+		inline f32x8 splat(float f) { return f32x8{} + f; }
+		inline V3 splat3(const vec3& v) { return { splat(v.x), splat(v.y), splat(v.z) }; }
+
+		inline f32x8 select(s32x8 mask, f32x8 a, f32x8 b) { return (f32x8) (((s32x8) a & mask) | ((s32x8) b & ~mask)); }
+		inline f32x8 min8(f32x8 a, f32x8 b) { return select(a < b, a, b); }
+		inline f32x8 max8(f32x8 a, f32x8 b) { return select(a > b, a, b); }
+		inline f32x8 clamp8(f32x8 v, float lo, float hi) { return min8(max8(v, splat(lo)), splat(hi)); }
+		inline f32x8 abs8(f32x8 v) { return (f32x8) ((s32x8) v & 0x7fffffff); }
+		inline s32x8 to_int(f32x8 v) { return __builtin_convertvector(v, s32x8); } // truncates
+		inline f32x8 to_float(u32x8 v) { return __builtin_convertvector((s32x8) v, f32x8); }
+
+#if defined(__AVX2__)
+		inline bool any(s32x8 mask) { return _mm256_movemask_ps((__m256) mask) != 0; }
+		inline f32x8 sqrt8(f32x8 v) { return (f32x8) _mm256_sqrt_ps((__m256) v); }
+		inline f32x8 floor8(f32x8 v) { return (f32x8) _mm256_floor_ps((__m256) v); }
+		inline u32x8 gather(const u32* base, s32x8 index) { return (u32x8) _mm256_i32gather_epi32((const int*) base, (__m256i) index, 4); }
+#else
+		inline bool any(s32x8 mask) { for (int i = 0; i < CPU_PACKET_SIZE; i++) if (mask[i]) return true; return false; }
+		inline f32x8 sqrt8(f32x8 v) { for (int i = 0; i < CPU_PACKET_SIZE; i++) v[i] = sqrtf(v[i]); return v; }
+		inline f32x8 floor8(f32x8 v) { for (int i = 0; i < CPU_PACKET_SIZE; i++) v[i] = floorf(v[i]); return v; }
+		inline u32x8 gather(const u32* base, s32x8 index) { u32x8 r; for (int i = 0; i < CPU_PACKET_SIZE; i++) r[i] = base[index[i]]; return r; }
+#endif
+		inline f32x8 pow8(f32x8 v, f32x8 e) { for (int i = 0; i < CPU_PACKET_SIZE; i++) v[i] = powf(v[i], e[i]); return v; }
+
+		inline V3 operator+(const V3& a, const V3& b) { return { a.x + b.x, a.y + b.y, a.z + b.z }; }
+		inline V3 operator-(const V3& a, const V3& b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+		inline V3 operator*(const V3& a, const V3& b) { return { a.x * b.x, a.y * b.y, a.z * b.z }; }
+		inline V3 operator*(const V3& a, f32x8 s) { return { a.x * s, a.y * s, a.z * s }; }
+		inline V3 operator*(const V3& a, float s) { return { a.x * s, a.y * s, a.z * s }; }
+		inline f32x8 dot(const V3& a, const V3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+		inline V3 cross(const V3& a, const V3& b) { return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x }; }
+		inline V3 normalize(const V3& v) { return v * (1.0f / sqrt8(dot(v, v))); }
+		inline V3 rgb(const V4& v) { return { v.r, v.g, v.b }; }
+
+		struct Tracer
+		{
+			G_Buffer_Dump& gbuffer;
+			Voxel_Grid_Dump& grid;
+			Cone_Tracing_Settings_Std140& settings;
+			u8* output;
+		};
+
+		struct Packet // CPU_PACKET_SIZE neighbouring pixels of a row, the f_ variables of the shader
+		{
+			s32x8 active; // inside the image and not background
+			V3 world_pos;
+			V3 voxel_pos; // -1.0 ... 1.0
+			V3 normal;
+			V4 albedo;
+			V4 specular; // a = shininess
+		};
+
+		//
+		// VOXEL GRID SAMPLING
+		// textureLod() with GL_LINEAR_MIPMAP_LINEAR / GL_NEAREST filters and a transparent GL_CLAMP_TO_BORDER, see texture3D::init
+		//
+		inline V4 unpack_rgba8(u32x8 t)
+		{
+			const float scale = 1.0f / 255.0f;
+			return { to_float(t & 0xff) * scale, to_float((t >> 8) & 0xff) * scale, to_float((t >> 16) & 0xff) * scale, to_float(t >> 24) * scale };
+		}
+
+		V4 sample_level_nearest(const Voxel_Grid_Dump& grid, int level, const V3& uvw)
+		{
+			int dim = grid.resolution >> level;
+			const u32* texels = grid.texels + grid.level_offsets[level];
+
+			s32x8 x = to_int(floor8(uvw.x * float(dim)));
+			s32x8 y = to_int(floor8(uvw.y * float(dim)));
+			s32x8 z = to_int(floor8(uvw.z * float(dim)));
+			s32x8 inside = (x >= 0) & (x < dim) & (y >= 0) & (y < dim) & (z >= 0) & (z < dim);
+
+			u32x8 t = gather(texels, (x + dim * (y + dim * z)) & inside) & (u32x8) inside;
+			return unpack_rgba8(t);
+		}
+
+		V4 sample_level_linear(const Voxel_Grid_Dump& grid, int level, const V3& uvw)
+		{
+			int dim = grid.resolution >> level;
+			const u32* texels = grid.texels + grid.level_offsets[level];
+
+			f32x8 x = uvw.x * float(dim) - 0.5f;
+			f32x8 y = uvw.y * float(dim) - 0.5f;
+			f32x8 z = uvw.z * float(dim) - 0.5f;
+			f32x8 x0 = floor8(x), y0 = floor8(y), z0 = floor8(z);
+			f32x8 fx = x - x0, fy = y - y0, fz = z - z0;
+			s32x8 ix = to_int(x0), iy = to_int(y0), iz = to_int(z0);
+
+			V4 result = {};
+			for (int corner = 0; corner < 8; corner++)
+			{
+				int dx = corner & 1, dy = (corner >> 1) & 1, dz = corner >> 2;
+				s32x8 cx = ix + dx, cy = iy + dy, cz = iz + dz;
+				s32x8 inside = (cx >= 0) & (cx < dim) & (cy >= 0) & (cy < dim) & (cz >= 0) & (cz < dim);
+
+				f32x8 weight = (dx ? fx : 1.0f - fx) * (dy ? fy : 1.0f - fy) * (dz ? fz : 1.0f - fz);
+				weight = select(inside, weight, splat(0.0f));
+
+				V4 t = unpack_rgba8(gather(texels, (cx + dim * (cy + dim * cz)) & inside)); // outside lanes read texel 0 with weight 0
+				result.r += t.r * weight;
+				result.g += t.g * weight;
+				result.b += t.b * weight;
+				result.a += t.a * weight;
+			}
+
+			return result;
+		}
+
+		V4 sample_voxel_grid(const Voxel_Grid_Dump& grid, const V3& uvw, float lod) // lod is uniform across the packet
+		{
+			if (!(lod > 0.0f))
+				return sample_level_nearest(grid, 0, uvw); // magnification
+
+			lod = glm::min(lod, float(grid.total_levels - 1));
+			int level = int(lod);
+			float t = lod - float(level);
+
+			V4 a = sample_level_linear(grid, level, uvw);
+			if (t == 0.0f)
+				return a;
+
+			V4 b = sample_level_linear(grid, level + 1, uvw);
+			return { a.r + (b.r - a.r) * t, a.g + (b.g - a.g) * t, a.b + (b.b - a.b) * t, a.a + (b.a - a.a) * t };
+		}
+
+		//
+		// CONE TRACING, see the functions with the same names in voxelconetracing_common.glsl
+		// the marching distance only depends on the cone settings so it's shared by the whole packet,
+		// lanes only differ in where they start, which way they go and when they are fully occluded
+		//
+		V4 trace_cone(const Tracer& tracer, const V3& start_clip_pos, V3 direction, float aperture, float distance_offset, float distance_max, float sampling_factor, s32x8 active)
+		{
+			aperture = glm::max(0.1f, aperture); // inf loop if 0
+			direction = normalize(direction);
+			float distance = distance_offset; // avoid self-collision
+			V4 accumulated = {}; // rgb + occlusion
+
+			float resolution = float(tracer.settings.voxel_grid_resolution);
+			float max_mipmap_level = float(tracer.settings.max_mipmap_level);
+
+			s32x8 tracing = active & (accumulated.a < splat(1.0f));
+			while (distance <= distance_max && any(tracing))
+			{
+				V3 cone_clip_pos = start_clip_pos + direction * distance;
+				V3 cone_voxelgrid_pos = cone_clip_pos * 0.5f + splat3(vec3(0.5f)); // from clipspace -1.0...1.0 to texcoords 0.0...1.0
+
+				float diameter = 2.0f * aperture * distance;
+				float mipmap_level = log2f(diameter * resolution);
+				V4 voxel_sample = sample_voxel_grid(tracer.grid, cone_voxelgrid_pos, glm::min(mipmap_level, max_mipmap_level));
+
+				// front to back composition, finished lanes keep their result
+				f32x8 transmittance = select(tracing, 1.0f - accumulated.a, splat(0.0f));
+				accumulated.r += transmittance * voxel_sample.r;
+				accumulated.g += transmittance * voxel_sample.g;
+				accumulated.b += transmittance * voxel_sample.b;
+				accumulated.a += transmittance * voxel_sample.a;
+
+				distance += diameter * sampling_factor;
+				tracing = active & (accumulated.a < splat(1.0f));
+			}
+
+			accumulated.a = min8(accumulated.a, splat(1.0f));
+			return accumulated;
+		}
+
+		// calc_indirect_diffuse() and calc_ambient_occlusion() in the shader, they only differ in the cone settings
+		V4 trace_diffuse_cones(const Tracer& tracer, const Packet& p, const Cone_Settings_Std140& cone)
+		{
+			// rotate cone around the normal
+			s32x8 is_parallel = abs8(p.normal.y) == splat(1.0f); // abs(dot(f_normal, guide)) == 1.0f
+			V3 guide = { splat(0.0f), select(is_parallel, splat(0.0f), splat(1.0f)), select(is_parallel, splat(1.0f), splat(0.0f)) };
+
+			// find a tangent and a bitangent
+			V3 right = normalize(guide - p.normal * dot(p.normal, guide));
+			V3 up = cross(right, p.normal);
+
+			V3 start_clip_pos = p.voxel_pos + p.normal * cone.distance_offset;
+
+			// the shader has the same set compiled in, see append_cone_set_defines
+			const Diffuse_Cone_Set& set = DIFFUSE_CONE_SETS[glm::clamp(tracer.settings.diffuse_cone_set, 0, int(TOTAL_DIFFUSE_CONE_SETS) - 1)];
+
+			V4 accumulated = {};
+			for (int i = 0; i < set.total_cones; i++)
+			{
+				V3 cone_direction = right * set.directions[i][0] + p.normal * set.directions[i][1] + up * set.directions[i][2];
+				V4 c = trace_cone(tracer, start_clip_pos, cone_direction, cone.aperture, cone.distance_offset, cone.max_distance, cone.sampling_factor, p.active);
+
+				float weight = set.weights[i];
+				accumulated.r += c.r * weight;
+				accumulated.g += c.g * weight;
+				accumulated.b += c.b * weight;
+				accumulated.a += c.a * weight;
+			}
+
+			return accumulated;
+		}
+
+		V4 calc_indirect_specular(const Tracer& tracer, const Packet& p)
+		{
+			const Cone_Settings_Std140& cone = tracer.settings.specular;
+
+			V3 view_direction = normalize(p.world_pos - splat3(tracer.gbuffer.camera_position));
+			V3 cone_direction = normalize(view_direction - p.normal * (2.0f * dot(p.normal, view_direction))); // reflect()
+
+			V3 start_clip_pos = p.voxel_pos + p.normal * cone.distance_offset;
+
+			V4 specular = trace_cone(tracer, start_clip_pos, cone_direction, cone.aperture, cone.distance_offset, cone.max_distance, cone.sampling_factor, p.active);
+			specular.r *= p.specular.r;
+			specular.g *= p.specular.g;
+			specular.b *= p.specular.b;
+			return specular;
+		}
+
+		V3 brdf(const Tracer& tracer, const Packet& p, const vec3& light_direction, float light_distance, const vec3& light_color, float strength, const vec3& attenuation) // blinn-phong
+		{
+			float attenuation_factor = strength / (attenuation.x + attenuation.y * light_distance + attenuation.z * light_distance * light_distance);
+
+			// diffuse
+			f32x8 diffuse_factor = max8(dot(p.normal, splat3(light_direction)), splat(0.0f));
+			V3 diffuse = splat3(light_color) * (diffuse_factor * attenuation_factor);
+
+			V3 to_light = splat3(light_direction) - p.world_pos;
+			V3 to_eye = splat3(tracer.gbuffer.camera_position) - p.world_pos;
+			V3 halfway = normalize(to_light + to_eye);
+			f32x8 cos_ref_angle = pow8(clamp8(dot(p.normal, halfway), 0.0f, 1.0f), p.specular.a);
+			V3 specular = rgb(p.specular) * splat3(light_color) * (cos_ref_angle * attenuation_factor);
+
+			return diffuse + specular;
+		}
+
+		V3 calc_direct_light(const Tracer& tracer, const Packet& p)
+		{
+			const Scene_Lights_Std140& lights = tracer.gbuffer.lights;
+			const Cone_Settings_Std140& shadow_cone = tracer.settings.softshadows;
+
+			V3 total_color = {};
+			for (int i = 0; i < lights.total_directional_lights; i++)
+			{
+				const Directional_Light_Std140& light = lights.directional_lights[i];
+
+				float light_distance = glm::length(light.direction);
+				vec3 light_direction = glm::normalize(light.direction);
+
+				f32x8 visibility = splat(1.0f);
+				if (tracer.settings.softshadows.is_enabled == 1) {
+					V3 start_clip_pos = p.voxel_pos + p.normal * shadow_cone.distance_offset;
+					V4 s = trace_cone(tracer, start_clip_pos, splat3(light_direction), shadow_cone.aperture, shadow_cone.distance_offset, shadow_cone.max_distance * 2.0f, shadow_cone.sampling_factor, p.active);
+					visibility = max8(splat(0.0f), 1.0f - s.a);
+				}
+
+				total_color = total_color + brdf(tracer, p, light_direction, light_distance, light.color, light.strength, light.attenuation) * visibility;
+			}
+
+			return total_color;
+		}
+
+		V3 shade(const Tracer& tracer, const Packet& p) // main() in the shader, without temporal accumulation and hard shadows
+		{
+			Cone_Tracing_Settings_Std140& settings = tracer.settings;
+
+			bool only_render_ao = (
+				settings.enable_direct_light == 0 &&
+				settings.diffuse.is_enabled == 0 &&
+				settings.specular.is_enabled == 0);
+
+			if (only_render_ao)
+			{
+				const Cone_Settings_Std140& cone = (settings.trace_ao_separately == 1) ? settings.ao : settings.diffuse;
+				f32x8 ao = clamp8(1.0f - trace_diffuse_cones(tracer, p, cone).a, 0.0f, 1.0f);
+				return { ao, ao, ao };
+			}
+
+			V3 albedo = rgb(p.albedo);
+			V3 direct_diffuse_color = {};
+			V3 indirect_diffuse_color = {};
+			V3 indirect_specular_color = {};
+			f32x8 ao = splat(0.0f);
+
+			if (settings.enable_direct_light == 1)
+				direct_diffuse_color = albedo * calc_direct_light(tracer, p);
+
+			if (settings.diffuse.is_enabled == 1) {
+				V4 diffuse = trace_diffuse_cones(tracer, p, settings.diffuse);
+				ao = diffuse.a;
+				indirect_diffuse_color = albedo * rgb(diffuse) * settings.diffuse.result_intensity;
+			}
+
+			if (settings.specular.is_enabled == 1)
+				indirect_specular_color = albedo * rgb(calc_indirect_specular(tracer, p)) * settings.specular.result_intensity;
+
+			f32x8 occlusion = p.albedo.a;
+			if (settings.ao.is_enabled == 1) {
+				if (settings.trace_ao_separately == 1 || settings.diffuse.is_enabled == 0)
+					occlusion = clamp8(1.0f - trace_diffuse_cones(tracer, p, settings.ao).a, 0.0f, 1.0f);
+				else
+					occlusion = clamp8(1.0f - ao, 0.0f, 1.0f);
+			}
+
+			V3 ambient_light = albedo * splat3(tracer.gbuffer.lights.ambient_light) * occlusion;
+			V3 total_light = ambient_light + direct_diffuse_color * settings.direct_light_intensity + indirect_specular_color + indirect_diffuse_color;
+
+			f32x8 inverse_gamma = splat(1.0f / settings.gamma);
+			return { pow8(total_light.x, inverse_gamma), pow8(total_light.y, inverse_gamma), pow8(total_light.z, inverse_gamma) };
+		}
+
+		void load_packet(const Tracer& tracer, Packet& p, int x0, int y)
+		{
+			G_Buffer_Dump& g = tracer.gbuffer;
+
+			for (int i = 0; i < CPU_PACKET_SIZE; i++)
+			{
+				int x = x0 + i;
+				int index = x + y * g.width;
+
+				// lanes outside the image or on the background get a valid normal so they don't produce NaNs
+				bool is_active = x < g.width && g.depth[index] != 1.0f;
+				vec4 position = is_active ? g.textures[G_Buffer_Dump::POSITION][index] : vec4(0.0f);
+				vec3 normal = is_active ? glm::normalize(vec3(g.textures[G_Buffer_Dump::NORMAL][index])) : vec3(0.0f, 1.0f, 0.0f);
+				vec4 albedo = is_active ? g.textures[G_Buffer_Dump::ALBEDO][index] : vec4(0.0f);
+				vec4 specular = is_active ? g.textures[G_Buffer_Dump::SPECULAR][index] : vec4(0.0f);
+
+				p.active[i] = is_active ? -1 : 0;
+				p.world_pos.x[i] = position.x; p.world_pos.y[i] = position.y; p.world_pos.z[i] = position.z;
+				p.normal.x[i] = normal.x; p.normal.y[i] = normal.y; p.normal.z[i] = normal.z;
+				p.albedo.r[i] = albedo.r; p.albedo.g[i] = albedo.g; p.albedo.b[i] = albedo.b; p.albedo.a[i] = albedo.a;
+				p.specular.r[i] = specular.r; p.specular.g[i] = specular.g; p.specular.b[i] = specular.b; p.specular.a[i] = specular.a;
+			}
+
+			p.voxel_pos = p.world_pos * splat3(g.voxel_scale);
+		}
+
+		void trace_row(const Tracer& tracer, int y)
+		{
+			int width = tracer.gbuffer.width;
+
+			for (int x0 = 0; x0 < width; x0 += CPU_PACKET_SIZE)
+			{
+				Packet p;
+				load_packet(tracer, p, x0, y);
+
+				V3 color = {};
+				if (any(p.active))
+					color = shade(tracer, p);
+
+				for (int i = 0; i < CPU_PACKET_SIZE && x0 + i < width; i++)
+				{
+					u8* out = tracer.output + 4 * (x0 + i + y * width);
+					bool is_active = p.active[i] != 0; // the background comes out black on the gpu too (no albedo)
+					out[0] = is_active ? u8(glm::clamp(color.x[i], 0.0f, 1.0f) * 255.0f + 0.5f) : 0;
+					out[1] = is_active ? u8(glm::clamp(color.y[i], 0.0f, 1.0f) * 255.0f + 0.5f) : 0;
+					out[2] = is_active ? u8(glm::clamp(color.z[i], 0.0f, 1.0f) * 255.0f + 0.5f) : 0;
+					out[3] = 255;
+				}
+			}
+		}
+
+		bool read_file(FILE* file, void* data, umm size) { return fread(data, size, 1, file) == 1; }
+		bool write_file(FILE* file, const void* data, umm size) { return fwrite(data, size, 1, file) == 1; }
+	}
+
+	namespace cpu_vct
+	{
+		void init(Voxel_Grid_Dump& grid, int resolution, int total_levels)
+		{
+			ASSERT(total_levels > 0 && total_levels <= MAX_VOXEL_GRID_LEVELS, "cpu_vct", "invalid amount of voxel grid levels (%d)", total_levels);
+
+			grid.resolution = resolution;
+			grid.total_levels = total_levels;
+
+			int total_texels = 0;
+			for (int level = 0; level < total_levels; level++) {
+				int dim = resolution >> level;
+				grid.level_offsets[level] = total_texels;
+				total_texels += dim * dim * dim;
+			}
+
+			grid.texels = new u32[total_texels];
+		}
+
+		void uninit(Voxel_Grid_Dump& grid)
+		{
+			delete[] grid.texels;
+			grid.texels = nullptr;
+		}
+
+		void init(G_Buffer_Dump& g, int width, int height)
+		{
+			g.width = width;
+			g.height = height;
+
+			for (int i = 0; i < G_Buffer_Dump::TOTAL_TEXTURES; i++)
+				g.textures[i] = new vec4[width * height];
+			g.depth = new float[width * height];
+		}
+
+		void uninit(G_Buffer_Dump& g)
+		{
+			for (int i = 0; i < G_Buffer_Dump::TOTAL_TEXTURES; i++) {
+				delete[] g.textures[i];
+				g.textures[i] = nullptr;
+			}
+			delete[] g.depth;
+			g.depth = nullptr;
+		}
+
+		bool save(Voxel_Grid_Dump& grid, const char* path)
+		{
+			FILE* file = fopen(path, "wb");
+			if (!file) {
+				LOG("cpu_vct", "couldn't open %s for writing", path);
+				return false;
+			}
+			defer { fclose(file); };
+
+			int last = grid.total_levels - 1;
+			int last_dim = grid.resolution >> last;
+			umm total_texels = umm(grid.level_offsets[last]) + umm(last_dim * last_dim * last_dim);
+			s32 header[] = { s32(VOXEL_GRID_DUMP_MAGIC), s32(DUMP_VERSION), grid.resolution, grid.total_levels };
+
+			return write_file(file, header, sizeof(header)) && write_file(file, grid.texels, sizeof(u32) * total_texels);
+		}
+
+		bool load(Voxel_Grid_Dump& grid, const char* path)
+		{
+			FILE* file = fopen(path, "rb");
+			if (!file) {
+				LOG("cpu_vct", "couldn't open %s", path);
+				return false;
+			}
+			defer { fclose(file); };
+
+			s32 header[4];
+			if (!read_file(file, header, sizeof(header)) || u32(header[0]) != VOXEL_GRID_DUMP_MAGIC || u32(header[1]) != DUMP_VERSION) {
+				LOG("cpu_vct", "%s isn't a voxel grid dump (version %u)", path, DUMP_VERSION);
+				return false;
+			}
+
+			init(grid, header[2], header[3]);
+
+			int last = grid.total_levels - 1;
+			int last_dim = grid.resolution >> last;
+			umm total_texels = umm(grid.level_offsets[last]) + umm(last_dim * last_dim * last_dim);
+
+			return read_file(file, grid.texels, sizeof(u32) * total_texels);
+		}
+
+		bool save(G_Buffer_Dump& g, const char* path)
+		{
+			FILE* file = fopen(path, "wb");
+			if (!file) {
+				LOG("cpu_vct", "couldn't open %s for writing", path);
+				return false;
+			}
+			defer { fclose(file); };
+
+			umm pixels = umm(g.width * g.height);
+			s32 header[] = { s32(G_BUFFER_DUMP_MAGIC), s32(DUMP_VERSION), g.width, g.height };
+
+			bool ok = write_file(file, header, sizeof(header))
+				&& write_file(file, &g.voxel_scale, sizeof(g.voxel_scale))
+				&& write_file(file, &g.camera_position, sizeof(g.camera_position))
+				&& write_file(file, &g.settings, sizeof(g.settings))
+				&& write_file(file, &g.lights, sizeof(g.lights));
+
+			for (int i = 0; i < G_Buffer_Dump::TOTAL_TEXTURES; i++)
+				ok = ok && write_file(file, g.textures[i], sizeof(vec4) * pixels);
+
+			return ok && write_file(file, g.depth, sizeof(float) * pixels);
+		}
+
+		bool load(G_Buffer_Dump& g, const char* path)
+		{
+			FILE* file = fopen(path, "rb");
+			if (!file) {
+				LOG("cpu_vct", "couldn't open %s", path);
+				return false;
+			}
+			defer { fclose(file); };
+
+			s32 header[4];
+			if (!read_file(file, header, sizeof(header)) || u32(header[0]) != G_BUFFER_DUMP_MAGIC || u32(header[1]) != DUMP_VERSION) {
+				LOG("cpu_vct", "%s isn't a g-buffer dump (version %u)", path, DUMP_VERSION);
+				return false;
+			}
+
+			init(g, header[2], header[3]);
+			umm pixels = umm(g.width * g.height);
+
+			bool ok = read_file(file, &g.voxel_scale, sizeof(g.voxel_scale))
+				&& read_file(file, &g.camera_position, sizeof(g.camera_position))
+				&& read_file(file, &g.settings, sizeof(g.settings))
+				&& read_file(file, &g.lights, sizeof(g.lights));
+
+			for (int i = 0; i < G_Buffer_Dump::TOTAL_TEXTURES; i++)
+				ok = ok && read_file(file, g.textures[i], sizeof(vec4) * pixels);
+
+			return ok && read_file(file, g.depth, sizeof(float) * pixels);
+		}
+
+		void render(G_Buffer_Dump& gbuffer, Voxel_Grid_Dump& grid, u8* rgba_out)
+		{
+			if (gbuffer.settings.enable_hard_shadows)
+				LOG("cpu_vct", "hard shadows aren't part of the dump, rendering without them");
+			if (gbuffer.settings.temporal.is_enabled)
+				LOG("cpu_vct", "temporal accumulation is ignored, every diffuse cone is traced");
+
+			Tracer tracer = { gbuffer, grid, gbuffer.settings, rgba_out };
+			jobs::parallel_for(gbuffer.height, [&tracer](int y) { trace_row(tracer, y); });
+		}
+
+		bool write_ppm(const char* path, int width, int height, const u8* rgba)
+		{
+			FILE* file = fopen(path, "wb");
+			if (!file) {
+				LOG("cpu_vct", "couldn't open %s for writing", path);
+				return false;
+			}
+			defer { fclose(file); };
+
+			fprintf(file, "P6\n%d %d\n255\n", width, height);
+			for (int y = height - 1; y >= 0; y--) {
+				for (int x = 0; x < width; x++) {
+					const u8* p = rgba + 4 * (x + y * width);
+					fputc(p[0], file);
+					fputc(p[1], file);
+					fputc(p[2], file);
+				}
+			}
+
+			return ferror(file) == 0;
+		}
+
+		bool run_reference(const char* gbuffer_path, const char* voxel_grid_path, const char* output_path)
+		{
+			G_Buffer_Dump gbuffer;
+			Voxel_Grid_Dump grid;
+			defer { uninit(gbuffer); uninit(grid); };
+
+			if (!load(gbuffer, gbuffer_path) || !load(grid, voxel_grid_path))
+				return false;
+
+			jobs::init();
+			defer { jobs::uninit(); };
+
+			u8* image = new u8[4 * gbuffer.width * gbuffer.height];
+			defer { delete[] image; };
+
+			auto start = std::chrono::steady_clock::now();
+			render(gbuffer, grid, image);
+			std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+#if defined(__AVX2__)
+			const char* simd = "avx2";
+#else
+			const char* simd = "no avx2";
+#endif
+			LOG("cpu_vct", "traced %dx%d pixels with a %d^3 voxel grid in %.1f ms (%d threads, %s)", gbuffer.width, gbuffer.height, grid.resolution, elapsed.count(), jobs::get_total_workers() + 1, simd);
+
+			if (!write_ppm(output_path, gbuffer.width, gbuffer.height, image))
+				return false;
+
+			LOG("cpu_vct", "wrote %s", output_path);
+			return true;
+		}
+	}
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "opengl.h"
+#include "scene.h"
+#include "voxel_cone_tracing.h"
+
+// CPU port of voxelconetracing_common.glsl for reference images and offline GI (no GL context needed).
+// Runs on dumps of the cone tracing pass inputs, see renderer::dump_cone_tracing_inputs.
+// Pixels are traced in packets of CPU_PACKET_SIZE lanes (AVX2 when enabled), rows are spread over jobs::.
+
+namespace vxgi
+{
+	const int CPU_PACKET_SIZE = 8; // pixels per packet, one 256-bit register of floats
+	const int MAX_VOXEL_GRID_LEVELS = 16;
+
+	struct Voxel_Grid_Dump // rgba8 mip pyramid of the voxel grid, as stored in the 3D texture
+	{
+		int resolution = 0;
+		int total_levels = 0;
+		int level_offsets[MAX_VOXEL_GRID_LEVELS] = {}; // in texels
+		u32* texels = nullptr; // every level back to back, level 0 first, x fastest
+	};
+
+	struct G_Buffer_Dump // everything the cone tracing pass reads for one frame
+	{
+		int width = 0;
+		int height = 0;
+		vec3 voxel_scale = vec3(1.0f);
+		vec3 camera_position = vec3(0.0f);
+		Cone_Tracing_Settings_Std140 settings = {}; // same layout as the shader sees
+		Scene_Lights_Std140 lights = {};
+
+		enum Texture_Type : int // decoded, the gpu g-buffer is packed (see G_Buffer in opengl.h)
+		{
+			POSITION = 0,
+			NORMAL,
+			BUMP,
+			ALBEDO,
+			SPECULAR, // alpha = shininess
+			TOTAL_TEXTURES
+		};
+
+		vec4* textures[TOTAL_TEXTURES] = {}; // rows bottom to top, like GL
+		float* depth = nullptr;
+	};
+
+	namespace cpu_vct
+	{
+		void init(Voxel_Grid_Dump&, int resolution, int total_levels); // allocates the texels
+		void uninit(Voxel_Grid_Dump&);
+		void init(G_Buffer_Dump&, int width, int height);
+		void uninit(G_Buffer_Dump&);
+
+		// native endian binary files
+		bool save(Voxel_Grid_Dump&, const char* path);
+		bool load(Voxel_Grid_Dump&, const char* path);
+		bool save(G_Buffer_Dump&, const char* path);
+		bool load(G_Buffer_Dump&, const char* path);
+
+		void render(G_Buffer_Dump&, Voxel_Grid_Dump&, u8* rgba_out); // width * height rgba8, rows bottom to top like the gpu output
+		bool write_ppm(const char* path, int width, int height, const u8* rgba); // rgba rows bottom to top
+
+		bool run_reference(const char* gbuffer_path, const char* voxel_grid_path, const char* output_path); // --reference on the command line
+	}
+}
@@ -0,0 +1,201 @@
+#include "cpu_profiler.h"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include "lib/imgui/imgui.h"
+
+#include "containers.hpp"
+
+namespace vxgi
+{
+	namespace
+	{
+		const char* CPU_TRACE_PATH = "cpu_trace.json";
+
+		struct Cpu_Zone
+		{
+			const char* name;
+			u64 begin_ns;
+			u64 end_ns;
+		};
+
+		struct Cpu_Thread // written by its thread only
+		{
+			char name[32];
+			int id; // its track
+			Cpu_Zone* zones; // a ring of CPU_PROFILER_EVENTS_PER_THREAD, in the order they ended
+			std::atomic<u64> total_zones; // ever recorded, published after the zone is written
+
+			const char* open_names[CPU_PROFILER_MAX_DEPTH]; // NULL = not recorded
+			u64 open_begin_ns[CPU_PROFILER_MAX_DEPTH];
+			int depth;
+		};
+
+		struct Cpu_Profiler
+		{
+			std::mutex lock; // for threads
+			Array<Cpu_Thread*> threads;
+			std::atomic<bool> is_enabled { true };
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		};
+
+		Cpu_Profiler& get_profiler() {
+			static Cpu_Profiler profiler;
+			return profiler;
+		}
+
+		thread_local Cpu_Thread* current_thread = nullptr;
+
+		u64 get_time_ns()
+		{
+			return u64(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - get_profiler().start).count());
+		}
+
+		Cpu_Thread& get_thread()
+		{
+			if (current_thread)
+				return *current_thread;
+
+			Cpu_Profiler& profiler = get_profiler();
+			Cpu_Thread* thread = new Cpu_Thread;
+			thread->zones = new Cpu_Zone[CPU_PROFILER_EVENTS_PER_THREAD];
+			thread->total_zones = 0;
+			thread->depth = 0;
+			{
+				std::lock_guard<std::mutex> guard(profiler.lock);
+				thread->id = array::size(profiler.threads);
+				array::add(profiler.threads, thread);
+			}
+			snprintf(thread->name, sizeof(thread->name), "thread %d", thread->id);
+
+			current_thread = thread;
+			return *thread;
+		}
+	}
+
+	namespace cpuprofiler
+	{
+		void uninit()
+		{
+			Cpu_Profiler& profiler = get_profiler();
+			std::lock_guard<std::mutex> guard(profiler.lock);
+			for (Cpu_Thread* thread : profiler.threads) {
+				delete[] thread->zones;
+				delete thread;
+			}
+			array::uninit(profiler.threads);
+			current_thread = nullptr;
+		}
+
+		void set_thread_name(const char* name)
+		{
+			Cpu_Thread& thread = get_thread();
+			snprintf(thread.name, sizeof(thread.name), "%s", name);
+		}
+
+		void set_enabled(bool is_enabled)
+		{
+			get_profiler().is_enabled = is_enabled;
+		}
+
+		bool is_enabled()
+		{
+			return get_profiler().is_enabled;
+		}
+
+		void begin(const char* name)
+		{
+			Cpu_Thread& thread = get_thread();
+			if (thread.depth < CPU_PROFILER_MAX_DEPTH) {
+				bool is_recorded = get_profiler().is_enabled.load(std::memory_order_relaxed);
+				thread.open_names[thread.depth] = is_recorded ? name : NULL;
+				thread.open_begin_ns[thread.depth] = is_recorded ? get_time_ns() : 0;
+			}
+			thread.depth++;
+		}
+
+		void end()
+		{
+			Cpu_Thread& thread = get_thread();
+			ASSERT(thread.depth > 0, "cpuprofiler", "end without a begin on %s", thread.name);
+
+			thread.depth--;
+			if (thread.depth >= CPU_PROFILER_MAX_DEPTH || !thread.open_names[thread.depth])
+				return;
+
+			u64 index = thread.total_zones.load(std::memory_order_relaxed);
+			thread.zones[index % CPU_PROFILER_EVENTS_PER_THREAD] = { thread.open_names[thread.depth], thread.open_begin_ns[thread.depth], get_time_ns() };
+			thread.total_zones.store(index + 1, std::memory_order_release);
+		}
+
+		bool export_chrome_trace(const char* path)
+		{
+			FILE* file = fopen(path, "w");
+			if (!file) {
+				LOG("cpuprofiler", "couldn't open %s for writing", path);
+				return false;
+			}
+			defer { fclose(file); };
+
+			Cpu_Profiler& profiler = get_profiler();
+			std::lock_guard<std::mutex> guard(profiler.lock);
+
+			// complete events ("X") in microseconds, and a name per track
+			int total_written = 0;
+			fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+			for (Cpu_Thread* thread : profiler.threads) {
+				fprintf(file, "%s{\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"name\":\"thread_name\",\"args\":{\"name\":", total_written > 0 ? ",\n" : "", thread->id);
+				write_json_string(file, thread->name);
+				fprintf(file, "}},\n{\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"name\":\"thread_sort_index\",\"args\":{\"sort_index\":%d}}", thread->id, thread->id);
+				total_written++;
+
+				u64 total = thread->total_zones.load(std::memory_order_acquire);
+				u64 first = total > u64(CPU_PROFILER_EVENTS_PER_THREAD) ? total - CPU_PROFILER_EVENTS_PER_THREAD : 0;
+				for (u64 i = first; i < total; i++) {
+					Cpu_Zone& zone = thread->zones[i % CPU_PROFILER_EVENTS_PER_THREAD];
+					fprintf(file, ",\n{\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,\"name\":", thread->id, double(zone.begin_ns) / 1000.0, double(zone.end_ns - zone.begin_ns) / 1000.0);
+					write_json_string(file, zone.name);
+					fputc('}', file);
+					total_written++;
+				}
+			}
+			fprintf(file, "\n]}\n");
+
+			LOG("cpuprofiler", "wrote %d zones of %d threads to %s", total_written - int(array::size(profiler.threads)), int(array::size(profiler.threads)), path);
+			return true;
+		}
+
+		void write_json_string(FILE* file, const char* s)
+		{
+			fputc('"', file);
+			for (; s && *s; s++) {
+				if (*s == '"' || *s == '\\')
+					fputc('\\', file);
+				if (u8(*s) >= 0x20)
+					fputc(*s, file);
+			}
+			fputc('"', file);
+		}
+
+		void render_ui()
+		{
+			using namespace ImGui;
+
+			bool is_recording = is_enabled();
+			if (Checkbox("record zones", &is_recording))
+				set_enabled(is_recording);
+			if (Button("export chrome trace"))
+				export_chrome_trace(CPU_TRACE_PATH);
+			if (IsItemHovered())
+				SetTooltip("%s in the working directory, for chrome://tracing or ui.perfetto.dev", CPU_TRACE_PATH);
+
+			Cpu_Profiler& profiler = get_profiler();
+			std::lock_guard<std::mutex> guard(profiler.lock);
+			for (Cpu_Thread* thread : profiler.threads) {
+				u64 total = thread->total_zones.load(std::memory_order_relaxed);
+				Text("%s: %llu zones%s", thread->name, (unsigned long long) total, total > u64(CPU_PROFILER_EVENTS_PER_THREAD) ? ", the oldest overwritten" : "");
+			}
+		}
+	}
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "types.h"
+
+// Scoped zones on the cpu: CPU_ZONE("name"); records the steady clock at that line and at the end of the block into a
+// ring buffer of the calling thread, so recording never takes a lock. A thread's buffer is made and registered the
+// first time it records and is kept until uninit, its track in the trace is named by set_thread_name. The zones of every
+// thread can be written as a Chrome trace (chrome://tracing, ui.perfetto.dev), one track per thread.
+
+#define CPU_ZONE(name) vxgi::cpuprofiler::begin(name); defer { vxgi::cpuprofiler::end(); }
+
+namespace vxgi
+{
+	const int CPU_PROFILER_EVENTS_PER_THREAD = 1 << 15; // the latest ones are kept
+	const int CPU_PROFILER_MAX_DEPTH = 32; // deeper zones aren't recorded
+
+	namespace cpuprofiler
+	{
+		void uninit(); // once the other threads are gone
+
+		void set_thread_name(const char* name); // copied, for the calling thread's track
+		void set_enabled(bool);
+		bool is_enabled();
+
+		void begin(const char* name); // the name has to outlive the profiler, a string literal
+		void end();
+
+		bool export_chrome_trace(const char* path); // every thread's zones so far, call it while the job threads are idle
+		void write_json_string(FILE*, const char* s); // quoted and escaped, NULL is "". also for the benchmark report
+
+		void render_ui();
+	}
+}
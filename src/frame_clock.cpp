@@ -0,0 +1,164 @@
+#include "frame_clock.h"
+
+#include <algorithm>
+#include <chrono>
+#include "lib/imgui/imgui.h"
+
+#include "containers.hpp"
+
+namespace vxgi
+{
+	namespace
+	{
+		const char* FRAME_TIMING_NAMES[] = // see FRAME_TIMING
+		{
+			"cpu",
+			"gpu",
+			"present",
+		};
+
+		double get_time_s()
+		{
+			static std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+			return elapsed.count();
+		}
+
+		void add_sample(Frame_Clock::History& history, float ms)
+		{
+			history.samples[history.next_sample] = ms;
+			history.next_sample = (history.next_sample + 1) % FRAME_CLOCK_HISTORY;
+			history.total_samples = glm::min(history.total_samples + 1, FRAME_CLOCK_HISTORY);
+		}
+	}
+
+	namespace frameclock
+	{
+		float begin_frame(Frame_Clock& clock)
+		{
+			double now = get_time_s();
+			if (clock.frame_begin_s >= 0.0) {
+				clock.unclamped_dt = float(now - clock.frame_begin_s);
+				clock.dt = glm::clamp(clock.unclamped_dt, FRAME_CLOCK_MIN_DT, FRAME_CLOCK_MAX_DT);
+				if (clock.dt != clock.unclamped_dt)
+					clock.clamped_frames++;
+			}
+			clock.frame_begin_s = now;
+			clock.frame++;
+			return clock.dt;
+		}
+
+		void end_cpu(Frame_Clock& clock)
+		{
+			add_sample(clock.histories[FRAME_TIMING_CPU], float(1000.0 * (get_time_s() - clock.frame_begin_s)));
+		}
+
+		void end_frame(Frame_Clock& clock)
+		{
+			double now = get_time_s();
+			if (clock.last_present_s >= 0.0)
+				add_sample(clock.histories[FRAME_TIMING_PRESENT], float(1000.0 * (now - clock.last_present_s)));
+			clock.last_present_s = now;
+		}
+
+		void add_gpu_samples(Frame_Clock& clock, const float* ring, int ring_size, int ring_next)
+		{
+			// a frame can read back a few at once, or none
+			for (; clock.next_gpu_sample != ring_next; clock.next_gpu_sample = (clock.next_gpu_sample + 1) % ring_size)
+				add_sample(clock.histories[FRAME_TIMING_GPU], ring[clock.next_gpu_sample]);
+		}
+
+		void reset(Frame_Clock& clock, int next_gpu_sample)
+		{
+			for (Frame_Clock::History& history : clock.histories)
+				history = {};
+			clock.last_present_s = -1.0; // the interval from before the reset isn't counted
+			clock.next_gpu_sample = next_gpu_sample;
+			clock.clamped_frames = 0;
+		}
+
+		Timing_Stats get_stats(Frame_Clock& clock, FRAME_TIMING timing)
+		{
+			Frame_Clock::History& history = clock.histories[timing];
+			return get_timing_stats(history.samples, history.total_samples); // the ring is full or starts at 0
+		}
+
+		Timing_Stats get_timing_stats(const float* samples_ms, int total_samples)
+		{
+			Timing_Stats stats = {};
+			int n = total_samples;
+			stats.total_samples = n;
+			if (n == 0)
+				return stats;
+
+			Array<float> sorted;
+			defer { array::uninit(sorted); };
+			array::set_length(sorted, n);
+			memcpy(sorted.data, samples_ms, sizeof(float) * n);
+			std::sort(sorted.data, sorted.data + n);
+
+			auto percentile = [&](float p) { return sorted[glm::clamp(int(ceilf(p * float(n))) - 1, 0, n - 1)]; }; // nearest rank
+			double sum = 0.0;
+			for (int i = 0; i < n; i++)
+				sum += sorted[i];
+
+			stats.min_ms = sorted[0];
+			stats.average_ms = float(sum / double(n));
+			stats.p50_ms = percentile(0.50f);
+			stats.p95_ms = percentile(0.95f);
+			stats.p99_ms = percentile(0.99f);
+			stats.max_ms = sorted[n - 1];
+			return stats;
+		}
+
+		float get_latest(Frame_Clock& clock, FRAME_TIMING timing)
+		{
+			Frame_Clock::History& history = clock.histories[timing];
+			if (history.total_samples == 0)
+				return 0.0f;
+			return history.samples[(history.next_sample + FRAME_CLOCK_HISTORY - 1) % FRAME_CLOCK_HISTORY];
+		}
+
+		const char* get_name(FRAME_TIMING timing)
+		{
+			return FRAME_TIMING_NAMES[timing];
+		}
+
+		void render_ui(Frame_Clock& clock)
+		{
+			using namespace ImGui;
+
+			Text("dt %.2f ms (%.2f unclamped), %d frames clamped to %.0f ms", clock.dt * 1000.0f, clock.unclamped_dt * 1000.0f, clock.clamped_frames, FRAME_CLOCK_MAX_DT * 1000.0f);
+			Text("%-8s %8s %8s %8s %8s %8s", "ms", "min", "avg", "p95", "p99", "max");
+			for (u32 i = 0; i < FRAME_TIMING_COUNT; i++) {
+				Timing_Stats stats = get_stats(clock, FRAME_TIMING(i));
+				Text("%-8s %8.2f %8.2f %8.2f %8.2f %8.2f", FRAME_TIMING_NAMES[i], stats.min_ms, stats.average_ms, stats.p95_ms, stats.p99_ms, stats.max_ms);
+			}
+
+			// per timing, the last FRAME_CLOCK_HISTORY frames oldest first and how their times are distributed. both go
+			// up to 1.25 * p99, the frames above that are in the last bin
+			for (u32 i = 0; i < FRAME_TIMING_COUNT; i++) {
+				Frame_Clock::History& history = clock.histories[i];
+				Timing_Stats stats = get_stats(clock, FRAME_TIMING(i));
+				float range_ms = glm::max(stats.p99_ms * 1.25f, 1.0f);
+
+				int offset = (history.total_samples == FRAME_CLOCK_HISTORY) ? history.next_sample : 0;
+				char label[32], overlay[64];
+				snprintf(label, sizeof(label), "%s ms", FRAME_TIMING_NAMES[i]);
+				snprintf(overlay, sizeof(overlay), "avg %.2f ms", stats.average_ms);
+				PlotLines(label, history.samples, history.total_samples, offset, overlay, 0.0f, range_ms, ImVec2(0.0f, 40.0f));
+
+				float bins[FRAME_CLOCK_HISTOGRAM_BINS] = {};
+				float max_count = 0.0f;
+				for (int s = 0; s < history.total_samples; s++) {
+					int bin = glm::clamp(int(history.samples[s] / range_ms * float(FRAME_CLOCK_HISTOGRAM_BINS)), 0, FRAME_CLOCK_HISTOGRAM_BINS - 1);
+					bins[bin] += 1.0f;
+					max_count = glm::max(max_count, bins[bin]);
+				}
+				snprintf(label, sizeof(label), "%s frames", FRAME_TIMING_NAMES[i]);
+				snprintf(overlay, sizeof(overlay), "0 ... %.1f ms, %.2f ms a bin", range_ms, range_ms / float(FRAME_CLOCK_HISTOGRAM_BINS));
+				PlotHistogram(label, bins, FRAME_CLOCK_HISTOGRAM_BINS, 0, overlay, 0.0f, max_count, ImVec2(0.0f, 60.0f));
+			}
+		}
+	}
+}
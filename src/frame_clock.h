@@ -0,0 +1,68 @@
+#pragma once
+
+#include "types.h"
+
+// Real frame timing from the steady clock: begin_frame returns the seconds since the previous frame began, clamped so a
+// hitch (a breakpoint, a revoxelization, a dragged window) doesn't move the camera across the scene. Every frame also adds
+// a sample of its cpu time (begin_frame to end_cpu, the swap isn't in it) and its present interval (end_frame to
+// end_frame, what the user sees) to a ring of FRAME_CLOCK_HISTORY frames. The gpu time arrives a few frames late from
+// the gpu profiler, see add_gpu_samples.
+
+namespace vxgi
+{
+	const int FRAME_CLOCK_HISTORY = 512; // frames
+	const float FRAME_CLOCK_MIN_DT = 1.0f / 1000.0f; // seconds
+	const float FRAME_CLOCK_MAX_DT = 1.0f / 10.0f;
+	const float FRAME_CLOCK_FIRST_DT = 1.0f / 60.0f; // before there's a previous frame
+	const int FRAME_CLOCK_HISTOGRAM_BINS = 32; // of the distribution in the ui, 0 ... 1.25 * p99
+
+	struct Timing_Stats // of a set of samples, nearest rank percentiles. the frame clock's, the gpu profiler's and the benchmark's
+	{
+		int total_samples;
+		float min_ms, average_ms, p50_ms, p95_ms, p99_ms, max_ms;
+	};
+
+	enum FRAME_TIMING : u32
+	{
+		FRAME_TIMING_CPU,
+		FRAME_TIMING_GPU,
+		FRAME_TIMING_PRESENT,
+		FRAME_TIMING_COUNT
+	};
+
+	struct Frame_Clock
+	{
+		struct History
+		{
+			float samples[FRAME_CLOCK_HISTORY]; // ms, a ring
+			int total_samples;
+			int next_sample;
+		};
+
+		History histories[FRAME_TIMING_COUNT] = {};
+		double frame_begin_s = -1.0; // of the steady clock, -1 = no frame yet
+		double last_present_s = -1.0;
+		int next_gpu_sample = 0; // of the gpu profiler's frame ring, taken up to here
+
+		float dt = FRAME_CLOCK_FIRST_DT; // seconds, clamped
+		float unclamped_dt = FRAME_CLOCK_FIRST_DT;
+		u64 frame = 0; // begun
+		int clamped_frames = 0;
+	};
+
+	namespace frameclock
+	{
+		float begin_frame(Frame_Clock&); // the clamped dt in seconds
+		void end_cpu(Frame_Clock&); // the frame is submitted, before the swap
+		void end_frame(Frame_Clock&); // after the swap
+		void add_gpu_samples(Frame_Clock&, const float* ring, int ring_size, int ring_next); // the entries the gpu profiler's frame scope got since the last call, once per frame
+		void reset(Frame_Clock&, int next_gpu_sample); // clears the histories, e.g. after a benchmark's warm up
+
+		Timing_Stats get_stats(Frame_Clock&, FRAME_TIMING);
+		Timing_Stats get_timing_stats(const float* samples_ms, int total_samples); // in any order
+		float get_latest(Frame_Clock&, FRAME_TIMING); // ms, 0 before the first sample
+		const char* get_name(FRAME_TIMING);
+
+		void render_ui(Frame_Clock&);
+	}
+}
@@ -0,0 +1,242 @@
+#include "frustum_culling.h"
+
+#include <algorithm>
+#include <GLFW/glfw3.h>
+#include "lib/imgui/imgui.h"
+
+#include "cpu_profiler.h"
+#include "jobs.h"
+
+namespace vxgi
+{
+	namespace
+	{
+		const int MAX_ITEMS_PER_LEAF = 4;
+		const int SUBTREES_PER_THREAD = 4; // jobs of a cull, the tree is rarely balanced in the amount of visible nodes
+
+		enum FRUSTUM_TEST { OUTSIDE, INTERSECTS, INSIDE };
+
+		FRUSTUM_TEST test_box(const Frustum& f, vec3 min_point, vec3 max_point)
+		{
+			FRUSTUM_TEST result = INSIDE;
+			for (const vec4& plane : f.planes) {
+				vec3 n = vec3(plane);
+				vec3 farthest = glm::mix(min_point, max_point, glm::greaterThan(n, vec3(0.0f))); // the corner furthest along the normal
+				vec3 nearest = glm::mix(max_point, min_point, glm::greaterThan(n, vec3(0.0f)));
+
+				if (glm::dot(n, farthest) + plane.w < 0.0f)
+					return OUTSIDE;
+				if (glm::dot(n, nearest) + plane.w < 0.0f)
+					result = INTERSECTS;
+			}
+			return result;
+		}
+
+		int build_node(Frustum_Culling& c, int node_index, int first_item, int total_items)
+		{
+			Frustum_Culling::Item* items = &c.items[first_item];
+
+			vec3 min_point = vec3(MAX_FLOAT_VALUE), max_point = vec3(MIN_FLOAT_VALUE);
+			vec3 min_center = vec3(MAX_FLOAT_VALUE), max_center = vec3(MIN_FLOAT_VALUE);
+			for (int i = 0; i < total_items; i++) {
+				min_point = glm::min(min_point, items[i].bounds.min_point);
+				max_point = glm::max(max_point, items[i].bounds.max_point);
+				min_center = glm::min(min_center, items[i].bounds.center);
+				max_center = glm::max(max_center, items[i].bounds.center);
+			}
+
+			c.nodes[node_index].min_point = min_point;
+			c.nodes[node_index].max_point = max_point;
+
+			if (total_items <= MAX_ITEMS_PER_LEAF) {
+				c.nodes[node_index].first = first_item;
+				c.nodes[node_index].total_items = total_items;
+				return 1;
+			}
+
+			// median split along the longest axis of the centers
+			vec3 size = max_center - min_center;
+			int axis = (size.x > size.y && size.x > size.z) ? 0 : (size.y > size.z ? 1 : 2);
+			int half = total_items / 2;
+			std::nth_element(items, items + half, items + total_items, [axis](const Frustum_Culling::Item& a, const Frustum_Culling::Item& b) {
+				return a.bounds.center[axis] < b.bounds.center[axis];
+			});
+
+			int first_child = array::size(c.nodes);
+			array::add(c.nodes, {});
+			array::add(c.nodes, {}); // don't hold on to node references, this reallocates
+			c.nodes[node_index].first = first_child;
+			c.nodes[node_index].total_items = 0;
+
+			int depth = build_node(c, first_child, first_item, half);
+			depth = glm::max(depth, build_node(c, first_child + 1, first_item + half, total_items - half));
+			return depth + 1;
+		}
+
+		void mark_visible(Frustum_Culling& c, int node_index, Array<u8>& out_visible)
+		{
+			Frustum_Culling::Node& node = c.nodes[node_index];
+			if (node.total_items > 0) {
+				for (int i = node.first; i < node.first + node.total_items; i++)
+					out_visible[c.items[i].index] = 1;
+			} else {
+				mark_visible(c, node.first, out_visible);
+				mark_visible(c, node.first + 1, out_visible);
+			}
+		}
+
+		// frustum_mask = the frustums the parent intersects, the others have either rejected or accepted it already
+		void cull_node(Frustum_Culling& c, int node_index, const Frustum* frustums, u32 frustum_mask, Array<u8>& out_visible)
+		{
+			Frustum_Culling::Node& node = c.nodes[node_index];
+
+			u32 intersecting = 0;
+			for (int f = 0; f < MAX_CULLING_FRUSTUMS; f++) {
+				if (!(frustum_mask & (1u << f)))
+					continue;
+
+				FRUSTUM_TEST test = test_box(frustums[f], node.min_point, node.max_point);
+				if (test == INSIDE) {
+					mark_visible(c, node_index, out_visible);
+					return;
+				}
+				if (test == INTERSECTS)
+					intersecting |= 1u << f;
+			}
+
+			if (!intersecting)
+				return;
+
+			if (node.total_items > 0) {
+				for (int i = node.first; i < node.first + node.total_items; i++) {
+					Frustum_Culling::Item& item = c.items[i];
+					for (int f = 0; f < MAX_CULLING_FRUSTUMS; f++) {
+						if ((intersecting & (1u << f)) && test_box(frustums[f], item.bounds.min_point, item.bounds.max_point) != OUTSIDE) {
+							out_visible[item.index] = 1;
+							break;
+						}
+					}
+				}
+			} else {
+				cull_node(c, node.first, frustums, intersecting, out_visible);
+				cull_node(c, node.first + 1, frustums, intersecting, out_visible);
+			}
+		}
+	}
+
+	namespace frustum
+	{
+		Frustum from_matrix(const mat4& VP)
+		{
+			// gribb & hartmann, -w <= x,y,z <= w
+			mat4 m = glm::transpose(VP);
+			Frustum f;
+			f.planes[0] = m[3] + m[0]; // left
+			f.planes[1] = m[3] - m[0]; // right
+			f.planes[2] = m[3] + m[1]; // bottom
+			f.planes[3] = m[3] - m[1]; // top
+			f.planes[4] = m[3] + m[2]; // near
+			f.planes[5] = m[3] - m[2]; // far
+			for (vec4& plane : f.planes)
+				plane /= glm::length(vec3(plane));
+			return f;
+		}
+
+		bool intersects(const Frustum& f, const Bounding_Box& box)
+		{
+			return test_box(f, box.min_point, box.max_point) != OUTSIDE;
+		}
+	}
+
+	namespace frustumculling
+	{
+		void uninit(Frustum_Culling& c)
+		{
+			array::uninit(c.nodes);
+			array::uninit(c.items);
+			array::uninit(c.subtrees);
+			array::uninit(c.camera_visible);
+			array::uninit(c.shadow_visible);
+			c.is_built = false;
+		}
+
+		void build(Frustum_Culling& c, Scene& scene)
+		{
+			double start_time = glfwGetTime();
+			c.is_built = true;
+
+			array::set_length(c.nodes, 0);
+			array::set_length(c.items, 0);
+			array::set_length(c.subtrees, 0);
+
+			for (Model* model : scene.models)
+				for (Mesh* mesh : model->meshes)
+					for (Sub_Mesh& sub_mesh : mesh->sub_meshes)
+						array::add(c.items, Frustum_Culling::Item { boundingbox::transformed(sub_mesh.bounding_box, model->transform.mtx), int(array::size(c.items)) });
+
+			c.total_sub_meshes = array::size(c.items);
+			array::set_length(c.camera_visible, c.total_sub_meshes);
+			array::set_length(c.shadow_visible, c.total_sub_meshes);
+			if (c.total_sub_meshes == 0)
+				return;
+
+			array::add(c.nodes, {});
+			int depth = build_node(c, 0, 0, c.total_sub_meshes);
+
+			// split the tree breadth first until every thread gets a few subtrees
+			int target = SUBTREES_PER_THREAD * (jobs::get_total_workers() + 1);
+			array::add(c.subtrees, 0);
+			for (int i = 0; i < int(array::size(c.subtrees)) && int(array::size(c.subtrees)) < target; ) {
+				Frustum_Culling::Node& node = c.nodes[c.subtrees[i]];
+				if (node.total_items > 0) {
+					i++;
+					continue;
+				}
+				int first_child = node.first;
+				c.subtrees[i] = first_child;
+				array::add(c.subtrees, first_child + 1);
+			}
+
+			c.build_ms = 1000.0 * (glfwGetTime() - start_time);
+			LOG("culling", "bvh of %d sub meshes: %d nodes, depth %d, %d subtrees in %.2f ms", c.total_sub_meshes, int(array::size(c.nodes)), depth, int(array::size(c.subtrees)), c.build_ms);
+		}
+
+		int cull(Frustum_Culling& c, const Frustum* frustums, int total_frustums, Array<u8>& out_visible)
+		{
+			CPU_ZONE("frustum culling");
+			ASSERT(total_frustums > 0 && total_frustums <= MAX_CULLING_FRUSTUMS, "culling", "invalid amount of frustums (%d)", total_frustums);
+
+			if (!c.is_enabled) {
+				memset(out_visible.data, 1, c.total_sub_meshes);
+				return c.total_sub_meshes;
+			}
+
+			memset(out_visible.data, 0, c.total_sub_meshes);
+			if (c.total_sub_meshes == 0)
+				return 0;
+
+			// each job writes the flags of its own subtree's sub meshes
+			u32 frustum_mask = (1u << total_frustums) - 1u;
+			jobs::parallel_for(array::size(c.subtrees), [&](int i) {
+				cull_node(c, c.subtrees[i], frustums, frustum_mask, out_visible);
+			});
+
+			int total_visible = 0;
+			for (int i = 0; i < c.total_sub_meshes; i++)
+				total_visible += out_visible[i];
+			return total_visible;
+		}
+
+		void render_ui(Frustum_Culling& c)
+		{
+			using namespace ImGui;
+
+			Checkbox("frustum culling", &c.is_enabled);
+			Text("camera: %d / %d sub meshes drawn, culled in %.3f ms", c.camera_drawn, c.total_sub_meshes, c.camera_ms);
+			Text("shadows: %d / %d sub meshes drawn, culled in %.3f ms", c.shadow_drawn, c.total_sub_meshes, c.shadow_ms);
+			if (IsItemHovered())
+				SetTooltip("every layer of every light, culled when the shadow maps are re-rendered");
+			Text("bvh: %d nodes over %d sub meshes, %d subtrees on %d threads", int(array::size(c.nodes)), c.total_sub_meshes, int(array::size(c.subtrees)), jobs::get_total_workers() + 1);
+		}
+	}
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "scene.h"
+
+// Frustum culling of the scene's sub meshes: their world aabbs go into a bvh once the scene is loaded (the models don't
+// move), and every cull walks it on the job threads, one subtree per job. The result is a flag per sub mesh in scene
+// order (models, meshes, sub meshes), the order the render queue and the multi draw commands are in.
+
+namespace vxgi
+{
+	const int MAX_CULLING_FRUSTUMS = MAX_SHADOW_ATLAS_LAYERS; // a sub mesh is visible if it's in any of them
+	static_assert(MAX_CULLING_FRUSTUMS < 32, "the frustums of a cull are a u32 mask");
+
+	struct Frustum
+	{
+		vec4 planes[6]; // xyz = inward normal, dot(normal, p) + w >= 0 inside
+	};
+
+	struct Frustum_Culling
+	{
+		struct Node
+		{
+			vec3 min_point;
+			int  first; // child nodes first and first + 1, or the first item of a leaf
+			vec3 max_point;
+			int  total_items; // 0 = inner node
+		};
+
+		struct Item
+		{
+			Bounding_Box bounds; // world space
+			int index; // of the sub mesh in scene order
+		};
+
+		Array<Node> nodes; // the root is nodes[0]
+		Array<Item> items; // in leaf order
+		Array<int> subtrees; // roots of the jobs of a cull
+
+		Array<u8> camera_visible; // per sub mesh in scene order, for the g-buffer pass
+		Array<u8> shadow_visible; // every shadow map layer, for render_shadowmaps
+
+		bool is_built = false;
+		bool is_enabled = true;
+
+		// stats of the latest culls
+		int total_sub_meshes = 0;
+		int camera_drawn = 0;
+		int shadow_drawn = 0;
+		double camera_ms = 0.0;
+		double shadow_ms = 0.0;
+		double build_ms = 0.0;
+	};
+
+	namespace frustum
+	{
+		Frustum from_matrix(const mat4& VP); // the planes of the clip volume in the space VP transforms from
+		bool intersects(const Frustum&, const Bounding_Box&); // conservative, a box near a corner can be outside
+	}
+
+	namespace frustumculling
+	{
+		void uninit(Frustum_Culling&);
+
+		void build(Frustum_Culling&, Scene&); // once the models have their final transforms
+		int  cull(Frustum_Culling&, const Frustum* frustums, int total_frustums, Array<u8>& out_visible); // returns the visible sub meshes
+
+		void render_ui(Frustum_Culling&);
+	}
+}
@@ -62,6 +62,29 @@ namespace vxgi
 		int index; // to vertices
 		int length; 
 		int material_index; // to Assets_Old::materials
+		Bounding_Box bounding_box; // model space
+		int first_meshlet = 0; // to mesh.meshlets, full detail only
+		int total_meshlets = 0;
+	};
+
+	struct Meshlet // up to MAX_MESHLET_TRIANGLES of a sub mesh's triangles, next to each other in the vertices. see meshlet_culling.h
+	{
+		vec3 center; // bounding sphere, model space
+		float radius;
+		vec3 cone_apex; // every triangle faces away from a camera with dot(normalize(cone_apex - camera), cone_axis) >= cone_cutoff
+		float cone_cutoff; // > 1 = never
+		vec3 cone_axis;
+		int index; // to vertices
+		int length;
+	};
+
+	const int MAX_MESH_LODS = 4; // besides the full detail
+
+	struct Mesh_Lod // a simplification of the whole mesh, see mesh_lod.h
+	{
+		float error = 0.0f; // model space, about how far the surface moved on average
+		int total_triangles = 0;
+		Array<Sub_Mesh> sub_meshes; // the mesh's sub meshes in the same order, after its full detail vertices. can be empty
 	};
 
 	struct Mesh
@@ -78,6 +101,10 @@ namespace vxgi
 
 	//	Array<Vertex> vertices; // not saved to ram, uploaded directly to gpu
 		Array<Sub_Mesh> sub_meshes;
+		Array<Meshlet> meshlets; // of every sub mesh, in its order
+
+		Mesh_Lod lods[MAX_MESH_LODS]; // coarser and coarser
+		int total_lods = 0;
 	};
 
 	struct Model
@@ -93,6 +120,12 @@ namespace vxgi
 		static void update(Bounding_Box& aabb) {
 			aabb.center = (aabb.max_point + aabb.min_point) * 0.5f;
 		}
+		inline Bounding_Box transformed(const Bounding_Box& aabb, const mat4& mtx) { // the aabb around the transformed box
+			vec3 center = vec3(mtx * vec4(aabb.center, 1.0f));
+			vec3 half_size = (aabb.max_point - aabb.min_point) * 0.5f;
+			vec3 extent = glm::abs(vec3(mtx[0])) * half_size.x + glm::abs(vec3(mtx[1])) * half_size.y + glm::abs(vec3(mtx[2])) * half_size.z;
+			return { center - extent, center + extent, center };
+		}
 	}
 	namespace transform
 	{
@@ -0,0 +1,253 @@
+#include "gpu_profiler.h"
+
+#include "lib/imgui/imgui.h"
+
+namespace vxgi
+{
+	namespace
+	{
+		const char* GPU_PROFILE_CSV_PATH = "gpu_profile.csv";
+
+		int find_scope(Gpu_Profiler& p, const char* name, int parent, int depth)
+		{
+			for (int i = 0; i < int(array::size(p.scopes)); i++)
+				if (p.scopes[i].parent == parent && strcmp(p.scopes[i].name, name) == 0)
+					return i;
+
+			Gpu_Profiler::Scope scope = {};
+			scope.name = name;
+			scope.parent = parent;
+			scope.depth = depth;
+			scope.last_frame = ~u64(0);
+			array::add(p.scopes, scope);
+			return array::size(p.scopes) - 1;
+		}
+
+		void add_sample(Gpu_Profiler::Scope& scope, u64 frame, float ms)
+		{
+			if (scope.last_frame == frame) {
+				int latest = (scope.next_sample + GPU_PROFILER_HISTORY - 1) % GPU_PROFILER_HISTORY;
+				scope.samples[latest] += ms;
+				return;
+			}
+			scope.samples[scope.next_sample] = ms;
+			scope.next_sample = (scope.next_sample + 1) % GPU_PROFILER_HISTORY;
+			scope.total_samples = glm::min(scope.total_samples + 1, GPU_PROFILER_HISTORY);
+			scope.last_frame = frame;
+		}
+
+		bool read_back(Gpu_Profiler& p, Gpu_Profiler::Frame& f) // false if it isn't done yet
+		{
+			GLint is_available = GL_FALSE;
+			glGetQueryObjectiv(f.queries[f.last_query], GL_QUERY_RESULT_AVAILABLE, &is_available);
+			if (!is_available)
+				return false;
+
+			for (int i = 0; i < f.total_scopes; i++) {
+				GLuint64 begin_ns = 0, end_ns = 0;
+				glGetQueryObjectui64v(f.queries[i * 2], GL_QUERY_RESULT, &begin_ns);
+				glGetQueryObjectui64v(f.queries[i * 2 + 1], GL_QUERY_RESULT, &end_ns);
+				add_sample(p.scopes[f.scopes[i]], f.frame, float(double(end_ns - begin_ns) / 1000000.0));
+			}
+			f.is_pending = false;
+			return true;
+		}
+
+		void render_table(Gpu_Profiler& p) // the default font is monospaced
+		{
+			using namespace ImGui;
+
+			Text("%-28s %8s %8s %8s %8s", "pass (ms)", "last", "avg", "p95", "p99");
+			for (Gpu_Profiler::Scope& scope : p.scopes) {
+				if (scope.total_samples == 0)
+					continue;
+				Timing_Stats stats = gpuprofiler::get_stats(scope);
+				int latest = (scope.next_sample + GPU_PROFILER_HISTORY - 1) % GPU_PROFILER_HISTORY;
+				char label[64];
+				snprintf(label, sizeof(label), "%*s%s", scope.depth * 2, "", scope.name);
+				Text("%-28s %8.3f %8.3f %8.3f %8.3f", label, scope.samples[latest], stats.average_ms, stats.p95_ms, stats.p99_ms);
+			}
+		}
+	}
+
+	namespace gpuprofiler
+	{
+		void init(Gpu_Profiler& p)
+		{
+			for (Gpu_Profiler::Frame& f : p.frames)
+				glGenQueries(GPU_PROFILER_MAX_SCOPES * 2, f.queries);
+		}
+
+		void uninit(Gpu_Profiler& p)
+		{
+			for (Gpu_Profiler::Frame& f : p.frames) {
+				glDeleteQueries(GPU_PROFILER_MAX_SCOPES * 2, f.queries);
+				f = {};
+			}
+			array::uninit(p.scopes);
+		}
+
+		void begin_frame(Gpu_Profiler& p)
+		{
+			// oldest first, the slot recorded next is the oldest
+			for (int i = 0; i < GPU_PROFILER_FRAMES; i++) {
+				Gpu_Profiler::Frame& f = p.frames[(p.slot + i) % GPU_PROFILER_FRAMES];
+				if (f.is_pending && !read_back(p, f))
+					break;
+			}
+
+			Gpu_Profiler::Frame& f = p.frames[p.slot];
+			p.is_recording = p.is_enabled && !f.is_pending;
+			if (p.is_enabled && f.is_pending)
+				p.skipped_frames++;
+
+			// a pending slot keeps its scopes until they're read back
+			if (p.is_recording) {
+				f.total_scopes = 0;
+				f.last_query = -1;
+				f.frame = p.frame;
+			}
+			p.depth = 0;
+		}
+
+		void end_frame(Gpu_Profiler& p)
+		{
+			ASSERT(p.depth == 0, "gpuprofiler", "%d scopes are still open at the end of the frame", p.depth);
+
+			if (p.is_recording) {
+				Gpu_Profiler::Frame& f = p.frames[p.slot];
+				f.is_pending = f.total_scopes > 0;
+				p.slot = (p.slot + 1) % GPU_PROFILER_FRAMES;
+			}
+			p.is_recording = false;
+			p.frame++;
+		}
+
+		void begin(Gpu_Profiler& p, const char* name)
+		{
+			int slot = -1;
+			if (p.is_recording) {
+				Gpu_Profiler::Frame& f = p.frames[p.slot];
+				if (p.depth < GPU_PROFILER_MAX_DEPTH && f.total_scopes < GPU_PROFILER_MAX_SCOPES) {
+					int parent_slot = p.depth > 0 ? p.stack[p.depth - 1] : -1;
+					int parent = parent_slot >= 0 ? f.scopes[parent_slot] : -1;
+					slot = f.total_scopes++;
+					f.scopes[slot] = find_scope(p, name, parent, p.depth);
+					f.last_query = slot * 2;
+					glQueryCounter(f.queries[slot * 2], GL_TIMESTAMP);
+				}
+				else {
+					p.dropped_scopes++;
+				}
+			}
+
+			if (p.depth < GPU_PROFILER_MAX_DEPTH)
+				p.stack[p.depth] = slot;
+			p.depth++;
+		}
+
+		void end(Gpu_Profiler& p)
+		{
+			ASSERT(p.depth > 0, "gpuprofiler", "end without a begin");
+
+			p.depth--;
+			int slot = p.depth < GPU_PROFILER_MAX_DEPTH ? p.stack[p.depth] : -1;
+			if (slot >= 0) {
+				Gpu_Profiler::Frame& f = p.frames[p.slot];
+				f.last_query = slot * 2 + 1;
+				glQueryCounter(f.queries[slot * 2 + 1], GL_TIMESTAMP);
+			}
+		}
+
+		void flush(Gpu_Profiler& p)
+		{
+			ASSERT(p.depth == 0, "gpuprofiler", "flush inside a frame");
+
+			glFinish();
+			for (int i = 0; i < GPU_PROFILER_FRAMES; i++) {
+				Gpu_Profiler::Frame& f = p.frames[(p.slot + i) % GPU_PROFILER_FRAMES];
+				if (f.is_pending)
+					read_back(p, f);
+			}
+		}
+
+		Timing_Stats get_stats(Gpu_Profiler::Scope& scope)
+		{
+			return frameclock::get_timing_stats(scope.samples, scope.total_samples); // the ring is full or starts at 0
+		}
+
+		void get_path(Gpu_Profiler& p, int scope, char* out, int size)
+		{
+			Gpu_Profiler::Scope& s = p.scopes[scope];
+			if (s.parent < 0) {
+				snprintf(out, size, "%s", s.name);
+				return;
+			}
+			get_path(p, s.parent, out, size);
+			int length = int(strlen(out));
+			snprintf(out + length, size - length, "/%s", s.name);
+		}
+
+		Gpu_Profiler::Scope* find(Gpu_Profiler& p, const char* name)
+		{
+			for (Gpu_Profiler::Scope& scope : p.scopes)
+				if (strcmp(scope.name, name) == 0)
+					return &scope;
+			return NULL;
+		}
+
+		bool export_csv(Gpu_Profiler& p, const char* path)
+		{
+			FILE* file = fopen(path, "w");
+			if (!file) {
+				LOG("gpuprofiler", "couldn't open %s for writing", path);
+				return false;
+			}
+			defer { fclose(file); };
+
+			fprintf(file, "pass,depth,samples,average_ms,min_ms,p50_ms,p95_ms,p99_ms,max_ms\n");
+			for (int i = 0; i < int(array::size(p.scopes)); i++) {
+				Gpu_Profiler::Scope& scope = p.scopes[i];
+				Timing_Stats stats = get_stats(scope);
+				char scope_path[256];
+				get_path(p, i, scope_path, sizeof(scope_path));
+				fprintf(file, "%s,%d,%d,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f\n", scope_path, scope.depth, scope.total_samples,
+					stats.average_ms, stats.min_ms, stats.p50_ms, stats.p95_ms, stats.p99_ms, stats.max_ms);
+			}
+
+			LOG("gpuprofiler", "wrote %d passes to %s", int(array::size(p.scopes)), path);
+			return true;
+		}
+
+		void render_ui(Gpu_Profiler& p)
+		{
+			using namespace ImGui;
+
+			Checkbox("gpu profiler", &p.is_enabled);
+			SameLine();
+			Checkbox("overlay", &p.show_overlay);
+			if (Button("export csv"))
+				export_csv(p, GPU_PROFILE_CSV_PATH);
+			if (IsItemHovered())
+				SetTooltip("%s in the working directory", GPU_PROFILE_CSV_PATH);
+			Text("ms over the last %d frames a pass ran, %d frames skipped in flight", GPU_PROFILER_HISTORY, p.skipped_frames);
+			if (p.dropped_scopes > 0)
+				Text("%d scopes dropped, more than %d per frame or %d deep", p.dropped_scopes, GPU_PROFILER_MAX_SCOPES, GPU_PROFILER_MAX_DEPTH);
+			render_table(p);
+		}
+
+		void render_overlay(Gpu_Profiler& p)
+		{
+			using namespace ImGui;
+
+			if (!p.show_overlay)
+				return;
+
+			SetNextWindowPos(ImVec2(10.0f, 10.0f), ImGuiCond_FirstUseEver);
+			SetNextWindowBgAlpha(0.6f);
+			if (Begin("gpu profiler", &p.show_overlay, ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoFocusOnAppearing))
+				render_table(p);
+			End();
+		}
+	}
+}
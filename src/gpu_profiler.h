@@ -0,0 +1,77 @@
+#pragma once
+
+#include "frame_clock.h"
+#include "opengl.h"
+
+// GPU time per pass: every scope writes a GL_TIMESTAMP query when it begins and when it ends, so scopes nest (unlike
+// GL_TIME_ELAPSED queries). A frame's queries go into a ring of GPU_PROFILER_FRAMES frames and are read back
+// once the frame's last query is available, a few frames later. The cpu never waits, a frame is skipped if its slot is
+// still in flight. Scopes are told apart by name and parent, each keeps its last GPU_PROFILER_HISTORY frames for the
+// averages and percentiles.
+
+namespace vxgi
+{
+	const int GPU_PROFILER_FRAMES = 4; // in flight
+	const int GPU_PROFILER_MAX_SCOPES = 64; // per frame
+	const int GPU_PROFILER_MAX_DEPTH = 8;
+	const int GPU_PROFILER_HISTORY = 240; // frames per scope
+
+	struct Gpu_Profiler
+	{
+		struct Scope // a distinct name under a parent
+		{
+			const char* name;
+			int parent; // -1 = top level
+			int depth;
+			float samples[GPU_PROFILER_HISTORY]; // ms, a ring. a scope that runs more than once in a frame is summed
+			int total_samples;
+			int next_sample;
+			u64 last_frame; // of the latest sample
+		};
+
+		struct Frame // of the query ring
+		{
+			GLuint queries[GPU_PROFILER_MAX_SCOPES * 2]; // begin and end timestamp per scope
+			int scopes[GPU_PROFILER_MAX_SCOPES]; // into Gpu_Profiler::scopes
+			int total_scopes = 0;
+			int last_query = -1; // written last, the gpu writes them in order
+			u64 frame = 0;
+			bool is_pending = false;
+		};
+
+		Frame frames[GPU_PROFILER_FRAMES];
+		Array<Scope> scopes; // in the order they first appeared, parents before their children
+		int stack[GPU_PROFILER_MAX_DEPTH] = {}; // the open scopes' slots in the frame, -1 = not recorded
+		int depth = 0;
+		int slot = 0; // of frames, recorded next
+		bool is_recording = false; // this frame
+		u64 frame = 0;
+
+		bool is_enabled = true;
+		bool show_overlay = false;
+
+		// stats
+		int skipped_frames = 0; // their slot was still in flight
+		int dropped_scopes = 0; // too many or too deep
+	};
+
+	namespace gpuprofiler
+	{
+		void init(Gpu_Profiler&);
+		void uninit(Gpu_Profiler&);
+
+		void begin_frame(Gpu_Profiler&); // reads back the frames that are done
+		void end_frame(Gpu_Profiler&);
+		void begin(Gpu_Profiler&, const char* name); // the name has to outlive the profiler, a string literal
+		void end(Gpu_Profiler&);
+		void flush(Gpu_Profiler&); // waits for the gpu and reads back every frame in flight, between frames
+
+		Timing_Stats get_stats(Gpu_Profiler::Scope&);
+		void get_path(Gpu_Profiler&, int scope, char* out, int size); // parent/child/..., of Gpu_Profiler::scopes
+		Gpu_Profiler::Scope* find(Gpu_Profiler&, const char* name); // the first scope of the name at any depth, NULL before it ran
+		bool export_csv(Gpu_Profiler&, const char* path); // a row per scope, its path and stats
+
+		void render_ui(Gpu_Profiler&);
+		void render_overlay(Gpu_Profiler&); // its own window, while show_overlay
+	}
+}
@@ -0,0 +1,169 @@
+#include "jobs.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "containers.hpp"
+#include "cpu_profiler.h"
+
+namespace vxgi
+{
+	namespace
+	{
+		struct Job_System
+		{
+			std::mutex lock;
+			std::condition_variable has_jobs;
+			std::condition_variable batch_done;
+
+			Array<Job_Batch*> queue; // batches with indices left to hand out, oldest first
+			std::thread* workers = nullptr;
+			int total_workers = 0;
+			bool is_quitting = false;
+		};
+
+		Job_System& get_job_system() {
+			static Job_System system;
+			return system;
+		}
+
+		// hands out the next index of the oldest batch, the caller must hold the lock
+		Job_Batch* take_job(Job_System& system, int* index)
+		{
+			if (array::size(system.queue) == 0)
+				return nullptr;
+
+			Job_Batch* batch = system.queue[0];
+			*index = batch->next++;
+			if (batch->next == batch->count)
+				array::remove(system.queue, 0); // nobody touches the batch after this except the jobs already handed out
+
+			return batch;
+		}
+
+		void execute_job(Job_System& system, Job_Batch* batch, int index)
+		{
+			{
+				CPU_ZONE("job");
+				batch->function(batch->data, index);
+			}
+
+			if (batch->remaining.fetch_sub(1) == 1) {
+				std::lock_guard<std::mutex> guard(system.lock);
+				system.batch_done.notify_all();
+			}
+		}
+
+		void worker_loop(int worker)
+		{
+			Job_System& system = get_job_system();
+
+			char name[32];
+			snprintf(name, sizeof(name), "job worker %d", worker);
+			cpuprofiler::set_thread_name(name);
+
+			while (true)
+			{
+				Job_Batch* batch = nullptr;
+				int index = 0;
+				{
+					std::unique_lock<std::mutex> guard(system.lock);
+					system.has_jobs.wait(guard, [&]() { return system.is_quitting || array::size(system.queue) > 0; });
+					if (system.is_quitting)
+						return;
+					batch = take_job(system, &index);
+				}
+
+				execute_job(system, batch, index);
+			}
+		}
+	}
+
+	namespace jobs
+	{
+		void init(int total_workers)
+		{
+			Job_System& system = get_job_system();
+			ASSERT(system.workers == nullptr, "jobs", "already initialized");
+
+			if (total_workers < 0)
+				total_workers = glm::max(int(std::thread::hardware_concurrency()) - 1, 0);
+
+			system.is_quitting = false;
+			system.total_workers = total_workers;
+			if (total_workers > 0) {
+				system.workers = new std::thread[total_workers];
+				for (int i = 0; i < total_workers; i++)
+					system.workers[i] = std::thread(worker_loop, i);
+			}
+
+			LOG("jobs", "initialized %d worker threads", total_workers);
+		}
+
+		void uninit()
+		{
+			Job_System& system = get_job_system();
+			{
+				std::lock_guard<std::mutex> guard(system.lock);
+				system.is_quitting = true;
+			}
+			system.has_jobs.notify_all();
+
+			for (int i = 0; i < system.total_workers; i++)
+				system.workers[i].join();
+
+			delete[] system.workers;
+			system.workers = nullptr;
+			system.total_workers = 0;
+			array::uninit(system.queue);
+		}
+
+		int get_total_workers()
+		{
+			return get_job_system().total_workers;
+		}
+
+		void run(Job_Batch& batch, Job_Function function, void* data, int count)
+		{
+			batch.function = function;
+			batch.data = data;
+			batch.count = count;
+			batch.next = 0;
+			batch.remaining = count;
+
+			if (count <= 0)
+				return;
+
+			Job_System& system = get_job_system();
+			{
+				std::lock_guard<std::mutex> guard(system.lock);
+				array::add(system.queue, &batch);
+			}
+			system.has_jobs.notify_all();
+		}
+
+		void wait(Job_Batch& batch)
+		{
+			Job_System& system = get_job_system();
+
+			while (batch.remaining > 0)
+			{
+				Job_Batch* job = nullptr;
+				int index = 0;
+				{
+					std::unique_lock<std::mutex> guard(system.lock);
+					job = take_job(system, &index);
+
+					// nothing left to help with, the last jobs of this batch are running on the workers
+					if (!job) {
+						system.batch_done.wait(guard, [&]() { return batch.remaining == 0 || array::size(system.queue) > 0; });
+						continue;
+					}
+				}
+
+				execute_job(system, job, index);
+			}
+		}
+	}
+}
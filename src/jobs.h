@@ -0,0 +1,42 @@
+#pragma once
+
+#include "types.h"
+
+#include <atomic>
+
+namespace vxgi
+{
+	typedef void (*Job_Function)(void* data, int index);
+
+	struct Job_Batch // calls function(data, 0...count-1) on the workers, owned by the caller until jobs::wait returns
+	{
+		Job_Function function = nullptr;
+		void* data = nullptr;
+		int count = 0;
+		int next = 0; // next index to hand out, protected by the job queue lock
+		std::atomic<int> remaining = 0;
+	};
+
+	namespace jobs
+	{
+		void init(int total_workers = -1); // -1 = one per hardware thread, not counting the calling thread
+		void uninit();
+		int get_total_workers();
+
+		void run(Job_Batch& batch, Job_Function function, void* data, int count);
+		void wait(Job_Batch& batch); // the calling thread helps with queued jobs until the batch is done
+
+		template<typename F> void parallel_for(int count, F function); // function(int index), blocks until every index is done
+	}
+
+	namespace jobs
+	{
+		template<typename F>
+		void parallel_for(int count, F function)
+		{
+			Job_Batch batch;
+			run(batch, [](void* data, int index) { (*(F*) data)(index); }, &function, count);
+			wait(batch);
+		}
+	}
+}
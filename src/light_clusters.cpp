@@ -0,0 +1,262 @@
+#include "light_clusters.h"
+
+#include <GLFW/glfw3.h>
+#include "lib/imgui/imgui.h"
+
+#include "camera.h"
+#include "jobs.h"
+
+namespace vxgi
+{
+	namespace
+	{
+		struct Local_Lights_Header // mirrors the start of Local_Lights_Block in local_lights.glsl
+		{
+			u32 total_lights;
+			u32 _pad0[3];
+		};
+
+		Light_Clusters::Light_Bounds get_view_bounds(const mat4& view, const vec3& center, float radius)
+		{
+			return { vec3(view * vec4(center, 1.0f)), radius };
+		}
+
+		Light_Clusters::Light_Bounds get_spot_view_bounds(const mat4& view, const Spot_Light& light)
+		{
+			// smallest sphere around the cone: wide cones are bounded by their base, narrow ones have the apex on the sphere too
+			vec3 direction = glm::normalize(light.direction);
+			float angle = DEGREES_TO_RADIANS * glm::clamp(light.outer_angle, 0.0f, 90.0f);
+			if (angle > 0.25f * PI)
+				return get_view_bounds(view, light.position + direction * cosf(angle) * light.radius, sinf(angle) * light.radius);
+
+			float radius = light.radius / (2.0f * cosf(angle));
+			return get_view_bounds(view, light.position + direction * radius, radius);
+		}
+
+		bool sphere_intersects_box(const vec3& center, float radius, const vec3& box_min, const vec3& box_max)
+		{
+			vec3 closest = glm::clamp(center, box_min, box_max);
+			vec3 d = center - closest;
+			return glm::dot(d, d) <= radius * radius;
+		}
+	}
+
+	namespace lightclusters
+	{
+		void init(Light_Clusters& clusters)
+		{
+			Local_Lights_Header empty = {};
+
+			glGenBuffers(1, &clusters.lights_ssbo);
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, clusters.lights_ssbo);
+			glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(Local_Lights_Header) + sizeof(Local_Light_Std430) * MAX_LOCAL_LIGHTS, NULL, GL_DYNAMIC_DRAW);
+			glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(empty), &empty);
+
+			// grows when the lights cover more clusters, see build
+			clusters.clusters_capacity = sizeof(Light_Clusters::Header) + sizeof(clusters.ranges) + sizeof(u32) * TOTAL_LIGHT_CLUSTERS;
+			glGenBuffers(1, &clusters.clusters_ssbo);
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, clusters.clusters_ssbo);
+			glBufferData(GL_SHADER_STORAGE_BUFFER, clusters.clusters_capacity, NULL, GL_STREAM_DRAW);
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+			check_gl_error();
+
+			LOG("lightclusters", "%dx%dx%d clusters, up to %d point and spot lights", LIGHT_CLUSTERS_X, LIGHT_CLUSTERS_Y, LIGHT_CLUSTERS_Z, MAX_LOCAL_LIGHTS);
+		}
+
+		void uninit(Light_Clusters& clusters)
+		{
+			glDeleteBuffers(1, &clusters.lights_ssbo);
+			glDeleteBuffers(1, &clusters.clusters_ssbo);
+			clusters.lights_ssbo = 0;
+			clusters.clusters_ssbo = 0;
+
+			array::uninit(clusters.bounds);
+			for (Array<u32>& indices : clusters.slice_indices)
+				array::uninit(indices);
+		}
+
+		void upload_lights(Light_Clusters& clusters, Scene_Lights& lights)
+		{
+			int total_lights = int(array::size(lights.point_lights) + array::size(lights.spot_lights));
+			ASSERT(total_lights <= MAX_LOCAL_LIGHTS, "lightclusters", "too many point and spot lights (%d)", total_lights);
+
+			Local_Light_Std430 packed[MAX_LOCAL_LIGHTS];
+			int index = 0;
+
+			for (Point_Light& p : lights.point_lights)
+			{
+				Local_Light_Std430& out = packed[index++];
+				out = {};
+				out.position = p.position;
+				out.radius = p.radius;
+				out.color = p.color;
+				out.strength = p.strength;
+				out.direction = vec3(0.0f, -1.0f, 0.0f);
+				out.spot_scale = 0.0f; // spot factor is always 1
+				out.spot_offset = 1.0f;
+			}
+
+			for (Spot_Light& p : lights.spot_lights)
+			{
+				float cos_inner = cosf(DEGREES_TO_RADIANS * p.inner_angle);
+				float cos_outer = cosf(DEGREES_TO_RADIANS * p.outer_angle);
+				float spot_scale = 1.0f / glm::max(cos_inner - cos_outer, 0.001f);
+
+				Local_Light_Std430& out = packed[index++];
+				out = {};
+				out.position = p.position;
+				out.radius = p.radius;
+				out.color = p.color;
+				out.strength = p.strength;
+				out.direction = glm::normalize(p.direction);
+				out.spot_scale = spot_scale; // 0 at the outer angle, 1 at the inner
+				out.spot_offset = -cos_outer * spot_scale;
+			}
+
+			Local_Lights_Header header = {};
+			header.total_lights = u32(total_lights);
+
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, clusters.lights_ssbo);
+			glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(header), &header);
+			if (total_lights > 0)
+				glBufferSubData(GL_SHADER_STORAGE_BUFFER, sizeof(header), sizeof(Local_Light_Std430) * total_lights, packed);
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+			clusters.total_lights = total_lights;
+		}
+
+		void build(Light_Clusters& clusters, Scene_Lights& lights, Camera& camera, const vec3& scene_min, const vec3& scene_max)
+		{
+			double start_time = glfwGetTime();
+
+			// nothing to bin, the shaders skip the clusters when there are no lights
+			if (clusters.total_lights == 0) {
+				clusters.header.total_references = 0;
+				clusters.max_lights_per_cluster = 0;
+				clusters.build_ms = 0.0;
+				return;
+			}
+
+			// the slices cover the part of the view the scene is in, like the shadow cascades. farther pixels use the last one
+			float near_plane = camera.near_plane;
+			float far_plane = near_plane * 2.0f;
+			for (int i = 0; i < 8; i++) {
+				vec3 corner = vec3((i & 1) ? scene_max.x : scene_min.x, (i & 2) ? scene_max.y : scene_min.y, (i & 4) ? scene_max.z : scene_min.z);
+				far_plane = glm::max(far_plane, glm::distance(camera.position, corner));
+			}
+			far_plane = glm::min(far_plane, camera.far_plane);
+
+			float slices_per_log_depth = float(LIGHT_CLUSTERS_Z) / logf(far_plane / near_plane);
+			float tan_y = tanf(0.5f * DEGREES_TO_RADIANS * camera.fov);
+			float tan_x = tan_y * camera.aspect_ratio;
+
+			// view space, looking down -z
+			array::set_length(clusters.bounds, 0); // keeps the memory
+			for (Point_Light& p : lights.point_lights)
+				array::add(clusters.bounds, get_view_bounds(camera.view, p.position, p.radius));
+			for (Spot_Light& p : lights.spot_lights)
+				array::add(clusters.bounds, get_spot_view_bounds(camera.view, p));
+
+			// one job per depth slice, each writes its own index list and ranges
+			jobs::parallel_for(LIGHT_CLUSTERS_Z, [&](int z)
+			{
+				float z_near = near_plane * expf(float(z) / slices_per_log_depth);
+				float z_far = (z == LIGHT_CLUSTERS_Z - 1) ? camera.far_plane : near_plane * expf(float(z + 1) / slices_per_log_depth);
+				if (z == 0)
+					z_near = 0.0f; // pixels in front of the first slice are clamped into it
+
+				// the lights that reach into the slice
+				u32 candidates[MAX_LOCAL_LIGHTS];
+				int total_candidates = 0;
+				for (int i = 0; i < int(array::size(clusters.bounds)); i++) {
+					Light_Clusters::Light_Bounds& b = clusters.bounds[i];
+					float depth = -b.center.z;
+					if (depth + b.radius >= z_near && depth - b.radius <= z_far)
+						candidates[total_candidates++] = u32(i);
+				}
+
+				Array<u32>& indices = clusters.slice_indices[z];
+				array::set_length(indices, 0);
+
+				for (int y = 0; y < LIGHT_CLUSTERS_Y; y++)
+				{
+					float y0 = tan_y * (-1.0f + 2.0f * float(y) / float(LIGHT_CLUSTERS_Y));
+					float y1 = tan_y * (-1.0f + 2.0f * float(y + 1) / float(LIGHT_CLUSTERS_Y));
+
+					for (int x = 0; x < LIGHT_CLUSTERS_X; x++)
+					{
+						float x0 = tan_x * (-1.0f + 2.0f * float(x) / float(LIGHT_CLUSTERS_X));
+						float x1 = tan_x * (-1.0f + 2.0f * float(x + 1) / float(LIGHT_CLUSTERS_X));
+
+						// box around the froxel, its sides are planes through the camera so the extremes are at the near or far depth
+						vec3 box_min = vec3(glm::min(x0 * z_near, x0 * z_far), glm::min(y0 * z_near, y0 * z_far), -z_far);
+						vec3 box_max = vec3(glm::max(x1 * z_near, x1 * z_far), glm::max(y1 * z_near, y1 * z_far), -z_near);
+
+						Light_Clusters::Range& range = clusters.ranges[(z * LIGHT_CLUSTERS_Y + y) * LIGHT_CLUSTERS_X + x];
+						range.first = u32(array::size(indices));
+						for (int i = 0; i < total_candidates; i++) {
+							Light_Clusters::Light_Bounds& b = clusters.bounds[candidates[i]];
+							if (sphere_intersects_box(b.center, b.radius, box_min, box_max))
+								array::add(indices, candidates[i]);
+						}
+						range.total = u32(array::size(indices)) - range.first;
+					}
+				}
+			});
+
+			// the slices' lists end to end
+			u32 total_references = 0;
+			u32 max_lights_per_cluster = 0;
+			for (int z = 0; z < LIGHT_CLUSTERS_Z; z++)
+			{
+				for (int i = 0; i < LIGHT_CLUSTERS_X * LIGHT_CLUSTERS_Y; i++) {
+					Light_Clusters::Range& range = clusters.ranges[z * LIGHT_CLUSTERS_X * LIGHT_CLUSTERS_Y + i];
+					range.first += total_references;
+					max_lights_per_cluster = glm::max(max_lights_per_cluster, range.total);
+				}
+				total_references += u32(array::size(clusters.slice_indices[z]));
+			}
+
+			clusters.header.near_plane = near_plane;
+			clusters.header.slices_per_log_depth = slices_per_log_depth;
+			clusters.header.total_references = total_references;
+
+			// orphaned every frame so the driver doesn't wait for the previous frame's reads
+			umm ranges_offset = sizeof(Light_Clusters::Header);
+			umm indices_offset = ranges_offset + sizeof(clusters.ranges);
+			umm size = indices_offset + sizeof(u32) * total_references;
+			while (clusters.clusters_capacity < size)
+				clusters.clusters_capacity *= 2;
+
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, clusters.clusters_ssbo);
+			glBufferData(GL_SHADER_STORAGE_BUFFER, clusters.clusters_capacity, NULL, GL_STREAM_DRAW);
+			glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(clusters.header), &clusters.header);
+			glBufferSubData(GL_SHADER_STORAGE_BUFFER, ranges_offset, sizeof(clusters.ranges), clusters.ranges);
+			for (int z = 0; z < LIGHT_CLUSTERS_Z; z++) {
+				Array<u32>& indices = clusters.slice_indices[z];
+				if (array::size(indices) > 0)
+					glBufferSubData(GL_SHADER_STORAGE_BUFFER, indices_offset, array::size_in_bytes(indices), indices.data);
+				indices_offset += array::size_in_bytes(indices);
+			}
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+			clusters.max_lights_per_cluster = int(max_lights_per_cluster);
+			clusters.build_ms = 1000.0 * (glfwGetTime() - start_time);
+		}
+
+		void bind(Light_Clusters& clusters)
+		{
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LIGHT_CLUSTERS_BINDING_LIGHTS, clusters.lights_ssbo);
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LIGHT_CLUSTERS_BINDING_CLUSTERS, clusters.clusters_ssbo);
+		}
+
+		void render_ui(Light_Clusters& clusters)
+		{
+			using namespace ImGui;
+
+			Text("%dx%dx%d clusters, %d point and spot lights", LIGHT_CLUSTERS_X, LIGHT_CLUSTERS_Y, LIGHT_CLUSTERS_Z, clusters.total_lights);
+			Text("%u light references, up to %d per cluster", clusters.header.total_references, clusters.max_lights_per_cluster);
+			Text("binned in %.3f ms on %d threads", clusters.build_ms, jobs::get_total_workers() + 1);
+		}
+	}
+}
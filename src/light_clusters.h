@@ -0,0 +1,71 @@
+#pragma once
+
+#include "opengl.h"
+#include "scene.h"
+
+// Clustered point and spot lights: the camera frustum is split into froxels (screen tiles x exponential depth slices),
+// the cpu bins the lights into them every frame, one job per depth slice, and the cone tracing pass only shades the
+// lights of a pixel's froxel. The voxelization pass goes through the whole light list. See local_lights.glsl.
+
+namespace vxgi
+{
+	const int LIGHT_CLUSTERS_X = 16; // see LIGHT_CLUSTERS_* in local_lights.glsl
+	const int LIGHT_CLUSTERS_Y = 9;
+	const int LIGHT_CLUSTERS_Z = 24;
+	const int TOTAL_LIGHT_CLUSTERS = LIGHT_CLUSTERS_X * LIGHT_CLUSTERS_Y * LIGHT_CLUSTERS_Z;
+
+	enum LIGHT_CLUSTERS_BINDING : GLuint // layout(std430, binding = N), after the tile lists (0) and the step counters (1)
+	{
+		LIGHT_CLUSTERS_BINDING_LIGHTS   = 2,
+		LIGHT_CLUSTERS_BINDING_CLUSTERS = 3
+	};
+
+	struct Light_Clusters
+	{
+		struct Header // mirrors the start of Light_Clusters_Block in local_lights.glsl
+		{
+			float near_plane; // of the first slice
+			float slices_per_log_depth; // slice = log(view depth / near_plane) * slices_per_log_depth
+			u32   total_references;
+			u32   _pad0;
+		};
+
+		struct Range // mirrors the cluster ranges in local_lights.glsl
+		{
+			u32 first; // into the light indices
+			u32 total;
+		};
+
+		struct Light_Bounds // a sphere around each light, in view space
+		{
+			vec3 center;
+			float radius;
+		};
+
+		GLuint lights_ssbo = 0; // u32 total lights, padding, then Local_Light_Std430[MAX_LOCAL_LIGHTS]
+		GLuint clusters_ssbo = 0; // Header, Range[TOTAL_LIGHT_CLUSTERS], then the u32 light indices
+		umm    clusters_capacity = 0; // in bytes
+
+		Array<Light_Bounds> bounds;
+		Array<u32> slice_indices[LIGHT_CLUSTERS_Z]; // light indices of each cluster in the slice, filled by its job
+		Range ranges[TOTAL_LIGHT_CLUSTERS] = {};
+		Header header = {};
+
+		// stats
+		int total_lights = 0;
+		int max_lights_per_cluster = 0;
+		double build_ms = 0.0;
+	};
+
+	namespace lightclusters
+	{
+		void init(Light_Clusters&);
+		void uninit(Light_Clusters&);
+
+		void upload_lights(Light_Clusters&, Scene_Lights&); // when the lights change
+		void build(Light_Clusters&, Scene_Lights&, Camera& camera, const vec3& scene_min, const vec3& scene_max); // every frame, bins and uploads
+		void bind(Light_Clusters&); // both ssbos, for the cone tracing and voxelization passes
+
+		void render_ui(Light_Clusters&);
+	}
+}
@@ -1,4 +1,7 @@
 #include "app.h"
+#include "cpu_cone_tracing.h"
+
+#include <cstring>
 
 int main(int argc, const char* argv[])
 {
@@ -6,11 +9,16 @@ int main(int argc, const char* argv[])
 
 	using namespace vxgi;
 
-	if (application::init(argc, argv, { 1920, 1080 })) {
-		application::run();
-	}
+	// headless, no window or GL context
+	if (argc == 5 && strcmp(argv[1], "--reference") == 0)
+		return cpu_vct::run_reference(argv[2], argv[3], argv[4]) ? 0 : 1;
+
+	// --benchmark <scene> [options] runs without the ui and writes a report, see benchmark.h
+	bool is_ok = application::init(argc, argv, { 1920, 1080 });
+	if (is_ok)
+		is_ok = application::run();
 	application::uninit();
 
 	LOG("main", "exiting application");
-	return 0;
+	return is_ok ? 0 : 1;
 }
\ No newline at end of file
@@ -0,0 +1,623 @@
+#include "mesh_lod.h"
+
+#include <algorithm>
+#include "lib/imgui/imgui.h"
+
+#include "frustum_culling.h"
+
+namespace vxgi
+{
+	namespace
+	{
+		const float  LOD_REDUCTION = 0.5f; // triangles per triangle of the previous lod, the goal
+		const float  MIN_LOD_REDUCTION = 0.8f; // a lod that can't get under this isn't worth the memory
+		const int    MIN_LOD_TRIANGLES = 16;
+		const int    MAX_PASSES = 16; // per lod
+		const float  PASS_ERROR_SLACK = 1.5f; // a pass takes collapses up to this times the error of the last one it needs
+		const double BORDER_WEIGHT = 10.0; // keeps the open borders in place, relative to the faces
+		const float  MIN_NORMAL_COS = 0.25f; // a collapse can't turn a triangle further than this
+
+		enum VERTEX_KIND : u8 { VERTEX_INTERIOR, VERTEX_BORDER, VERTEX_LOCKED }; // locked = on a non-manifold edge
+
+		struct Quadric // sum of w * (dot(n, p) + d)^2 over planes
+		{
+			double a00 = 0, a01 = 0, a02 = 0, a11 = 0, a12 = 0, a22 = 0;
+			double b0 = 0, b1 = 0, b2 = 0;
+			double c = 0;
+			double w = 0;
+		};
+
+		struct Edge // of a triangle, between positions a < b
+		{
+			int a, b;
+			int triangle;
+		};
+
+		struct Collapse // moves position from onto position to
+		{
+			int from, to;
+			float error;
+		};
+
+		struct Simplifier
+		{
+			Array<vec3> positions; // welded
+			Array<Quadric> quadrics; // per position
+			Array<int> wedge_position; // a wedge is a unique vertex (attributes and sub mesh) at a position
+			Array<int> wedge_vertex; // one of the mesh's vertices that is the wedge
+			Array<u8> is_wedge_hard; // its vertices have different normals (a hard edge), the lods use the face normals
+			Array<int> corners; // wedges, 3 per triangle in the mesh's order
+			Array<u8> is_removed; // per triangle
+			int total_triangles = 0; // not removed
+			float error = 0.0f; // of the largest collapse so far
+
+			// per pass
+			Array<int> first_triangle; // per position + 1, into triangles
+			Array<int> triangles; // around each position
+			Array<u8> kinds; // per position
+			Array<u8> is_touched; // per position, collapsed away or into this pass
+			Array<Edge> edges;
+			Array<Collapse> collapses;
+
+			// per collapse
+			Array<int> from_neighbours;
+			Array<int> to_neighbours;
+			Array<int> wedge_map; // pairs of from and to wedges
+		};
+
+		void uninit(Simplifier& s)
+		{
+			array::uninit(s.positions);
+			array::uninit(s.quadrics);
+			array::uninit(s.wedge_position);
+			array::uninit(s.wedge_vertex);
+			array::uninit(s.is_wedge_hard);
+			array::uninit(s.corners);
+			array::uninit(s.is_removed);
+			array::uninit(s.first_triangle);
+			array::uninit(s.triangles);
+			array::uninit(s.kinds);
+			array::uninit(s.is_touched);
+			array::uninit(s.edges);
+			array::uninit(s.collapses);
+			array::uninit(s.from_neighbours);
+			array::uninit(s.to_neighbours);
+			array::uninit(s.wedge_map);
+		}
+
+		void add_plane(Quadric& q, vec3 n, float d, double w)
+		{
+			q.a00 += w * n.x * n.x; q.a01 += w * n.x * n.y; q.a02 += w * n.x * n.z;
+			q.a11 += w * n.y * n.y; q.a12 += w * n.y * n.z; q.a22 += w * n.z * n.z;
+			q.b0 += w * n.x * d; q.b1 += w * n.y * d; q.b2 += w * n.z * d;
+			q.c += w * d * d;
+			q.w += w;
+		}
+
+		void add_quadric(Quadric& q, const Quadric& r)
+		{
+			q.a00 += r.a00; q.a01 += r.a01; q.a02 += r.a02;
+			q.a11 += r.a11; q.a12 += r.a12; q.a22 += r.a22;
+			q.b0 += r.b0; q.b1 += r.b1; q.b2 += r.b2;
+			q.c += r.c;
+			q.w += r.w;
+		}
+
+		float get_error(const Quadric& a, const Quadric& b, vec3 p) // of the sum at p, the weighted rms distance to the planes
+		{
+			Quadric q = a;
+			add_quadric(q, b);
+			double x = p.x, y = p.y, z = p.z;
+			double e = x * x * q.a00 + 2.0 * x * y * q.a01 + 2.0 * x * z * q.a02 + y * y * q.a11 + 2.0 * y * z * q.a12 + z * z * q.a22
+				+ 2.0 * (x * q.b0 + y * q.b1 + z * q.b2) + q.c;
+			return q.w > 0.0 ? float(sqrt(glm::max(e, 0.0) / q.w)) : 0.0f;
+		}
+
+		int get_position(Simplifier& s, int triangle, int corner)
+		{
+			return s.wedge_position[s.corners[triangle * 3 + corner]];
+		}
+
+		void add_unique(Array<int>& arr, int value)
+		{
+			for (int v : arr)
+				if (v == value)
+					return;
+			array::add(arr, value);
+		}
+
+		bool contains(Array<int>& arr, int value)
+		{
+			for (int v : arr)
+				if (v == value)
+					return true;
+			return false;
+		}
+
+		void build_edges(Simplifier& s)
+		{
+			array::set_length(s.edges, 0);
+			int total_triangles = array::size(s.is_removed);
+			for (int t = 0; t < total_triangles; t++) {
+				if (s.is_removed[t])
+					continue;
+				for (int k = 0; k < 3; k++) {
+					int a = get_position(s, t, k), b = get_position(s, t, (k + 1) % 3);
+					array::add(s.edges, Edge { glm::min(a, b), glm::max(a, b), t });
+				}
+			}
+			std::sort(s.edges.data, s.edges.data + array::size(s.edges), [](const Edge& x, const Edge& y) { return x.a != y.a ? x.a < y.a : x.b < y.b; });
+		}
+
+		template<typename F>
+		void for_each_edge(Simplifier& s, F function) // function(first edge, triangles sharing it)
+		{
+			int total_edges = array::size(s.edges);
+			for (int i = 0; i < total_edges;) {
+				int end = i + 1;
+				while (end < total_edges && s.edges[end].a == s.edges[i].a && s.edges[end].b == s.edges[i].b)
+					end++;
+				function(s.edges[i], end - i);
+				i = end;
+			}
+		}
+
+		void init(Simplifier& s, Mesh& mesh, Array<Vertex>& vertices)
+		{
+			int total_vertices = array::size(vertices);
+			int total_triangles = total_vertices / 3;
+
+			Array<int> sub_mesh_of; // per vertex
+			Array<int> order;
+			Array<int> vertex_wedge;
+			defer {
+				array::uninit(sub_mesh_of);
+				array::uninit(order);
+				array::uninit(vertex_wedge);
+			};
+
+			array::set_length(sub_mesh_of, total_vertices);
+			for (int i = 0; i < int(array::size(mesh.sub_meshes)); i++)
+				for (int v = mesh.sub_meshes[i].index; v < mesh.sub_meshes[i].index + mesh.sub_meshes[i].length; v++)
+					sub_mesh_of[v] = i;
+
+			// the wedges, vertices with the same position, color and uv in the same sub mesh. the normals can't be a
+			// part of it, flat shaded meshes would have nothing to collapse. the tangents are per face (see assets.cpp)
+			auto compare = [&](int a, int b) {
+				if (sub_mesh_of[a] != sub_mesh_of[b])
+					return sub_mesh_of[a] < sub_mesh_of[b] ? -1 : 1;
+				int result = memcmp(&vertices[a].position, &vertices[b].position, sizeof(vec3));
+				if (result != 0)
+					return result;
+				return memcmp(&vertices[a].color, &vertices[b].color, offsetof(Vertex, tangent) - offsetof(Vertex, color)); // and tex_coord
+			};
+
+			array::set_length(order, total_vertices);
+			for (int i = 0; i < total_vertices; i++)
+				order[i] = i;
+			std::sort(order.data, order.data + total_vertices, [&](int a, int b) { return compare(a, b) < 0; });
+
+			array::set_length(vertex_wedge, total_vertices);
+			for (int i = 0; i < total_vertices; i++) {
+				int v = order[i];
+				if (i == 0 || compare(v, order[i - 1]) != 0) {
+					array::add(s.wedge_vertex, v);
+					array::add(s.is_wedge_hard, u8(0));
+				}
+				int wedge = array::size(s.wedge_vertex) - 1;
+				vertex_wedge[v] = wedge;
+				if (vertices[v].normal != vertices[s.wedge_vertex[wedge]].normal)
+					s.is_wedge_hard[wedge] = 1;
+			}
+
+			// the positions the wedges share
+			int total_wedges = array::size(s.wedge_vertex);
+			array::set_length(order, total_wedges);
+			for (int i = 0; i < total_wedges; i++)
+				order[i] = i;
+			std::sort(order.data, order.data + total_wedges, [&](int a, int b) {
+				return memcmp(&vertices[s.wedge_vertex[a]].position, &vertices[s.wedge_vertex[b]].position, sizeof(vec3)) < 0;
+			});
+
+			array::set_length(s.wedge_position, total_wedges);
+			for (int i = 0; i < total_wedges; i++) {
+				vec3& position = vertices[s.wedge_vertex[order[i]]].position;
+				if (i == 0 || memcmp(&position, &vertices[s.wedge_vertex[order[i - 1]]].position, sizeof(vec3)) != 0)
+					array::add(s.positions, position);
+				s.wedge_position[order[i]] = array::size(s.positions) - 1;
+			}
+
+			array::set_length(s.corners, total_vertices);
+			for (int i = 0; i < total_vertices; i++)
+				s.corners[i] = vertex_wedge[i];
+
+			int total_positions = array::size(s.positions);
+			array::set_length(s.quadrics, total_positions);
+			for (Quadric& q : s.quadrics)
+				q = {};
+
+			// the faces' planes, weighted by area
+			array::set_length(s.is_removed, total_triangles);
+			s.total_triangles = 0;
+			for (int t = 0; t < total_triangles; t++) {
+				int p0 = get_position(s, t, 0), p1 = get_position(s, t, 1), p2 = get_position(s, t, 2);
+				vec3 n = glm::cross(s.positions[p1] - s.positions[p0], s.positions[p2] - s.positions[p0]);
+				float length = glm::length(n);
+
+				s.is_removed[t] = p0 == p1 || p1 == p2 || p2 == p0 || length == 0.0f;
+				if (s.is_removed[t])
+					continue;
+				s.total_triangles++;
+
+				n /= length;
+				for (int p : { p0, p1, p2 })
+					add_plane(s.quadrics[p], n, -glm::dot(n, s.positions[p0]), 0.5 * length);
+			}
+
+			// planes through the open borders, perpendicular to their face
+			build_edges(s);
+			for_each_edge(s, [&](const Edge& edge, int total_sharing) {
+				if (total_sharing != 1)
+					return;
+				int t = edge.triangle;
+				vec3 p0 = s.positions[get_position(s, t, 0)], p1 = s.positions[get_position(s, t, 1)], p2 = s.positions[get_position(s, t, 2)];
+				vec3 face_normal = glm::normalize(glm::cross(p1 - p0, p2 - p0));
+				vec3 e = s.positions[edge.b] - s.positions[edge.a];
+				vec3 n = glm::cross(e, face_normal);
+				if (glm::length(n) == 0.0f)
+					return;
+				n = glm::normalize(n);
+				double w = glm::dot(e, e) * BORDER_WEIGHT;
+				add_plane(s.quadrics[edge.a], n, -glm::dot(n, s.positions[edge.a]), w);
+				add_plane(s.quadrics[edge.b], n, -glm::dot(n, s.positions[edge.a]), w);
+			});
+		}
+
+		bool try_collapse(Simplifier& s, int from, int to)
+		{
+			array::set_length(s.from_neighbours, 0);
+			array::set_length(s.to_neighbours, 0);
+			array::set_length(s.wedge_map, 0);
+
+			auto find_corner = [&](int t, int position) {
+				for (int k = 0; k < 3; k++)
+					if (get_position(s, t, k) == position)
+						return k;
+				return -1;
+			};
+			auto find_mapped = [&](int wedge) {
+				for (int i = 0; i < int(array::size(s.wedge_map)); i += 2)
+					if (s.wedge_map[i] == wedge)
+						return s.wedge_map[i + 1];
+				return -1;
+			};
+
+			// the triangles on the edge decide which wedge of to each wedge of from becomes
+			int total_shared = 0;
+			for (int i = s.first_triangle[from]; i < s.first_triangle[from + 1]; i++) {
+				int t = s.triangles[i];
+				if (s.is_removed[t])
+					continue;
+
+				for (int k = 0; k < 3; k++) {
+					int p = get_position(s, t, k);
+					if (p != from && p != to)
+						add_unique(s.from_neighbours, p);
+				}
+
+				int to_corner = find_corner(t, to);
+				if (to_corner < 0)
+					continue;
+				total_shared++;
+
+				int from_wedge = s.corners[t * 3 + find_corner(t, from)];
+				int to_wedge = s.corners[t * 3 + to_corner];
+				int mapped = find_mapped(from_wedge);
+				if (mapped < 0) {
+					array::add(s.wedge_map, from_wedge);
+					array::add(s.wedge_map, to_wedge);
+				} else if (mapped != to_wedge) {
+					return false;
+				}
+			}
+			if (total_shared == 0)
+				return false;
+
+			// a wedge away from the edge would need attributes it doesn't have (a uv or material seam crossing it),
+			// two wedges into one would close a seam
+			for (int i = 0; i < int(array::size(s.wedge_map)); i += 2)
+				for (int j = i + 2; j < int(array::size(s.wedge_map)); j += 2)
+					if (s.wedge_map[i + 1] == s.wedge_map[j + 1])
+						return false;
+
+			vec3 target = s.positions[to];
+			for (int i = s.first_triangle[from]; i < s.first_triangle[from + 1]; i++) {
+				int t = s.triangles[i];
+				if (s.is_removed[t] || find_corner(t, to) >= 0)
+					continue;
+
+				int corner = find_corner(t, from);
+				if (find_mapped(s.corners[t * 3 + corner]) < 0)
+					return false;
+
+				// no folds
+				vec3 p[3] = { s.positions[get_position(s, t, 0)], s.positions[get_position(s, t, 1)], s.positions[get_position(s, t, 2)] };
+				vec3 n0 = glm::cross(p[1] - p[0], p[2] - p[0]);
+				p[corner] = target;
+				vec3 n1 = glm::cross(p[1] - p[0], p[2] - p[0]);
+				if (glm::dot(n0, n1) <= MIN_NORMAL_COS * glm::length(n0) * glm::length(n1))
+					return false;
+			}
+
+			// the link condition, the only neighbours both have are across the shared triangles. otherwise the
+			// surface would pinch into a non-manifold edge
+			for (int i = s.first_triangle[to]; i < s.first_triangle[to + 1]; i++) {
+				int t = s.triangles[i];
+				if (s.is_removed[t])
+					continue;
+				for (int k = 0; k < 3; k++) {
+					int p = get_position(s, t, k);
+					if (p != from && p != to)
+						add_unique(s.to_neighbours, p);
+				}
+			}
+			int total_common = 0;
+			for (int p : s.from_neighbours)
+				total_common += contains(s.to_neighbours, p) ? 1 : 0;
+			if (total_common > total_shared)
+				return false;
+
+			for (int i = s.first_triangle[from]; i < s.first_triangle[from + 1]; i++) {
+				int t = s.triangles[i];
+				if (s.is_removed[t])
+					continue;
+
+				if (find_corner(t, to) >= 0) {
+					s.is_removed[t] = 1;
+					s.total_triangles--;
+				} else {
+					int corner = t * 3 + find_corner(t, from);
+					s.corners[corner] = find_mapped(s.corners[corner]);
+				}
+			}
+			add_quadric(s.quadrics[to], s.quadrics[from]);
+			return true;
+		}
+
+		int simplify_pass(Simplifier& s, int target_triangles)
+		{
+			int total_positions = array::size(s.positions);
+			int total_triangles = array::size(s.is_removed);
+
+			// the triangles around each position
+			array::set_length(s.first_triangle, total_positions + 1);
+			for (int& first : s.first_triangle)
+				first = 0;
+			for (int t = 0; t < total_triangles; t++)
+				if (!s.is_removed[t])
+					for (int k = 0; k < 3; k++)
+						s.first_triangle[get_position(s, t, k) + 1]++;
+			for (int p = 0; p < total_positions; p++)
+				s.first_triangle[p + 1] += s.first_triangle[p];
+
+			array::set_length(s.triangles, s.first_triangle[total_positions]);
+			array::set_length(s.is_touched, total_positions);
+			for (u8& t : s.is_touched)
+				t = 0;
+			Array<int>& fill = s.from_neighbours; // free until the collapses
+			array::set_length(fill, total_positions);
+			for (int& f : fill)
+				f = 0;
+			for (int t = 0; t < total_triangles; t++) {
+				if (s.is_removed[t])
+					continue;
+				for (int k = 0; k < 3; k++) {
+					int p = get_position(s, t, k);
+					s.triangles[s.first_triangle[p] + fill[p]++] = t;
+				}
+			}
+
+			// open borders can only move along themselves, non-manifold edges don't move
+			build_edges(s);
+			array::set_length(s.kinds, total_positions);
+			for (u8& kind : s.kinds)
+				kind = VERTEX_INTERIOR;
+			for_each_edge(s, [&](const Edge& edge, int total_sharing) {
+				u8 kind = total_sharing == 1 ? VERTEX_BORDER : (total_sharing > 2 ? VERTEX_LOCKED : VERTEX_INTERIOR);
+				s.kinds[edge.a] = glm::max(s.kinds[edge.a], kind);
+				s.kinds[edge.b] = glm::max(s.kinds[edge.b], kind);
+			});
+
+			// the cheaper way of each edge
+			array::set_length(s.collapses, 0);
+			for_each_edge(s, [&](const Edge& edge, int total_sharing) {
+				Collapse best = { -1, -1, MAX_FLOAT_VALUE };
+				for (int i = 0; i < 2; i++) {
+					int from = i == 0 ? edge.a : edge.b;
+					int to = i == 0 ? edge.b : edge.a;
+					bool is_allowed = s.kinds[from] == VERTEX_INTERIOR || (s.kinds[from] == VERTEX_BORDER && total_sharing == 1);
+					if (!is_allowed)
+						continue;
+
+					float error = get_error(s.quadrics[from], s.quadrics[to], s.positions[to]);
+					if (error < best.error)
+						best = { from, to, error };
+				}
+				if (best.from >= 0)
+					array::add(s.collapses, best);
+			});
+
+			int total_collapses = array::size(s.collapses);
+			if (total_collapses == 0)
+				return 0;
+			std::sort(s.collapses.data, s.collapses.data + total_collapses, [](const Collapse& a, const Collapse& b) { return a.error < b.error; });
+
+			// a collapse takes away two triangles, the rest of the way takes about this many. the costs are of the
+			// start of the pass, so it stops a bit after them and lets the next pass sort again
+			int goal = glm::clamp((s.total_triangles - target_triangles) / 2, 0, total_collapses - 1);
+			float error_limit = s.collapses[goal].error * PASS_ERROR_SLACK;
+
+			int total_done = 0;
+			for (Collapse& c : s.collapses) {
+				if (s.total_triangles <= target_triangles || c.error > error_limit)
+					break;
+				if (s.is_touched[c.from] || s.is_touched[c.to])
+					continue;
+				if (!try_collapse(s, c.from, c.to))
+					continue;
+
+				s.is_touched[c.from] = 1;
+				s.is_touched[c.to] = 1;
+				s.error = glm::max(s.error, c.error);
+				total_done++;
+			}
+			return total_done;
+		}
+
+		void add_lod(Simplifier& s, Mesh& mesh, Array<Vertex>& vertices)
+		{
+			Mesh_Lod& lod = mesh.lods[mesh.total_lods++];
+			lod.error = s.error;
+			lod.total_triangles = s.total_triangles;
+			array::set_length(lod.sub_meshes, 0);
+
+			for (Sub_Mesh& full : mesh.sub_meshes) {
+				Sub_Mesh sub_mesh = full;
+				sub_mesh.index = array::size(vertices);
+				sub_mesh.length = 0;
+				sub_mesh.first_meshlet = 0; // the lods have none
+				sub_mesh.total_meshlets = 0;
+
+				for (int t = full.index / 3; t < (full.index + full.length) / 3; t++) {
+					if (s.is_removed[t])
+						continue;
+					vec3 p0 = s.positions[get_position(s, t, 0)], p1 = s.positions[get_position(s, t, 1)], p2 = s.positions[get_position(s, t, 2)];
+					vec3 face_normal = glm::normalize(glm::cross(p1 - p0, p2 - p0));
+					for (int k = 0; k < 3; k++) {
+						int wedge = s.corners[t * 3 + k];
+						Vertex v = vertices[s.wedge_vertex[wedge]]; // copied, adding can move the array
+						if (s.is_wedge_hard[wedge])
+							v.normal = face_normal;
+						array::add(vertices, v);
+					}
+					sub_mesh.length += 3;
+				}
+				array::add(lod.sub_meshes, sub_mesh);
+			}
+		}
+
+		float get_max_scale(const mat4& m)
+		{
+			return glm::max(glm::length(vec3(m[0])), glm::max(glm::length(vec3(m[1])), glm::length(vec3(m[2]))));
+		}
+
+		template<typename F>
+		int select_scene(Mesh_Lods& lods, Scene& scene, Array<u8>& out_lods, F get_max_world_error) // get_max_world_error(Model&), returns the triangles
+		{
+			array::set_length(out_lods, 0);
+			int total_triangles = 0;
+			int full_detail_triangles = 0;
+
+			for (Model* model : scene.models) {
+				float max_world_error = get_max_world_error(*model);
+				for (Mesh* mesh : model->meshes) {
+					int lod = lods.is_enabled ? meshlod::select(*model, *mesh, max_world_error) : 0;
+					for (int i = 0; i < int(array::size(mesh->sub_meshes)); i++) {
+						array::add(out_lods, u8(lod));
+						total_triangles += meshlod::get_sub_mesh(*mesh, i, lod).length / 3;
+						full_detail_triangles += mesh->sub_meshes[i].length / 3;
+					}
+				}
+			}
+
+			lods.full_detail_triangles = full_detail_triangles;
+			return total_triangles;
+		}
+	}
+
+	namespace meshlod
+	{
+		void generate(Mesh& mesh, Array<Vertex>& vertices)
+		{
+			mesh.total_lods = 0;
+			if (int(array::size(vertices)) / 3 < MIN_LOD_TRIANGLES * 2)
+				return;
+
+			Simplifier s;
+			defer { uninit(s); };
+			init(s, mesh, vertices);
+
+			int previous_triangles = s.total_triangles;
+			while (mesh.total_lods < MAX_MESH_LODS && previous_triangles > MIN_LOD_TRIANGLES) {
+				int target_triangles = int(float(previous_triangles) * LOD_REDUCTION);
+				for (int pass = 0; pass < MAX_PASSES && s.total_triangles > target_triangles; pass++)
+					if (simplify_pass(s, target_triangles) == 0)
+						break;
+
+				if (float(s.total_triangles) > float(previous_triangles) * MIN_LOD_REDUCTION)
+					break;
+
+				add_lod(s, mesh, vertices);
+				previous_triangles = s.total_triangles;
+			}
+		}
+
+		void uninit(Mesh_Lods& lods)
+		{
+			array::uninit(lods.voxelization_lods);
+			array::uninit(lods.shadow_lods);
+		}
+
+		Sub_Mesh& get_sub_mesh(Mesh& mesh, int sub_mesh, int lod)
+		{
+			return lod == 0 ? mesh.sub_meshes[sub_mesh] : mesh.lods[lod - 1].sub_meshes[sub_mesh];
+		}
+
+		int select(Model& model, Mesh& mesh, float max_world_error)
+		{
+			float max_error = max_world_error / get_max_scale(model.transform.mtx); // in model space
+			int lod = 0;
+			while (lod < mesh.total_lods && mesh.lods[lod].error <= max_error)
+				lod++;
+			return lod;
+		}
+
+		void select_for_voxelization(Mesh_Lods& lods, Scene& scene, float voxel_size)
+		{
+			lods.voxelization_triangles = select_scene(lods, scene, lods.voxelization_lods, [&](Model&) { return lods.max_error * voxel_size; });
+		}
+
+		void select_for_shadow_maps(Mesh_Lods& lods, Scene& scene, const mat4* layer_VP, const int* layer_resolution, int total_layers)
+		{
+			// the layers are orthographic, a texel is the same size everywhere in one
+			Frustum frustums[MAX_SHADOW_ATLAS_LAYERS];
+			float texel_sizes[MAX_SHADOW_ATLAS_LAYERS];
+			for (int i = 0; i < total_layers; i++) {
+				const mat4& m = layer_VP[i];
+				float ndc_per_world = glm::max(glm::length(vec3(m[0][0], m[1][0], m[2][0])), glm::length(vec3(m[0][1], m[1][1], m[2][1])));
+				frustums[i] = frustum::from_matrix(m);
+				texel_sizes[i] = 2.0f / (ndc_per_world * float(layer_resolution[i]));
+			}
+
+			lods.shadow_triangles = select_scene(lods, scene, lods.shadow_lods, [&](Model& model) {
+				Bounding_Box bounds = boundingbox::transformed(model.bounding_box, model.transform.mtx);
+				float texel_size = MAX_FLOAT_VALUE; // in none of them, culled
+				for (int i = 0; i < total_layers; i++)
+					if (frustum::intersects(frustums[i], bounds))
+						texel_size = glm::min(texel_size, texel_sizes[i]);
+				return lods.max_error * texel_size;
+			});
+		}
+
+		bool render_ui(Mesh_Lods& lods)
+		{
+			using namespace ImGui;
+
+			bool is_changed = Checkbox("lods in the voxelization and shadow maps", &lods.is_enabled);
+			is_changed |= SliderFloat("max error", &lods.max_error, 0.1f, 4.0f, "%.2f voxels / texels");
+			Text("voxelization: %d / %d triangles", lods.voxelization_triangles, lods.full_detail_triangles);
+			Text("shadow maps: %d / %d triangles", lods.shadow_triangles, lods.full_detail_triangles);
+			return is_changed;
+		}
+	}
+}
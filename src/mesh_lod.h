@@ -0,0 +1,41 @@
+#pragma once
+
+#include "scene.h"
+
+// Levels of detail for the passes that don't need the full detail: the voxelization, whose voxels are larger than most
+// triangles, and the shadow maps. Every mesh is simplified at load time by edge collapses ordered by a quadric error
+// (Garland & Heckbert), each lod continuing from the previous one with about half the triangles. Collapses only move a
+// vertex onto a neighbour, so the lods' vertices are the original ones with their normals and uvs, and the borders of
+// meshes and materials and the uv seams stay closed. A pass then picks per model the coarsest lod whose error, in
+// world space, stays under a fraction of its voxel or shadow map texel.
+
+namespace vxgi
+{
+	struct Mesh_Lods
+	{
+		Array<u8> voxelization_lods; // per sub mesh in scene order, 0 = full detail
+		Array<u8> shadow_lods;
+
+		bool is_enabled = true;
+		float max_error = 0.5f; // in voxels or shadow map texels
+
+		// stats
+		int voxelization_triangles = 0; // at the selected lods
+		int shadow_triangles = 0;
+		int full_detail_triangles = 0;
+	};
+
+	namespace meshlod
+	{
+		void generate(Mesh&, Array<Vertex>& vertices); // appends the lods' vertices to the mesh's (3 per triangle, in sub mesh ranges), doesn't call gl
+		void uninit(Mesh_Lods&);
+
+		Sub_Mesh& get_sub_mesh(Mesh&, int sub_mesh, int lod);
+		int select(Model&, Mesh&, float max_world_error); // the coarsest lod that's close enough
+
+		void select_for_voxelization(Mesh_Lods&, Scene&, float voxel_size);
+		void select_for_shadow_maps(Mesh_Lods&, Scene&, const mat4* layer_VP, const int* layer_resolution, int total_layers); // the finest texel of the layers a model is in
+
+		bool render_ui(Mesh_Lods&); // true when the settings changed
+	}
+}
@@ -0,0 +1,467 @@
+#include "meshlet_culling.h"
+
+#include <algorithm>
+#include <GLFW/glfw3.h>
+#include "lib/imgui/imgui.h"
+
+#include "cpu_profiler.h"
+#include "jobs.h"
+
+namespace vxgi
+{
+	namespace
+	{
+		const float CONE_WEIGHT = 0.5f; // how much a candidate's facing counts against its distance, see get_score
+		const float MIN_CONE_COS = 0.1f; // a wider normal cone has no camera position that sees every triangle's back
+		const int   DRAWS_PER_JOB = 16;
+
+		struct Clusterer // of one sub mesh at a time, the arrays are reused
+		{
+			Array<int> order;
+			Array<vec3> positions; // welded
+			Array<int> corners; // positions, 3 per triangle
+			Array<vec3> centers; // per triangle
+			Array<vec3> normals; // per triangle, 0 if degenerate
+			Array<int> first_triangle; // per position + 1, into triangles
+			Array<int> triangles; // around each position
+			Array<u32> morton; // per triangle, of its center
+			Array<int> seeds; // triangles in morton order
+			Array<u8> is_used; // per triangle
+			Array<int> position_meshlet; // per position, the meshlet it was last added to
+			Array<int> meshlet_positions; // of the current meshlet
+			Array<int> meshlet_triangles; // every triangle, meshlet after meshlet
+			Array<int> meshlet_lengths; // in triangles
+			Array<Vertex> scratch;
+		};
+
+		void uninit(Clusterer& c)
+		{
+			array::uninit(c.order);
+			array::uninit(c.positions);
+			array::uninit(c.corners);
+			array::uninit(c.centers);
+			array::uninit(c.normals);
+			array::uninit(c.first_triangle);
+			array::uninit(c.triangles);
+			array::uninit(c.morton);
+			array::uninit(c.seeds);
+			array::uninit(c.is_used);
+			array::uninit(c.position_meshlet);
+			array::uninit(c.meshlet_positions);
+			array::uninit(c.meshlet_triangles);
+			array::uninit(c.meshlet_lengths);
+			array::uninit(c.scratch);
+		}
+
+		u32 spread_bits(u32 x) // 10 bits to every third of 30
+		{
+			x = (x | (x << 16)) & 0x030000ff;
+			x = (x | (x << 8)) & 0x0300f00f;
+			x = (x | (x << 4)) & 0x030c30c3;
+			x = (x | (x << 2)) & 0x09249249;
+			return x;
+		}
+
+		float get_score(float distance, float spread, float expected_radius) // lower is better, see meshoptimizer's getMeshletScore
+		{
+			float cone = glm::max(1.0f - spread * CONE_WEIGHT, 1e-3f);
+			return (1.0f + distance / expected_radius * (1.0f - CONE_WEIGHT)) * cone;
+		}
+
+		int get_extra_positions(Clusterer& c, int triangle, int meshlet) // that adding the triangle would add
+		{
+			int extra = 0;
+			for (int k = 0; k < 3; k++)
+				if (c.position_meshlet[c.corners[triangle * 3 + k]] != meshlet)
+					extra++;
+			return extra;
+		}
+
+		void build_adjacency(Clusterer& c, const Array<Vertex>& vertices, int first_vertex, int total_triangles)
+		{
+			int total_vertices = total_triangles * 3;
+
+			// positions that are bit for bit the same are one
+			array::set_length(c.order, total_vertices);
+			for (int i = 0; i < total_vertices; i++)
+				c.order[i] = first_vertex + i;
+			std::sort(c.order.data, c.order.data + total_vertices, [&](int a, int b) {
+				return memcmp(&vertices[a].position, &vertices[b].position, sizeof(vec3)) < 0;
+			});
+
+			array::set_length(c.positions, 0);
+			array::set_length(c.corners, total_vertices);
+			for (int i = 0; i < total_vertices; i++) {
+				int v = c.order[i];
+				if (i == 0 || memcmp(&vertices[v].position, &vertices[c.order[i - 1]].position, sizeof(vec3)) != 0)
+					array::add(c.positions, vertices[v].position);
+				c.corners[v - first_vertex] = array::size(c.positions) - 1;
+			}
+
+			int total_positions = array::size(c.positions);
+			array::set_length(c.first_triangle, total_positions + 1);
+			memset(c.first_triangle.data, 0, sizeof(int) * (total_positions + 1));
+			for (int i = 0; i < total_vertices; i++)
+				c.first_triangle[c.corners[i] + 1]++;
+			for (int p = 0; p < total_positions; p++)
+				c.first_triangle[p + 1] += c.first_triangle[p];
+
+			array::set_length(c.triangles, total_vertices);
+			array::set_length(c.order, total_positions); // the next free slot per position
+			for (int p = 0; p < total_positions; p++)
+				c.order[p] = c.first_triangle[p];
+			for (int i = 0; i < total_vertices; i++)
+				c.triangles[c.order[c.corners[i]]++] = i / 3;
+		}
+
+		void build_meshlets(Clusterer& c, int total_triangles, float expected_radius)
+		{
+			int total_positions = array::size(c.positions);
+			array::set_length(c.is_used, total_triangles);
+			memset(c.is_used.data, 0, total_triangles);
+			array::set_length(c.position_meshlet, total_positions);
+			for (int p = 0; p < total_positions; p++)
+				c.position_meshlet[p] = -1;
+			array::set_length(c.meshlet_positions, 0);
+			array::set_length(c.meshlet_triangles, 0);
+			array::set_length(c.meshlet_lengths, 0);
+
+			int meshlet = 0;
+			int length = 0;
+			vec3 center_sum = vec3(0.0f);
+			vec3 normal_sum = vec3(0.0f);
+			int next_seed = 0;
+
+			auto next_unused_seed = [&]() {
+				while (next_seed < total_triangles && c.is_used[c.seeds[next_seed]])
+					next_seed++;
+				return next_seed < total_triangles ? c.seeds[next_seed] : -1;
+			};
+
+			auto end_meshlet = [&]() {
+				array::add(c.meshlet_lengths, length);
+				array::set_length(c.meshlet_positions, 0);
+				meshlet++;
+				length = 0;
+				center_sum = vec3(0.0f);
+				normal_sum = vec3(0.0f);
+			};
+
+			while (int(array::size(c.meshlet_triangles)) < total_triangles) {
+				int best = -1;
+				if (length > 0) {
+					vec3 center = center_sum / float(length);
+					vec3 axis = glm::length(normal_sum) > 0.0f ? glm::normalize(normal_sum) : vec3(0.0f);
+					int meshlet_positions = array::size(c.meshlet_positions);
+
+					// the triangles sharing a position with the meshlet, fewest new positions first
+					int best_extra = 4;
+					float best_score = MAX_FLOAT_VALUE;
+					for (int p : c.meshlet_positions) {
+						for (int j = c.first_triangle[p]; j < c.first_triangle[p + 1]; j++) {
+							int t = c.triangles[j];
+							if (c.is_used[t])
+								continue;
+							int extra = get_extra_positions(c, t, meshlet);
+							if (meshlet_positions + extra > MAX_MESHLET_VERTICES || extra > best_extra)
+								continue;
+							float score = get_score(glm::length(c.centers[t] - center), glm::dot(c.normals[t], axis), expected_radius);
+							if (extra < best_extra || score < best_score) {
+								best = t;
+								best_extra = extra;
+								best_score = score;
+							}
+						}
+					}
+
+					// none, the meshlet can still take a nearby triangle that isn't connected
+					if (best == -1) {
+						int seed = next_unused_seed();
+						if (seed != -1 && glm::length(c.centers[seed] - center) <= expected_radius && meshlet_positions + get_extra_positions(c, seed, meshlet) <= MAX_MESHLET_VERTICES)
+							best = seed;
+					}
+
+					if (best == -1) {
+						end_meshlet();
+						continue;
+					}
+				}
+				else {
+					best = next_unused_seed();
+				}
+
+				c.is_used[best] = 1;
+				array::add(c.meshlet_triangles, best);
+				for (int k = 0; k < 3; k++) {
+					int p = c.corners[best * 3 + k];
+					if (c.position_meshlet[p] != meshlet) {
+						c.position_meshlet[p] = meshlet;
+						array::add(c.meshlet_positions, p);
+					}
+				}
+				center_sum += c.centers[best];
+				normal_sum += c.normals[best];
+				length++;
+
+				if (length == MAX_MESHLET_TRIANGLES)
+					end_meshlet();
+			}
+			if (length > 0)
+				end_meshlet();
+		}
+
+		Meshlet get_bounds(const Array<Vertex>& vertices, int index, int length)
+		{
+			Meshlet m = {};
+			m.index = index;
+			m.length = length;
+
+			vec3 min_point = vec3(MAX_FLOAT_VALUE), max_point = vec3(MIN_FLOAT_VALUE);
+			for (int v = index; v < index + length; v++) {
+				min_point = glm::min(min_point, vertices[v].position);
+				max_point = glm::max(max_point, vertices[v].position);
+			}
+			m.center = (min_point + max_point) * 0.5f;
+			for (int v = index; v < index + length; v++)
+				m.radius = glm::max(m.radius, glm::length(vertices[v].position - m.center));
+
+			auto get_normal = [&](int v) {
+				vec3 n = glm::cross(vertices[v + 1].position - vertices[v].position, vertices[v + 2].position - vertices[v].position);
+				float n_length = glm::length(n);
+				return n_length > 0.0f ? n / n_length : vec3(0.0f); // degenerate ones aren't drawn
+			};
+
+			vec3 normal_sum = vec3(0.0f);
+			for (int v = index; v < index + length; v += 3)
+				normal_sum += get_normal(v);
+
+			m.cone_apex = m.center;
+			m.cone_axis = glm::length(normal_sum) > 0.0f ? glm::normalize(normal_sum) : vec3(0.0f, 0.0f, 1.0f);
+			m.cone_cutoff = 2.0f;
+
+			float min_cos = 1.0f;
+			for (int v = index; v < index + length; v += 3) {
+				vec3 n = get_normal(v);
+				if (n != vec3(0.0f))
+					min_cos = glm::min(min_cos, glm::dot(n, m.cone_axis));
+			}
+			if (min_cos <= MIN_CONE_COS)
+				return m;
+
+			// the apex goes back along the axis until it's behind every triangle's plane
+			float max_t = 0.0f;
+			for (int v = index; v < index + length; v += 3) {
+				vec3 n = get_normal(v);
+				if (n != vec3(0.0f))
+					max_t = glm::max(max_t, glm::dot(m.center - vertices[v].position, n) / glm::dot(m.cone_axis, n));
+			}
+			m.cone_apex = m.center - m.cone_axis * max_t;
+			m.cone_cutoff = sqrtf(1.0f - min_cos * min_cos);
+			return m;
+		}
+
+		void generate_sub_mesh(Clusterer& c, Mesh& mesh, Sub_Mesh& sub_mesh, Array<Vertex>& vertices)
+		{
+			int first_vertex = sub_mesh.index;
+			int total_triangles = sub_mesh.length / 3;
+			if (total_triangles == 0)
+				return;
+
+			build_adjacency(c, vertices, first_vertex, total_triangles);
+
+			float total_area = 0.0f;
+			vec3 min_point = vec3(MAX_FLOAT_VALUE), max_point = vec3(MIN_FLOAT_VALUE);
+			array::set_length(c.centers, total_triangles);
+			array::set_length(c.normals, total_triangles);
+			for (int t = 0; t < total_triangles; t++) {
+				vec3 p0 = c.positions[c.corners[t * 3]], p1 = c.positions[c.corners[t * 3 + 1]], p2 = c.positions[c.corners[t * 3 + 2]];
+				vec3 n = glm::cross(p1 - p0, p2 - p0);
+				float n_length = glm::length(n);
+				total_area += n_length * 0.5f;
+				c.centers[t] = (p0 + p1 + p2) / 3.0f;
+				c.normals[t] = n_length > 0.0f ? n / n_length : vec3(0.0f);
+				min_point = glm::min(min_point, c.centers[t]);
+				max_point = glm::max(max_point, c.centers[t]);
+			}
+
+			// the seeds of new meshlets go through the sub mesh in morton order, the next one is nearby
+			vec3 extent = glm::max(max_point - min_point, vec3(1e-6f));
+			array::set_length(c.morton, total_triangles);
+			array::set_length(c.seeds, total_triangles);
+			for (int t = 0; t < total_triangles; t++) {
+				glm::uvec3 cell = glm::uvec3(glm::clamp((c.centers[t] - min_point) / extent * 1023.0f, vec3(0.0f), vec3(1023.0f)));
+				c.morton[t] = spread_bits(cell.x) | (spread_bits(cell.y) << 1) | (spread_bits(cell.z) << 2);
+				c.seeds[t] = t;
+			}
+			std::sort(c.seeds.data, c.seeds.data + total_triangles, [&](int a, int b) { return c.morton[a] < c.morton[b]; });
+
+			// about the radius of a full meshlet of average triangles
+			float expected_radius = glm::max(sqrtf(total_area * float(MAX_MESHLET_TRIANGLES) / float(total_triangles)) * 0.5f, 1e-6f);
+			build_meshlets(c, total_triangles, expected_radius);
+
+			// the vertices in meshlet order
+			array::set_length(c.scratch, sub_mesh.length);
+			memcpy(c.scratch.data, &vertices[first_vertex], sizeof(Vertex) * sub_mesh.length);
+			for (int i = 0; i < total_triangles; i++)
+				memcpy(&vertices[first_vertex + i * 3], &c.scratch[c.meshlet_triangles[i] * 3], sizeof(Vertex) * 3);
+
+			int index = first_vertex;
+			for (int length : c.meshlet_lengths) {
+				array::add(mesh.meshlets, get_bounds(vertices, index, length * 3));
+				index += length * 3;
+			}
+		}
+
+		struct Cull_Stats // per job
+		{
+			int tested = 0;
+			int frustum_culled = 0;
+			int cone_culled = 0;
+			int drawn = 0;
+		};
+
+		bool is_outside(const Frustum& frustum, vec3 center, float radius)
+		{
+			for (const vec4& plane : frustum.planes)
+				if (glm::dot(vec3(plane), center) + plane.w < -radius)
+					return true;
+			return false;
+		}
+
+		int cull_draw(Meshlet_Culling& mc, Meshlet_Culling::Draw& draw, const Frustum& frustum, vec3 camera_position, Cull_Stats& stats)
+		{
+			Sub_Mesh& sub_mesh = draw.mesh->sub_meshes[draw.sub_mesh];
+			Meshlet_Culling::Range* ranges = &mc.ranges[draw.first_range];
+			if (sub_mesh.length == 0)
+				return 0;
+			if (sub_mesh.total_meshlets == 0) {
+				ranges[0] = { sub_mesh.index, sub_mesh.length };
+				return 1;
+			}
+
+			// the cone test is in model space, facing away doesn't change with the transform unless it mirrors
+			const mat4& M = draw.model->transform.mtx;
+			float max_scale = glm::max(glm::length(vec3(M[0])), glm::max(glm::length(vec3(M[1])), glm::length(vec3(M[2]))));
+			bool is_cone_culling = mc.is_cone_culling && glm::determinant(glm::mat3(M)) > 0.0f;
+			vec3 camera = vec3(glm::inverse(M) * vec4(camera_position, 1.0f));
+
+			int total_ranges = 0;
+			for (int i = sub_mesh.first_meshlet; i < sub_mesh.first_meshlet + sub_mesh.total_meshlets; i++) {
+				Meshlet& meshlet = draw.mesh->meshlets[i];
+				stats.tested++;
+
+				if (is_outside(frustum, vec3(M * vec4(meshlet.center, 1.0f)), meshlet.radius * max_scale)) {
+					stats.frustum_culled++;
+					continue;
+				}
+				if (is_cone_culling && meshlet.cone_cutoff <= 1.0f && glm::dot(glm::normalize(meshlet.cone_apex - camera), meshlet.cone_axis) >= meshlet.cone_cutoff) {
+					stats.cone_culled++;
+					continue;
+				}
+				stats.drawn++;
+
+				// the meshlets are consecutive, neighbours that both survive are one draw
+				if (total_ranges > 0 && ranges[total_ranges - 1].index + ranges[total_ranges - 1].length == meshlet.index)
+					ranges[total_ranges - 1].length += meshlet.length;
+				else
+					ranges[total_ranges++] = { meshlet.index, meshlet.length };
+			}
+			return total_ranges;
+		}
+	}
+
+	namespace meshletculling
+	{
+		void generate(Mesh& mesh, Array<Vertex>& vertices)
+		{
+			Clusterer c;
+			defer { uninit(c); };
+
+			array::set_length(mesh.meshlets, 0);
+			for (Sub_Mesh& sub_mesh : mesh.sub_meshes) {
+				sub_mesh.first_meshlet = array::size(mesh.meshlets);
+				generate_sub_mesh(c, mesh, sub_mesh, vertices);
+				sub_mesh.total_meshlets = array::size(mesh.meshlets) - sub_mesh.first_meshlet;
+			}
+		}
+
+		void uninit(Meshlet_Culling& mc)
+		{
+			array::uninit(mc.draws);
+			array::uninit(mc.ranges);
+			array::uninit(mc.total_ranges);
+			mc.is_built = false;
+		}
+
+		void build(Meshlet_Culling& mc, Scene& scene)
+		{
+			mc.is_built = true;
+			array::set_length(mc.draws, 0);
+			mc.total_meshlets = 0;
+
+			int total_ranges = 0;
+			for (Model* model : scene.models) {
+				for (Mesh* mesh : model->meshes) {
+					for (int i = 0; i < int(array::size(mesh->sub_meshes)); i++) {
+						int total_meshlets = mesh->sub_meshes[i].total_meshlets;
+						array::add(mc.draws, Meshlet_Culling::Draw { model, mesh, i, total_ranges });
+						total_ranges += glm::max(total_meshlets, 1);
+						mc.total_meshlets += total_meshlets;
+					}
+				}
+			}
+
+			array::set_length(mc.ranges, total_ranges);
+			array::set_length(mc.total_ranges, array::size(mc.draws));
+			memset(mc.total_ranges.data, 0, sizeof(int) * array::size(mc.draws));
+
+			LOG("meshlets", "%d meshlets in %d sub meshes", mc.total_meshlets, int(array::size(mc.draws)));
+		}
+
+		int cull(Meshlet_Culling& mc, const Frustum& frustum, vec3 camera_position, const u8* is_visible)
+		{
+			CPU_ZONE("meshlet culling");
+			double start_time = glfwGetTime();
+
+			int total = array::size(mc.draws);
+			int total_jobs = (total + DRAWS_PER_JOB - 1) / DRAWS_PER_JOB;
+			Array<Cull_Stats> job_stats;
+			defer { array::uninit(job_stats); };
+			array::set_length(job_stats, total_jobs);
+
+			jobs::parallel_for(total_jobs, [&](int job) {
+				Cull_Stats stats;
+				int end = glm::min((job + 1) * DRAWS_PER_JOB, total);
+				for (int i = job * DRAWS_PER_JOB; i < end; i++)
+					mc.total_ranges[i] = (is_visible && !is_visible[i]) ? 0 : cull_draw(mc, mc.draws[i], frustum, camera_position, stats);
+				job_stats[job] = stats;
+			});
+
+			mc.tested = mc.frustum_culled = mc.cone_culled = mc.drawn = mc.drawn_ranges = 0;
+			for (Cull_Stats& stats : job_stats) {
+				mc.tested += stats.tested;
+				mc.frustum_culled += stats.frustum_culled;
+				mc.cone_culled += stats.cone_culled;
+				mc.drawn += stats.drawn;
+			}
+			for (int i = 0; i < total; i++)
+				mc.drawn_ranges += mc.total_ranges[i];
+
+			mc.cull_ms = 1000.0 * (glfwGetTime() - start_time);
+			return mc.drawn_ranges;
+		}
+
+		void render_ui(Meshlet_Culling& mc)
+		{
+			using namespace ImGui;
+
+			Checkbox("meshlet culling", &mc.is_enabled);
+			if (IsItemHovered())
+				SetTooltip("g-buffer pass with multi draw only");
+			Checkbox("normal cones", &mc.is_cone_culling);
+			Text("%d meshlets, %d tested in the visible sub meshes", mc.total_meshlets, mc.tested);
+			Text("%d outside the frustum, %d facing away", mc.frustum_culled, mc.cone_culled);
+			Text("%d drawn in %d commands, culled in %.3f ms", mc.drawn, mc.drawn_ranges, mc.cull_ms);
+		}
+	}
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "scene.h"
+#include "frustum_culling.h"
+
+// Culling below the sub meshes: at load time every sub mesh's triangles are regrouped into meshlets, clusters of
+// neighbouring triangles grown greedily from a seed while they share vertices and face about the same way, then written
+// back meshlet by meshlet so that each one is a range of the vertices. A meshlet has a bounding sphere and a normal cone
+// (as in meshoptimizer). The g-buffer pass then tests the meshlets of the sub meshes that are still visible on the job
+// threads, against the camera frustum and for facing away from the camera (which the back face culling would discard
+// anyway), and the survivors become the multi draw's indirect commands, neighbouring ones merged into one.
+
+namespace vxgi
+{
+	const int MAX_MESHLET_TRIANGLES = 128;
+	const int MAX_MESHLET_VERTICES = 64; // distinct positions, keeps them compact
+
+	struct Meshlet_Culling
+	{
+		struct Range // of a sub mesh's vertices that's drawn
+		{
+			int index;
+			int length;
+		};
+
+		struct Draw // a sub mesh in scene order
+		{
+			Model* model;
+			Mesh* mesh;
+			int sub_mesh;
+			int first_range; // the most it can have is its meshlets, or 1 without them
+		};
+
+		Array<Draw> draws;
+		Array<Range> ranges; // of the latest cull, from each draw's first_range
+		Array<int> total_ranges; // per draw
+
+		bool is_built = false;
+		bool is_enabled = true;
+		bool is_cone_culling = true;
+
+		// stats of the latest cull
+		int total_meshlets = 0; // in the scene
+		int tested = 0; // in the visible sub meshes
+		int frustum_culled = 0;
+		int cone_culled = 0;
+		int drawn = 0;
+		int drawn_ranges = 0;
+		double cull_ms = 0.0;
+	};
+
+	namespace meshletculling
+	{
+		void generate(Mesh&, Array<Vertex>& vertices); // reorders each sub mesh's vertices into its meshlets, before they're uploaded. doesn't call gl
+		void uninit(Meshlet_Culling&);
+
+		void build(Meshlet_Culling&, Scene&); // once the models have their final transforms
+		int  cull(Meshlet_Culling&, const Frustum&, vec3 camera_position, const u8* is_visible); // per sub mesh in scene order. returns the ranges
+
+		void render_ui(Meshlet_Culling&);
+	}
+}
@@ -0,0 +1,370 @@
+#include "multi_draw.h"
+
+#include <GLFW/glfw3.h>
+#include "lib/imgui/imgui.h"
+
+#include "assets.h"
+#include "mesh_lod.h"
+#include "meshlet_culling.h"
+
+namespace vxgi
+{
+	namespace
+	{
+		bool has_extension(const char* name) // GLEW with glewExperimental reports extensions whose entry points merely exist
+		{
+			GLint total = 0;
+			glGetIntegerv(GL_NUM_EXTENSIONS, &total);
+			for (GLint i = 0; i < total; i++)
+				if (strcmp((const char*) glGetStringi(GL_EXTENSIONS, i), name) == 0)
+					return true;
+			return false;
+		}
+
+		Texture2D* get_material_texture(Texture2D* texture)
+		{
+			return (texture && texture->is_loaded) ? texture : &assets::get_white_texture();
+		}
+
+		u64 get_resident_handle(Multi_Draw& md, Texture2D* texture)
+		{
+			// the same texture gives the same handle, it can only be made resident once
+			GLuint64 handle = glGetTextureHandleARB(texture->id);
+			if (!glIsTextureHandleResidentARB(handle)) {
+				glMakeTextureHandleResidentARB(handle);
+				md.total_textures++;
+			}
+			return u64(handle);
+		}
+
+		// one GL_TEXTURE_2D_ARRAY per texture size, the textures are copied in as layers. like the originals there are no mipmaps
+		bool build_texture_arrays(Multi_Draw& md, Array<Texture2D*>& textures, Hashmap<Texture2D*, u64>& locations)
+		{
+			int widths[MULTI_DRAW_MAX_TEXTURE_ARRAYS];
+			int heights[MULTI_DRAW_MAX_TEXTURE_ARRAYS];
+			int layers[MULTI_DRAW_MAX_TEXTURE_ARRAYS] = {};
+			int total_arrays = 0;
+
+			for (Texture2D* texture : textures) {
+				int index = 0;
+				while (index < total_arrays && (widths[index] != texture->width || heights[index] != texture->height))
+					index++;
+
+				if (index == total_arrays) {
+					if (total_arrays == MULTI_DRAW_MAX_TEXTURE_ARRAYS) {
+						LOG("multidraw", "more than %d texture sizes, the scene is drawn sub mesh by sub mesh", MULTI_DRAW_MAX_TEXTURE_ARRAYS);
+						return false;
+					}
+					widths[index] = texture->width;
+					heights[index] = texture->height;
+					total_arrays++;
+				}
+
+				hashmap::insert(locations, texture, u64(index) | (u64(layers[index]) << 32));
+				layers[index]++;
+			}
+
+			glGenTextures(total_arrays, md.texture_arrays);
+			for (int i = 0; i < total_arrays; i++) {
+				glBindTexture(GL_TEXTURE_2D_ARRAY, md.texture_arrays[i]);
+				glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_RGBA8, widths[i], heights[i], layers[i]);
+				glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR); // same as upload_texture in assets.cpp
+				glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+				glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+				glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+			}
+			glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+			for (Texture2D* texture : textures) {
+				u64 location = hashmap::get(locations, texture);
+				GLuint index = GLuint(location & 0xffffffff);
+				GLint layer = GLint(location >> 32);
+				glCopyImageSubData(texture->id, GL_TEXTURE_2D, 0, 0, 0, 0, md.texture_arrays[index], GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, texture->width, texture->height, 1);
+			}
+
+			md.total_texture_arrays = total_arrays;
+			md.total_textures = array::size(textures);
+			return true;
+		}
+
+		void submit(Multi_Draw& md, GLuint command_buffer, int total_commands)
+		{
+			glBindVertexArray(md.vao);
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, command_buffer);
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MULTI_DRAW_BINDING_DRAWS, md.draws_ssbo);
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MULTI_DRAW_BINDING_MATERIALS, md.materials_ssbo);
+			for (int i = 0; i < md.total_texture_arrays; i++) {
+				glActiveTexture(GL_TEXTURE0 + MULTI_DRAW_TEXTURE_ARRAY_UNIT + i);
+				glBindTexture(GL_TEXTURE_2D_ARRAY, md.texture_arrays[i]);
+			}
+
+			glMultiDrawArraysIndirect(GL_TRIANGLES, NULL, total_commands, 0);
+
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+			glBindVertexArray(0);
+		}
+	}
+
+	namespace multidraw
+	{
+		void init(Multi_Draw& md)
+		{
+			md.is_supported = true; // glMultiDrawArraysIndirect + base instance are core in 4.5
+			md.is_bindless = GLEW_ARB_bindless_texture && has_extension("GL_ARB_bindless_texture");
+			LOG("multidraw", "material textures through %s", md.is_bindless ? "bindless handles" : "texture arrays");
+		}
+
+		const char* get_shader_defines(Multi_Draw& md)
+		{
+			return md.is_bindless ? "#define MULTI_DRAW\n#define MULTI_DRAW_BINDLESS\n" : "#define MULTI_DRAW\n";
+		}
+
+		void uninit(Multi_Draw& md)
+		{
+			if (!md.is_built || !md.is_supported)
+				return;
+
+			glDeleteVertexArrays(1, &md.vao);
+			glDeleteBuffers(1, &md.vertex_buffer);
+			glDeleteBuffers(1, &md.draw_id_buffer);
+			glDeleteBuffers(1, &md.command_buffer);
+			glDeleteBuffers(1, &md.meshlet_command_buffer);
+			glDeleteBuffers(1, &md.draws_ssbo);
+			glDeleteBuffers(1, &md.materials_ssbo);
+			glDeleteTextures(md.total_texture_arrays, md.texture_arrays);
+			array::uninit(md.commands);
+			array::uninit(md.sources);
+			array::uninit(md.meshlet_commands);
+			md.is_built = false;
+		}
+
+		void build(Multi_Draw& md, Scene& scene)
+		{
+			md.is_built = true;
+			if (!md.is_supported)
+				return;
+
+			double start_time = glfwGetTime();
+
+			Array<Multi_Draw::Draw_Std430> draws;
+			Array<Multi_Draw::Material_Std430> materials;
+			Array<u32> draw_ids;
+			Array<Texture2D*> textures; // unique, without bindless textures
+			Hashmap<Texture2D*, u64> texture_locations; // see Material_Std430
+			Array<Multi_Draw::Command>& commands = md.commands;
+			defer {
+				array::uninit(draws);
+				array::uninit(materials);
+				array::uninit(draw_ids);
+				array::uninit(textures);
+				hashmap::uninit(texture_locations);
+			};
+
+			md.total_materials = assets::get_total_materials();
+
+			if (!md.is_bindless) {
+				for (int i = 0; i < md.total_materials; i++) {
+					Material& m = assets::get_material(i);
+					for (Texture2D* map : { m.map_Ka, m.map_Kd, m.map_Ks, m.map_Ke, m.map_bump }) {
+						Texture2D* texture = get_material_texture(map);
+						if (!hashmap::contains(texture_locations, texture)) {
+							hashmap::insert(texture_locations, texture, u64(0));
+							array::add(textures, texture);
+						}
+					}
+				}
+
+				if (!build_texture_arrays(md, textures, texture_locations)) {
+					md.is_supported = false;
+					return;
+				}
+			}
+
+			auto get_texture = [&](Texture2D* map) -> u64 {
+				Texture2D* texture = get_material_texture(map);
+				return md.is_bindless ? get_resident_handle(md, texture) : hashmap::get(texture_locations, texture);
+			};
+
+			// the vertices are only on the gpu after loading, they're copied buffer to buffer
+			GLint64 total_bytes = 0;
+			for (Model* model : scene.models) {
+				for (Mesh* mesh : model->meshes) {
+					GLint64 size = 0;
+					glGetNamedBufferParameteri64v(mesh->vbo, GL_BUFFER_SIZE, &size);
+					total_bytes += size;
+				}
+			}
+
+			glGenBuffers(1, &md.vertex_buffer);
+			glBindBuffer(GL_COPY_WRITE_BUFFER, md.vertex_buffer);
+			glBufferData(GL_COPY_WRITE_BUFFER, total_bytes, NULL, GL_STATIC_DRAW);
+			glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+			GLint64 offset = 0;
+			for (Model* model : scene.models) {
+				for (Mesh* mesh : model->meshes) {
+					GLint64 size = 0;
+					glGetNamedBufferParameteri64v(mesh->vbo, GL_BUFFER_SIZE, &size);
+					glCopyNamedBufferSubData(mesh->vbo, md.vertex_buffer, 0, offset, size);
+
+					u32 first_vertex = u32(offset / sizeof(Vertex));
+					for (int i = 0; i < int(array::size(mesh->sub_meshes)); i++) {
+						Sub_Mesh& sub_mesh = mesh->sub_meshes[i];
+						u32 draw_id = array::size(draws);
+						array::add(commands, Multi_Draw::Command { u32(sub_mesh.length), 1, first_vertex + u32(sub_mesh.index), draw_id });
+						array::add(md.sources, Multi_Draw::Draw_Source { mesh, i, first_vertex });
+						array::add(draws, Multi_Draw::Draw_Std430 { model->transform.mtx, model->transform.normal_mtx, u32(sub_mesh.material_index) });
+						array::add(draw_ids, draw_id);
+						md.max_meshlet_commands += glm::max(sub_mesh.total_meshlets, 1);
+					}
+					offset += size;
+				}
+			}
+
+			md.total_draws = array::size(draws);
+			md.total_vertices = int(total_bytes / sizeof(Vertex));
+			for (int i = 0; i < md.total_materials; i++) {
+				Material& m = assets::get_material(i);
+				Multi_Draw::Material_Std430 data = {};
+				data.Ka = m.Ka;
+				data.Ns = m.Ns;
+				data.Kd = m.Kd;
+				data.d = m.d;
+				data.Ks = m.Ks;
+				data.Ni = m.Ni;
+				data.Ke = m.Ke;
+				data.map_Ka = get_texture(m.map_Ka);
+				data.map_Kd = get_texture(m.map_Kd);
+				data.map_Ks = get_texture(m.map_Ks);
+				data.map_Ke = get_texture(m.map_Ke);
+				data.map_bump = get_texture(m.map_bump);
+				array::add(materials, data);
+			}
+
+			glGenBuffers(1, &md.command_buffer);
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, md.command_buffer);
+			glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(Multi_Draw::Command) * md.total_draws, commands.data, GL_STATIC_DRAW);
+			glGenBuffers(1, &md.meshlet_command_buffer);
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, md.meshlet_command_buffer);
+			glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(Multi_Draw::Command) * md.max_meshlet_commands, NULL, GL_DYNAMIC_DRAW);
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+			glGenBuffers(1, &md.draws_ssbo);
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, md.draws_ssbo);
+			glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(Multi_Draw::Draw_Std430) * md.total_draws, draws.data, GL_STATIC_DRAW);
+			glGenBuffers(1, &md.materials_ssbo);
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, md.materials_ssbo);
+			glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(Multi_Draw::Material_Std430) * md.total_materials, materials.data, GL_STATIC_DRAW);
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+			// same attributes as a mesh's vao (see upload_mesh_to_gpu in assets.cpp), plus the draw id per instance
+			size_t vertex_size = sizeof(Vertex);
+			glGenVertexArrays(1, &md.vao);
+			glBindVertexArray(md.vao);
+
+			glBindBuffer(GL_ARRAY_BUFFER, md.vertex_buffer);
+			glEnableVertexAttribArray(0); glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, vertex_size, (GLvoid*) offsetof(Vertex, position));
+			glEnableVertexAttribArray(1); glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, vertex_size, (GLvoid*) offsetof(Vertex, normal));
+			glEnableVertexAttribArray(2); glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, vertex_size, (GLvoid*) offsetof(Vertex, color));
+			glEnableVertexAttribArray(3); glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, vertex_size, (GLvoid*) offsetof(Vertex, tex_coord));
+			glEnableVertexAttribArray(4); glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, vertex_size, (GLvoid*) offsetof(Vertex, tangent));
+			glEnableVertexAttribArray(5); glVertexAttribPointer(5, 3, GL_FLOAT, GL_FALSE, vertex_size, (GLvoid*) offsetof(Vertex, bitangent));
+
+			// instance i of a command reads draw_ids[base instance + i], there's one instance
+			glGenBuffers(1, &md.draw_id_buffer);
+			glBindBuffer(GL_ARRAY_BUFFER, md.draw_id_buffer);
+			glBufferData(GL_ARRAY_BUFFER, sizeof(u32) * md.total_draws, draw_ids.data, GL_STATIC_DRAW);
+			glEnableVertexAttribArray(MULTI_DRAW_ID_ATTRIBUTE);
+			glVertexAttribIPointer(MULTI_DRAW_ID_ATTRIBUTE, 1, GL_UNSIGNED_INT, sizeof(u32), (GLvoid*) 0);
+			glVertexAttribDivisor(MULTI_DRAW_ID_ATTRIBUTE, 1);
+
+			glBindVertexArray(0);
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+			check_gl_error();
+
+			LOG("multidraw", "%d draws, %d vertices, %d materials, %d textures (%d texture arrays) in %.1f ms", md.total_draws, md.total_vertices, md.total_materials, md.total_textures, md.total_texture_arrays, 1000.0 * (glfwGetTime() - start_time));
+		}
+
+		bool is_active(Multi_Draw& md)
+		{
+			return md.is_supported && md.is_built && md.is_enabled;
+		}
+
+		void draw(Multi_Draw& md, const u8* is_visible, const u8* lods)
+		{
+			double start_time = glfwGetTime();
+
+			// the culled commands draw 0 instances, the command buffer is only re-uploaded when the visibility or the lods can change
+			if (is_visible || lods || !md.is_everything_drawn) {
+				for (int i = 0; i < md.total_draws; i++) {
+					Multi_Draw::Command& command = md.commands[i];
+					Multi_Draw::Draw_Source& source = md.sources[i];
+					Sub_Mesh& sub_mesh = meshlod::get_sub_mesh(*source.mesh, source.sub_mesh, lods ? lods[i] : 0);
+					command.count = u32(sub_mesh.length);
+					command.first = source.first_vertex + u32(sub_mesh.index);
+					command.instance_count = is_visible ? is_visible[i] : 1;
+				}
+				glNamedBufferSubData(md.command_buffer, 0, sizeof(Multi_Draw::Command) * md.total_draws, md.commands.data);
+				md.is_everything_drawn = !is_visible && !lods;
+			}
+
+			submit(md, md.command_buffer, md.total_draws);
+			add_submit_stats(md, 1, start_time);
+		}
+
+		void draw_meshlets(Multi_Draw& md, Meshlet_Culling& mc)
+		{
+			double start_time = glfwGetTime();
+			ASSERT(int(array::size(mc.draws)) == md.total_draws, "multidraw", "%d meshlet culling draws for %d commands", int(array::size(mc.draws)), md.total_draws);
+
+			// every range is a command of its sub mesh's draw, the base instance picks its transform and material
+			array::set_length(md.meshlet_commands, 0);
+			for (int i = 0; i < md.total_draws; i++) {
+				Multi_Draw::Draw_Source& source = md.sources[i];
+				Meshlet_Culling::Range* ranges = &mc.ranges[mc.draws[i].first_range];
+				for (int r = 0; r < mc.total_ranges[i]; r++)
+					array::add(md.meshlet_commands, Multi_Draw::Command { u32(ranges[r].length), 1, source.first_vertex + u32(ranges[r].index), u32(i) });
+			}
+
+			int total_commands = array::size(md.meshlet_commands);
+			if (total_commands > 0) {
+				glNamedBufferSubData(md.meshlet_command_buffer, 0, sizeof(Multi_Draw::Command) * total_commands, md.meshlet_commands.data);
+				submit(md, md.meshlet_command_buffer, total_commands);
+			}
+			add_submit_stats(md, 1, start_time);
+		}
+
+		void add_submit_stats(Multi_Draw& md, int draw_calls, double start_time)
+		{
+			md.frame_draw_calls += draw_calls;
+			md.frame_submit_ms += 1000.0 * (glfwGetTime() - start_time);
+		}
+
+		void end_frame(Multi_Draw& md)
+		{
+			md.draw_calls = md.frame_draw_calls;
+			md.submit_ms = md.frame_submit_ms;
+			md.frame_draw_calls = 0;
+			md.frame_submit_ms = 0.0;
+		}
+
+		void render_ui(Multi_Draw& md)
+		{
+			using namespace ImGui;
+
+			if (md.is_supported)
+				Checkbox("multi draw indirect", &md.is_enabled);
+			else
+				Text("too many texture sizes, sub mesh by sub mesh");
+
+			Text("%d draws, %d vertices, %d materials", md.total_draws, md.total_vertices, md.total_materials);
+			if (md.is_bindless)
+				Text("%d bindless textures", md.total_textures);
+			else
+				Text("%d textures in %d texture arrays", md.total_textures, md.total_texture_arrays);
+			Text("last frame: %d draw calls, %.3f ms submitting", md.draw_calls, md.submit_ms);
+			if (IsItemHovered())
+				SetTooltip("scene passes only. the shadow maps and the voxelization don't run every frame");
+		}
+	}
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include "opengl.h"
+#include "scene.h"
+
+// GPU-driven scene drawing: every mesh's vertices are copied into one vertex buffer and every sub mesh becomes an
+// indirect draw command, so a scene pass (g-buffer, shadow maps, voxelization) is a single glMultiDrawArraysIndirect.
+// A command's base instance is its index into the per-draw ssbo (transform + material). The materials' textures are
+// bindless handles with GL_ARB_bindless_texture, otherwise they're copied into one texture array per texture size.
+// If neither works out the renderer draws sub mesh by sub mesh. See multi_draw.glsl.
+
+namespace vxgi
+{
+	enum MULTI_DRAW_BINDING : GLuint // layout(std430, binding = N), after the light clusters (2, 3)
+	{
+		MULTI_DRAW_BINDING_DRAWS     = 4,
+		MULTI_DRAW_BINDING_MATERIALS = 5
+	};
+
+	const GLuint MULTI_DRAW_ID_ATTRIBUTE = 6; // after the Vertex attributes, see upload_mesh_to_gpu in assets.cpp
+
+	const int    MULTI_DRAW_MAX_TEXTURE_ARRAYS = 8; // distinct texture sizes, see u_material_textures in multi_draw.glsl
+	const GLuint MULTI_DRAW_TEXTURE_ARRAY_UNIT = 8; // the arrays take units 8...15
+
+	struct Meshlet_Culling;
+
+	struct Multi_Draw
+	{
+		struct Draw_Std430 // mirrors Multi_Draw_Data in multi_draw.glsl
+		{
+			mat4 M;
+			mat4 N;
+			u32  material;
+			u32  _pad0[3] = {};
+		};
+
+		struct Material_Std430 // mirrors Multi_Draw_Material in multi_draw.glsl
+		{
+			vec3 Ka;
+			float Ns;
+			vec3 Kd;
+			float d;
+			vec3 Ks;
+			float Ni;
+			vec3 Ke;
+			float _pad0;
+			u64 map_Ka; // bindless handles, or the texture array index in the low 32 bits and the layer in the high
+			u64 map_Kd;
+			u64 map_Ks;
+			u64 map_Ke;
+			u64 map_bump;
+			u64 _pad1;
+		};
+
+		struct Command // DrawArraysIndirectCommand
+		{
+			u32 count;
+			u32 instance_count;
+			u32 first;
+			u32 base_instance; // = draw id
+		};
+
+		GLuint vao = 0;
+		GLuint vertex_buffer = 0; // every mesh's vertices, one after another
+		GLuint draw_id_buffer = 0; // u32 0...total_draws-1, read per instance
+		GLuint command_buffer = 0;
+		GLuint meshlet_command_buffer = 0; // the meshlet ranges that survived, see meshlet_culling.h
+		GLuint draws_ssbo = 0;
+		GLuint materials_ssbo = 0;
+		GLuint texture_arrays[MULTI_DRAW_MAX_TEXTURE_ARRAYS] = {}; // without bindless textures
+
+		struct Draw_Source // what a command draws at each lod
+		{
+			Mesh* mesh;
+			int sub_mesh;
+			u32 first_vertex; // of the mesh in vertex_buffer
+		};
+
+		Array<Command> commands; // culled sub meshes have 0 instances
+		Array<Draw_Source> sources; // per command
+		Array<Command> meshlet_commands; // of the latest draw_meshlets
+		int max_meshlet_commands = 0; // every meshlet drawn separately
+		bool is_everything_drawn = true; // the command buffer has every instance count at 1, at full detail
+
+		int total_draws = 0;
+		int total_vertices = 0;
+		int total_materials = 0;
+		int total_textures = 0; // resident handles or texture array layers
+		int total_texture_arrays = 0;
+
+		bool is_supported = false; // false once the build finds more texture sizes than texture arrays
+		bool is_bindless = false; // GL_ARB_bindless_texture
+		bool is_built = false;
+		bool is_enabled = true; // otherwise sub mesh by sub mesh, to compare
+
+		// stats, counted by the scene draw functions and published once per frame
+		int    frame_draw_calls = 0;
+		double frame_submit_ms = 0.0;
+		int    draw_calls = 0;
+		double submit_ms = 0.0;
+	};
+	static_assert(sizeof(Multi_Draw::Draw_Std430) == 144, "Draw_Std430 doesn't match the std430 layout");
+	static_assert(sizeof(Multi_Draw::Material_Std430) == 112, "Material_Std430 doesn't match the std430 layout");
+
+	namespace multidraw
+	{
+		void init(Multi_Draw&);
+		const char* get_shader_defines(Multi_Draw&); // for the multi draw variants of the scene programs
+		void uninit(Multi_Draw&);
+
+		void build(Multi_Draw&, Scene&); // once the scene is loaded, copies the vertices and makes the textures resident
+		bool is_active(Multi_Draw&); // supported, built and enabled
+		void draw(Multi_Draw&, const u8* is_visible = NULL, const u8* lods = NULL); // per sub mesh in scene order, NULL = all / full detail. the pass's multi draw program has to be active
+		void draw_meshlets(Multi_Draw&, Meshlet_Culling&); // the ranges of the latest meshletculling::cull, at full detail
+
+		void add_submit_stats(Multi_Draw&, int draw_calls, double start_time); // start_time from glfwGetTime
+		void end_frame(Multi_Draw&);
+
+		void render_ui(Multi_Draw&);
+	}
+}
@@ -0,0 +1,323 @@
+#include "occlusion_culling.h"
+
+#include <algorithm>
+#include <GLFW/glfw3.h>
+#include "lib/imgui/imgui.h"
+
+#include "assets.h"
+#include "cpu_profiler.h"
+#include "jobs.h"
+
+namespace vxgi
+{
+	namespace
+	{
+		const int TILES_X = OCCLUSION_WIDTH / OCCLUSION_TILE_WIDTH;
+		const int TILES_Y = OCCLUSION_HEIGHT / OCCLUSION_TILE_HEIGHT;
+		const int BLOCKS_X = OCCLUSION_WIDTH / OCCLUSION_BLOCK_SIZE;
+		const int BLOCKS_Y = OCCLUSION_HEIGHT / OCCLUSION_BLOCK_SIZE;
+		static_assert(OCCLUSION_TILE_WIDTH % 8 == 0 && OCCLUSION_TILE_HEIGHT % OCCLUSION_BLOCK_SIZE == 0 && OCCLUSION_TILE_WIDTH % OCCLUSION_BLOCK_SIZE == 0, "a tile is whole packets and blocks");
+		static_assert(OCCLUSION_WIDTH % OCCLUSION_TILE_WIDTH == 0 && OCCLUSION_HEIGHT % OCCLUSION_TILE_HEIGHT == 0, "the depth buffer is whole tiles");
+
+		const int TRIANGLES_PER_JOB = 256; // vertex transform
+		const int SUB_MESHES_PER_JOB = 64; // aabb tests
+		const float MIN_W = 1e-4f; // in front of the camera
+		const float DEPTH_EPSILON = 1e-5f;
+
+		//
+		// 8 pixels of a row at a time, gcc/clang vector extensions like the packets in cpu_cone_tracing.cpp
+		//
+		typedef float f32x8 __attribute__((vector_size(32)));
+		typedef s32   s32x8 __attribute__((vector_size(32)));
+
+		inline f32x8 splat(float f) { return f32x8{} + f; }
+		inline f32x8 select(s32x8 mask, f32x8 a, f32x8 b) { return (f32x8) (((s32x8) a & mask) | ((s32x8) b & ~mask)); }
+		inline f32x8 load8(const float* p) { f32x8 v; memcpy(&v, p, sizeof(v)); return v; }
+		inline void  store8(float* p, f32x8 v) { memcpy(p, &v, sizeof(v)); }
+		const f32x8 LANE_OFFSETS = { 0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f }; // pixel centers
+
+		struct Occluder_Candidate
+		{
+			Model* model;
+			Mesh* mesh;
+			Sub_Mesh* sub_mesh;
+			float score; // aabb surface area per triangle, big and simple first
+		};
+
+		float surface_area(const Bounding_Box& b)
+		{
+			vec3 s = b.max_point - b.min_point;
+			return 2.0f * (s.x * s.y + s.y * s.z + s.z * s.x);
+		}
+
+		void transform_triangle(Occlusion_Culling::Triangle& out, const vec3* v, const mat4& VP)
+		{
+			out.min_x = out.min_y = 0;
+			out.max_x = out.max_y = -1;
+
+			vec3 screen[3];
+			for (int i = 0; i < 3; i++) {
+				vec4 clip = VP * vec4(v[i], 1.0f);
+				if (clip.w < MIN_W)
+					return; // not drawing an occluder is always safe
+				vec3 ndc = vec3(clip) / clip.w;
+				screen[i] = vec3((ndc.x * 0.5f + 0.5f) * OCCLUSION_WIDTH, (ndc.y * 0.5f + 0.5f) * OCCLUSION_HEIGHT, ndc.z * 0.5f + 0.5f);
+			}
+
+			out.p0 = vec2(screen[0]);
+			out.p1 = vec2(screen[1]);
+			out.p2 = vec2(screen[2]);
+			out.depth = vec3(screen[0].z, screen[1].z, screen[2].z);
+
+			// the pixels whose centers can be inside
+			vec2 lo = glm::min(out.p0, glm::min(out.p1, out.p2));
+			vec2 hi = glm::max(out.p0, glm::max(out.p1, out.p2));
+			out.min_x = glm::max(int(ceilf(lo.x - 0.5f)), 0);
+			out.min_y = glm::max(int(ceilf(lo.y - 0.5f)), 0);
+			out.max_x = glm::min(int(floorf(hi.x - 0.5f)), OCCLUSION_WIDTH - 1);
+			out.max_y = glm::min(int(floorf(hi.y - 0.5f)), OCCLUSION_HEIGHT - 1);
+		}
+
+		void rasterize_tile(Occlusion_Culling& occ, int tile)
+		{
+			int x0 = (tile % TILES_X) * OCCLUSION_TILE_WIDTH;
+			int y0 = (tile / TILES_X) * OCCLUSION_TILE_HEIGHT;
+			int x1 = x0 + OCCLUSION_TILE_WIDTH - 1;
+			int y1 = y0 + OCCLUSION_TILE_HEIGHT - 1;
+			float* depth = occ.depth.data;
+
+			for (int y = y0; y <= y1; y++)
+				for (int x = x0; x <= x1; x += 8)
+					store8(&depth[y * OCCLUSION_WIDTH + x], splat(1.0f));
+
+			for (Occlusion_Culling::Triangle& t : occ.triangles) {
+				if (t.min_x > x1 || t.max_x < x0 || t.min_y > y1 || t.max_y < y0 || t.min_x > t.max_x || t.min_y > t.max_y)
+					continue;
+
+				// counter clockwise is front facing like in gl, the g-buffer pass culls the back faces so they can't occlude
+				float area = (t.p1.x - t.p0.x) * (t.p2.y - t.p0.y) - (t.p2.x - t.p0.x) * (t.p1.y - t.p0.y);
+				if (area < 1e-8f)
+					continue;
+
+				// edge functions a * x + b * y + c, >= 0 inside. an edge is always set up from the same end and negated
+				// for the other direction, so the two triangles sharing it get exactly opposite values and the pixels on
+				// it aren't rounded out of both
+				vec2 p[3] = { t.p0, t.p1, t.p2 };
+				float a[3], b[3], c[3];
+				for (int i = 0; i < 3; i++) {
+					vec2 from = p[i], to = p[(i + 1) % 3];
+					bool is_flipped = to.y < from.y || (to.y == from.y && to.x < from.x);
+					if (is_flipped)
+						std::swap(from, to);
+					a[i] = -(to.y - from.y);
+					b[i] = to.x - from.x;
+					c[i] = -(a[i] * from.x + b[i] * from.y);
+					if (is_flipped) {
+						a[i] = -a[i];
+						b[i] = -b[i];
+						c[i] = -c[i];
+					}
+				}
+
+				// depth is linear in screen space
+				float dzdx = ((t.depth.y - t.depth.x) * (t.p2.y - t.p0.y) - (t.depth.z - t.depth.x) * (t.p1.y - t.p0.y)) / area;
+				float dzdy = ((t.depth.z - t.depth.x) * (t.p1.x - t.p0.x) - (t.depth.y - t.depth.x) * (t.p2.x - t.p0.x)) / area;
+				float z0 = t.depth.x - dzdx * t.p0.x - dzdy * t.p0.y;
+
+				int row_x0 = glm::max(t.min_x, x0) & ~7;
+				int row_x1 = glm::min(t.max_x, x1);
+				for (int y = glm::max(t.min_y, y0); y <= glm::min(t.max_y, y1); y++) {
+					float py = float(y) + 0.5f;
+					float e0_row = b[0] * py + c[0], e1_row = b[1] * py + c[1], e2_row = b[2] * py + c[2];
+					float z_row = dzdy * py + z0;
+
+					for (int x = row_x0; x <= row_x1; x += 8) {
+						f32x8 px = splat(float(x)) + LANE_OFFSETS;
+						s32x8 inside = (px * a[0] + e0_row >= 0.0f) & (px * a[1] + e1_row >= 0.0f) & (px * a[2] + e2_row >= 0.0f);
+						f32x8 z = px * dzdx + z_row;
+
+						float* row = &depth[y * OCCLUSION_WIDTH + x];
+						f32x8 d = load8(row);
+						store8(row, select(inside & (z < d), z, d));
+					}
+				}
+			}
+
+			// the farthest occluder of each block, an object behind it is behind everything in the block
+			for (int by = y0 / OCCLUSION_BLOCK_SIZE; by <= y1 / OCCLUSION_BLOCK_SIZE; by++) {
+				for (int bx = x0 / OCCLUSION_BLOCK_SIZE; bx <= x1 / OCCLUSION_BLOCK_SIZE; bx++) {
+					float block_max = 0.0f;
+					for (int y = by * OCCLUSION_BLOCK_SIZE; y < (by + 1) * OCCLUSION_BLOCK_SIZE; y++)
+						for (int x = bx * OCCLUSION_BLOCK_SIZE; x < (bx + 1) * OCCLUSION_BLOCK_SIZE; x++)
+							block_max = glm::max(block_max, depth[y * OCCLUSION_WIDTH + x]);
+					occ.max_depth[by * BLOCKS_X + bx] = block_max;
+				}
+			}
+		}
+	}
+
+	namespace occlusionculling
+	{
+		void uninit(Occlusion_Culling& occ)
+		{
+			array::uninit(occ.occluder_vertices);
+			array::uninit(occ.sub_mesh_bounds);
+			array::uninit(occ.triangles);
+			array::uninit(occ.depth);
+			array::uninit(occ.max_depth);
+			occ.is_built = false;
+		}
+
+		void build(Occlusion_Culling& occ, Scene& scene)
+		{
+			occ.is_built = true;
+			array::set_length(occ.sub_mesh_bounds, 0);
+
+			Array<Occluder_Candidate> candidates;
+			Array<Vertex> vertices;
+			Array<vec3> occluder_vertices;
+			defer {
+				array::uninit(candidates);
+				array::uninit(vertices);
+				array::uninit(occluder_vertices);
+			};
+
+			for (Model* model : scene.models) {
+				for (Mesh* mesh : model->meshes) {
+					for (Sub_Mesh& sub_mesh : mesh->sub_meshes) {
+						Bounding_Box bounds = boundingbox::transformed(sub_mesh.bounding_box, model->transform.mtx);
+						array::add(occ.sub_mesh_bounds, bounds);
+
+						bool is_opaque = assets::get_material(sub_mesh.material_index).d >= 1.0f;
+						if (is_opaque && sub_mesh.length > 0)
+							array::add(candidates, Occluder_Candidate { model, mesh, &sub_mesh, surface_area(bounds) / float(sub_mesh.length / 3) });
+					}
+				}
+			}
+
+			std::sort(candidates.data, candidates.data + array::size(candidates), [](const Occluder_Candidate& a, const Occluder_Candidate& b) { return a.score > b.score; });
+
+			// the vertices are only on the gpu, the occluders' are read back once
+			occ.total_occluders = 0;
+			for (Occluder_Candidate& candidate : candidates) {
+				Sub_Mesh& sub_mesh = *candidate.sub_mesh;
+				if (int(array::size(occluder_vertices)) / 3 + sub_mesh.length / 3 > MAX_OCCLUDER_TRIANGLES)
+					continue;
+
+				array::set_length(vertices, sub_mesh.length);
+				glGetNamedBufferSubData(candidate.mesh->vbo, sub_mesh.index * sizeof(Vertex), sub_mesh.length * sizeof(Vertex), vertices.data);
+				for (Vertex& v : vertices)
+					array::add(occluder_vertices, vec3(candidate.model->transform.mtx * vec4(v.position, 1.0f)));
+				occ.total_occluders++;
+			}
+			check_gl_error();
+
+			set_occluders(occ, occluder_vertices.data, array::size(occluder_vertices) / 3);
+			LOG("occlusion", "%d occluders (%d triangles) of %d sub meshes", occ.total_occluders, occ.total_occluder_triangles, int(array::size(occ.sub_mesh_bounds)));
+		}
+
+		void set_occluders(Occlusion_Culling& occ, const vec3* world_vertices, int total_triangles)
+		{
+			array::set_length(occ.occluder_vertices, total_triangles * 3);
+			if (total_triangles > 0)
+				memcpy(occ.occluder_vertices.data, world_vertices, sizeof(vec3) * total_triangles * 3);
+			array::set_length(occ.triangles, total_triangles);
+			array::set_length(occ.depth, OCCLUSION_WIDTH * OCCLUSION_HEIGHT);
+			array::set_length(occ.max_depth, BLOCKS_X * BLOCKS_Y);
+			occ.total_occluder_triangles = total_triangles;
+		}
+
+		void rasterize_occluders(Occlusion_Culling& occ, const mat4& VP)
+		{
+			int total_triangles = occ.total_occluder_triangles;
+			int total_jobs = (total_triangles + TRIANGLES_PER_JOB - 1) / TRIANGLES_PER_JOB;
+			jobs::parallel_for(total_jobs, [&](int job) {
+				int end = glm::min((job + 1) * TRIANGLES_PER_JOB, total_triangles);
+				for (int i = job * TRIANGLES_PER_JOB; i < end; i++)
+					transform_triangle(occ.triangles[i], &occ.occluder_vertices[i * 3], VP);
+			});
+
+			occ.rasterized_triangles = 0;
+			for (Occlusion_Culling::Triangle& t : occ.triangles)
+				occ.rasterized_triangles += (t.min_x <= t.max_x && t.min_y <= t.max_y) ? 1 : 0;
+
+			// the tiles don't share pixels or blocks
+			jobs::parallel_for(TILES_X * TILES_Y, [&](int tile) {
+				rasterize_tile(occ, tile);
+			});
+		}
+
+		bool is_occluded(Occlusion_Culling& occ, const Bounding_Box& b, const mat4& VP)
+		{
+			vec2 lo = vec2(MAX_FLOAT_VALUE), hi = vec2(MIN_FLOAT_VALUE);
+			float nearest = MAX_FLOAT_VALUE;
+			for (int i = 0; i < 8; i++) {
+				vec3 corner = vec3((i & 1) ? b.max_point.x : b.min_point.x, (i & 2) ? b.max_point.y : b.min_point.y, (i & 4) ? b.max_point.z : b.min_point.z);
+				vec4 clip = VP * vec4(corner, 1.0f);
+				if (clip.w < MIN_W)
+					return false; // crosses the camera plane
+				vec3 ndc = vec3(clip) / clip.w;
+				lo = glm::min(lo, vec2(ndc));
+				hi = glm::max(hi, vec2(ndc));
+				nearest = glm::min(nearest, ndc.z * 0.5f + 0.5f); // the nearest point of a box is one of its corners
+			}
+
+			int bx0 = glm::max(int(floorf((lo.x * 0.5f + 0.5f) * OCCLUSION_WIDTH)) / OCCLUSION_BLOCK_SIZE, 0);
+			int by0 = glm::max(int(floorf((lo.y * 0.5f + 0.5f) * OCCLUSION_HEIGHT)) / OCCLUSION_BLOCK_SIZE, 0);
+			int bx1 = glm::min(int(floorf((hi.x * 0.5f + 0.5f) * OCCLUSION_WIDTH)) / OCCLUSION_BLOCK_SIZE, BLOCKS_X - 1);
+			int by1 = glm::min(int(floorf((hi.y * 0.5f + 0.5f) * OCCLUSION_HEIGHT)) / OCCLUSION_BLOCK_SIZE, BLOCKS_Y - 1);
+			if (bx0 > bx1 || by0 > by1)
+				return false; // off screen, that's for the frustum culling
+
+			for (int by = by0; by <= by1; by++)
+				for (int bx = bx0; bx <= bx1; bx++)
+					if (occ.max_depth[by * BLOCKS_X + bx] + DEPTH_EPSILON >= nearest)
+						return false;
+			return true;
+		}
+
+		int cull(Occlusion_Culling& occ, const mat4& VP, Array<u8>& visible)
+		{
+			CPU_ZONE("occlusion culling");
+			int total = array::size(occ.sub_mesh_bounds);
+			ASSERT(int(array::size(visible)) == total, "occlusion", "%d visibility flags for %d sub meshes", int(array::size(visible)), total);
+
+			occ.tested = 0;
+			occ.occluded = 0;
+			for (int i = 0; i < total; i++)
+				occ.tested += visible[i];
+			if (!occ.is_enabled || occ.total_occluder_triangles == 0)
+				return occ.tested;
+
+			double start_time = glfwGetTime();
+			rasterize_occluders(occ, VP);
+			double raster_end_time = glfwGetTime();
+
+			int total_jobs = (total + SUB_MESHES_PER_JOB - 1) / SUB_MESHES_PER_JOB;
+			jobs::parallel_for(total_jobs, [&](int job) {
+				int end = glm::min((job + 1) * SUB_MESHES_PER_JOB, total);
+				for (int i = job * SUB_MESHES_PER_JOB; i < end; i++)
+					if (visible[i] && is_occluded(occ, occ.sub_mesh_bounds[i], VP))
+						visible[i] = 0;
+			});
+
+			for (int i = 0; i < total; i++)
+				occ.occluded += visible[i] ? 0 : 1;
+			occ.occluded -= total - occ.tested; // the ones frustum culling already took out
+
+			occ.raster_ms = 1000.0 * (raster_end_time - start_time);
+			occ.test_ms = 1000.0 * (glfwGetTime() - raster_end_time);
+			return occ.tested - occ.occluded;
+		}
+
+		void render_ui(Occlusion_Culling& occ)
+		{
+			using namespace ImGui;
+
+			Checkbox("occlusion culling", &occ.is_enabled);
+			Text("%d occluders, %d / %d triangles rasterized at %dx%d", occ.total_occluders, occ.rasterized_triangles, occ.total_occluder_triangles, OCCLUSION_WIDTH, OCCLUSION_HEIGHT);
+			Text("%d / %d sub meshes occluded", occ.occluded, occ.tested);
+			Text("rasterized in %.3f ms, tested in %.3f ms", occ.raster_ms, occ.test_ms);
+		}
+	}
+}
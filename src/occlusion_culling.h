@@ -0,0 +1,62 @@
+#pragma once
+
+#include "scene.h"
+
+// Software occlusion culling for the g-buffer pass: a few large, simple sub meshes (the occluders) are rasterized on the
+// cpu into a small depth buffer, 8 pixels per instruction (see the packets in cpu_cone_tracing.cpp), one screen tile
+// per job. Its max depth per 8x8 block is then the hierarchical buffer the sub meshes that passed frustum culling are
+// tested against, by the nearest depth of their world aabb. Only the occluder selection touches gl.
+
+namespace vxgi
+{
+	const int OCCLUSION_WIDTH = 256; // depth buffer, the camera's view squeezed in
+	const int OCCLUSION_HEIGHT = 128;
+	const int OCCLUSION_TILE_WIDTH = 64; // rasterized by one job each
+	const int OCCLUSION_TILE_HEIGHT = 32;
+	const int OCCLUSION_BLOCK_SIZE = 8; // pixels per side of a hierarchical depth texel
+	const int MAX_OCCLUDER_TRIANGLES = 8192;
+
+	struct Occlusion_Culling
+	{
+		struct Triangle // an occluder triangle after the vertex transform, in pixels and depth 0...1
+		{
+			vec2 p0, p1, p2;
+			vec3 depth;
+			int min_x, min_y, max_x, max_y; // inclusive pixel bounds, clamped to the screen. min > max = not drawn
+		};
+
+		Array<vec3> occluder_vertices; // world space, 3 per triangle
+		Array<Bounding_Box> sub_mesh_bounds; // world space, in scene order
+
+		Array<Triangle> triangles; // per occluder triangle, of the current frame
+		Array<float> depth; // OCCLUSION_WIDTH x OCCLUSION_HEIGHT, 1 = far
+		Array<float> max_depth; // per block
+
+		bool is_built = false;
+		bool is_enabled = true;
+
+		// stats
+		int total_occluders = 0; // sub meshes
+		int total_occluder_triangles = 0;
+		int rasterized_triangles = 0;
+		int tested = 0;
+		int occluded = 0;
+		double raster_ms = 0.0;
+		double test_ms = 0.0;
+	};
+
+	namespace occlusionculling
+	{
+		void uninit(Occlusion_Culling&);
+
+		void build(Occlusion_Culling&, Scene&); // picks the occluders and reads their vertices back, once the scene is loaded
+
+		// the rest doesn't call gl
+		void set_occluders(Occlusion_Culling&, const vec3* world_vertices, int total_triangles);
+		void rasterize_occluders(Occlusion_Culling&, const mat4& VP);
+		bool is_occluded(Occlusion_Culling&, const Bounding_Box& world_bounds, const mat4& VP);
+		int  cull(Occlusion_Culling&, const mat4& VP, Array<u8>& visible); // rasterizes, then clears the occluded sub meshes' flags. returns the ones left
+
+		void render_ui(Occlusion_Culling&);
+	}
+}
@@ -1,13 +1,204 @@
 #include "opengl.h"
 
+#include <cfloat>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+
 #include "app.h"
+#include "camera.h"
+#include "cpu_profiler.h"
 
 namespace vxgi
 {
+	namespace
+	{
+		const char* SHADER_UNIFORM_NAMES[] = // see SHADER_UNIFORM
+		{
+			"M",
+			"N",
+			"VP_shadow",
+			"u_material.Ka",
+			"u_material.Kd",
+			"u_material.Ks",
+			"u_material.Ns",
+			"u_material.Ke",
+			"u_material.d",
+			"u_material.Ni",
+			"u_material.Tf",
+			"u_tex_ambient",
+			"u_tex_diffuse",
+			"u_tex_specular",
+			"u_tex_emission",
+			"u_tex_bumpmap",
+			"u_tex_shadowmap",
+			"u_shadowmap_mvp",
+			"u_scene_voxel_scale",
+			"u_tex_voxelgrid",
+			"u_tex_cube_back",
+			"u_tex_cube_front",
+			"g_normal",
+			"g_albedo",
+			"g_specular",
+			"g_depth",
+			"u_tex_history_indirect_diffuse",
+			"u_tex_history_geometry",
+			"u_temporal_has_history",
+			"u_temporal_frame_index",
+			"u_previous_VP",
+			"u_previous_camera_world_position",
+			"u_is_tiled",
+			"u_tile_class",
+			"u_max_tiles",
+			"u_tile_scale",
+			"u_tex_empty_space",
+			"u_empty_space_pass",
+			"u_far_field_footprint",
+			"u_far_field_normal_tolerance",
+			"u_total_shadowmap_layers",
+			"u_shadowmap_layer_light",
+			"u_shadowmap_light_layers",
+			"u_shadowmap_atlas_scale",
+			"u_gbuffer_view",
+		};
+		static_assert(SIZE_OF_STATIC_ARRAY(SHADER_UNIFORM_NAMES) == TOTAL_SHADER_UNIFORMS, "SHADER_UNIFORM_NAMES is out of sync with SHADER_UNIFORM");
+
+		Shader_Program* active_program = NULL;
+
+		//
+		// PROGRAM BINARY CACHE
+		// linked programs are stored per driver, keyed by a hash of the final sources (defines included)
+		// and the GL_VENDOR/GL_RENDERER/GL_VERSION strings. files the driver rejects are recompiled and overwritten.
+		//
+		const char* PROGRAM_BINARY_CACHE_DIRECTORY = "shader_cache"; // relative to the working directory
+		const u32 PROGRAM_BINARY_MAGIC = 0x42505856; // "VXPB"
+
+		Program_Binary_Cache_Stats binary_cache_stats;
+		bool is_parallel_compile_enabled = false; // GL_KHR_parallel_shader_compile or the ARB version
+
+		u64 hash_bytes(u64 hash, const void* data, umm size) // FNV-1a
+		{
+			const u8* bytes = (const u8*) data;
+			for (umm i = 0; i < size; i++) {
+				hash ^= bytes[i];
+				hash *= 1099511628211ull;
+			}
+			return hash;
+		}
+
+		u64 hash_program_sources(const std::string* sources[], int count)
+		{
+			u64 hash = 14695981039346656037ull;
+
+			const GLenum driver_strings[] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+			for (GLenum name : driver_strings) {
+				const char* str = (const char*) glGetString(name);
+				if (str)
+					hash = hash_bytes(hash, str, strlen(str) + 1);
+			}
+
+			for (int i = 0; i < count; i++) {
+				umm size = sources[i]->size();
+				hash = hash_bytes(hash, &size, sizeof(size)); // keeps stage boundaries apart
+				hash = hash_bytes(hash, sources[i]->data(), size);
+			}
+
+			return hash;
+		}
+
+		bool is_program_binary_cache_supported()
+		{
+			GLint total_formats = 0;
+			glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &total_formats);
+			return total_formats > 0;
+		}
+
+		std::string get_program_binary_path(const char* name, u64 hash)
+		{
+			char file_name[256];
+			snprintf(file_name, sizeof(file_name), "%s/%s_%016llx.bin", PROGRAM_BINARY_CACHE_DIRECTORY, name, (unsigned long long) hash);
+			return file_name;
+		}
+
+		bool load_program_binary(Shader_Program& prog, u64 hash)
+		{
+			if (!is_program_binary_cache_supported())
+				return false;
+
+			std::string path = get_program_binary_path(prog.name, hash);
+			FILE* file = fopen(path.c_str(), "rb");
+			if (!file)
+				return false;
+
+			u32 header[3] = {}; // magic, binary format, length
+			bool ok = fread(header, sizeof(header), 1, file) == 1 && header[0] == PROGRAM_BINARY_MAGIC && header[2] > 0;
+
+			std::string binary;
+			if (ok) {
+				binary.resize(header[2]);
+				ok = fread(&binary[0], header[2], 1, file) == 1;
+			}
+			fclose(file);
+
+			if (ok) {
+				prog.id = glCreateProgram();
+				glProgramBinary(prog.id, GLenum(header[1]), binary.data(), GLsizei(header[2]));
+
+				GLint is_linked = 0;
+				glGetProgramiv(prog.id, GL_LINK_STATUS, &is_linked);
+				ok = (is_linked == GL_TRUE);
+
+				if (!ok) {
+					glDeleteProgram(prog.id);
+					prog.id = 0;
+				}
+			}
+
+			if (!ok) {
+				binary_cache_stats.rejected++;
+				LOG("shader", "program binary (%s) was rejected, recompiling", path.c_str());
+			}
+
+			return ok;
+		}
+
+		void save_program_binary(Shader_Program& prog, u64 hash)
+		{
+			if (!is_program_binary_cache_supported())
+				return;
+
+			GLint length = 0;
+			glGetProgramiv(prog.id, GL_PROGRAM_BINARY_LENGTH, &length);
+			if (length <= 0)
+				return;
+
+			std::string binary;
+			binary.resize(length);
+			GLenum format = 0;
+			glGetProgramBinary(prog.id, length, NULL, &format, &binary[0]);
+
+			std::error_code error;
+			std::filesystem::create_directories(PROGRAM_BINARY_CACHE_DIRECTORY, error);
+
+			std::string path = get_program_binary_path(prog.name, hash);
+			FILE* file = fopen(path.c_str(), "wb");
+			if (!file) {
+				LOG("shader", "couldn't write program binary (%s)", path.c_str());
+				return;
+			}
+
+			u32 header[3] = { PROGRAM_BINARY_MAGIC, u32(format), u32(length) };
+			fwrite(header, sizeof(header), 1, file);
+			fwrite(binary.data(), length, 1, file);
+			fclose(file);
+		}
+	}
+
 	namespace texture
 	{
 		void init(Texture2D& t, const void* data, int w, int h, GLint internalFormat, GLenum format, GLenum type, GLenum minFilter, GLenum magFilter, GLenum wrapS, GLenum wrapT, bool generateMipmaps, bool attachToFrameBuffer, GLenum fboAttachment, GLuint fboAttachmentLevel)
 		{
+			CPU_ZONE("texture2d init");
 			t.width = w;
 			t.height = h;
 
@@ -35,9 +226,9 @@ namespace vxgi
 			if (t.is_loaded) 
 				glDeleteTextures(1, &t.id);
 		}
-		void activate(Texture2D& t, GLuint shader_id, const char* sampler_name, GLuint offset)
+		void activate(Texture2D& t, GLuint shader_id, SHADER_UNIFORM sampler, GLuint offset)
 		{
-			glUniform1i(glGetUniformLocation(shader_id, sampler_name), offset);
+			glUniform1i(shader::uniform_location(shader_id, sampler), offset);
 			glActiveTexture(GL_TEXTURE0 + offset);
 			glBindTexture(GL_TEXTURE_2D, t.id);
 		}
@@ -47,6 +238,7 @@ namespace vxgi
 	{
 		void init(Texture3D& t, GLfloat* data, int dimensions)
 		{
+			CPU_ZONE("texture3d init");
 			t.dimensions = dimensions;
 
 			glGenTextures(1, &t.id);
@@ -73,9 +265,9 @@ namespace vxgi
 				glDeleteTextures(1, &t.id);
 			t.is_loaded = false;
 		}
-		void activate(Texture3D& t, GLuint shader_id, const char* samplerName, int textureLocation)
+		void activate(Texture3D& t, GLuint shader_id, SHADER_UNIFORM sampler, int textureLocation)
 		{
-			glUniform1i(glGetUniformLocation(shader_id, samplerName), textureLocation);
+			glUniform1i(shader::uniform_location(shader_id, sampler), textureLocation);
 			glActiveTexture(GL_TEXTURE0 + textureLocation);
 			glBindTexture(GL_TEXTURE_3D, t.id);
 		}
@@ -139,7 +331,7 @@ namespace vxgi
 
 			GLenum magFilter = GL_NEAREST;
 			GLenum minFilter = GL_NEAREST;
-			GLint internalFormat = GL_RGB16F;
+			GLint internalFormat = GL_RGBA16F; // not RGB16F, compute cone tracing writes the color with imageStore
 			GLint format = GL_FLOAT;
 			GLint wrap = GL_REPEAT;
 
@@ -190,9 +382,9 @@ namespace vxgi
 			glBindFramebuffer(GL_FRAMEBUFFER, 0);
 		}
 
-		void activate_color_as_texture(Frame_Buffer& fbo, const int shaderProgram, const char* glSamplerName, const int textureLocation)
+		void activate_color_as_texture(Frame_Buffer& fbo, const int shaderProgram, SHADER_UNIFORM sampler, const int textureLocation)
 		{
-			glUniform1i(glGetUniformLocation(shaderProgram, glSamplerName), textureLocation);
+			glUniform1i(shader::uniform_location(shaderProgram, sampler), textureLocation);
 			glActiveTexture(GL_TEXTURE0 + textureLocation);
 			glBindTexture(GL_TEXTURE_2D, fbo.color_texture_id);
 		}
@@ -200,55 +392,318 @@ namespace vxgi
 
 	namespace shader
 	{
-		bool init(Shader_Program& prog, const char* name, const char* path_to_vert, const char* path_to_frag, const char* path_to_geom)
+		bool init(Shader_Program& prog, const char* name, const char* path_to_vert, const char* path_to_frag, const char* path_to_geom, const char* defines)
 		{
+			return submit(prog, name, path_to_vert, path_to_frag, path_to_geom, defines) && resolve(prog);
+		}
+		bool init_compute(Shader_Program& prog, const char* name, const char* path_to_comp, const char* defines)
+		{
+			return submit_compute(prog, name, path_to_comp, defines) && resolve(prog);
+		}
+
+		bool submit(Shader_Program& prog, const char* name, const char* path_to_vert, const char* path_to_frag, const char* path_to_geom, const char* defines)
+		{
+			CPU_ZONE("shader submit");
 			prog.name = name;
 
 			bool hasGeom = (strlen(path_to_geom) > 0); // @TODO @Cleanup lol
 
-			std::string vert_src = application::read_file(path_to_vert);
-			std::string frag_src = application::read_file(path_to_frag);
+			std::string vert_src = read_source(path_to_vert);
+			std::string frag_src = read_source(path_to_frag);
 			std::string geom_src;
-			if (hasGeom) geom_src = application::read_file(path_to_geom);
+			if (hasGeom) geom_src = read_source(path_to_geom);
 
-			Shader_Source vert, frag, geom;
+			if (strlen(defines) > 0) {
+				insert_defines(vert_src, defines);
+				insert_defines(frag_src, defines);
+				if (hasGeom) insert_defines(geom_src, defines);
+			}
+
+			const std::string* sources[] = { &vert_src, &frag_src, &geom_src };
+			u64 hash = hash_program_sources(sources, SIZE_OF_STATIC_ARRAY(sources));
+			if (load_program_binary(prog, hash)) {
+				binary_cache_stats.loaded++;
+				reflect(prog);
+				LOG("shader", "loaded shader program (%s) (%u) from the binary cache", prog.name, prog.id);
+				return true;
+			}
+
+			prog.binary_hash = hash;
+			prog.total_pending_sources = 0;
+			Shader_Source& vert = prog.pending_sources[prog.total_pending_sources++];
+			Shader_Source& frag = prog.pending_sources[prog.total_pending_sources++];
 			source_init(vert, name, SHADER_TYPE_VERTEX, vert_src.c_str());
 			source_init(frag, name, SHADER_TYPE_FRAGMENT, frag_src.c_str());
-			if (hasGeom) source_init(geom, name, SHADER_TYPE_GEOMETRY, geom_src.c_str());
-
-			if (!source_compile(vert)) return false;
-			if (!source_compile(frag)) return false;
-			if (hasGeom) if (!source_compile(geom)) return false;
+			source_submit(vert);
+			source_submit(frag);
 
 			prog.id = glCreateProgram();
 			glAttachShader(prog.id, vert.id);
 			glAttachShader(prog.id, frag.id);
-			if (hasGeom) glAttachShader(prog.id, geom.id);
+			if (hasGeom) {
+				Shader_Source& geom = prog.pending_sources[prog.total_pending_sources++];
+				source_init(geom, name, SHADER_TYPE_GEOMETRY, geom_src.c_str());
+				source_submit(geom);
+				glAttachShader(prog.id, geom.id);
+			}
+			glProgramParameteri(prog.id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+			glLinkProgram(prog.id);
+
+			prog.is_pending = true;
+			return true;
+		}
+		bool submit_compute(Shader_Program& prog, const char* name, const char* path_to_comp, const char* defines)
+		{
+			CPU_ZONE("shader submit");
+			prog.name = name;
+
+			std::string comp_src = read_source(path_to_comp);
+			if (strlen(defines) > 0)
+				insert_defines(comp_src, defines);
+
+			const std::string* sources[] = { &comp_src };
+			u64 hash = hash_program_sources(sources, SIZE_OF_STATIC_ARRAY(sources));
+			if (load_program_binary(prog, hash)) {
+				binary_cache_stats.loaded++;
+				reflect(prog);
+				LOG("shader", "loaded compute shader program (%s) (%u) from the binary cache", prog.name, prog.id);
+				return true;
+			}
+
+			prog.binary_hash = hash;
+			prog.total_pending_sources = 1;
+			Shader_Source& comp = prog.pending_sources[0];
+			source_init(comp, name, SHADER_TYPE_COMPUTE, comp_src.c_str());
+			source_submit(comp);
+
+			prog.id = glCreateProgram();
+			glAttachShader(prog.id, comp.id);
+			glProgramParameteri(prog.id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
 			glLinkProgram(prog.id);
 
+			prog.is_pending = true;
+			return true;
+		}
+		bool resolve(Shader_Program& prog)
+		{
+			if (!prog.is_pending)
+				return true;
+			CPU_ZONE("shader resolve");
+			prog.is_pending = false;
+
+			bool is_compiled = true;
+			for (int i = 0; i < prog.total_pending_sources; i++) {
+				Shader_Source& source = prog.pending_sources[i];
+				source.isCompiled = was_compilation_successful(source);
+				if (source.isCompiled)
+					LOG("shader", "compiled shader (%s)", source.name);
+				else
+					LOG("shader", "couldn't compile shader (%s)", source.name);
+				is_compiled = is_compiled && source.isCompiled;
+			}
+
 			GLint is_linked = 0;
-			glGetProgramiv(prog.id, GL_LINK_STATUS, &is_linked);
+			if (is_compiled)
+				glGetProgramiv(prog.id, GL_LINK_STATUS, &is_linked);
+
+			for (int i = 0; i < prog.total_pending_sources; i++)
+				source_uninit(prog.pending_sources[i]);
+			prog.total_pending_sources = 0;
+
+			if (!is_compiled)
+				return false;
+
 			assert(is_linked == GL_TRUE);
+			reflect(prog);
 
-			source_uninit(vert);
-			source_uninit(frag);
-			if (hasGeom) source_uninit(geom);
+			binary_cache_stats.compiled++;
+			save_program_binary(prog, prog.binary_hash);
 
 			LOG("shader", "created shader program (%s) (%u)", prog.name, prog.id);
 			return true;
 		}
+		bool is_ready(Shader_Program& prog)
+		{
+			if (!prog.is_pending || !is_parallel_compile_enabled)
+				return true;
+
+			GLint is_completed = GL_FALSE;
+			glGetProgramiv(prog.id, GL_COMPLETION_STATUS_KHR, &is_completed);
+			return is_completed == GL_TRUE;
+		}
+		void enable_parallel_compile()
+		{
+			if (GLEW_KHR_parallel_shader_compile) {
+				glMaxShaderCompilerThreadsKHR(0xFFFFFFFF); // as many as the driver wants
+				is_parallel_compile_enabled = true;
+			} else if (GLEW_ARB_parallel_shader_compile) {
+				glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+				is_parallel_compile_enabled = true;
+			}
+
+			LOG("shader", "parallel shader compile %s", is_parallel_compile_enabled ? "enabled" : "not supported, compiling on submit");
+		}
 		void uninit(Shader_Program& prog) {
 			glDeleteProgram(prog.id);
 			prog.id = 0;
 		}
+
+		void init_permutations(Shader_Permutations& permutations, const char* name, const char* path_to_vert, const char* path_to_frag, const char* const* feature_defines, int total_features)
+		{
+			ASSERT(total_features <= 32, "shader", "too many features (%d) for a u32 mask in (%s)", total_features, name);
+
+			permutations.name = name;
+			permutations.path_to_vert = path_to_vert;
+			permutations.path_to_frag = path_to_frag;
+			permutations.feature_defines = feature_defines;
+			permutations.total_features = total_features;
+		}
+		void init_compute_permutations(Shader_Permutations& permutations, const char* name, const char* path_to_comp, const char* const* feature_defines, int total_features)
+		{
+			init_permutations(permutations, name, "", "", feature_defines, total_features);
+			permutations.path_to_comp = path_to_comp;
+		}
+		void uninit_permutations(Shader_Permutations& permutations)
+		{
+			for (int i = 0; i < int(hashmap::size(permutations.variants)); i++) {
+				Shader_Program* prog = permutations.variants.data[i].value;
+				uninit(*prog);
+				delete prog;
+			}
+			hashmap::uninit(permutations.variants);
+		}
+		Shader_Program& get_permutation(Shader_Permutations& permutations, u32 feature_mask)
+		{
+			auto* entry = hashmap::get_entry(permutations.variants, feature_mask);
+			if (entry)
+				return *entry->value;
+
+			std::string defines;
+			for (int i = 0; i < permutations.total_features; i++)
+				if (feature_mask & (1u << i))
+					defines += std::string("#define ") + permutations.feature_defines[i] + "\n";
+			if (permutations.append_defines)
+				permutations.append_defines(feature_mask, defines);
+
+			auto start = std::chrono::steady_clock::now();
+
+			Shader_Program* prog = new Shader_Program;
+			bool is_compiled = (strlen(permutations.path_to_comp) > 0)
+				? init_compute(*prog, permutations.name, permutations.path_to_comp, defines.c_str())
+				: init(*prog, permutations.name, permutations.path_to_vert, permutations.path_to_frag, "", defines.c_str());
+			ASSERT(is_compiled, "shader", "couldn't compile permutation (0x%x) of (%s)", feature_mask, permutations.name);
+
+			std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+			LOG("shader", "created permutation (0x%x) of (%s) in %.1f ms, %d variants", feature_mask, permutations.name, elapsed.count(), int(hashmap::size(permutations.variants)) + 1);
+			hashmap::insert(permutations.variants, feature_mask, prog);
+			return *prog;
+		}
 		GLuint activate(Shader_Program& prog) {
 			assert(prog.id != u32(-1));
 			glUseProgram(prog.id);
 			check_gl_error();
+			active_program = &prog;
 			return prog.id;
 		}
 		void deactivate() {
 			glUseProgram(0);
+			active_program = NULL;
+		}
+
+		void reflect(Shader_Program& prog)
+		{
+			for (GLint& location : prog.uniform_locations)
+				location = -1;
+
+			GLint total_uniforms = 0;
+			glGetProgramiv(prog.id, GL_ACTIVE_UNIFORMS, &total_uniforms);
+
+			for (GLint i = 0; i < total_uniforms; i++)
+			{
+				GLchar name[128];
+				GLint size = 0;
+				GLenum type = 0;
+				glGetActiveUniform(prog.id, GLuint(i), sizeof(name), NULL, &size, &type, name);
+
+				GLint location = glGetUniformLocation(prog.id, name);
+				if (location == -1)
+					continue; // uniform block member
+
+				// arrays are reported as "name[0]", the location of the first element is the one uploads start from
+				umm length = strlen(name);
+				if (length > 3 && strcmp(name + length - 3, "[0]") == 0)
+					name[length - 3] = '\0';
+
+				bool is_known = false;
+				for (u32 u = 0; u < TOTAL_SHADER_UNIFORMS; u++) {
+					if (strcmp(name, SHADER_UNIFORM_NAMES[u]) == 0) {
+						prog.uniform_locations[u] = location;
+						is_known = true;
+						break;
+					}
+				}
+
+				if (!is_known)
+					LOG("shader", "program (%s) has an active uniform (%s) without a SHADER_UNIFORM id", prog.name, name);
+			}
+		}
+
+		Program_Binary_Cache_Stats& get_binary_cache_stats()
+		{
+			return binary_cache_stats;
+		}
+
+		std::string read_source(const char* path)
+		{
+			std::string src = application::read_file(path);
+
+			std::string directory = path;
+			umm slash = directory.find_last_of('/');
+			directory = (slash == std::string::npos) ? "" : directory.substr(0, slash + 1);
+
+			// the included text is scanned again, so included files can include too.
+			// every file is pasted once (like #pragma once), later #includes of it are dropped
+			const char* INCLUDE = "#include \"";
+			std::string included_paths;
+			for (umm include = src.find(INCLUDE); include != std::string::npos; include = src.find(INCLUDE, include))
+			{
+				umm name_start = include + strlen(INCLUDE);
+				umm name_end = src.find('"', name_start);
+				umm line_end = src.find('\n', include);
+				ASSERT(name_end != std::string::npos && name_end < line_end, "shader", "malformed #include in (%s)", path);
+
+				std::string included_path = directory + src.substr(name_start, name_end - name_start);
+				if (included_paths.find(included_path + '\n') != std::string::npos) {
+					src.erase(include, line_end - include);
+					continue;
+				}
+				included_paths += included_path + '\n';
+
+				std::string included = application::read_file(included_path.c_str());
+				ASSERT(!included.empty(), "shader", "couldn't read (%s) included from (%s)", included_path.c_str(), path);
+
+				src.replace(include, line_end - include, included);
+			}
+
+			return src;
+		}
+
+		void insert_defines(std::string& src, const char* defines)
+		{
+			// has to come after #version, which has to be the first line
+			umm version = src.find("#version");
+			umm line_end = (version == std::string::npos) ? std::string::npos : src.find('\n', version);
+			if (line_end == std::string::npos) {
+				src.insert(0, defines);
+				return;
+			}
+			src.insert(line_end + 1, defines);
+		}
+
+		GLint uniform_location(GLuint shader_id, SHADER_UNIFORM uniform)
+		{
+			ASSERT(active_program && active_program->id == shader_id, "shader", "program (%u) isn't active", shader_id);
+			return active_program->uniform_locations[uniform];
 		}
 
 		void source_init(Shader_Source& shader, const char* name, SHADER_TYPE type, const char* src) {
@@ -262,7 +717,7 @@ namespace vxgi
 			shader.isCompiled = false;
 		}
 
-		bool source_compile(Shader_Source& shader)
+		void source_submit(Shader_Source& shader)
 		{
 			ASSERT(shader.isCompiled == false, "shader", "shader (%s) already compiled", shader.name);
 			ASSERT(shader.src != 0, "shader", "shader (%s) source is null", shader.name);
@@ -270,6 +725,11 @@ namespace vxgi
 			shader.id = glCreateShader((GLenum) shader.type);
 			glShaderSource(shader.id, 1, &shader.src, NULL);
 			glCompileShader(shader.id);
+			shader.src = 0; // copied by glShaderSource
+		}
+		bool source_compile(Shader_Source& shader)
+		{
+			source_submit(shader);
 
 			shader.isCompiled = was_compilation_successful(shader);
 			if (shader.isCompiled)
@@ -330,21 +790,17 @@ namespace vxgi
 
 			int w = framebufferWidth;
 			int h = framebufferHeight;
-			GLint internalFormat = GL_RGBA16F;
-			GLenum format = GL_RGBA;
-			GLenum type = GL_FLOAT;
 			GLenum minFilter = GL_NEAREST;
 			GLenum magFilter = GL_NEAREST;
 			GLenum wrapS = GL_REPEAT;
 			GLenum wrapT = GL_REPEAT;
 
-			GLenum drawBuffers[G_Buffer::TOTAL_GBUFFER_TEXTURES] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2, GL_COLOR_ATTACHMENT3, GL_COLOR_ATTACHMENT4 };
-			texture::init(g.textures[G_Buffer::POSITION], NULL, w,h, internalFormat,format,type, minFilter,magFilter, wrapS,wrapT, false, true, GL_COLOR_ATTACHMENT0 + G_Buffer::POSITION, 0);
-			texture::init(g.textures[G_Buffer::NORMAL], NULL, w,h, internalFormat,format,type, minFilter,magFilter, wrapS,wrapT, false, true, GL_COLOR_ATTACHMENT0 + G_Buffer::NORMAL, 0);
-			texture::init(g.textures[G_Buffer::BUMP], NULL, w,h, internalFormat,format,type, minFilter,magFilter, wrapS,wrapT, false, true, GL_COLOR_ATTACHMENT0 + G_Buffer::BUMP, 0);
-			texture::init(g.textures[G_Buffer::ALBEDO], NULL, w,h, internalFormat,format,type, minFilter,magFilter, wrapS,wrapT, false, true, GL_COLOR_ATTACHMENT0 + G_Buffer::ALBEDO, 0);
-			texture::init(g.textures[G_Buffer::SPECULAR], NULL, w,h, internalFormat,format,type, minFilter,magFilter, wrapS,wrapT, false, true, GL_COLOR_ATTACHMENT0 + G_Buffer::SPECULAR, 0);
-			//texture::init(g.textures[G_Buffer::EMISSION], NULL, w,h, internalFormat,format,type, minFilter,magFilter, wrapS,wrapT, false, true, GL_COLOR_ATTACHMENT0 + EMISSION, 0);
+			// 20 bytes per pixel, was 44 with five GL_RGBA16F targets (position, normal, bump, albedo, specular) + depth
+			GLenum drawBuffers[G_Buffer::TOTAL_GBUFFER_TEXTURES] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2 };
+			texture::init(g.textures[G_Buffer::NORMAL], NULL, w,h, GL_RGBA16,GL_RGBA,GL_UNSIGNED_SHORT, minFilter,magFilter, wrapS,wrapT, false, true, GL_COLOR_ATTACHMENT0 + G_Buffer::NORMAL, 0);
+			texture::init(g.textures[G_Buffer::ALBEDO], NULL, w,h, GL_SRGB8_ALPHA8,GL_RGBA,GL_UNSIGNED_BYTE, minFilter,magFilter, wrapS,wrapT, false, true, GL_COLOR_ATTACHMENT0 + G_Buffer::ALBEDO, 0);
+			texture::init(g.textures[G_Buffer::SPECULAR], NULL, w,h, GL_RGBA8,GL_RGBA,GL_UNSIGNED_BYTE, minFilter,magFilter, wrapS,wrapT, false, true, GL_COLOR_ATTACHMENT0 + G_Buffer::SPECULAR, 0);
+			g.bytes_per_pixel = 8 + 4 + 4 + 4;
 			texture::init(g.depthTexture, NULL, w,h, GL_DEPTH_COMPONENT32F, GL_DEPTH_COMPONENT, GL_FLOAT, GL_NEAREST, GL_NEAREST, GL_REPEAT, GL_REPEAT, false, true, GL_DEPTH_ATTACHMENT, 0);
 
 			if (createDepthRenderBuffer) {
@@ -376,6 +832,7 @@ namespace vxgi
 
 		void activate(G_Buffer& g) {
 			glBindFramebuffer(GL_DRAW_FRAMEBUFFER, g.fbo);
+			glEnable(GL_FRAMEBUFFER_SRGB); // albedo is encoded on write
 			glViewport(0, 0, g.width, g.height);
 			glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
 			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -390,6 +847,7 @@ namespace vxgi
 
 		void deactivate(G_Buffer& g) {
 			glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+			glDisable(GL_FRAMEBUFFER_SRGB);
 			glDisable(GL_BLEND);
 		}
 
@@ -397,121 +855,227 @@ namespace vxgi
 		{
 			glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo);
 
-			texture::activate(g.textures[G_Buffer::POSITION], shader_id, "g_world_pos", textureLocationOffset + G_Buffer::POSITION);
-			texture::activate(g.textures[G_Buffer::NORMAL], shader_id, "g_normal", textureLocationOffset + G_Buffer::NORMAL);
-			texture::activate(g.textures[G_Buffer::BUMP], shader_id, "g_bump", textureLocationOffset + G_Buffer::BUMP);
-			texture::activate(g.textures[G_Buffer::ALBEDO], shader_id, "g_albedo", textureLocationOffset + G_Buffer::ALBEDO);
-			texture::activate(g.textures[G_Buffer::SPECULAR], shader_id, "g_specular", textureLocationOffset + G_Buffer::SPECULAR);
-			//texture::activate(g.textures[EMISSION], shader_id, "g_emission", textureLocationOffset + EMISSION);
-			texture::activate(g.depthTexture, shader_id, "g_depth", textureLocationOffset + G_Buffer::TOTAL_GBUFFER_TEXTURES);
+			texture::activate(g.textures[G_Buffer::NORMAL], shader_id, SHADER_UNIFORM_G_NORMAL, textureLocationOffset + G_Buffer::NORMAL);
+			texture::activate(g.textures[G_Buffer::ALBEDO], shader_id, SHADER_UNIFORM_G_ALBEDO, textureLocationOffset + G_Buffer::ALBEDO);
+			texture::activate(g.textures[G_Buffer::SPECULAR], shader_id, SHADER_UNIFORM_G_SPECULAR, textureLocationOffset + G_Buffer::SPECULAR);
+			texture::activate(g.depthTexture, shader_id, SHADER_UNIFORM_G_DEPTH, textureLocationOffset + G_Buffer::TOTAL_GBUFFER_TEXTURES);
+		}
+	}
+
+	namespace shadowmap
+	{
+		const mat4 TEXTURE_SPACE_BIAS = mat4({ // clip space -> [0, 1]
+			0.5, 0.0, 0.0, 0.0,
+			0.0, 0.5, 0.0, 0.0,
+			0.0, 0.0, 0.5, 0.0,
+			0.5, 0.5, 0.5, 1.0 });
+
+		void init(Shadow_Map& s, const Shadow_Map::Config& config)
+		{
+			s.config = config;
+			s.config.total_cascades = glm::clamp(config.total_cascades, 0, MAX_SHADOW_CASCADES);
+			s.total_layers = s.config.total_cascades + 1;
+			LOG("shadowmap", "initializing (%d cascades + whole scene, %dx%d each)", s.config.total_cascades, s.config.resolution, s.config.resolution);
 		}
 
-		void blit_to_screen(G_Buffer& g, float viewportWidth, float viewportHeight)
+		void update(Shadow_Map& s, const vec3& light_direction)
 		{
-			GLsizei padding = 2;
+			s.view = glm::lookAt(light_direction, vec3(0.0f,0.0f,0.0f), vec3(0.0f,1.0f,0.0f));
+			s.projection = glm::ortho(-s.config.ortho,s.config.ortho,-s.config.ortho,s.config.ortho, s.config.near_plane,s.config.far_plane);
+			s.VP = s.projection * s.view;
+			s.VP_biased = TEXTURE_SPACE_BIAS * s.VP;
 
-			float aspectRatio = viewportWidth / viewportHeight;
-			GLsizei blitW = (GLsizei) (viewportWidth / float(G_Buffer::TOTAL_GBUFFER_TEXTURES));
-			GLsizei blitH = (GLsizei) (blitW / aspectRatio);
+			// the cascades cover the whole scene too until fit_cascades places them
+			for (int i = 0; i < s.total_layers; i++) {
+				s.layer_VP[i] = s.VP;
+				s.layer_VP_biased[i] = s.VP_biased;
+			}
+		}
 
-			glBindFramebuffer(GL_READ_FRAMEBUFFER, g.fbo); 
-			glDrawBuffer(GL_COLOR_ATTACHMENT0);
+		bool fit_cascades(Shadow_Map& s, const vec3& light_direction, const Camera& camera, const vec3& scene_min, const vec3& scene_max)
+		{
+			int total_cascades = s.config.total_cascades;
+			if (total_cascades == 0)
+				return false;
 
-			for (int i=0; i < G_Buffer::TOTAL_GBUFFER_TEXTURES; i++) {
-				GLint dstX0 = blitW * i + padding * i;
-				GLint dstY0 = 0;
-				GLint dstX1 = dstX0 + blitW;
-				GLint dstY1 = blitH;
+			mat4 previous_VP[MAX_SHADOW_CASCADES];
+			memcpy(previous_VP, s.layer_VP, sizeof(mat4) * total_cascades);
+
+			// fixed orientation, the cascades only slide on its xy plane so they can be snapped to texels
+			vec3 to_light = glm::normalize(light_direction);
+			vec3 light_up = (fabsf(to_light.y) > 0.99f) ? vec3(0.0f, 0.0f, 1.0f) : vec3(0.0f, 1.0f, 0.0f);
+			mat4 light_view = glm::lookAt(vec3(0.0f), -to_light, light_up);
+
+			// depth range covers every caster in the scene, not just the ones inside a slice.
+			// the splits only cover the part of the view the scene is in, from its nearest point to its farthest corner
+			float min_z = FLT_MAX;
+			float max_z = -FLT_MAX;
+			float far_plane = camera.near_plane;
+			for (int i = 0; i < 8; i++) {
+				vec3 corner = vec3((i & 1) ? scene_max.x : scene_min.x, (i & 2) ? scene_max.y : scene_min.y, (i & 4) ? scene_max.z : scene_min.z);
+				float z = (light_view * vec4(corner, 1.0f)).z;
+				min_z = glm::min(min_z, z);
+				max_z = glm::max(max_z, z);
+				far_plane = glm::max(far_plane, glm::distance(camera.position, corner));
+			}
+			far_plane = glm::min(far_plane, camera.far_plane);
+			float z_padding = 0.01f * (max_z - min_z) + 0.01f;
+
+			vec3 forward = glm::normalize(camera.direction);
+			vec3 right = glm::normalize(glm::cross(forward, camera.up));
+			vec3 up = glm::cross(right, forward);
+			float tan_y = tanf(0.5f * DEGREES_TO_RADIANS * camera.fov);
+			float tan_x = tan_y * camera.aspect_ratio;
+
+			// distance -> view depth, a point at the corner of the view is the closest for its distance
+			float nearest_distance = glm::distance(camera.position, glm::clamp(camera.position, scene_min, scene_max));
+			float nearest_depth = nearest_distance / sqrtf(1.0f + tan_x * tan_x + tan_y * tan_y);
+			float near_plane = glm::clamp(nearest_depth, camera.near_plane, far_plane * 0.5f);
+
+			// practical split scheme, a blend of uniform and logarithmic
+			s.cascade_splits[0] = near_plane;
+			for (int i = 1; i <= total_cascades; i++) {
+				float t = float(i) / float(total_cascades);
+				float uniform_split = near_plane + (far_plane - near_plane) * t;
+				float log_split = near_plane * powf(far_plane / near_plane, t);
+				s.cascade_splits[i] = glm::mix(uniform_split, log_split, s.config.split_lambda);
+			}
 
-				glReadBuffer(GL_COLOR_ATTACHMENT0 + i);
-				glBlitFramebuffer(0,0,g.width,g.height, dstX0,dstY0, dstX1,dstY1, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+			for (int i = 0; i < total_cascades; i++)
+			{
+				// bounding sphere of the slice. its size doesn't change when the camera turns, so neither does the texel size
+				vec3 corners[8];
+				vec3 center = vec3(0.0f);
+				for (int j = 0; j < 8; j++) {
+					float d = s.cascade_splits[i + (j >> 2)];
+					float x = ((j & 1) ? 1.0f : -1.0f) * tan_x * d;
+					float y = ((j & 2) ? 1.0f : -1.0f) * tan_y * d;
+					corners[j] = camera.position + forward * d + right * x + up * y;
+					center += corners[j] * (1.0f / 8.0f);
+				}
+
+				float radius = 0.0f;
+				for (int j = 0; j < 8; j++)
+					radius = glm::max(radius, glm::distance(center, corners[j]));
+				radius = ceilf(radius * 16.0f) / 16.0f; // float noise would otherwise change it a little every frame
+
+				// move in whole texels so the shadow edges don't crawl when the camera moves
+				float texel = 2.0f * radius / float(s.config.resolution);
+				vec3 light_center = vec3(light_view * vec4(center, 1.0f));
+				light_center.x = floorf(light_center.x / texel) * texel;
+				light_center.y = floorf(light_center.y / texel) * texel;
+
+				mat4 projection = glm::ortho(light_center.x - radius, light_center.x + radius, light_center.y - radius, light_center.y + radius, -max_z - z_padding, -min_z + z_padding);
+				s.layer_VP[i] = projection * light_view;
+				s.layer_VP_biased[i] = TEXTURE_SPACE_BIAS * s.layer_VP[i];
 			}
 
-			glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
-			glReadBuffer(0);
+			return memcmp(previous_VP, s.layer_VP, sizeof(mat4) * total_cascades) != 0;
 		}
 	}
 
-	namespace shadowmap
+	namespace shadowatlas
 	{
-		void init(Shadow_Map& s, const Shadow_Map::Config& config)
+		void init(Shadow_Atlas& atlas, int resolution, int total_layers)
 		{
-			LOG("shadowmap", "initializing");
-			assert(!s.is_fbo_created);
-			s.config = config;
-
-			glGenFramebuffers(1, &s.depth_fbo_id);
-			glBindFramebuffer(GL_FRAMEBUFFER, s.depth_fbo_id);
-
-			glGenTextures(1, &s.depth_texture_id);
-			glBindTexture(GL_TEXTURE_2D, s.depth_texture_id);
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT16, s.config.resolution, s.config.resolution, 0, GL_DEPTH_COMPONENT, GL_FLOAT, 0);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST); //GL_NEAREST);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST); //GL_NEAREST);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE); //GL_REPEAT);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE); //GL_REPEAT);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_R_TO_TEXTURE);
-
-			glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, s.depth_texture_id, 0);
+			assert(!atlas.is_created);
+			ASSERT(total_layers > 0 && total_layers <= MAX_SHADOW_ATLAS_LAYERS, "shadowatlas", "invalid amount of layers (%d)", total_layers);
+			atlas.resolution = resolution;
+			atlas.total_layers = total_layers;
+			LOG("shadowatlas", "initializing (%d layers, %dx%d each)", total_layers, resolution, resolution);
+
+			glGenFramebuffers(1, &atlas.fbo_id);
+			glBindFramebuffer(GL_FRAMEBUFFER, atlas.fbo_id);
+
+			glGenTextures(1, &atlas.depth_texture_id);
+			glBindTexture(GL_TEXTURE_2D_ARRAY, atlas.depth_texture_id);
+			glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT16, resolution, resolution, total_layers, 0, GL_DEPTH_COMPONENT, GL_FLOAT, 0);
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST); //GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST); //GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE); //GL_REPEAT);
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE); //GL_REPEAT);
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_R_TO_TEXTURE);
+
+			glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, atlas.depth_texture_id, 0); // layered, shadowmap_geom.glsl picks gl_Layer
 			glDrawBuffer(GL_NONE); // dont need color buffer
 
 			if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-				ASSERT(false, "shadowmap", "couldn't create FBO");
+				ASSERT(false, "shadowatlas", "couldn't create FBO");
 
 			glBindFramebuffer(GL_FRAMEBUFFER, 0);
-			s.is_fbo_created = true;
+			atlas.is_created = true;
 
 			check_gl_error();
 		}
 
-		void uninit(Shadow_Map& s)
+		void uninit(Shadow_Atlas& atlas)
 		{
-			if (s.is_fbo_created) {
-				LOG("shadowmap", "destroying");
-				glDeleteTextures(1, &s.depth_texture_id);
-				glDeleteFramebuffers(1, &s.depth_fbo_id);
+			if (atlas.is_created) {
+				LOG("shadowatlas", "destroying");
+				glDeleteTextures(1, &atlas.depth_texture_id);
+				glDeleteFramebuffers(1, &atlas.fbo_id);
+				atlas.depth_texture_id = 0;
+				atlas.fbo_id = 0;
+				atlas.is_created = false;
 			}
 		}
 
-		void update(Shadow_Map& s, const vec3& light_direction)
+		void fbo_activate(Shadow_Atlas& atlas)
 		{
-			static mat4 bias = mat4({
-				0.5, 0.0, 0.0, 0.0,
-				0.0, 0.5, 0.0, 0.0,
-				0.0, 0.0, 0.5, 0.0,
-				0.5, 0.5, 0.5, 1.0 });
+			glEnable(GL_DEPTH_TEST);
+			glBindFramebuffer(GL_FRAMEBUFFER, atlas.fbo_id);
+			glClear(GL_DEPTH_BUFFER_BIT); // every layer, the clear ignores the viewports
+		}
 
-			s.view = glm::lookAt(light_direction, vec3(0.0f,0.0f,0.0f), vec3(0.0f,1.0f,0.0f));
-			s.projection = glm::ortho(-s.config.ortho,s.config.ortho,-s.config.ortho,s.config.ortho, s.config.near_plane,s.config.far_plane);
-			s.VP = s.projection * s.view;
-			s.VP_biased = bias * s.VP;
+		void fbo_deactivate()
+		{
+			glBindFramebuffer(GL_FRAMEBUFFER, 0);
 		}
 
-		// TODO!!! move these shaibas to fbo:: and texture::
-		void fbo_activate(Shadow_Map& s)
+		void texture_activate(Shadow_Atlas& atlas, GLuint shader_id, SHADER_UNIFORM sampler, int texture_location_offset)
 		{
-			glEnable(GL_DEPTH_TEST);
-			glBindFramebuffer(GL_FRAMEBUFFER, s.depth_fbo_id);
-			glViewport(0,0, s.config.resolution, s.config.resolution);
-			glClear(GL_DEPTH_BUFFER_BIT);
+			glUniform1i(shader::uniform_location(shader_id, sampler), texture_location_offset);
+			glActiveTexture(GL_TEXTURE0 + texture_location_offset);
+			glBindTexture(GL_TEXTURE_2D_ARRAY, atlas.depth_texture_id);
 		}
 
-		void fbo_deactivate(Shadow_Map& s)
+		void texture_deactivate(Shadow_Atlas& atlas)
 		{
-			glBindFramebuffer(GL_FRAMEBUFFER, 0);
+			glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
 		}
+	}
 
-		void texture_activate(Shadow_Map& s, GLuint shader_id, const char* sampler_name, int texture_location_offset)
+	namespace uniformbuffer
+	{
+		void init(Uniform_Buffer& u, GLuint binding, umm size)
 		{
-			glUniform1i(glGetUniformLocation(shader_id, sampler_name), texture_location_offset);
-			glActiveTexture(GL_TEXTURE0 + texture_location_offset);
-			glBindTexture(GL_TEXTURE_2D, s.depth_texture_id);
+			u.binding = binding;
+			u.size = size;
+
+			glGenBuffers(1, &u.id);
+			glBindBuffer(GL_UNIFORM_BUFFER, u.id);
+			glBufferData(GL_UNIFORM_BUFFER, size, NULL, GL_DYNAMIC_DRAW);
+			glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+			// stays bound for the lifetime of the buffer, nothing else uses the binding point
+			glBindBufferBase(GL_UNIFORM_BUFFER, binding, u.id);
+			check_gl_error();
 		}
 
-		void texture_deactivate(Shadow_Map& s)
+		void uninit(Uniform_Buffer& u)
 		{
-			glBindTexture(GL_TEXTURE_2D, 0);
+			glDeleteBuffers(1, &u.id);
+			u.id = 0;
+		}
+
+		void upload(Uniform_Buffer& u, const void* data, umm size)
+		{
+			ASSERT(size <= u.size, "uniformbuffer", "upload of %zu bytes to a buffer of %zu bytes", size, u.size);
+
+			glBindBuffer(GL_UNIFORM_BUFFER, u.id);
+			glBufferSubData(GL_UNIFORM_BUFFER, 0, size, data);
+			glBindBuffer(GL_UNIFORM_BUFFER, 0);
 		}
 	}
 
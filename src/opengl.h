@@ -1,6 +1,7 @@
 #pragma once
 
 #include "types.h"
+#include "containers.hpp"
 
 namespace vxgi
 {
@@ -38,7 +39,8 @@ namespace vxgi
 		SHADER_TYPE_NULL,
 		SHADER_TYPE_VERTEX   = GL_VERTEX_SHADER,
 		SHADER_TYPE_FRAGMENT = GL_FRAGMENT_SHADER,
-		SHADER_TYPE_GEOMETRY = GL_GEOMETRY_SHADER
+		SHADER_TYPE_GEOMETRY = GL_GEOMETRY_SHADER,
+		SHADER_TYPE_COMPUTE  = GL_COMPUTE_SHADER
 	};
 	struct Shader_Source
 	{
@@ -49,26 +51,104 @@ namespace vxgi
 		GLuint        id = 0;
 		bool          isCompiled = false;
 	};
+	enum SHADER_UNIFORM : u32 // uniforms set by the renderer, locations are reflected once per program in shader::init
+	{
+		SHADER_UNIFORM_M,
+		SHADER_UNIFORM_N,
+		SHADER_UNIFORM_VP_SHADOW,
+		SHADER_UNIFORM_MATERIAL_KA,
+		SHADER_UNIFORM_MATERIAL_KD,
+		SHADER_UNIFORM_MATERIAL_KS,
+		SHADER_UNIFORM_MATERIAL_NS,
+		SHADER_UNIFORM_MATERIAL_KE,
+		SHADER_UNIFORM_MATERIAL_D,
+		SHADER_UNIFORM_MATERIAL_NI,
+		SHADER_UNIFORM_MATERIAL_TF,
+		SHADER_UNIFORM_TEX_AMBIENT,
+		SHADER_UNIFORM_TEX_DIFFUSE,
+		SHADER_UNIFORM_TEX_SPECULAR,
+		SHADER_UNIFORM_TEX_EMISSION,
+		SHADER_UNIFORM_TEX_BUMPMAP,
+		SHADER_UNIFORM_TEX_SHADOWMAP,
+		SHADER_UNIFORM_SHADOWMAP_MVP,
+		SHADER_UNIFORM_SCENE_VOXEL_SCALE,
+		SHADER_UNIFORM_TEX_VOXELGRID,
+		SHADER_UNIFORM_TEX_CUBE_BACK,
+		SHADER_UNIFORM_TEX_CUBE_FRONT,
+		SHADER_UNIFORM_G_NORMAL,
+		SHADER_UNIFORM_G_ALBEDO,
+		SHADER_UNIFORM_G_SPECULAR,
+		SHADER_UNIFORM_G_DEPTH,
+		SHADER_UNIFORM_TEX_HISTORY_INDIRECT_DIFFUSE,
+		SHADER_UNIFORM_TEX_HISTORY_GEOMETRY,
+		SHADER_UNIFORM_TEMPORAL_HAS_HISTORY,
+		SHADER_UNIFORM_TEMPORAL_FRAME_INDEX,
+		SHADER_UNIFORM_PREVIOUS_VP,
+		SHADER_UNIFORM_PREVIOUS_CAMERA_WORLD_POSITION,
+		SHADER_UNIFORM_IS_TILED,
+		SHADER_UNIFORM_TILE_CLASS,
+		SHADER_UNIFORM_MAX_TILES,
+		SHADER_UNIFORM_TILE_SCALE,
+		SHADER_UNIFORM_TEX_EMPTY_SPACE,
+		SHADER_UNIFORM_EMPTY_SPACE_PASS,
+		SHADER_UNIFORM_FAR_FIELD_FOOTPRINT,
+		SHADER_UNIFORM_FAR_FIELD_NORMAL_TOLERANCE,
+		SHADER_UNIFORM_TOTAL_SHADOWMAP_LAYERS,
+		SHADER_UNIFORM_SHADOWMAP_LAYER_LIGHT,
+		SHADER_UNIFORM_SHADOWMAP_LIGHT_LAYERS,
+		SHADER_UNIFORM_SHADOWMAP_ATLAS_SCALE,
+		SHADER_UNIFORM_GBUFFER_VIEW,
+		TOTAL_SHADER_UNIFORMS
+	};
+
 	struct Shader_Program
 	{
 		const char* name = "";
 		GLuint      id = 0;
+		GLint       uniform_locations[TOTAL_SHADER_UNIFORMS]; // -1 if not active in this program
+
+		// between shader::submit and shader::resolve
+		Shader_Source pending_sources[3];
+		int           total_pending_sources = 0;
+		u64           binary_hash = 0;
+		bool          is_pending = false;
 	};
 
-	struct G_Buffer
+	struct Program_Binary_Cache_Stats // since startup, see the program binary cache in opengl.cpp
+	{
+		int loaded = 0;
+		int compiled = 0;
+		int rejected = 0; // stale or from another driver, recompiled
+	};
+
+	struct Shader_Permutations // variants of one program, compiled on first use with a #define per set feature bit
+	{
+		const char* name = "";
+		const char* path_to_vert = "";
+		const char* path_to_frag = "";
+		const char* path_to_comp = ""; // compute programs have no vert + frag
+		const char* const* feature_defines = nullptr; // define name per feature bit
+		void (*append_defines)(u32 feature_mask, std::string& defines) = nullptr; // for mask bits above total_features that aren't a plain #define
+		int total_features = 0;
+
+		Hashmap<u32, Shader_Program*> variants; // by feature mask
+	};
+
+	struct G_Buffer // packed targets, see gbuffer_encoding.glsl. world position isn't stored, it's reconstructed from depth
 	{
 		enum Texture_Type : int
 		{
-			POSITION = 0,
-			NORMAL,
-			BUMP, // we use regular normals for cone tracing
-			ALBEDO,
-			SPECULAR,
-			//EMISSION, // replaced with bump
+			NORMAL = 0, // GL_RGBA16, octahedral normal in rg + octahedral bump normal in ba (we use regular normals for cone tracing)
+			ALBEDO, // GL_SRGB8_ALPHA8, alpha halved
+			SPECULAR, // GL_RGBA8, alpha = log encoded shininess
 			//DEPTH, // handled separately
 			TOTAL_GBUFFER_TEXTURES
 		};
 
+		static constexpr float MIN_SHININESS = 0.06f; // see GBUFFER_*_SHININESS in gbuffer_encoding.glsl
+		static constexpr float MAX_SHININESS = 2048.0f;
+		static constexpr float ALBEDO_ALPHA_SCALE = 2.0f; // diffuse + emission alpha
+
 		Texture2D textures[TOTAL_GBUFFER_TEXTURES];
 		Texture2D depthTexture;
 
@@ -78,41 +158,68 @@ namespace vxgi
 
 		int width = 0;
 		int height = 0;
+		int bytes_per_pixel = 0; // color targets + depth
 		bool isDepthRenderBufferCreated = false;
 	};
 
-	struct Shadow_Map
+	const int MAX_SHADOW_CASCADES = 4;
+	const int MAX_SHADOW_MAP_LAYERS = MAX_SHADOW_CASCADES + 1; // per light
+	const int MAX_SHADOW_ATLAS_LAYERS = 4 * MAX_SHADOW_MAP_LAYERS; // MAX_DIRECTIONAL_LIGHTS maps, see MAX_SHADOW_ATLAS_LAYERS in the shaders
+
+	struct Shadow_Map // layer i < total_cascades = cascade i fitted to the camera, last layer = the whole scene. drawn into a Shadow_Atlas
 	{
 		struct Config {
-			int resolution;
-			float ortho;
+			int resolution; // per layer
+			float ortho; // whole scene layer
 			float near_plane;
 			float far_plane;
+			int total_cascades = 3;
+			float split_lambda = 0.75f; // 0 = uniform splits, 1 = logarithmic
 		};
 
 		Config config;
 
-		mat4 view = mat4(1.0);
+		mat4 view = mat4(1.0); // whole scene layer
 		mat4 projection = mat4(1.0);
 		mat4 VP = mat4(1.0);
 		mat4 VP_biased = mat4(1.0);
 
-		bool   is_fbo_created = false;
-		GLuint depth_fbo_id = 0;
-		GLuint depth_texture_id = 0;
+		int   total_layers = 1;
+		mat4  layer_VP[MAX_SHADOW_MAP_LAYERS];
+		mat4  layer_VP_biased[MAX_SHADOW_MAP_LAYERS];
+		float cascade_splits[MAX_SHADOW_CASCADES + 1] = {}; // view distances, cascade i covers [i, i + 1]
+
+		int first_layer = 0; // of its layers in the Shadow_Atlas
+	};
+
+	struct Shadow_Atlas // the layers of every Shadow_Map in one depth array, drawn in one pass
+	{
+		int resolution = 0; // the largest Shadow_Map, smaller ones use the lower left corner of their layers
+		int total_layers = 0;
+
+		bool   is_created = false;
+		GLuint fbo_id = 0;
+		GLuint depth_texture_id = 0; // GL_TEXTURE_2D_ARRAY
+	};
+
+	struct Uniform_Buffer // std140 block bound to a fixed binding point, shaders declare layout(std140, binding = N)
+	{
+		GLuint id = 0;
+		GLuint binding = 0;
+		umm    size = 0;
 	};
 
 	namespace texture
 	{
 		void init(Texture2D&, const void* data, int w, int h, GLint internalFormat, GLenum format, GLenum type, GLenum minFilter, GLenum magFilter, GLenum wrapS, GLenum wrapT, bool generateMipmaps, bool attachToFrameBuffer, GLenum fboAttachment = GL_COLOR_ATTACHMENT0, GLuint fboAttachmentLevel = 0);
 		void uninit(Texture2D&);
-		void activate(Texture2D&, GLuint shader_id, const char* sampler_name, GLuint offset);
+		void activate(Texture2D&, GLuint shader_id, SHADER_UNIFORM sampler, GLuint offset);
 	}
 	namespace texture3D
 	{
 		void init(Texture3D&, GLfloat* data, int dimensions);
 		void uninit(Texture3D&);
-		void activate(Texture3D&, GLuint shader_id, const char* samplerName, int textureLocation = 0);
+		void activate(Texture3D&, GLuint shader_id, SHADER_UNIFORM sampler, int textureLocation = 0);
 		void deactivate();
 		void clear(Texture3D&, const vec4& clearColor);
 		void generate_mipmaps(Texture3D&);
@@ -124,17 +231,37 @@ namespace vxgi
 		void init(Frame_Buffer&, int w, int h);
 		void uninit(Frame_Buffer&);
 		void init_with_depth(Frame_Buffer&, int w, int h);
-		void activate_color_as_texture(Frame_Buffer&, const int shaderProgram, const char* glSamplerName, const int textureLocation = 0);
+		void activate_color_as_texture(Frame_Buffer&, const int shaderProgram, SHADER_UNIFORM sampler, const int textureLocation = 0);
 	}
 	namespace shader
 	{
-		bool   init(Shader_Program&, const char* name, const char* path_to_vert, const char* path_to_frag, const char* path_to_geom = "");
+		bool   init(Shader_Program&, const char* name, const char* path_to_vert, const char* path_to_frag, const char* path_to_geom = "", const char* defines = ""); // defines are inserted after #version
+		bool   init_compute(Shader_Program&, const char* name, const char* path_to_comp, const char* defines = "");
+		// init in two phases: submit compiles and links without waiting, resolve waits and checks the status.
+		// other work can go in between while the driver compiles, see enable_parallel_compile
+		bool   submit(Shader_Program&, const char* name, const char* path_to_vert, const char* path_to_frag, const char* path_to_geom = "", const char* defines = "");
+		bool   submit_compute(Shader_Program&, const char* name, const char* path_to_comp, const char* defines = "");
+		bool   resolve(Shader_Program&); // false if it didn't compile
+		bool   is_ready(Shader_Program&); // true if resolve won't stall
+		void   enable_parallel_compile(); // GL_KHR_parallel_shader_compile, compiles on driver threads after submit
 		void   uninit(Shader_Program&);
 		GLuint activate(Shader_Program&);
 		void   deactivate();
 
+		void   init_permutations(Shader_Permutations&, const char* name, const char* path_to_vert, const char* path_to_frag, const char* const* feature_defines, int total_features);
+		void   init_compute_permutations(Shader_Permutations&, const char* name, const char* path_to_comp, const char* const* feature_defines, int total_features);
+		void   uninit_permutations(Shader_Permutations&);
+		Shader_Program& get_permutation(Shader_Permutations&, u32 feature_mask); // compiles the variant if it's the first time it's needed
+
+		std::string read_source(const char* path); // with #include "file" lines replaced by the file, relative to path
+		void   insert_defines(std::string& src, const char* defines);
+		Program_Binary_Cache_Stats& get_binary_cache_stats();
+		void   reflect(Shader_Program&);
+		GLint  uniform_location(GLuint shader_id, SHADER_UNIFORM uniform); // shader_id has to be the active program
+
 		void source_init(Shader_Source&, const char* name, SHADER_TYPE type, const char* src);
 		void source_uninit(Shader_Source&);
+		void source_submit(Shader_Source&); // glCompileShader without checking the status
 		bool source_compile(Shader_Source&);
 		bool was_compilation_successful(Shader_Source&);
 		void log_compile_error(Shader_Source&);
@@ -146,18 +273,28 @@ namespace vxgi
 		void activate(G_Buffer&);
 		void deactivate(G_Buffer&);
 		void bind_as_textures(G_Buffer&, GLuint fbo, GLuint shader_id, int textureLocationOffset = 0);
-		void blit_to_screen(G_Buffer&, float viewportWidth, float viewportHeight);
 	}
 	namespace shadowmap
 	{
 		void init(Shadow_Map&, const Shadow_Map::Config& config);
-		void uninit(Shadow_Map&);
 
 		void update(Shadow_Map&, const vec3& light_direction);
+		bool fit_cascades(Shadow_Map&, const vec3& light_direction, const Camera& camera, const vec3& scene_min, const vec3& scene_max); // true if a layer moved
+	}
+	namespace shadowatlas
+	{
+		void init(Shadow_Atlas&, int resolution, int total_layers);
+		void uninit(Shadow_Atlas&);
 
-		void fbo_activate(Shadow_Map&);
-		void fbo_deactivate(Shadow_Map&);
-		void texture_activate(Shadow_Map&, GLuint shader_id, const char* sampler_name, int texture_location_offset = 0);
-		void texture_deactivate(Shadow_Map&);
+		void fbo_activate(Shadow_Atlas&); // the viewports are per light, see renderer::render_shadowmaps
+		void fbo_deactivate();
+		void texture_activate(Shadow_Atlas&, GLuint shader_id, SHADER_UNIFORM sampler, int texture_location_offset = 0);
+		void texture_deactivate(Shadow_Atlas&);
+	}
+	namespace uniformbuffer
+	{
+		void init(Uniform_Buffer&, GLuint binding, umm size);
+		void uninit(Uniform_Buffer&);
+		void upload(Uniform_Buffer&, const void* data, umm size);
 	}
 }
\ No newline at end of file
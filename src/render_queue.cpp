@@ -0,0 +1,247 @@
+#include "render_queue.h"
+
+#include <algorithm>
+#include "lib/imgui/imgui.h"
+
+#include "assets.h"
+#include "mesh_lod.h"
+
+namespace vxgi
+{
+	namespace
+	{
+		void gl_bind_vertex_array(GLuint vao) { glBindVertexArray(vao); }
+		void gl_bind_texture(GLuint unit, GLuint texture) { glActiveTexture(GL_TEXTURE0 + unit); glBindTexture(GL_TEXTURE_2D, texture); }
+		void gl_uniform_1i(GLint location, GLint value) { glUniform1i(location, value); }
+		void gl_uniform_1f(GLint location, GLfloat value) { glUniform1f(location, value); }
+		void gl_uniform_3fv(GLint location, const GLfloat* value) { glUniform3fv(location, 1, value); }
+		void gl_uniform_matrix_4fv(GLint location, const GLfloat* value) { glUniformMatrix4fv(location, 1, GL_FALSE, value); }
+		void gl_draw_arrays(GLint first, GLsizei count) { glDrawArrays(GL_TRIANGLES, first, count); }
+
+		struct Material_Texture // a sampler and its unit, relative to the queue's texture_location_offset
+		{
+			SHADER_UNIFORM sampler;
+			int unit;
+		};
+
+		const Material_Texture ALL_TEXTURES[] = { // see upload_material in renderer.cpp
+			{ SHADER_UNIFORM_TEX_AMBIENT, 0 }, { SHADER_UNIFORM_TEX_DIFFUSE, 1 }, { SHADER_UNIFORM_TEX_SPECULAR, 2 }, { SHADER_UNIFORM_TEX_EMISSION, 3 }, { SHADER_UNIFORM_TEX_BUMPMAP, 4 }
+		};
+		const Material_Texture ALBEDO_TEXTURES[] = { // the diffuse map doubles as the emission map
+			{ SHADER_UNIFORM_TEX_AMBIENT, 0 }, { SHADER_UNIFORM_TEX_DIFFUSE, 1 }, { SHADER_UNIFORM_TEX_EMISSION, 2 }
+		};
+
+		Texture2D* get_texture(Material& m, SHADER_UNIFORM sampler, DRAW_MATERIAL materials)
+		{
+			switch (sampler) {
+				case SHADER_UNIFORM_TEX_AMBIENT:  return m.map_Ka;
+				case SHADER_UNIFORM_TEX_DIFFUSE:  return m.map_Kd;
+				case SHADER_UNIFORM_TEX_SPECULAR: return m.map_Ks;
+				case SHADER_UNIFORM_TEX_EMISSION: return materials == DRAW_MATERIAL_ALBEDO ? m.map_Kd : m.map_Ke;
+				default:                          return m.map_bump;
+			}
+		}
+
+		void set_program(Render_Queue& q, Shader_Program& program)
+		{
+			Render_State_Cache& state = q.state;
+			if (state.program_id == program.id)
+				return;
+
+			state.program_id = q.gl.use_program(program);
+			state.model = NULL; // uniforms are per program
+			state.material = -1;
+			state.are_samplers_set = false;
+			q.frame_state_calls++;
+		}
+
+		void set_model(Render_Queue& q, Model& model)
+		{
+			Render_State_Cache& state = q.state;
+			if (state.model == &model) {
+				q.frame_elided_calls += 2;
+				return;
+			}
+
+			state.model = &model;
+			q.gl.uniform_matrix_4fv(q.gl.uniform_location(state.program_id, SHADER_UNIFORM_M), glm::value_ptr(model.transform.mtx));
+			q.gl.uniform_matrix_4fv(q.gl.uniform_location(state.program_id, SHADER_UNIFORM_N), glm::value_ptr(model.transform.normal_mtx));
+			q.frame_state_calls += 2;
+		}
+
+		void set_vertex_array(Render_Queue& q, GLuint vao)
+		{
+			Render_State_Cache& state = q.state;
+			if (state.vao == vao) {
+				q.frame_elided_calls++;
+				return;
+			}
+
+			state.vao = vao;
+			q.gl.bind_vertex_array(vao);
+			q.frame_state_calls++;
+		}
+
+		void set_material(Render_Queue& q, int material_index)
+		{
+			if (q.materials == DRAW_MATERIAL_NONE)
+				return;
+
+			Render_State_Cache& state = q.state;
+			Render_Queue_Gl& gl = q.gl;
+			GLuint program_id = state.program_id;
+			bool is_all = q.materials == DRAW_MATERIAL_ALL;
+
+			const Material_Texture* textures = is_all ? ALL_TEXTURES : ALBEDO_TEXTURES;
+			int total_textures = is_all ? int(SIZE_OF_STATIC_ARRAY(ALL_TEXTURES)) : int(SIZE_OF_STATIC_ARRAY(ALBEDO_TEXTURES));
+			int total_uniforms = is_all ? 8 : 3;
+
+			// the uncached loops set the samplers with every material
+			if (state.are_samplers_set) {
+				q.frame_elided_calls += total_textures;
+			} else {
+				for (int i = 0; i < total_textures; i++)
+					gl.uniform_1i(gl.uniform_location(program_id, textures[i].sampler), q.texture_location_offset + textures[i].unit);
+				state.are_samplers_set = true;
+				q.frame_state_calls += total_textures;
+			}
+
+			if (state.material == material_index) {
+				q.frame_elided_calls += total_uniforms + total_textures;
+				return;
+			}
+			state.material = material_index;
+
+			Material& m = assets::get_material(material_index);
+			gl.uniform_3fv(gl.uniform_location(program_id, SHADER_UNIFORM_MATERIAL_KA), glm::value_ptr(m.Ka));
+			gl.uniform_3fv(gl.uniform_location(program_id, SHADER_UNIFORM_MATERIAL_KD), glm::value_ptr(m.Kd));
+			gl.uniform_3fv(gl.uniform_location(program_id, SHADER_UNIFORM_MATERIAL_KE), glm::value_ptr(m.Ke));
+			if (is_all) {
+				gl.uniform_3fv(gl.uniform_location(program_id, SHADER_UNIFORM_MATERIAL_KS), glm::value_ptr(m.Ks));
+				gl.uniform_1f(gl.uniform_location(program_id, SHADER_UNIFORM_MATERIAL_NS), m.Ns);
+				gl.uniform_1f(gl.uniform_location(program_id, SHADER_UNIFORM_MATERIAL_D), m.d);
+				gl.uniform_1f(gl.uniform_location(program_id, SHADER_UNIFORM_MATERIAL_NI), m.Ni);
+				gl.uniform_3fv(gl.uniform_location(program_id, SHADER_UNIFORM_MATERIAL_TF), glm::value_ptr(m.Tf));
+			}
+			q.frame_state_calls += total_uniforms;
+
+			for (int i = 0; i < total_textures; i++) {
+				GLuint unit = q.texture_location_offset + textures[i].unit;
+				GLuint texture_id = get_texture(m, textures[i].sampler, q.materials)->id;
+				ASSERT(unit < Render_State_Cache::MAX_TEXTURE_UNITS, "renderqueue", "texture unit %u isn't cached", unit);
+
+				if (state.textures[unit] == texture_id) {
+					q.frame_elided_calls++;
+				} else {
+					state.textures[unit] = texture_id;
+					gl.bind_texture(unit, texture_id);
+					q.frame_state_calls++;
+				}
+			}
+		}
+	}
+
+	namespace renderqueue
+	{
+		void init(Render_Queue& q)
+		{
+			q.gl.use_program = shader::activate;
+			q.gl.uniform_location = shader::uniform_location;
+			q.gl.bind_vertex_array = gl_bind_vertex_array;
+			q.gl.bind_texture = gl_bind_texture;
+			q.gl.uniform_1i = gl_uniform_1i;
+			q.gl.uniform_1f = gl_uniform_1f;
+			q.gl.uniform_3fv = gl_uniform_3fv;
+			q.gl.uniform_matrix_4fv = gl_uniform_matrix_4fv;
+			q.gl.draw_arrays = gl_draw_arrays;
+		}
+
+		void uninit(Render_Queue& q)
+		{
+			array::uninit(q.items);
+		}
+
+		u64 make_key(GLuint program_id, int material, GLuint vao, float depth)
+		{
+			// positive floats sort like their bits, the top 16 keep the exponent and 7 bits of mantissa
+			u32 depth_bits = 0;
+			depth = glm::max(depth, 0.0f);
+			memcpy(&depth_bits, &depth, sizeof(depth_bits));
+
+			return (u64(program_id & 0xffff) << 48) | (u64(u32(material + 1) & 0xffff) << 32) | (u64(vao & 0xffff) << 16) | u64(depth_bits >> 16);
+		}
+
+		void begin(Render_Queue& q, DRAW_MATERIAL materials, int texture_location_offset)
+		{
+			array::set_length(q.items, 0);
+			q.materials = materials;
+			q.texture_location_offset = texture_location_offset;
+		}
+
+		void add_scene(Render_Queue& q, Scene& scene, Shader_Program& program, vec3 view_position, const u8* is_visible, const u8* lods)
+		{
+			int scene_index = 0;
+			for (Model* model : scene.models) {
+				vec3 center = vec3(model->transform.mtx * vec4(model->bounding_box.center, 1.0f));
+				float depth = glm::length(center - view_position);
+
+				for (Mesh* mesh : model->meshes) {
+					for (int i = 0; i < int(array::size(mesh->sub_meshes)); i++, scene_index++) {
+						if (is_visible && !is_visible[scene_index])
+							continue;
+
+						Sub_Mesh& sub_mesh = meshlod::get_sub_mesh(*mesh, i, lods ? lods[scene_index] : 0);
+						if (sub_mesh.length == 0)
+							continue;
+
+						int material = q.materials == DRAW_MATERIAL_NONE ? -1 : sub_mesh.material_index; // then grouped by vao
+						array::add(q.items, Draw_Item { make_key(program.id, material, mesh->vao, depth), &program, model, &sub_mesh, mesh->vao });
+					}
+				}
+			}
+		}
+
+		int submit(Render_Queue& q, GLuint active_program_id)
+		{
+			if (q.is_sorted)
+				std::sort(q.items.data, q.items.data + array::size(q.items), [](const Draw_Item& a, const Draw_Item& b) { return a.key < b.key; });
+
+			// the caller has the program active with its own uniforms set, nothing else is known
+			q.state = {};
+			q.state.program_id = active_program_id;
+
+			for (Draw_Item& item : q.items) {
+				set_program(q, *item.program);
+				set_model(q, *item.model);
+				set_vertex_array(q, item.vao);
+				set_material(q, item.sub_mesh->material_index);
+
+				q.gl.draw_arrays(item.sub_mesh->index, item.sub_mesh->length);
+			}
+
+			int draws = array::size(q.items);
+			q.frame_draws += draws;
+			return draws;
+		}
+
+		void end_frame(Render_Queue& q)
+		{
+			q.draws = q.frame_draws;
+			q.state_calls = q.frame_state_calls;
+			q.elided_calls = q.frame_elided_calls;
+			q.frame_draws = 0;
+			q.frame_state_calls = 0;
+			q.frame_elided_calls = 0;
+		}
+
+		void render_ui(Render_Queue& q)
+		{
+			using namespace ImGui;
+
+			Checkbox("sort by program, material, vao, depth", &q.is_sorted);
+			Text("last frame: %d draws, %d binds + uniform uploads, %d elided", q.draws, q.state_calls, q.elided_calls);
+			if (IsItemHovered())
+				SetTooltip("when the scene passes don't go through multi draw. elided = already current");
+		}
+	}
+}
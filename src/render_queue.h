@@ -0,0 +1,87 @@
+#pragma once
+
+#include "opengl.h"
+#include "scene.h"
+
+// The scene passes' draws as a list of items sorted by (program, material, vao, depth), so that neighbouring items
+// share most of their state, submitted through a cache of what's currently bound that skips the binds and uniform
+// uploads that wouldn't change anything. Every gl call goes through Render_Queue_Gl, which can be swapped for a mock
+// that records the calls.
+
+namespace vxgi
+{
+	enum DRAW_MATERIAL // what a pass uploads of each material
+	{
+		DRAW_MATERIAL_ALL,    // everything in upload_material, the g-buffer and the forward pass
+		DRAW_MATERIAL_ALBEDO, // ambient, diffuse and emission, the voxelization
+		DRAW_MATERIAL_NONE    // the shadow maps
+	};
+
+	struct Render_Queue_Gl // the defaults (renderqueue::init) call gl, a mock can record
+	{
+		GLuint (*use_program)(Shader_Program& program);
+		GLint  (*uniform_location)(GLuint program_id, SHADER_UNIFORM uniform);
+		void   (*bind_vertex_array)(GLuint vao);
+		void   (*bind_texture)(GLuint unit, GLuint texture); // GL_TEXTURE_2D
+		void   (*uniform_1i)(GLint location, GLint value);
+		void   (*uniform_1f)(GLint location, GLfloat value);
+		void   (*uniform_3fv)(GLint location, const GLfloat* value);
+		void   (*uniform_matrix_4fv)(GLint location, const GLfloat* value);
+		void   (*draw_arrays)(GLint first, GLsizei count); // GL_TRIANGLES
+	};
+
+	struct Draw_Item
+	{
+		u64 key; // see renderqueue::make_key
+		Shader_Program* program;
+		Model* model;
+		Sub_Mesh* sub_mesh;
+		GLuint vao;
+	};
+
+	struct Render_State_Cache // what's bound right now, reset at the start of every submit
+	{
+		static const int MAX_TEXTURE_UNITS = 16;
+
+		GLuint program_id = 0;
+		GLuint vao = 0;
+		Model* model = NULL; // whose M and N are uploaded
+		int material = -1; // whose uniforms are uploaded
+		bool are_samplers_set = false; // the program's sampler uniforms point to the material texture units
+		GLuint textures[MAX_TEXTURE_UNITS] = {};
+	};
+
+	struct Render_Queue
+	{
+		Array<Draw_Item> items;
+		Render_State_Cache state;
+		Render_Queue_Gl gl = {};
+
+		DRAW_MATERIAL materials = DRAW_MATERIAL_ALL; // of the items since begin
+		int texture_location_offset = 0;
+
+		bool is_sorted = true; // otherwise in load order, to compare
+
+		// stats, state calls (binds + uniform uploads) counted by submit and published once per frame
+		int frame_draws = 0;
+		int frame_state_calls = 0;
+		int frame_elided_calls = 0; // that the unsorted, uncached loops would have made
+		int draws = 0;
+		int state_calls = 0;
+		int elided_calls = 0;
+	};
+
+	namespace renderqueue
+	{
+		void init(Render_Queue&); // the gl calls default to gl, replace queue.gl afterwards to record them
+		void uninit(Render_Queue&);
+
+		u64  make_key(GLuint program_id, int material, GLuint vao, float depth); // depth >= 0, nearer sorts first
+		void begin(Render_Queue&, DRAW_MATERIAL, int texture_location_offset = 0); // clears the items
+		void add_scene(Render_Queue&, Scene&, Shader_Program&, vec3 view_position, const u8* is_visible = NULL, const u8* lods = NULL); // per sub mesh in scene order, NULL = all / full detail
+		int  submit(Render_Queue&, GLuint active_program_id); // sorts, draws and returns the draw calls
+
+		void end_frame(Render_Queue&);
+		void render_ui(Render_Queue&);
+	}
+}
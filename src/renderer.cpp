@@ -5,6 +5,8 @@
 
 #include "app.h"
 #include "assets.h"
+#include "cpu_cone_tracing.h"
+#include "cpu_profiler.h"
 #include "scene.h"
 
 namespace vxgi
@@ -15,36 +17,110 @@ namespace vxgi
 			static Renderer renderer;
 			return renderer;
 		}
+
+		bool uses_tile_classification(Scene& scene) // the compute pass does its own tiling. ao only traces neither of the cones the tiles are sorted by
+		{
+			Renderer& renderer = get_renderer();
+			return renderer.tile_classification.is_enabled && !renderer.compute_cone_tracing.is_enabled && !vct::is_only_ao(vct::get_feature_mask(scene.vct_settings));
+		}
+
+		float get_pass_ms(const char* name) // gpu profiler average over the last frames the pass ran, 0 before it ran
+		{
+			Gpu_Profiler::Scope* scope = gpuprofiler::find(get_renderer().gpu_profiler, name);
+			return scope ? gpuprofiler::get_stats(*scope).average_ms : 0.0f;
+		}
+
+		// written next to the executable, trace them with `vxgi --reference <gbuffer> <voxels> <output.ppm>`
+		const char* CPU_REFERENCE_GBUFFER_PATH = "cpu_reference_gbuffer.bin";
+		const char* CPU_REFERENCE_VOXELS_PATH = "cpu_reference_voxels.bin";
+		const char* CPU_REFERENCE_GPU_IMAGE_PATH = "cpu_reference_gpu.ppm";
+
+		// the g-buffer packing on the cpu, for the dump. see gbuffer_encoding.glsl
+		vec3 decode_octahedral(float ex, float ey)
+		{
+			vec2 p = 2.0f * vec2(ex, ey) - 1.0f;
+			vec3 n = vec3(p, 1.0f - glm::abs(p.x) - glm::abs(p.y));
+			float t = glm::max(-n.z, 0.0f);
+			n.x += n.x >= 0.0f ? -t : t;
+			n.y += n.y >= 0.0f ? -t : t;
+			return glm::normalize(n);
+		}
+
+		float decode_shininess(float e)
+		{
+			return G_Buffer::MIN_SHININESS * glm::exp2(e * glm::log2(G_Buffer::MAX_SHININESS / G_Buffer::MIN_SHININESS));
+		}
+
+		float srgb_to_linear(u8 c) // texture reads decode, glGetTextureImage doesn't
+		{
+			float f = float(c) / 255.0f;
+			return f <= 0.04045f ? f / 12.92f : glm::pow((f + 0.055f) / 1.055f, 2.4f);
+		}
 	}
 
 	namespace renderer
 	{
 		void init(GLFWwindow* window)
 		{
+			CPU_ZONE("renderer::init");
 			LOG("renderer", "initializing");
 			Renderer& renderer = get_renderer();
 
 			int window_w, window_h;
 			glfwGetWindowSize(window, &window_w, &window_h);
 
-			// load shaders first (early exit if some of them doesn't compile)
+			// submit shaders first, the driver compiles them while the rest of the app initializes (see resolve_shaders)
+			renderer.shaders_submit_time = glfwGetTime();
+			renderer.shaders_startup_phase = application::startup_phase_begin("shader compile");
+			int submit_phase = application::startup_phase_begin("shader submit");
 			Renderer_Shaders& shaders = renderer.shaders;
-			shader::init(shaders.model, "shader_model", "../src/shaders/model_vert.glsl", "../src/shaders/model_frag.glsl");
-			shader::init(shaders.world_pos, "shader_world_pos", "../src/shaders/world_pos_vert.glsl", "../src/shaders/world_pos_frag.glsl");
-			shader::init(shaders.gbuffer, "shader_gbuffer", "../src/shaders/gbuffer_vert.glsl", "../src/shaders/gbuffer_frag.glsl");
-			shader::init(shaders.shadowmap, "shader_shadowmap", "../src/shaders/shadowmap_vert.glsl", "../src/shaders/shadowmap_frag.glsl");
-			shader::init(shaders.shadowmap_visualizer, "shader_shadowmap_visualizer", "../src/shaders/shadowmap_visualizer_vert.glsl", "../src/shaders/shadowmap_visualizer_frag.glsl");
-			shader::init(shaders.voxelconetracing, "shader_voxelconetracing", "../src/shaders/voxelconetracing_vert.glsl", "../src/shaders/voxelconetracing_frag.glsl");
-			shader::init(shaders.voxelization, "shader_voxelization", "../src/shaders/voxelization_vert.glsl", "../src/shaders/voxelization_frag.glsl", "../src/shaders/voxelization_geom.glsl");
-			shader::init(shaders.voxelization_visualizer, "shader_voxelization_visualizer", "../src/shaders/voxelization_visualizer_vert.glsl", "../src/shaders/voxelization_visualizer_frag.glsl");
+			shader::enable_parallel_compile();
+			shader::submit(shaders.model, "shader_model", "../src/shaders/model_vert.glsl", "../src/shaders/model_frag.glsl");
+			shader::submit(shaders.world_pos, "shader_world_pos", "../src/shaders/world_pos_vert.glsl", "../src/shaders/world_pos_frag.glsl");
+			shader::submit(shaders.gbuffer, "shader_gbuffer", "../src/shaders/gbuffer_vert.glsl", "../src/shaders/gbuffer_frag.glsl");
+			shader::submit(shaders.shadowmap, "shader_shadowmap", "../src/shaders/shadowmap_vert.glsl", "../src/shaders/shadowmap_frag.glsl", "../src/shaders/shadowmap_geom.glsl");
+			shader::submit(shaders.shadowmap_visualizer, "shader_shadowmap_visualizer", "../src/shaders/shadowmap_visualizer_vert.glsl", "../src/shaders/shadowmap_visualizer_frag.glsl");
+			shader::submit(shaders.gbuffer_visualizer, "shader_gbuffer_visualizer", "../src/shaders/gbuffer_visualizer_vert.glsl", "../src/shaders/gbuffer_visualizer_frag.glsl");
+			shader::init_permutations(shaders.voxelconetracing, "shader_voxelconetracing", "../src/shaders/voxelconetracing_vert.glsl", "../src/shaders/voxelconetracing_frag.glsl", CONE_TRACING_FEATURE_DEFINES, TOTAL_CONE_TRACING_FEATURES);
+			shader::init_permutations(shaders.voxelconetracing_tiled, "shader_voxelconetracing_tiled", "../src/shaders/voxelconetracing_tiled_vert.glsl", "../src/shaders/voxelconetracing_frag.glsl", CONE_TRACING_FEATURE_DEFINES, TOTAL_CONE_TRACING_FEATURES);
+			shader::init_compute_permutations(shaders.voxelconetracing_compute, "shader_voxelconetracing_compute", "../src/shaders/voxelconetracing_comp.glsl", CONE_TRACING_FEATURE_DEFINES, TOTAL_CONE_TRACING_FEATURES);
+			shaders.voxelconetracing.append_defines = vct::append_cone_set_defines;
+			shaders.voxelconetracing_tiled.append_defines = vct::append_cone_set_defines;
+			shaders.voxelconetracing_compute.append_defines = vct::append_cone_set_defines;
+			shader::submit_compute(shaders.tileclassification, "shader_tileclassification", "../src/shaders/tileclassification_comp.glsl");
+			shader::submit_compute(shaders.emptyspace, "shader_emptyspace", "../src/shaders/emptyspace_comp.glsl");
+			shader::submit(shaders.voxelization, "shader_voxelization", "../src/shaders/voxelization_vert.glsl", "../src/shaders/voxelization_frag.glsl", "../src/shaders/voxelization_geom.glsl");
+			shader::submit(shaders.voxelization_visualizer, "shader_voxelization_visualizer", "../src/shaders/voxelization_visualizer_vert.glsl", "../src/shaders/voxelization_visualizer_frag.glsl");
+
+			renderqueue::init(renderer.render_queue);
+			multidraw::init(renderer.multi_draw);
+			const char* multi_draw_defines = multidraw::get_shader_defines(renderer.multi_draw);
+			shader::submit(shaders.gbuffer_multi_draw, "shader_gbuffer_multi_draw", "../src/shaders/gbuffer_vert.glsl", "../src/shaders/gbuffer_frag.glsl", "", multi_draw_defines);
+			shader::submit(shaders.shadowmap_multi_draw, "shader_shadowmap_multi_draw", "../src/shaders/shadowmap_vert.glsl", "../src/shaders/shadowmap_frag.glsl", "../src/shaders/shadowmap_geom.glsl", multi_draw_defines);
+			shader::submit(shaders.voxelization_multi_draw, "shader_voxelization_multi_draw", "../src/shaders/voxelization_vert.glsl", "../src/shaders/voxelization_frag.glsl", "../src/shaders/voxelization_geom.glsl", multi_draw_defines);
+			application::startup_phase_end(submit_phase);
 			check_gl_error();
 
 			// fbos
+			int resources_phase = application::startup_phase_begin("render targets");
 			Application_Resolution& resolution = application::resolution_get();
 			framebuffer::init_with_depth(renderer.main_fbo, resolution.internal.x, resolution.internal.y);
 			framebuffer::init(renderer.voxelization.vox_front, resolution.internal.x, resolution.internal.y);
 			framebuffer::init(renderer.voxelization.vox_back, resolution.internal.x, resolution.internal.y);
 			gbuffer::init(renderer.g_buffer, resolution.internal.x, resolution.internal.y);
+			gpuprofiler::init(renderer.gpu_profiler);
+			vct::init_history(renderer.cone_tracing_history, renderer.main_fbo.color_texture_id, resolution.internal.x, resolution.internal.y);
+			vct::init_tiles(renderer.tile_classification, resolution.internal.x, resolution.internal.y);
+			vct::init_step_counters(renderer.cone_step_counters);
+			lightclusters::init(renderer.light_clusters);
+			check_gl_error();
+
+			// uniform buffers
+			Renderer_Uniform_Buffers& ubos = renderer.uniform_buffers;
+			uniformbuffer::init(ubos.camera, UNIFORM_BUFFER_BINDING_CAMERA, sizeof(Camera_Std140));
+			uniformbuffer::init(ubos.lights, UNIFORM_BUFFER_BINDING_LIGHTS, sizeof(Scene_Lights_Std140));
+			uniformbuffer::init(ubos.cone_tracing, UNIFORM_BUFFER_BINDING_CONE_TRACING, sizeof(Cone_Tracing_Settings_Std140));
+			uniformbuffer::init(ubos.voxelization, UNIFORM_BUFFER_BINDING_VOXELIZATION, sizeof(Voxelization_Settings_Std140));
 			check_gl_error();
 
 			// voxel grids
@@ -57,6 +133,7 @@ namespace vxgi
 				delete[] data; // uploaded to gpu, no need to keep in app memory (@Cleanup)
 			}
 			check_gl_error();
+			application::startup_phase_end(resources_phase);
 
 			// misc crap
 			camera::set_to_ortho(renderer.voxelization.camera);
@@ -66,6 +143,33 @@ namespace vxgi
 			glfwSetFramebufferSizeCallback(window, glfw_framebuffer_size_callback);
 			check_gl_error();
 		}
+		bool resolve_shaders()
+		{
+			Renderer& renderer = get_renderer();
+			Renderer_Shaders& shaders = renderer.shaders;
+
+			Shader_Program* programs[] = {
+				&shaders.model, &shaders.world_pos, &shaders.gbuffer, &shaders.shadowmap, &shaders.shadowmap_visualizer, &shaders.gbuffer_visualizer,
+				&shaders.tileclassification, &shaders.emptyspace, &shaders.voxelization, &shaders.voxelization_visualizer,
+				&shaders.gbuffer_multi_draw, &shaders.shadowmap_multi_draw, &shaders.voxelization_multi_draw
+			};
+
+			int resolve_phase = application::startup_phase_begin("shader resolve");
+			int total_ready = 0;
+			for (Shader_Program* prog : programs)
+				total_ready += shader::is_ready(*prog) ? 1 : 0;
+
+			bool is_compiled = true;
+			for (Shader_Program* prog : programs)
+				is_compiled = shader::resolve(*prog) && is_compiled;
+			check_gl_error();
+			application::startup_phase_end(resolve_phase);
+			application::startup_phase_end(renderer.shaders_startup_phase);
+
+			Program_Binary_Cache_Stats& cache_stats = shader::get_binary_cache_stats();
+			LOG("renderer", "shaders ready in %.1f ms (%s start, %d from the binary cache, %d compiled, %d/%d done before resolve)", 1000.0 * (glfwGetTime() - renderer.shaders_submit_time), cache_stats.compiled == 0 ? "warm" : "cold", cache_stats.loaded, cache_stats.compiled, total_ready, int(SIZE_OF_STATIC_ARRAY(programs)));
+			return is_compiled;
+		}
 		void uninit()
 		{
 			LOG("renderer", "destroying");
@@ -78,15 +182,50 @@ namespace vxgi
 			framebuffer::uninit(renderer.voxelization.vox_front);
 			framebuffer::uninit(renderer.voxelization.vox_back);
 			gbuffer::uninit(renderer.g_buffer);
+			gpuprofiler::uninit(renderer.gpu_profiler);
+			vct::uninit_history(renderer.cone_tracing_history);
+			vct::uninit_tiles(renderer.tile_classification);
+			vct::uninit_empty_space(renderer.empty_space);
+			vct::uninit_step_counters(renderer.cone_step_counters);
+			lightclusters::uninit(renderer.light_clusters);
+			multidraw::uninit(renderer.multi_draw);
+			renderqueue::uninit(renderer.render_queue);
+			frustumculling::uninit(renderer.culling);
+			occlusionculling::uninit(renderer.occlusion);
+			meshletculling::uninit(renderer.meshlets);
+			meshlod::uninit(renderer.lods);
+
+			uniformbuffer::uninit(renderer.uniform_buffers.camera);
+			uniformbuffer::uninit(renderer.uniform_buffers.lights);
+			uniformbuffer::uninit(renderer.uniform_buffers.cone_tracing);
+			uniformbuffer::uninit(renderer.uniform_buffers.voxelization);
+
+			shader::uninit_permutations(renderer.shaders.voxelconetracing);
+			shader::uninit_permutations(renderer.shaders.voxelconetracing_tiled);
+			shader::uninit_permutations(renderer.shaders.voxelconetracing_compute);
 		}
 
 		void render(GLFWwindow* window, Scene& scene, float dt)
 		{
+			CPU_ZONE("renderer::render");
 			Renderer& renderer = get_renderer();
 			Application_Resolution& resolution = application::resolution_get();
+			Gpu_Profiler& profiler = renderer.gpu_profiler;
 
 			check_gl_error();
+			gpuprofiler::begin_frame(profiler);
+			gpuprofiler::begin(profiler, "frame");
 			camera::update(renderer.fps_camera);
+			upload_uniform_buffers(scene);
+
+			if (!renderer.multi_draw.is_built)
+				multidraw::build(renderer.multi_draw, scene); // the scene is loaded after renderer::init
+			if (!renderer.culling.is_built)
+				frustumculling::build(renderer.culling, scene);
+			if (!renderer.occlusion.is_built)
+				occlusionculling::build(renderer.occlusion, scene);
+			if (!renderer.meshlets.is_built)
+				meshletculling::build(renderer.meshlets, scene);
 
 			// render to main fbo
 			{
@@ -100,8 +239,11 @@ namespace vxgi
 
 				if (renderer.voxelize_next_frame) {
 					renderer.voxelize_next_frame = false;
-					render_shadowmaps(scene, fboID);
-					voxelize_scene(scene, fboID, get_current_voxelgrid(), renderer.voxelization, renderer.voxelization_settings);
+					renderer.cone_tracing_history.is_valid = false; // accumulated lighting is stale after revoxelizing
+					gpuprofiler::begin(profiler, "shadow maps");
+					render_shadowmaps(scene, renderer.fps_camera, fboID);
+					gpuprofiler::end(profiler);
+					voxelize_scene(scene, fboID, get_current_voxelgrid());
 				}
 
 				switch (renderer.mode)
@@ -109,33 +251,64 @@ namespace vxgi
 					case RENDERER_MODE_SCENE:
 					{
 						check_gl_error();
-						render_shadowmaps(scene, fboID);
-						render_scene_to_gbuffer(scene, renderer.fps_camera, fboID, renderer.g_buffer);
-						render_scene_with_voxel_cone_tracing(scene, renderer.fps_camera, fboID, renderer.g_buffer, get_current_voxelgrid());
+						gpuprofiler::begin(profiler, "shadow maps");
+						render_shadowmaps(scene, renderer.fps_camera, fboID);
+						gpuprofiler::end(profiler);
 
-						if (renderer.visualize_gbuffers)
-							gbuffer::blit_to_screen(renderer.g_buffer, resolution.internal.x, resolution.internal.y);
+						gpuprofiler::begin(profiler, "g-buffer");
+						render_scene_to_gbuffer(scene, renderer.fps_camera, fboID, renderer.g_buffer);
+						gpuprofiler::end(profiler);
+
+						gpuprofiler::begin(profiler, "light clusters");
+						build_light_clusters(scene, renderer.fps_camera, renderer.light_clusters);
+						gpuprofiler::end(profiler);
+
+						if (uses_tile_classification(scene)) {
+							gpuprofiler::begin(profiler, "tile classification");
+							classify_tiles(scene, fboID, renderer.g_buffer, renderer.tile_classification);
+							gpuprofiler::end(profiler);
+						}
+
+						gpuprofiler::begin(profiler, "cone tracing");
+						render_scene_with_voxel_cone_tracing(scene, renderer.fps_camera, fboID, renderer.g_buffer, get_current_voxelgrid(), renderer.cone_tracing_history, renderer.tile_classification, renderer.empty_space, renderer.cone_step_counters, renderer.compute_cone_tracing);
+						gpuprofiler::end(profiler);
+
+						if (renderer.dump_next_frame) {
+							renderer.dump_next_frame = false;
+							dump_cone_tracing_inputs(scene, renderer.fps_camera, renderer.g_buffer, get_current_voxelgrid(), renderer.main_fbo.color_texture_id);
+						}
+
+						if (renderer.visualize_gbuffers) {
+							gpuprofiler::begin(profiler, "g-buffer visualization");
+							render_gbuffer_to_screen(renderer.g_buffer, fboID);
+							gpuprofiler::end(profiler);
+						}
 					}
 					break;
 
 					case RENDERER_MODE_SCENE_VOXELIZED:
 					{
-						render_voxelized_scene(scene, renderer.fps_camera, fboID, get_current_voxelgrid(), renderer.voxelization, renderer.voxelization_settings);
+						gpuprofiler::begin(profiler, "voxel visualization");
+						render_voxelized_scene(scene, renderer.fps_camera, fboID, get_current_voxelgrid(), renderer.voxelization);
+						gpuprofiler::end(profiler);
 					}
 					break;
 
 					case RENDERER_MODE_SCENE_SHADOW_MAP:
 					{
-						render_shadowmaps(scene, fboID);
+						gpuprofiler::begin(profiler, "shadow maps");
+						render_shadowmaps(scene, renderer.fps_camera, fboID);
+						gpuprofiler::end(profiler);
 
 						if (array::size(scene.lights.directional_lights) > 0)
-							render_shadowmap_to_screen(scene.lights.directional_lights[0].shadow_map, fboID);
+							render_shadowmap_to_screen(scene.lights.shadow_atlas, fboID);
 					}
 					break;
 				}
 			}
 
 			// blit main fbo to actual window
+			gpuprofiler::begin(profiler, "blit");
 			{
 				static const GLfloat bg_color[] = { 0.75, 0.75, 0.75, 1.0 };
 				glBindFramebuffer(GL_FRAMEBUFFER, 0);
@@ -155,7 +328,13 @@ namespace vxgi
 				glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
 				glReadBuffer(0);
 			}
+			gpuprofiler::end(profiler);
+
+			gpuprofiler::end(profiler); // frame
+			gpuprofiler::end_frame(profiler);
 
+			multidraw::end_frame(renderer.multi_draw);
+			renderqueue::end_frame(renderer.render_queue);
 			renderer.is_first_frame = false;
 		}
 
@@ -191,6 +370,51 @@ namespace vxgi
 				TreePop();
 			}
 
+			if (TreeNode("Light clusters")) {
+				lightclusters::render_ui(renderer.light_clusters);
+				TreePop();
+			}
+
+			if (TreeNode("Multi draw")) {
+				multidraw::render_ui(renderer.multi_draw);
+				TreePop();
+			}
+
+			if (TreeNode("Frustum culling")) {
+				frustumculling::render_ui(renderer.culling);
+				TreePop();
+			}
+
+			if (TreeNode("Occlusion culling")) {
+				occlusionculling::render_ui(renderer.occlusion);
+				TreePop();
+			}
+
+			if (TreeNode("Meshlet culling")) {
+				meshletculling::render_ui(renderer.meshlets);
+				TreePop();
+			}
+
+			if (TreeNode("Mesh LODs")) {
+				if (meshlod::render_ui(renderer.lods)) {
+					renderer.voxelize_next_frame = true;
+					for (Directional_Light& light : scene.lights.directional_lights)
+						light.is_dirty = true;
+				}
+				Text("voxelization %.2f ms, shadow maps %.2f ms", get_pass_ms("voxelization"), get_pass_ms("shadow maps"));
+				TreePop();
+			}
+
+			if (TreeNode("GPU profiler")) {
+				gpuprofiler::render_ui(renderer.gpu_profiler);
+				TreePop();
+			}
+
+			if (TreeNode("Render queue")) {
+				renderqueue::render_ui(renderer.render_queue);
+				TreePop();
+			}
+
 			if (TreeNode("Renderer"))
 			{
 				Text("mode");
@@ -202,9 +426,61 @@ namespace vxgi
 				Text("");
 
 				Checkbox("visualize g-buffers", &renderer.visualize_gbuffers);
+				Text("g-buffer: %d bytes per pixel, %.2f ms", renderer.g_buffer.bytes_per_pixel, get_pass_ms("g-buffer"));
 				Checkbox("render light bulbs", &renderer.render_light_bulbs);
 				Text("");
 
+				if (Button("dump cone tracing inputs"))
+					renderer.dump_next_frame = true;
+				if (IsItemHovered())
+					SetTooltip("g-buffer + voxel grid for the cpu reference tracer (--reference)");
+				Text("");
+
+				Tile_Classification& tiles = renderer.tile_classification;
+				Checkbox("tile classification", &tiles.is_enabled);
+				if (tiles.is_enabled) {
+					Checkbox("show tile stats (stalls)", &tiles.show_stats);
+					if (tiles.show_stats) {
+						u32 total_tiles = u32(tiles.tiles_x * tiles.tiles_y);
+						u32 shaded_tiles = 0;
+						for (u32 count : tiles.tiles_per_class)
+							shaded_tiles += count;
+
+						Text("tiles %u (%dx%d px)", total_tiles, TILE_SIZE, TILE_SIZE);
+						Text("skipped %u", total_tiles - shaded_tiles);
+						Text("diffuse only %u", tiles.tiles_per_class[0]);
+						Text("+ specular %u", tiles.tiles_per_class[1]);
+						Text("+ soft shadows %u", tiles.tiles_per_class[2]);
+						Text("+ specular + soft shadows %u", tiles.tiles_per_class[3]);
+					}
+				}
+				Text("");
+
+				Compute_Cone_Tracing& compute = renderer.compute_cone_tracing;
+				Text("cone tracing pass %.2f ms", get_pass_ms("cone tracing"));
+				int cone_tracing_path = compute.is_enabled ? 1 : 0;
+				RadioButton("fragment", &cone_tracing_path, 0); SameLine();
+				RadioButton("compute (8x8 tiles)", &cone_tracing_path, 1);
+				compute.is_enabled = (cone_tracing_path == 1);
+				if (compute.is_enabled) {
+					Checkbox("share far field per tile", &compute.share_far_field);
+					SliderFloat("far field footprint (tiles)", &compute.far_field_footprint, 1.0f, 8.0f);
+					SliderFloat("far field normal tolerance", &compute.far_field_normal_tolerance, 0.5f, 1.0f);
+				}
+				Text("");
+
+				Checkbox("empty space skipping", &renderer.empty_space.is_enabled);
+				Cone_Step_Counters& step_counters = renderer.cone_step_counters;
+				Checkbox("count cone steps (stalls)", &step_counters.is_enabled);
+				if (step_counters.is_enabled) {
+					Cone_Step_Counters::Counters& c = step_counters.last_frame;
+					float cones = float(glm::max(c.total_cones, 1u));
+					Text("cones %u", c.total_cones);
+					Text("steps per cone %.2f", float(c.total_steps) / cones);
+					Text("leaps per cone %.2f", float(c.total_leaps) / cones);
+				}
+				Text("");
+
 				if (TreeNode("camera")) {
 					Camera& c = renderer.fps_camera;
 					Text("up %.2f,%.2f,%.2f", c.up.x, c.up.y, c.up.z);
@@ -217,9 +493,18 @@ namespace vxgi
 			}
 		}
 
+		void render_overlay()
+		{
+			gpuprofiler::render_overlay(get_renderer().gpu_profiler);
+		}
+
 		Camera& get_camera() {
 			return get_renderer().fps_camera;
 		}
+
+		Gpu_Profiler& get_gpu_profiler() {
+			return get_renderer().gpu_profiler;
+		}
 	}
 
 	namespace renderer
@@ -232,21 +517,41 @@ namespace vxgi
 			glEnable(GL_BLEND);
 			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-			GLuint shader_id = shader::activate(get_renderer().shaders.model);
+			shader::activate(get_renderer().shaders.model);
 
-			upload_camera(shader_id, camera);
-			draw_models_with_materials(shader_id, scene);
+			upload_camera(camera);
+			draw_models(get_renderer().shaders.model, scene, camera.position, DRAW_MATERIAL_ALL);
 
 			shader::deactivate();
 		}
 
 		void render_scene_to_gbuffer(Scene& scene, Camera& camera, GLuint mainFboId, G_Buffer& gb)
 		{
-			GLuint shader_id = shader::activate(get_renderer().shaders.gbuffer);
+			CPU_ZONE("g-buffer");
+			Renderer& renderer = get_renderer();
+			bool is_multi_draw = multidraw::is_active(renderer.multi_draw);
+
+			Frustum_Culling& culling = renderer.culling;
+			double cull_start_time = glfwGetTime();
+			Frustum frustum = frustum::from_matrix(camera.VP);
+			culling.camera_drawn = frustumculling::cull(culling, &frustum, 1, culling.camera_visible);
+			culling.camera_ms = 1000.0 * (glfwGetTime() - cull_start_time);
+			culling.camera_drawn = occlusionculling::cull(renderer.occlusion, camera.VP, culling.camera_visible); // of what's left
+
+			bool is_meshlet_culling = is_multi_draw && renderer.meshlets.is_enabled; // the ranges are indirect commands
+			if (is_meshlet_culling)
+				meshletculling::cull(renderer.meshlets, frustum, camera.position, culling.camera_visible.data);
+
+			shader::activate(is_multi_draw ? renderer.shaders.gbuffer_multi_draw : renderer.shaders.gbuffer);
 			gbuffer::activate(gb);
 
-			upload_camera(shader_id, camera);
-			draw_models_with_materials(shader_id, scene);
+			upload_camera(camera);
+			if (is_meshlet_culling)
+				multidraw::draw_meshlets(renderer.multi_draw, renderer.meshlets);
+			else if (is_multi_draw)
+				multidraw::draw(renderer.multi_draw, culling.camera_visible.data);
+			else
+				draw_models(renderer.shaders.gbuffer, scene, camera.position, DRAW_MATERIAL_ALL, 0, culling.camera_visible.data); // front to back within a material
 
 			gbuffer::deactivate(gb);
 			shader::deactivate();
@@ -254,13 +559,21 @@ namespace vxgi
 			glBindFramebuffer(GL_FRAMEBUFFER, mainFboId);
 		}
 
-		void voxelize_scene(Scene& scene, GLuint mainFboId, Texture3D& voxel_grid, Voxelization& voxelization_state, Voxelization_Settings& voxelization_settings)
+		void voxelize_scene(Scene& scene, GLuint mainFboId, Texture3D& voxel_grid)
 		{
+			CPU_ZONE("voxelization");
 			LOG("renderer", "voxelizing scene");
+			Gpu_Profiler& profiler = get_renderer().gpu_profiler;
+			gpuprofiler::begin(profiler, "voxelization");
 
+			gpuprofiler::begin(profiler, "clear");
 			texture3D::clear(voxel_grid, { 0.0f, 0.0f, 0.0f, 0.0f });
+			gpuprofiler::end(profiler);
 
-			GLuint shader_id = shader::activate(get_renderer().shaders.voxelization);
+			Multi_Draw& multi_draw = get_renderer().multi_draw;
+			bool is_multi_draw = multidraw::is_active(multi_draw);
+
+			GLuint shader_id = shader::activate(is_multi_draw ? get_renderer().shaders.voxelization_multi_draw : get_renderer().shaders.voxelization);
 			{
 				glBindFramebuffer(GL_FRAMEBUFFER, 0);
 				glViewport(0, 0, voxel_grid.dimensions, voxel_grid.dimensions);
@@ -269,26 +582,41 @@ namespace vxgi
 				glDisable(GL_DEPTH_TEST);
 				glDisable(GL_BLEND);
 
-				vct::upload_voxelization_settings(shader_id, voxelization_settings);
 				upload_voxel_scale(shader_id, scene, voxel_grid.dimensions);
-				upload_camera(shader_id, voxelization_state.camera);
-				upload_lights(shader_id, scene.lights);
 
-				texture3D::activate(voxel_grid, shader_id, "u_tex_voxelgrid");
+				texture3D::activate(voxel_grid, shader_id, SHADER_UNIFORM_TEX_VOXELGRID);
 				glBindImageTexture(0, voxel_grid.id, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA8);
 				upload_shadowmap(shader_id, scene.lights, 1);
-
-				draw_models_with_albedo(shader_id, scene, 2);
+				lightclusters::bind(get_renderer().light_clusters); // only the lights, every voxel goes through all of them
+
+				// voxel_scale maps the scene to -1...1
+				Mesh_Lods& lods = get_renderer().lods;
+				float voxel_size = 2.0f / (float(voxel_grid.dimensions) * glm::max(scene.voxel_scale.x, glm::max(scene.voxel_scale.y, scene.voxel_scale.z)));
+				meshlod::select_for_voxelization(lods, scene, voxel_size);
+
+				gpuprofiler::begin(profiler, "draw");
+				if (is_multi_draw)
+					multidraw::draw(multi_draw, NULL, lods.voxelization_lods.data);
+				else
+					draw_models(get_renderer().shaders.voxelization, scene, get_camera().position, DRAW_MATERIAL_ALBEDO, 2, NULL, lods.voxelization_lods.data);
+				gpuprofiler::end(profiler);
 			}
 			shader::deactivate();
 
+			gpuprofiler::begin(profiler, "mipmaps");
 			texture3D::generate_mipmaps(voxel_grid);
+			gpuprofiler::end(profiler);
+
+			gpuprofiler::begin(profiler, "empty space");
+			vct::build_empty_space(get_renderer().empty_space, get_renderer().shaders.emptyspace, voxel_grid);
+			gpuprofiler::end(profiler);
 
 			glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
 			glBindFramebuffer(GL_FRAMEBUFFER, mainFboId);
+			gpuprofiler::end(profiler); // voxelization
 		}
 
-		void render_voxelized_scene(Scene& scene, Camera& camera, GLuint mainFboId, Texture3D& voxel_grid, Voxelization& voxelization_state, Voxelization_Settings& voxelization_settings)
+		void render_voxelized_scene(Scene& scene, Camera& camera, GLuint mainFboId, Texture3D& voxel_grid, Voxelization& voxelization_state)
 		{
 			// render FBOs
 			{
@@ -298,7 +626,7 @@ namespace vxgi
 				glEnable(GL_CULL_FACE);
 				glEnable(GL_DEPTH_TEST);
 
-				upload_camera(shader_id, camera);
+				upload_camera(camera);
 
 				// render back of cube
 				{
@@ -333,12 +661,11 @@ namespace vxgi
 				glDisable(GL_DEPTH_TEST);
 				glEnable(GL_CULL_FACE);
 
-				vct::upload_voxelization_settings(shader_id, voxelization_settings);
-				upload_camera(shader_id, camera);
+				upload_camera(camera);
 
-				texture3D::activate(voxel_grid, shader_id, "u_tex_voxelgrid", 0);
-				framebuffer::activate_color_as_texture(voxelization_state.vox_back, shader_id, "u_tex_cube_back", 1);
-				framebuffer::activate_color_as_texture(voxelization_state.vox_front, shader_id, "u_tex_cube_front", 2);
+				texture3D::activate(voxel_grid, shader_id, SHADER_UNIFORM_TEX_VOXELGRID, 0);
+				framebuffer::activate_color_as_texture(voxelization_state.vox_back, shader_id, SHADER_UNIFORM_TEX_CUBE_BACK, 1);
+				framebuffer::activate_color_as_texture(voxelization_state.vox_front, shader_id, SHADER_UNIFORM_TEX_CUBE_FRONT, 2);
 				draw_simple_mesh(shader_id, assets::get_unit_quad());
 				texture3D::deactivate();
 
@@ -346,32 +673,89 @@ namespace vxgi
 			}
 		}
 
-		void render_shadowmaps(Scene& scene, GLuint mainFboId)
+		void render_shadowmaps(Scene& scene, Camera& camera, GLuint mainFboId)
 		{
+			CPU_ZONE("shadow maps");
 			check_gl_error();
 			glEnable(GL_DEPTH_TEST);
 
-			GLuint shader_id = shader::activate(get_renderer().shaders.shadowmap);
+			Multi_Draw& multi_draw = get_renderer().multi_draw;
+			bool is_multi_draw = multidraw::is_active(multi_draw);
 
-			for (Directional_Light& light : scene.lights.directional_lights)
+			GLuint shader_id = shader::activate(is_multi_draw ? get_renderer().shaders.shadowmap_multi_draw : get_renderer().shaders.shadowmap);
+
+			vec3 scene_min, scene_max;
+			get_scene_bounds(scene, scene_min, scene_max);
+
+			Scene_Lights& lights = scene.lights;
+			bool is_dirty = false;
+			for (Directional_Light& light : lights.directional_lights)
 			{
-				if (light.is_dirty)
-				{
-					light.is_dirty = false;
+				// the cascades move in whole texels, most camera movements don't change them
+				if (shadowmap::fit_cascades(light.shadow_map, light.direction, camera, scene_min, scene_max))
+					light.is_dirty = true;
 
-					glUniformMatrix4fv(glGetUniformLocation(shader_id, "VP_shadow"), 1, GL_FALSE, glm::value_ptr(light.shadow_map.VP));
+				is_dirty |= light.is_dirty;
+				light.is_dirty = false;
+			}
+
+			if (is_dirty)
+			{
+				// every layer of every light in one pass, see shadowmap_geom.glsl. each light draws into its own viewport
+				mat4 layer_VP[MAX_SHADOW_ATLAS_LAYERS];
+				int  layer_light[MAX_SHADOW_ATLAS_LAYERS] = {};
+				int  layer_resolution[MAX_SHADOW_ATLAS_LAYERS] = {};
 
-					shadowmap::fbo_activate(light.shadow_map);
-					draw_models_without_materials(shader_id, scene);
-					shadowmap::fbo_deactivate(light.shadow_map);
+				int light_index = 0;
+				for (Directional_Light& light : lights.directional_lights)
+				{
+					Shadow_Map& shadow_map = light.shadow_map;
+					for (int i = 0; i < shadow_map.total_layers; i++) {
+						layer_VP[shadow_map.first_layer + i] = shadow_map.layer_VP[i];
+						layer_light[shadow_map.first_layer + i] = light_index;
+						layer_resolution[shadow_map.first_layer + i] = shadow_map.config.resolution;
+					}
+					glViewportIndexedf(light_index, 0.0f, 0.0f, float(shadow_map.config.resolution), float(shadow_map.config.resolution));
+					light_index++;
 				}
+
+				Frustum_Culling& culling = get_renderer().culling;
+				double cull_start_time = glfwGetTime();
+				Frustum frustums[MAX_SHADOW_ATLAS_LAYERS];
+				for (int i = 0; i < lights.shadow_atlas.total_layers; i++)
+					frustums[i] = frustum::from_matrix(layer_VP[i]);
+				culling.shadow_drawn = frustumculling::cull(culling, frustums, lights.shadow_atlas.total_layers, culling.shadow_visible);
+				culling.shadow_ms = 1000.0 * (glfwGetTime() - cull_start_time);
+
+				Mesh_Lods& lods = get_renderer().lods;
+				meshlod::select_for_shadow_maps(lods, scene, layer_VP, layer_resolution, lights.shadow_atlas.total_layers);
+
+				Shadow_Atlas& atlas = lights.shadow_atlas;
+				glUniformMatrix4fv(shader::uniform_location(shader_id, SHADER_UNIFORM_VP_SHADOW), atlas.total_layers, GL_FALSE, glm::value_ptr(layer_VP[0]));
+				glUniform1iv(shader::uniform_location(shader_id, SHADER_UNIFORM_SHADOWMAP_LAYER_LIGHT), atlas.total_layers, layer_light);
+				glUniform1i(shader::uniform_location(shader_id, SHADER_UNIFORM_TOTAL_SHADOWMAP_LAYERS), atlas.total_layers);
+
+				shadowatlas::fbo_activate(atlas);
+				if (is_multi_draw)
+					multidraw::draw(multi_draw, culling.shadow_visible.data, lods.shadow_lods.data);
+				else
+					draw_models(get_renderer().shaders.shadowmap, scene, camera.position, DRAW_MATERIAL_NONE, 0, culling.shadow_visible.data, lods.shadow_lods.data);
+				shadowatlas::fbo_deactivate();
 			}
 
 			shader::deactivate();
 			glBindFramebuffer(GL_FRAMEBUFFER, mainFboId);
 		}
 
-		void render_shadowmap_to_screen(Shadow_Map& shadow_map, GLuint mainFboId)
+		void build_light_clusters(Scene& scene, Camera& camera, Light_Clusters& clusters)
+		{
+			CPU_ZONE("light clusters");
+			vec3 scene_min, scene_max;
+			get_scene_bounds(scene, scene_min, scene_max);
+			lightclusters::build(clusters, scene.lights, camera, scene_min, scene_max);
+		}
+
+		void render_shadowmap_to_screen(Shadow_Atlas& atlas, GLuint mainFboId)
 		{
 			GLuint shader_id = shader::activate(get_renderer().shaders.shadowmap_visualizer);
 
@@ -379,106 +763,355 @@ namespace vxgi
 			glViewport(0, 0, application::resolution_get().internal.x, application::resolution_get().internal.y);
 			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-			glUniform1i(glGetUniformLocation(shader_id, "u_tex_shadowmap"), 0);
+			glUniform1i(shader::uniform_location(shader_id, SHADER_UNIFORM_TEX_SHADOWMAP), 0);
+			glUniform1i(shader::uniform_location(shader_id, SHADER_UNIFORM_TOTAL_SHADOWMAP_LAYERS), atlas.total_layers);
 			glActiveTexture(GL_TEXTURE0);
-			glBindTexture(GL_TEXTURE_2D, shadow_map.depth_texture_id);
+			glBindTexture(GL_TEXTURE_2D_ARRAY, atlas.depth_texture_id);
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_NONE); // plain depth values, sampler2DArray
 
 			draw_simple_mesh(shader_id, assets::get_unit_quad());
 
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_R_TO_TEXTURE);
+
 			shader::deactivate();
 		}
 
-		void render_scene_with_voxel_cone_tracing(Scene& scene, Camera& camera, GLuint mainFboId, G_Buffer& gbuf, Texture3D& voxel_grid)
+		void render_gbuffer_to_screen(G_Buffer& gbuf, GLuint mainFboId)
 		{
-			glBindFramebuffer(GL_FRAMEBUFFER, mainFboId);
+			const int TOTAL_VIEWS = 5; // world position, normal, bump, albedo, specular, see gbuffer_visualizer_frag.glsl
+			const int padding = 2;
+
+			GLuint shader_id = shader::activate(get_renderer().shaders.gbuffer_visualizer);
+			gbuffer::bind_as_textures(gbuf, mainFboId, shader_id);
+
+			glDisable(GL_DEPTH_TEST);
+			glDisable(GL_CULL_FACE);
+
+			// a strip along the bottom of the screen
+			Application_Resolution& resolution = application::resolution_get();
+			int view_w = int(resolution.internal.x) / TOTAL_VIEWS;
+			int view_h = int(float(view_w) / resolution.internalAspectRatio);
+
+			for (int i = 0; i < TOTAL_VIEWS; i++) {
+				glViewport((view_w + padding) * i, 0, view_w, view_h);
+				glUniform1i(shader::uniform_location(shader_id, SHADER_UNIFORM_GBUFFER_VIEW), i);
+				draw_simple_mesh(shader_id, assets::get_unit_quad());
+			}
+
+			glViewport(0, 0, resolution.internal.x, resolution.internal.y);
+			shader::deactivate();
+		}
+
+		void classify_tiles(Scene& scene, GLuint mainFboId, G_Buffer& gbuf, Tile_Classification& tiles)
+		{
+			vct::reset_tiles(tiles, assets::get_unit_quad().vao_size);
+
+			GLuint shader_id = shader::activate(get_renderer().shaders.tileclassification);
+			{
+				vct::upload_tile_settings(shader_id, tiles, gbuf.width, gbuf.height);
+				gbuffer::bind_as_textures(gbuf, mainFboId, shader_id, 0);
+
+				glDispatchCompute(tiles.tiles_x, tiles.tiles_y, 1);
+				glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT); // tile lists + indirect draw commands
+			}
+			shader::deactivate();
+
+			if (tiles.show_stats)
+				vct::read_tile_stats(tiles);
+		}
+
+		void render_scene_with_voxel_cone_tracing(Scene& scene, Camera& camera, GLuint mainFboId, G_Buffer& gbuf, Texture3D& voxel_grid, Cone_Tracing_History& history, Tile_Classification& tiles, Empty_Space_Field& empty_space, Cone_Step_Counters& step_counters, Compute_Cone_Tracing& compute)
+		{
+			CPU_ZONE("cone tracing");
+			// with temporal accumulation on, render into the history fbo which shares the main color texture
+			// and additionally writes this frame's indirect diffuse + geometry for the next frame
+			Temporal_Settings& temporal = scene.vct_settings.temporal_settings;
+			GLuint target_fbo = temporal.is_enabled ? history.fbos[history.current] : mainFboId;
+
+			glBindFramebuffer(GL_FRAMEBUFFER, target_fbo);
+
+			u32 feature_mask = vct::get_feature_mask(scene.vct_settings, empty_space, step_counters);
+			bool is_tiled = uses_tile_classification(scene);
+			if (is_tiled)
+			{
+				// background isn't drawn, match what the full screen pass outputs there (no albedo = black)
+				static const GLfloat black[] = { 0.0f, 0.0f, 0.0f, 1.0f };
+				glClearBufferfv(GL_COLOR, 0, black);
+
+				// skipped tiles would otherwise keep geometry from older frames and pass the history rejection
+				static const GLfloat no_geometry[] = { 0.0f, 0.0f, 0.0f, 0.0f };
+				if (temporal.is_enabled)
+					glClearBufferfv(GL_COLOR, 1 + Cone_Tracing_History::GEOMETRY, no_geometry);
+			}
+
 			glViewport(0, 0, application::resolution_get().internal.x, application::resolution_get().internal.y);
 			glEnable(GL_DEPTH_TEST);
 			glEnable(GL_CULL_FACE);
 			glCullFace(GL_BACK);
 			glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
 
-			GLuint shader_id = shader::activate(get_renderer().shaders.voxelconetracing);
-			{
-				vct::upload_cone_tracing_settings(shader_id, scene.vct_settings, voxel_grid.dimensions); // voxel_cone_tracing.h
-				upload_camera(shader_id, camera);
+			// the variant without the disabled features, compiled the first time a combination is used
+			auto activate = [&](Shader_Permutations& permutations, u32 mask) -> GLuint {
+				GLuint shader_id = shader::activate(shader::get_permutation(permutations, mask));
+				upload_camera(camera);
 				upload_voxel_scale(shader_id, scene, voxel_grid.dimensions);
-				upload_lights(shader_id, scene.lights);
 
-				texture3D::activate(voxel_grid, shader_id, "u_tex_voxelgrid", 0);
+				texture3D::activate(voxel_grid, shader_id, SHADER_UNIFORM_TEX_VOXELGRID, 0);
 				upload_shadowmap(shader_id, scene.lights, 1);
-				gbuffer::bind_as_textures(gbuf, mainFboId, shader_id, 2);
+				lightclusters::bind(get_renderer().light_clusters);
+				gbuffer::bind_as_textures(gbuf, target_fbo, shader_id, 2);
+				vct::upload_temporal_settings(shader_id, temporal, history, DIFFUSE_CONE_SETS[scene.vct_settings.diffuse_cone_set].total_cones, 2 + G_Buffer::TOTAL_GBUFFER_TEXTURES + 1); // after gbuffer color + depth
+				if (empty_space.is_enabled)
+					vct::upload_empty_space(shader_id, empty_space, 2 + G_Buffer::TOTAL_GBUFFER_TEXTURES + 1 + Cone_Tracing_History::TOTAL_HISTORY_TEXTURES); // after the history
+				glUniform1i(shader::uniform_location(shader_id, SHADER_UNIFORM_IS_TILED), is_tiled);
+				return shader_id;
+			};
+
+			if (step_counters.is_enabled)
+				vct::reset_step_counters(step_counters);
+
+			Renderer_Shaders& shaders = get_renderer().shaders;
+			if (compute.is_enabled) {
+				GLuint shader_id = activate(shaders.voxelconetracing_compute, feature_mask);
+				vct::upload_compute_settings(shader_id, compute);
+				vct::dispatch_compute(get_renderer().main_fbo.color_texture_id, history, temporal.is_enabled, gbuf.width, gbuf.height);
+			} else if (is_tiled) {
+				// a draw per class with its own variant, only the features its tiles need are compiled in
+				for (int i = 0; i < Tile_Classification::TOTAL_TILE_CLASSES; i++) {
+					GLuint shader_id = activate(shaders.voxelconetracing_tiled, vct::get_tile_class_mask(feature_mask, i));
+					vct::upload_tile_settings(shader_id, tiles, gbuf.width, gbuf.height);
+					vct::draw_tiles(shader_id, tiles, assets::get_unit_quad(), i);
+				}
+			} else {
+				GLuint shader_id = activate(shaders.voxelconetracing, feature_mask);
 				draw_simple_mesh(shader_id, assets::get_unit_quad());
-				texture3D::deactivate();
 			}
+			texture3D::deactivate();
 			shader::deactivate();
 
+			if (step_counters.is_enabled)
+				vct::read_step_counters(step_counters);
+
+			if (temporal.is_enabled)
+				vct::advance_history(history, camera);
+			else
+				history.is_valid = false;
+
+			glBindFramebuffer(GL_FRAMEBUFFER, mainFboId);
+
 			glDisable(GL_DEPTH_TEST);
 			glDisable(GL_CULL_FACE);
 		}
 
-		void upload_camera(GLuint shader_id, Camera& camera)
+		void dump_cone_tracing_inputs(Scene& scene, Camera& camera, G_Buffer& gbuf, Texture3D& voxel_grid, GLuint color_texture_id)
 		{
-			glUniformMatrix4fv(glGetUniformLocation(shader_id, "VP"), 1, GL_FALSE, glm::value_ptr(camera.VP));
-			glUniform3fv(glGetUniformLocation(shader_id, "u_camera_world_position"), 1, glm::value_ptr(camera.position));
+			int w = gbuf.width;
+			int h = gbuf.height;
+
+			G_Buffer_Dump g_dump;
+			cpu_vct::init(g_dump, w, h);
+			defer { cpu_vct::uninit(g_dump); };
+
+			g_dump.voxel_scale = scene.voxel_scale;
+			g_dump.camera_position = camera.position;
+			vct::pack_cone_tracing_settings(g_dump.settings, scene.vct_settings, voxel_grid.dimensions);
+			pack_lights(g_dump.lights, scene.lights);
+			if (array::size(scene.lights.point_lights) + array::size(scene.lights.spot_lights) > 0)
+				LOG("renderer", "point and spot lights aren't part of the dump, the cpu reference renders without them");
+
+			glGetTextureImage(gbuf.depthTexture.id, 0, GL_DEPTH_COMPONENT, GL_FLOAT, sizeof(float) * w * h, g_dump.depth);
+
+			// decoded to what the cone tracing pass sees, the dump keeps the unpacked layout
+			{
+				u16* normals = new u16[4 * w * h];
+				u8* albedo = new u8[4 * w * h];
+				u8* specular = new u8[4 * w * h];
+				defer { delete[] normals; delete[] albedo; delete[] specular; };
+
+				glGetTextureImage(gbuf.textures[G_Buffer::NORMAL].id, 0, GL_RGBA, GL_UNSIGNED_SHORT, sizeof(u16) * 4 * w * h, normals);
+				glGetTextureImage(gbuf.textures[G_Buffer::ALBEDO].id, 0, GL_RGBA, GL_UNSIGNED_BYTE, 4 * w * h, albedo);
+				glGetTextureImage(gbuf.textures[G_Buffer::SPECULAR].id, 0, GL_RGBA, GL_UNSIGNED_BYTE, 4 * w * h, specular);
+
+				mat4 inverse_VP = glm::inverse(camera.VP);
+				for (int y = 0; y < h; y++) {
+					for (int x = 0; x < w; x++) {
+						int i = x + y * w;
+						vec2 tex_coords = (vec2(x, y) + 0.5f) / vec2(w, h);
+						vec4 world_pos = inverse_VP * vec4(vec3(tex_coords, g_dump.depth[i]) * 2.0f - 1.0f, 1.0f);
+						const u16* n = normals + 4 * i;
+						const u8* a = albedo + 4 * i;
+						const u8* s = specular + 4 * i;
+
+						g_dump.textures[G_Buffer_Dump::POSITION][i] = vec4(vec3(world_pos) / world_pos.w, 1.0f);
+						g_dump.textures[G_Buffer_Dump::NORMAL][i] = vec4(decode_octahedral(n[0] / 65535.0f, n[1] / 65535.0f), 1.0f);
+						g_dump.textures[G_Buffer_Dump::BUMP][i] = vec4(decode_octahedral(n[2] / 65535.0f, n[3] / 65535.0f), 1.0f);
+						g_dump.textures[G_Buffer_Dump::ALBEDO][i] = vec4(srgb_to_linear(a[0]), srgb_to_linear(a[1]), srgb_to_linear(a[2]), a[3] / 255.0f * G_Buffer::ALBEDO_ALPHA_SCALE);
+						g_dump.textures[G_Buffer_Dump::SPECULAR][i] = vec4(s[0] / 255.0f, s[1] / 255.0f, s[2] / 255.0f, decode_shininess(s[3] / 255.0f));
+					}
+				}
+			}
+
+			GLint total_levels = 0;
+			glGetTextureParameteriv(voxel_grid.id, GL_TEXTURE_IMMUTABLE_LEVELS, &total_levels);
+
+			Voxel_Grid_Dump voxel_dump;
+			cpu_vct::init(voxel_dump, voxel_grid.dimensions, total_levels);
+			defer { cpu_vct::uninit(voxel_dump); };
+
+			for (int level = 0; level < total_levels; level++) {
+				int dim = voxel_grid.dimensions >> level;
+				glGetTextureImage(voxel_grid.id, level, GL_RGBA, GL_UNSIGNED_BYTE, sizeof(u32) * dim * dim * dim, voxel_dump.texels + voxel_dump.level_offsets[level]);
+			}
+
+			// what the gpu rendered, to compare against
+			u8* image = new u8[4 * w * h];
+			defer { delete[] image; };
+			glGetTextureImage(color_texture_id, 0, GL_RGBA, GL_UNSIGNED_BYTE, 4 * w * h, image);
+			check_gl_error();
+
+			bool ok = cpu_vct::save(g_dump, CPU_REFERENCE_GBUFFER_PATH)
+				&& cpu_vct::save(voxel_dump, CPU_REFERENCE_VOXELS_PATH)
+				&& cpu_vct::write_ppm(CPU_REFERENCE_GPU_IMAGE_PATH, w, h, image);
+
+			if (ok)
+				LOG("renderer", "dumped cone tracing inputs to %s + %s, gpu result to %s", CPU_REFERENCE_GBUFFER_PATH, CPU_REFERENCE_VOXELS_PATH, CPU_REFERENCE_GPU_IMAGE_PATH);
+		}
+
+		void upload_uniform_buffers(Scene& scene)
+		{
+			CPU_ZONE("upload uniform buffers");
+			Renderer& renderer = get_renderer();
+			Renderer_Uniform_Buffers& ubos = renderer.uniform_buffers;
+
+			// only re-uploaded when something changed, the ui sets the dirty flags
+			upload_camera(renderer.fps_camera);
+			upload_lights(scene.lights);
+
+			if (scene.vct_settings.is_dirty) {
+				scene.vct_settings.is_dirty = false;
+				vct::upload_cone_tracing_settings(ubos.cone_tracing, scene.vct_settings, get_current_voxelgrid_resolution()); // voxel_cone_tracing.h
+			}
+
+			if (renderer.voxelization_settings.is_dirty) {
+				renderer.voxelization_settings.is_dirty = false;
+				vct::upload_voxelization_settings(ubos.voxelization, renderer.voxelization_settings);
+			}
+		}
+
+		void upload_camera(Camera& camera)
+		{
+			CPU_ZONE("upload camera");
+			Renderer_Uniform_Buffers& ubos = get_renderer().uniform_buffers;
+
+			Camera_Std140 block = {};
+			block.VP = camera.VP;
+			block.position = camera.position;
+			block.inverse_VP = glm::inverse(camera.VP);
+
+			if (memcmp(&block, &ubos.uploaded_camera, sizeof(block)) != 0) {
+				ubos.uploaded_camera = block;
+				uniformbuffer::upload(ubos.camera, &block, sizeof(block));
+			}
 		}
 
 		void upload_material(GLuint shader_id, Material& material, int texture_location_offset)
 		{
+			CPU_ZONE("upload material");
 			using glm::value_ptr;
 			
-			glUniform3fv(glGetUniformLocation(shader_id, "u_material.Ka"), 1, value_ptr(material.Ka));
-			glUniform3fv(glGetUniformLocation(shader_id, "u_material.Kd"), 1, value_ptr(material.Kd));
-			glUniform3fv(glGetUniformLocation(shader_id, "u_material.Ks"), 1, value_ptr(material.Ks));
-			glUniform1f(glGetUniformLocation(shader_id, "u_material.Ns"), material.Ns);
-			glUniform3fv(glGetUniformLocation(shader_id, "u_material.Ke"), 1, value_ptr(material.Ke));
-			glUniform1f(glGetUniformLocation(shader_id, "u_material.d"), material.d);
-			glUniform1f(glGetUniformLocation(shader_id, "u_material.Ni"), material.Ni);
-			glUniform3fv(glGetUniformLocation(shader_id, "u_material.Tf"), 1, value_ptr(material.Tf));
+			glUniform3fv(shader::uniform_location(shader_id, SHADER_UNIFORM_MATERIAL_KA), 1, value_ptr(material.Ka));
+			glUniform3fv(shader::uniform_location(shader_id, SHADER_UNIFORM_MATERIAL_KD), 1, value_ptr(material.Kd));
+			glUniform3fv(shader::uniform_location(shader_id, SHADER_UNIFORM_MATERIAL_KS), 1, value_ptr(material.Ks));
+			glUniform1f(shader::uniform_location(shader_id, SHADER_UNIFORM_MATERIAL_NS), material.Ns);
+			glUniform3fv(shader::uniform_location(shader_id, SHADER_UNIFORM_MATERIAL_KE), 1, value_ptr(material.Ke));
+			glUniform1f(shader::uniform_location(shader_id, SHADER_UNIFORM_MATERIAL_D), material.d);
+			glUniform1f(shader::uniform_location(shader_id, SHADER_UNIFORM_MATERIAL_NI), material.Ni);
+			glUniform3fv(shader::uniform_location(shader_id, SHADER_UNIFORM_MATERIAL_TF), 1, value_ptr(material.Tf));
+
+			texture::activate(*material.map_Ka,   shader_id, SHADER_UNIFORM_TEX_AMBIENT, texture_location_offset + 0);
+			texture::activate(*material.map_Kd,   shader_id, SHADER_UNIFORM_TEX_DIFFUSE, texture_location_offset + 1);
+			texture::activate(*material.map_Ks,   shader_id, SHADER_UNIFORM_TEX_SPECULAR, texture_location_offset + 2);
+			texture::activate(*material.map_Ke,   shader_id, SHADER_UNIFORM_TEX_EMISSION, texture_location_offset + 3);
+			texture::activate(*material.map_bump, shader_id, SHADER_UNIFORM_TEX_BUMPMAP, texture_location_offset + 4);
+		}
+
+		void upload_lights(Scene_Lights& lights)
+		{
+			CPU_ZONE("upload lights");
+			if (!lights.is_dirty)
+				return;
+			lights.is_dirty = false;
 
-			texture::activate(*material.map_Ka,   shader_id, "u_tex_ambient", texture_location_offset + 0);
-			texture::activate(*material.map_Kd,   shader_id, "u_tex_diffuse", texture_location_offset + 1);
-			texture::activate(*material.map_Ks,   shader_id, "u_tex_specular", texture_location_offset + 2);
-			texture::activate(*material.map_Ke,   shader_id, "u_tex_emission", texture_location_offset + 3);
-			texture::activate(*material.map_bump, shader_id, "u_tex_bumpmap", texture_location_offset + 4);
+			Scene_Lights_Std140 block = {};
+			pack_lights(block, lights);
+
+			uniformbuffer::upload(get_renderer().uniform_buffers.lights, &block, sizeof(block));
+			lightclusters::upload_lights(get_renderer().light_clusters, lights);
 		}
 
-		void upload_lights(GLuint shader_id, Scene_Lights& lights)
+		void pack_lights(Scene_Lights_Std140& block, Scene_Lights& lights)
 		{
-			glUniform3fv(glGetUniformLocation(shader_id, "u_ambient_light"), 1, glm::value_ptr(lights.ambient_light));
+			ASSERT(array::size(lights.directional_lights) <= MAX_DIRECTIONAL_LIGHTS, "renderer", "too many directional lights (%d)", int(array::size(lights.directional_lights)));
 
-			{
-				glUniform1i(glGetUniformLocation(shader_id, "u_total_directional_lights"), array::size(lights.directional_lights));
+			block.ambient_light = lights.ambient_light;
+			block.total_directional_lights = array::size(lights.directional_lights);
 
-				int index = 0;
-				for (Directional_Light& p : lights.directional_lights)
-				{
-					// @Todo @Speed @Cleanup string allocations
-					glUniform1f(glGetUniformLocation(shader_id,  ("u_directional_lights[" + std::to_string(index) + "].strength").c_str()), p.strength);
-					glUniform3fv(glGetUniformLocation(shader_id, ("u_directional_lights[" + std::to_string(index) + "].direction").c_str()), 1, glm::value_ptr(p.direction));
-					glUniform3fv(glGetUniformLocation(shader_id, ("u_directional_lights[" + std::to_string(index) + "].attenuation").c_str()), 1, glm::value_ptr(p.attenuation));
-					glUniform3fv(glGetUniformLocation(shader_id, ("u_directional_lights[" + std::to_string(index) + "].color").c_str()), 1, glm::value_ptr(p.color));
-					index++;
-				}
+			int index = 0;
+			for (Directional_Light& p : lights.directional_lights)
+			{
+				Directional_Light_Std140& out = block.directional_lights[index++];
+				out.strength = p.strength;
+				out.direction = p.direction;
+				out.attenuation = p.attenuation;
+				out.color = p.color;
 			}
 		}
 
-		void upload_shadowmap(GLuint shader_id, Scene_Lights& lights, int texture_location_offset) // @Note: only 1 supported atm
+		void upload_shadowmap(GLuint shader_id, Scene_Lights& lights, int texture_location_offset)
 		{
-			if (array::size(lights.directional_lights) > 0) {
-				Directional_Light& light = lights.directional_lights[0];
-				glUniformMatrix4fv(glGetUniformLocation(shader_id, "u_shadowmap_mvp"), 1, GL_FALSE, glm::value_ptr(light.shadow_map.VP_biased));
-				shadowmap::texture_activate(light.shadow_map, shader_id, "u_tex_shadowmap", texture_location_offset);
-			} else {
-				// no shadowmap -- throw in a white texture instead so everything will be visible.
-				static mat4 identity_matrix = mat4(1.0f);
-				glUniformMatrix4fv(glGetUniformLocation(shader_id, "u_shadowmap_mvp"), 1, GL_FALSE, glm::value_ptr(identity_matrix));
-				texture::activate(assets::get_white_texture(), shader_id, "u_tex_shadowmap", texture_location_offset);
+			CPU_ZONE("upload shadow map");
+			if (!lights.shadow_atlas.is_created) {
+				// no shadowmap -- no layers to sample, everything will be visible. something still has to be bound to the unit
+				ivec2 light_layers[MAX_DIRECTIONAL_LIGHTS] = {};
+				glUniform2iv(shader::uniform_location(shader_id, SHADER_UNIFORM_SHADOWMAP_LIGHT_LAYERS), MAX_DIRECTIONAL_LIGHTS, glm::value_ptr(light_layers[0]));
+				texture::activate(assets::get_white_texture(), shader_id, SHADER_UNIFORM_TEX_SHADOWMAP, texture_location_offset);
+				return;
 			}
+
+			Shadow_Atlas& atlas = lights.shadow_atlas;
+			mat4  layer_VP_biased[MAX_SHADOW_ATLAS_LAYERS];
+			ivec2 light_layers[MAX_DIRECTIONAL_LIGHTS] = {}; // first layer, total layers
+			float atlas_scale[MAX_DIRECTIONAL_LIGHTS] = {};
+
+			int light_index = 0;
+			for (Directional_Light& light : lights.directional_lights)
+			{
+				Shadow_Map& shadow_map = light.shadow_map;
+				for (int i = 0; i < shadow_map.total_layers; i++)
+					layer_VP_biased[shadow_map.first_layer + i] = shadow_map.layer_VP_biased[i];
+				light_layers[light_index] = ivec2(shadow_map.first_layer, shadow_map.total_layers);
+				atlas_scale[light_index] = float(shadow_map.config.resolution) / float(atlas.resolution);
+				light_index++;
+			}
+
+			glUniformMatrix4fv(shader::uniform_location(shader_id, SHADER_UNIFORM_SHADOWMAP_MVP), atlas.total_layers, GL_FALSE, glm::value_ptr(layer_VP_biased[0]));
+			glUniform2iv(shader::uniform_location(shader_id, SHADER_UNIFORM_SHADOWMAP_LIGHT_LAYERS), MAX_DIRECTIONAL_LIGHTS, glm::value_ptr(light_layers[0]));
+			glUniform1fv(shader::uniform_location(shader_id, SHADER_UNIFORM_SHADOWMAP_ATLAS_SCALE), MAX_DIRECTIONAL_LIGHTS, atlas_scale);
+			shadowatlas::texture_activate(atlas, shader_id, SHADER_UNIFORM_TEX_SHADOWMAP, texture_location_offset);
+		}
+
+		void get_scene_bounds(Scene& scene, vec3& scene_min, vec3& scene_max)
+		{
+			// the models are centered around the origin, see scene::init
+			Bounding_Box& bb = scene.bounding_box;
+			scene_min = bb.min_point - bb.center;
+			scene_max = bb.max_point - bb.center;
 		}
 
 		void upload_voxel_scale(GLuint shader_id, Scene& scene, int current_voxel_resolution)
 		{
-			glUniform3fv(glGetUniformLocation(shader_id, "u_scene_voxel_scale"), 1, glm::value_ptr(scene.voxel_scale));
+			CPU_ZONE("upload voxel scale");
+			glUniform3fv(shader::uniform_location(shader_id, SHADER_UNIFORM_SCENE_VOXEL_SCALE), 1, glm::value_ptr(scene.voxel_scale));
 		}
 
 		void draw_simple_mesh(GLuint shader_id, Mesh& mesh)
@@ -486,7 +1119,7 @@ namespace vxgi
 			glBindVertexArray(mesh.vao);
 
 			static mat4 im = mat4(1.0f);
-			glUniformMatrix4fv(glGetUniformLocation(shader_id, "M"), 1, GL_FALSE, glm::value_ptr(im));
+			glUniformMatrix4fv(shader::uniform_location(shader_id, SHADER_UNIFORM_M), 1, GL_FALSE, glm::value_ptr(im));
 
 			for (Sub_Mesh& sub_mesh : mesh.sub_meshes)
 				glDrawArrays(GL_TRIANGLES, sub_mesh.index, sub_mesh.length);
@@ -494,59 +1127,17 @@ namespace vxgi
 			glBindVertexArray(0);
 		}
 
-		void draw_models_with_materials(GLuint shader_id, Scene& scene, int texture_location_offset)
-		{
-			for (Model* model : scene.models) {
-				glUniformMatrix4fv(glGetUniformLocation(shader_id, "M"), 1, GL_FALSE, glm::value_ptr(model->transform.mtx));
-				glUniformMatrix4fv(glGetUniformLocation(shader_id, "N"), 1, GL_FALSE, glm::value_ptr(model->transform.normal_mtx));
-
-				for (Mesh* mesh : model->meshes) {
-					glBindVertexArray(mesh->vao);
-
-					for (Sub_Mesh& sub_mesh : mesh->sub_meshes) { // btw, usually n = 1 here, only a few models have more than 1 material per mesh.
-						upload_material(shader_id, assets::get_material(sub_mesh.material_index), texture_location_offset);
-						glDrawArrays(GL_TRIANGLES, sub_mesh.index, sub_mesh.length);
-					}
-				}
-			}
-		}
-
-		void draw_models_with_albedo(GLuint shader_id, Scene& scene, int texture_location_offset)
-		{
-			for (Model* model : scene.models) {
-				glUniformMatrix4fv(glGetUniformLocation(shader_id, "M"), 1, GL_FALSE, glm::value_ptr(model->transform.mtx));
-				glUniformMatrix4fv(glGetUniformLocation(shader_id, "N"), 1, GL_FALSE, glm::value_ptr(model->transform.normal_mtx));
-
-				for (Mesh* mesh : model->meshes) {
-					glBindVertexArray(mesh->vao);
-
-					for (Sub_Mesh& sub_mesh : mesh->sub_meshes) {
-						Material& material = assets::get_material(sub_mesh.material_index);
-						glUniform3fv(glGetUniformLocation(shader_id, "u_material.Ka"), 1, value_ptr(material.Ka));
-						glUniform3fv(glGetUniformLocation(shader_id, "u_material.Kd"), 1, value_ptr(material.Kd));
-						glUniform3fv(glGetUniformLocation(shader_id, "u_material.Ke"), 1, value_ptr(material.Ke));
-						texture::activate(*material.map_Ka, shader_id, "u_tex_ambient", texture_location_offset + 0);
-						texture::activate(*material.map_Kd, shader_id, "u_tex_diffuse", texture_location_offset + 1);
-						texture::activate(*material.map_Kd, shader_id, "u_tex_emission", texture_location_offset + 2);
-						glDrawArrays(GL_TRIANGLES, sub_mesh.index, sub_mesh.length);
-					}
-				}
-			}
-		}
-
-		void draw_models_without_materials(GLuint shader_id, Scene& scene)
+		void draw_models(Shader_Program& program, Scene& scene, vec3 view_position, DRAW_MATERIAL materials, int texture_location_offset, const u8* is_visible, const u8* lods)
 		{
-			for (Model* model : scene.models) {
-				glUniformMatrix4fv(glGetUniformLocation(shader_id, "M"), 1, GL_FALSE, glm::value_ptr(model->transform.mtx));
-				glUniformMatrix4fv(glGetUniformLocation(shader_id, "N"), 1, GL_FALSE, glm::value_ptr(model->transform.normal_mtx));
+			Renderer& renderer = get_renderer();
+			double start_time = glfwGetTime();
 
-				for (Mesh* mesh : model->meshes) {
-					glBindVertexArray(mesh->vao);
+			Render_Queue& queue = renderer.render_queue;
+			renderqueue::begin(queue, materials, texture_location_offset);
+			renderqueue::add_scene(queue, scene, program, view_position, is_visible, lods);
+			int draw_calls = renderqueue::submit(queue, program.id);
 
-					for (Sub_Mesh& sub_mesh : mesh->sub_meshes) // @Speed: store the length of the whole vertex buffer so no need to iterate here
-						glDrawArrays(GL_TRIANGLES, sub_mesh.index, sub_mesh.length);
-				}
-			}
+			multidraw::add_submit_stats(renderer.multi_draw, draw_calls, start_time);
 		}
 
 		void voxel_grid_resolution_changed(int new_resolution_index) {
@@ -555,6 +1146,7 @@ namespace vxgi
 			Renderer& r = get_renderer();
 			r.voxelization.current_resolution = new_resolution_index;
 			r.voxelize_next_frame = true;
+			scenes::get_current().vct_settings.is_dirty = true; // voxel size is in the cone tracing uniform buffer
 
 			LOG("renderer", "new voxel resolution: %d", VOXELGRID_RESOLUTIONS[new_resolution_index]);
 		}
@@ -5,6 +5,14 @@
 #include "camera.h"
 #include "opengl.h"
 #include "voxel_cone_tracing.h"
+#include "light_clusters.h"
+#include "multi_draw.h"
+#include "render_queue.h"
+#include "frustum_culling.h"
+#include "occlusion_culling.h"
+#include "meshlet_culling.h"
+#include "mesh_lod.h"
+#include "gpu_profiler.h"
 
 namespace vxgi
 {
@@ -15,14 +23,40 @@ namespace vxgi
 		RENDERER_MODE_SCENE_SHADOW_MAP
 	};
 
+	enum UNIFORM_BUFFER_BINDING : GLuint // layout(std140, binding = N) in the shaders
+	{
+		UNIFORM_BUFFER_BINDING_CAMERA       = 0,
+		UNIFORM_BUFFER_BINDING_LIGHTS       = 1,
+		UNIFORM_BUFFER_BINDING_CONE_TRACING = 2,
+		UNIFORM_BUFFER_BINDING_VOXELIZATION = 3
+	};
+
+	struct Renderer_Uniform_Buffers
+	{
+		Uniform_Buffer camera;
+		Uniform_Buffer lights;
+		Uniform_Buffer cone_tracing;
+		Uniform_Buffer voxelization;
+
+		Camera_Std140 uploaded_camera = {}; // camera changes are detected by comparing against the last upload
+	};
+
 	struct Renderer_Shaders
 	{
 		Shader_Program model;
 		Shader_Program world_pos;
 		Shader_Program gbuffer;
+		Shader_Program gbuffer_multi_draw; // the same programs with MULTI_DRAW defined, see multi_draw.h
+		Shader_Program shadowmap_multi_draw;
+		Shader_Program voxelization_multi_draw;
 		Shader_Program shadowmap;
 		Shader_Program shadowmap_visualizer;
-		Shader_Program voxelconetracing;
+		Shader_Program gbuffer_visualizer;
+		Shader_Permutations voxelconetracing; // by CONE_TRACING_FEATURE mask, see voxel_cone_tracing.h
+		Shader_Permutations voxelconetracing_tiled;
+		Shader_Permutations voxelconetracing_compute;
+		Shader_Program tileclassification;
+		Shader_Program emptyspace;
 		Shader_Program voxelization;
 		Shader_Program voxelization_visualizer;
 	};
@@ -33,44 +67,70 @@ namespace vxgi
 		Camera fps_camera;
 
 		Renderer_Shaders shaders;
+		Renderer_Uniform_Buffers uniform_buffers;
 
 		G_Buffer g_buffer;
 		Frame_Buffer main_fbo;
 		Voxelization voxelization; // see voxel_cone_tracing.h
 		Voxelization_Settings voxelization_settings;
+		Cone_Tracing_History cone_tracing_history; // see voxel_cone_tracing.h
+		Tile_Classification tile_classification; // see voxel_cone_tracing.h
+		Empty_Space_Field empty_space; // see voxel_cone_tracing.h
+		Cone_Step_Counters cone_step_counters;
+		Compute_Cone_Tracing compute_cone_tracing; // see voxel_cone_tracing.h
+		Light_Clusters light_clusters; // point and spot lights, see light_clusters.h
+		Multi_Draw multi_draw; // the scene passes as one indirect draw each, see multi_draw.h
+		Render_Queue render_queue; // the scene passes without multi draw, see render_queue.h
+		Frustum_Culling culling; // of the g-buffer and shadow map passes, see frustum_culling.h
+		Occlusion_Culling occlusion; // of the g-buffer pass after the frustum culling, see occlusion_culling.h
+		Meshlet_Culling meshlets; // of the g-buffer pass within the sub meshes that are left, see meshlet_culling.h
+		Mesh_Lods lods; // of the voxelization and shadow map passes, see mesh_lod.h
+		Gpu_Profiler gpu_profiler; // every pass of render, see gpu_profiler.h
 
 		bool visualize_gbuffers = false;
 		bool is_first_frame = true;
 		bool voxelize_next_frame = true;
 		bool render_light_bulbs = false;
+		bool dump_next_frame = false; // cone tracing inputs for the cpu reference, see cpu_cone_tracing.h
+
+		double shaders_submit_time = 0.0; // startup, from init to resolve_shaders
+		int shaders_startup_phase = -1;
 	};
 
 	namespace renderer
 	{
-		void init(GLFWwindow*);
+		void init(GLFWwindow*); // submits the shaders, they're compiled while the app loads the scene
+		bool resolve_shaders(); // false if some of them didn't compile
 		void uninit();
 
 		void render(GLFWwindow*, Scene&, float dt);
 		void render_ui();
+		void render_overlay(); // outside the debug window, also while the camera has the mouse
 
-		void voxelize_scene(Scene&, GLuint mainFboId, Texture3D& voxel_grid, Voxelization& voxelization_state, Voxelization_Settings& voxelization_settings);
-		void render_voxelized_scene(Scene&, Camera& camera, GLuint mainFboId, Texture3D& voxel_grid, Voxelization& voxelization_state, Voxelization_Settings& voxelization_settings);
-		void render_shadowmaps(Scene&, GLuint mainFboId);
-		void render_shadowmap_to_screen(Shadow_Map& shadow_map, GLuint mainFboId);
+		void voxelize_scene(Scene&, GLuint mainFboId, Texture3D& voxel_grid);
+		void render_voxelized_scene(Scene&, Camera& camera, GLuint mainFboId, Texture3D& voxel_grid, Voxelization& voxelization_state);
+		void render_shadowmaps(Scene&, Camera& camera, GLuint mainFboId); // cascades are fitted to the camera, every light in one pass
+		void build_light_clusters(Scene&, Camera& camera, Light_Clusters& clusters);
+		void render_shadowmap_to_screen(Shadow_Atlas& atlas, GLuint mainFboId);
 		void render_scene_without_shenanigans(Scene&, Camera& camera);
 		void render_scene_to_gbuffer(Scene&, Camera& camera, GLuint mainFboId, G_Buffer& gb);
-		void render_scene_with_voxel_cone_tracing(Scene&, Camera& camera, GLuint mainFboId, G_Buffer& gbuf, Texture3D& voxel_grid);
-		void upload_camera(GLuint shader_id, Camera& camera);
+		void render_gbuffer_to_screen(G_Buffer& gbuf, GLuint mainFboId); // the packed targets decoded, along the bottom
+		void classify_tiles(Scene&, GLuint mainFboId, G_Buffer& gbuf, Tile_Classification& tiles);
+		void render_scene_with_voxel_cone_tracing(Scene&, Camera& camera, GLuint mainFboId, G_Buffer& gbuf, Texture3D& voxel_grid, Cone_Tracing_History& history, Tile_Classification& tiles, Empty_Space_Field& empty_space, Cone_Step_Counters& step_counters, Compute_Cone_Tracing& compute);
+		void dump_cone_tracing_inputs(Scene&, Camera& camera, G_Buffer& gbuf, Texture3D& voxel_grid, GLuint color_texture_id);
+		void upload_uniform_buffers(Scene&);
+		void upload_camera(Camera& camera);
 		void upload_material(GLuint shader_id, Material& material, int texture_location_offset = 0);
-		void upload_lights(GLuint shader_id, Scene_Lights&);
+		void upload_lights(Scene_Lights&);
+		void pack_lights(Scene_Lights_Std140&, Scene_Lights&);
 		void upload_shadowmap(GLuint shader_id,  Scene_Lights&, int texture_location_offset);
+		void get_scene_bounds(Scene&, vec3& scene_min, vec3& scene_max); // world space
 		void upload_voxel_scale(GLuint shader_id, Scene&, int current_voxel_resolution);
 		void draw_simple_mesh(GLuint shader_id, Mesh& mesh);
-		void draw_models_with_materials(GLuint shader_id, Scene&, int texture_location_offset = 0);
-		void draw_models_with_albedo(GLuint shader_id, Scene&, int texture_location_offset);
-		void draw_models_without_materials(GLuint shader_id, Scene&);
+		void draw_models(Shader_Program& active_program, Scene&, vec3 view_position, DRAW_MATERIAL, int texture_location_offset = 0, const u8* is_visible = NULL, const u8* lods = NULL); // sorted, see render_queue.h
 
 		Camera& get_camera();
+		Gpu_Profiler& get_gpu_profiler();
 		Texture3D& get_current_voxelgrid();
 		void voxel_grid_resolution_changed(int new_resolution_index);
 		int get_current_voxelgrid_resolution();
@@ -23,14 +23,15 @@ namespace vxgi
 			.sun_color                 = vec3(1.0f, 1.0f, 1.0f),
 			.sun_attenuation           = vec3(1.0f, 1.0f, 1.0f),
 			.sun_strength              = 1.0f,
-			.shadow_map_config         = { 1024, 1.5, -1.0f, 3.5f },
+			.shadow_map_config         = { 1024, 1.5, -1.0f, 3.5f, 0 }, // small and always in view, cascades would be coarser than the whole scene layer
 
 			.vct_config =
 			{
 				.diffuse_settings      = { vct::get_aperture(60.00f), 0.272f, 32.0f, 2.0f, 1.0f, true },
 				.specular_settings     = { vct::get_aperture(5.000f), 1.000f,  2.0f, 2.0f, 1.0f, true },
 				.soft_shadows_settings = { vct::get_aperture(1.676f), 1.865f, 3.17f, 2.0f, 1.0f, true },
-				.ao_settings           = { vct::get_aperture(60.00f), 0.594f, 10.0f, 0.6f, 1.0f, true }
+				.ao_settings           = { vct::get_aperture(60.00f), 0.594f, 10.0f, 0.6f, 1.0f, true },
+				.temporal_settings     = { false, 2, 0.9f, 0.05f, 0.9f }
 			}
 		};
 
@@ -46,14 +47,15 @@ namespace vxgi
 			.sun_color                 = vec3(1.0f, 1.0f, 1.0f),
 			.sun_attenuation           = vec3(1.0f, 1.0f, 1.0f),
 			.sun_strength              = 1.0f,
-			.shadow_map_config         = { 2048, 1.5, -1.0f, 3.5f },
+			.shadow_map_config         = { 2048, 1.5, -1.0f, 3.5f, 0 }, // the default view sees the whole box, 1024^2 cascades are blurrier than this
 
 			.vct_config =
 			{
 				.diffuse_settings      = { vct::get_aperture(60.00f), 0.272f, 32.0f, 2.0f, 1.0f, true },
 				.specular_settings     = { vct::get_aperture(5.000f), 1.000f,  2.0f, 2.0f, 1.0f, true },
 				.soft_shadows_settings = { vct::get_aperture(1.676f), 1.865f, 3.17f, 2.0f, 1.0f, true },
-				.ao_settings           = { vct::get_aperture(60.00f), 1.000f, 10.0f, 0.6f, 1.0f, true }
+				.ao_settings           = { vct::get_aperture(60.00f), 1.000f, 10.0f, 0.6f, 1.0f, true },
+				.temporal_settings     = { false, 2, 0.9f, 0.05f, 0.9f }
 			}
 		};
 
@@ -69,14 +71,15 @@ namespace vxgi
 			.sun_color                 = vec3(1.0f, 1.0f, 1.0f),
 			.sun_attenuation           = vec3(1.0f, 1.0f, 1.0f),
 			.sun_strength              = 1.0f,
-			.shadow_map_config         = { 4096, 8.0f, -20.0f, 25.0f },
+			.shadow_map_config         = { 1024, 8.0f, -20.0f, 25.0f, 4, 0.9f },
 
 			.vct_config =
 			{
 				.diffuse_settings      = { vct::get_aperture(60.00f), 0.100f,  3.9f, 2.0f, 1.0f, true },
 				.specular_settings     = { vct::get_aperture(0.700f), 1.000f,  1.0f, 2.0f, 1.0f, true },
 				.soft_shadows_settings = { vct::get_aperture(1.293f), 0.359f, 10.7f, 2.0f, 1.0f, false },
-				.ao_settings           = { vct::get_aperture(60.00f), 0.594f, 10.0f, 0.5f, 1.0f, true }
+				.ao_settings           = { vct::get_aperture(60.00f), 0.594f, 10.0f, 0.5f, 1.0f, true },
+				.temporal_settings     = { false, 2, 0.9f, 0.05f, 0.9f }
 			}
 		};
 	}
@@ -124,6 +127,8 @@ namespace vxgi
 
 		void add_directional_light(Scene& scene, const vec3& direction, const vec3& color, const vec3& attenuation, float strength, const Shadow_Map::Config& shadow_map_config)
 		{
+			ASSERT(array::size(scene.lights.directional_lights) < MAX_DIRECTIONAL_LIGHTS, "scene", "too many directional lights");
+
 			Directional_Light new_light;
 			new_light.direction = direction;
 			new_light.color = color;
@@ -134,6 +139,53 @@ namespace vxgi
 			shadowmap::update(new_light.shadow_map, direction);
 
 			array::add(scene.lights.directional_lights, new_light);
+			scene.lights.is_dirty = true;
+
+			// the lights' layers one after another, in an atlas as large as the largest shadow map
+			int resolution = 0;
+			int total_layers = 0;
+			for (Directional_Light& light : scene.lights.directional_lights) {
+				light.shadow_map.first_layer = total_layers;
+				light.is_dirty = true;
+				total_layers += light.shadow_map.total_layers;
+				resolution = glm::max(resolution, light.shadow_map.config.resolution);
+			}
+
+			shadowatlas::uninit(scene.lights.shadow_atlas);
+			shadowatlas::init(scene.lights.shadow_atlas, resolution, total_layers);
+		}
+
+		void add_point_light(Scene& scene, const vec3& position, const vec3& color, float strength, float radius)
+		{
+			Scene_Lights& lights = scene.lights;
+			ASSERT(array::size(lights.point_lights) + array::size(lights.spot_lights) < MAX_LOCAL_LIGHTS, "scene", "too many point and spot lights");
+
+			Point_Light new_light;
+			new_light.position = position;
+			new_light.color = color;
+			new_light.strength = strength;
+			new_light.radius = radius;
+
+			array::add(lights.point_lights, new_light);
+			lights.is_dirty = true;
+		}
+
+		void add_spot_light(Scene& scene, const vec3& position, const vec3& direction, const vec3& color, float strength, float radius, float inner_angle, float outer_angle)
+		{
+			Scene_Lights& lights = scene.lights;
+			ASSERT(array::size(lights.point_lights) + array::size(lights.spot_lights) < MAX_LOCAL_LIGHTS, "scene", "too many point and spot lights");
+
+			Spot_Light new_light;
+			new_light.position = position;
+			new_light.direction = direction;
+			new_light.color = color;
+			new_light.strength = strength;
+			new_light.radius = radius;
+			new_light.inner_angle = inner_angle;
+			new_light.outer_angle = outer_angle;
+
+			array::add(lights.spot_lights, new_light);
+			lights.is_dirty = true;
 		}
 	}
 
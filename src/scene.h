@@ -5,6 +5,9 @@
 
 namespace vxgi
 {
+	const int MAX_DIRECTIONAL_LIGHTS = 4; // see MAX_DIRECTIONAL_LIGHTS in the shaders
+	static_assert(MAX_SHADOW_ATLAS_LAYERS == MAX_DIRECTIONAL_LIGHTS * MAX_SHADOW_MAP_LAYERS, "the Shadow_Atlas must fit every light's layers");
+
 	struct Directional_Light
 	{
 		float strength;
@@ -17,11 +20,72 @@ namespace vxgi
 		Shadow_Map shadow_map;
 	};
 
+	const int MAX_LOCAL_LIGHTS = 256; // point + spot lights, binned into froxels every frame, see light_clusters.h
+
+	struct Point_Light
+	{
+		vec3 position;
+		vec3 color;
+		float strength; // at distance 1, falls off with the inverse square
+		float radius; // no light beyond
+	};
+
+	struct Spot_Light
+	{
+		vec3 position;
+		vec3 direction; // of the cone
+		vec3 color;
+		float strength; // at distance 1, falls off with the inverse square
+		float radius; // no light beyond
+		float inner_angle; // degrees from the direction, full strength inside
+		float outer_angle; // no light outside
+	};
+
 	struct Scene_Lights
 	{
 		vec3 ambient_light = vec3(0.2);
 		Array<Directional_Light> directional_lights;
+		Shadow_Atlas shadow_atlas; // of every directional light, rebuilt when one is added
+		Array<Point_Light> point_lights; // not shadowed
+		Array<Spot_Light> spot_lights; // not shadowed
+
+		bool is_dirty = true; // re-upload uniform buffer
+	};
+
+	struct Directional_Light_Std140 // mirrors Directional_Light in the shaders
+	{
+		float strength;
+		float _pad0[3];
+		vec3 direction;
+		float _pad1;
+		vec3 color;
+		float _pad2;
+		vec3 attenuation;
+		float _pad3;
+	};
+	static_assert(sizeof(Directional_Light_Std140) == 64, "Directional_Light_Std140 doesn't match the std140 layout");
+
+	struct Scene_Lights_Std140 // mirrors Lights_Block in the shaders
+	{
+		vec3 ambient_light;
+		s32 total_directional_lights;
+		Directional_Light_Std140 directional_lights[MAX_DIRECTIONAL_LIGHTS];
+	};
+	static_assert(offsetof(Scene_Lights_Std140, directional_lights) == 16, "Scene_Lights_Std140 doesn't match the std140 layout");
+	static_assert(sizeof(Scene_Lights_Std140) == 16 + 64 * MAX_DIRECTIONAL_LIGHTS, "Scene_Lights_Std140 doesn't match the std140 layout");
+
+	struct Local_Light_Std430 // mirrors Local_Light in local_lights.glsl, point lights are spot lights that light every direction
+	{
+		vec3 position;
+		float radius;
+		vec3 color;
+		float strength;
+		vec3 direction;
+		float spot_scale; // spot factor = dot(-light direction, direction) * spot_scale + spot_offset
+		float spot_offset;
+		float _pad0[3];
 	};
+	static_assert(sizeof(Local_Light_Std430) == 64, "Local_Light_Std430 doesn't match the std430 layout");
 
 	struct Scene
 	{
@@ -62,6 +126,8 @@ namespace vxgi
 		void uninit(Scene&);
 
 		void add_directional_light(Scene&, const vec3& direction, const vec3& color, const vec3& attenuation, float strength, const Shadow_Map::Config&);
+		void add_point_light(Scene&, const vec3& position, const vec3& color, float strength, float radius);
+		void add_spot_light(Scene&, const vec3& position, const vec3& direction, const vec3& color, float strength, float radius, float inner_angle, float outer_angle);
 	}
 
 	namespace scenes
@@ -0,0 +1,51 @@
+#version 450 core
+
+#define CELL_SIZE 4 // voxels per side of a cell, see EMPTY_SPACE_CELL_SIZE in voxel_cone_tracing.h
+#define MAX_DISTANCE 15 // in cells, see MAX_EMPTY_SPACE_DISTANCE
+
+// coarse chebyshev distance field of the voxel grid: how many cells away the nearest cell with a non-empty voxel is.
+// pass 0 marks the occupied cells, passes 1-3 take the distance along x, y and z (the chebyshev distance is separable).
+// distances beyond MAX_DISTANCE are clamped, so the field never overestimates the empty space.
+layout(local_size_x = 4, local_size_y = 4, local_size_z = 4) in;
+
+uniform int u_empty_space_pass;
+uniform sampler3D u_tex_voxelgrid;
+
+layout(r8ui, binding = 0) uniform readonly uimage3D u_input; // previous pass
+layout(r8ui, binding = 1) uniform writeonly uimage3D u_output;
+
+void main()
+{
+	ivec3 cell = ivec3(gl_GlobalInvocationID);
+	ivec3 cells = imageSize(u_output);
+	if (any(greaterThanEqual(cell, cells)))
+		return;
+
+	if (u_empty_space_pass == 0)
+	{
+		bool is_occupied = false;
+		ivec3 first_voxel = cell * CELL_SIZE;
+		for (int z = 0; z < CELL_SIZE; z++)
+		for (int y = 0; y < CELL_SIZE; y++)
+		for (int x = 0; x < CELL_SIZE; x++)
+			if (any(notEqual(texelFetch(u_tex_voxelgrid, first_voxel + ivec3(x, y, z), 0), vec4(0.0f))))
+				is_occupied = true;
+
+		imageStore(u_output, cell, uvec4(is_occupied ? 0u : uint(MAX_DISTANCE)));
+		return;
+	}
+
+	ivec3 axis = ivec3(equal(ivec3(u_empty_space_pass - 1), ivec3(0, 1, 2)));
+	uint distance = uint(MAX_DISTANCE);
+
+	for (int i = -MAX_DISTANCE; i <= MAX_DISTANCE; i++)
+	{
+		ivec3 neighbour = cell + axis * i;
+		if (any(lessThan(neighbour, ivec3(0))) || any(greaterThanEqual(neighbour, cells)))
+			continue; // outside the grid is empty
+
+		distance = min(distance, max(uint(abs(i)), imageLoad(u_input, neighbour).r));
+	}
+
+	imageStore(u_output, cell, uvec4(distance));
+}
@@ -0,0 +1,44 @@
+// packing of the g-buffer targets, see G_Buffer in opengl.h. written by gbuffer_frag.glsl, read by the cone tracing
+// passes, the tile classification and the g-buffer visualizer. the cpu side decodes it in dump_cone_tracing_inputs
+#define GBUFFER_MIN_SHININESS 0.06f // see G_Buffer::*_SHININESS in opengl.h
+#define GBUFFER_MAX_SHININESS 2048.0f
+#define GBUFFER_ALBEDO_ALPHA_SCALE 2.0f // diffuse + emission alpha doesn't fit in [0, 1]
+
+// unit vector -> [0, 1]^2, the lower hemisphere is folded over the diagonals
+vec2 encode_octahedral(vec3 n)
+{
+	n /= abs(n.x) + abs(n.y) + abs(n.z);
+	vec2 p = n.xy;
+	if (n.z < 0.0f)
+		p = (1.0f - abs(n.yx)) * vec2(n.x >= 0.0f ? 1.0f : -1.0f, n.y >= 0.0f ? 1.0f : -1.0f);
+	return 0.5f * p + 0.5f;
+}
+
+vec3 decode_octahedral(vec2 e)
+{
+	vec2 p = 2.0f * e - 1.0f;
+	vec3 n = vec3(p, 1.0f - abs(p.x) - abs(p.y));
+	float t = max(-n.z, 0.0f);
+	n.x += n.x >= 0.0f ? -t : t;
+	n.y += n.y >= 0.0f ? -t : t;
+	return normalize(n);
+}
+
+// log2 spaced, 8 bits keep it within ~2%
+float encode_shininess(float shininess)
+{
+	float s = clamp(shininess, GBUFFER_MIN_SHININESS, GBUFFER_MAX_SHININESS);
+	return log2(s / GBUFFER_MIN_SHININESS) / log2(GBUFFER_MAX_SHININESS / GBUFFER_MIN_SHININESS);
+}
+
+float decode_shininess(float e)
+{
+	return GBUFFER_MIN_SHININESS * exp2(e * log2(GBUFFER_MAX_SHININESS / GBUFFER_MIN_SHININESS));
+}
+
+// tex_coords + depth are in [0, 1], inverse_VP comes from Camera_Block
+vec3 reconstruct_world_pos(vec2 tex_coords, float depth, mat4 inverse_VP)
+{
+	vec4 world_pos = inverse_VP * vec4(vec3(tex_coords, depth) * 2.0f - 1.0f, 1.0f);
+	return world_pos.xyz / world_pos.w;
+}
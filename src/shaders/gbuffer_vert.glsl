@@ -1,8 +1,21 @@
 #version 450 core
 
+#ifdef MULTI_DRAW
+#include "multi_draw.glsl"
+layout (location = 6) in uint v_draw_id; // see MULTI_DRAW_ID_ATTRIBUTE in multi_draw.h
+flat out uint f_material;
+mat4 M;
+mat4 N;
+#else
 uniform mat4 M;
 uniform mat4 N;
-uniform mat4 VP;
+#endif
+
+layout(std140, binding = 0) uniform Camera_Block // see Camera_Std140 in camera.h
+{
+	mat4 VP;
+	vec3 u_camera_world_position;
+};
 
 layout (location = 0) in vec3 v_position;
 layout (location = 1) in vec3 v_normal;
@@ -20,6 +33,12 @@ out mat3 fTBN;
 
 void main()
 {
+#ifdef MULTI_DRAW
+	M = u_draws[v_draw_id].M;
+	N = u_draws[v_draw_id].N;
+	f_material = u_draws[v_draw_id].material;
+#endif
+
 	f_world_pos = (M * vec4(v_position, 1.0f)).xyz;
 	f_normal = (N * vec4(v_normal, 1.0f)).xyz;
 	f_tex_coords = v_tex_coords;
@@ -0,0 +1,41 @@
+#version 450 core
+
+#include "gbuffer_encoding.glsl"
+
+layout(std140, binding = 0) uniform Camera_Block // see Camera_Std140 in camera.h
+{
+	mat4 VP;
+	vec3 u_camera_world_position;
+	mat4 u_inverse_VP;
+};
+
+uniform sampler2D g_normal;
+uniform sampler2D g_albedo;
+uniform sampler2D g_specular;
+uniform sampler2D g_depth;
+uniform int u_gbuffer_view; // 0 world position, 1 normal, 2 bump, 3 albedo, 4 specular
+
+in vec2 f_tex_coords;
+out vec4 o_color;
+
+// the packed targets decoded, one view per draw, see renderer::render_gbuffer_to_screen
+void main()
+{
+	float depth = texture(g_depth, f_tex_coords).r;
+	if (depth == 1.0f) {
+		o_color = vec4(0.0f, 0.0f, 0.0f, 1.0f);
+		return;
+	}
+
+	vec4 normals = texture(g_normal, f_tex_coords);
+	vec3 color = vec3(0.0f);
+	switch (u_gbuffer_view)
+	{
+		case 0: color = reconstruct_world_pos(f_tex_coords, depth, u_inverse_VP); break;
+		case 1: color = 0.5f * decode_octahedral(normals.xy) + 0.5f; break;
+		case 2: color = 0.5f * decode_octahedral(normals.zw) + 0.5f; break;
+		case 3: color = texture(g_albedo, f_tex_coords).rgb; break;
+		case 4: color = texture(g_specular, f_tex_coords).rgb; break;
+	}
+	o_color = vec4(color, 1.0f);
+}
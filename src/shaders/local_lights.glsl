@@ -0,0 +1,57 @@
+// point and spot lights, see Light_Clusters in light_clusters.h. the cpu bins them into froxels of the camera frustum,
+// the cone tracing pass shades the lights in the pixel's cluster and the voxelization pass goes through all of them
+#define MAX_LOCAL_LIGHTS 256 // see MAX_LOCAL_LIGHTS in scene.h
+#define LIGHT_CLUSTERS_X 16 // see LIGHT_CLUSTERS_* in light_clusters.h
+#define LIGHT_CLUSTERS_Y 9
+#define LIGHT_CLUSTERS_Z 24
+#define TOTAL_LIGHT_CLUSTERS (LIGHT_CLUSTERS_X * LIGHT_CLUSTERS_Y * LIGHT_CLUSTERS_Z)
+
+struct Local_Light // see Local_Light_Std430 in scene.h
+{
+	vec3 position;
+	float radius;
+	vec3 color;
+	float strength;
+	vec3 direction;
+	float spot_scale;
+	float spot_offset;
+};
+
+layout(std430, binding = 2) readonly buffer Local_Lights_Block // see LIGHT_CLUSTERS_BINDING in light_clusters.h
+{
+	uint u_total_local_lights;
+	Local_Light u_local_lights[MAX_LOCAL_LIGHTS];
+};
+
+layout(std430, binding = 3) readonly buffer Light_Clusters_Block
+{
+	float u_light_clusters_near_plane;
+	float u_light_clusters_slices_per_log_depth;
+	uint  u_light_clusters_total_references;
+	uvec2 u_light_cluster_ranges[TOTAL_LIGHT_CLUSTERS]; // first index, total lights
+	uint  u_light_indices[];
+};
+
+// inverse square falloff, windowed to 0 at the radius and shaped by the spot cone
+float get_local_light_intensity(Local_Light light, vec3 world_pos, out vec3 light_direction)
+{
+	vec3 to_light = light.position - world_pos;
+	float distance_squared = max(dot(to_light, to_light), 1e-4f);
+	light_direction = to_light * inversesqrt(distance_squared);
+
+	float d = distance_squared / (light.radius * light.radius);
+	float window = clamp(1.0f - d * d, 0.0f, 1.0f);
+
+	float spot = clamp(dot(-light_direction, light.direction) * light.spot_scale + light.spot_offset, 0.0f, 1.0f);
+
+	return light.strength * window * window * spot * spot / distance_squared;
+}
+
+// the froxel of a point, from its position in the camera's clip space (w = view depth)
+uint get_light_cluster(vec4 clip_pos)
+{
+	vec2 ndc = clip_pos.xy / clip_pos.w;
+	ivec2 tile = clamp(ivec2((0.5f * ndc + 0.5f) * vec2(LIGHT_CLUSTERS_X, LIGHT_CLUSTERS_Y)), ivec2(0), ivec2(LIGHT_CLUSTERS_X - 1, LIGHT_CLUSTERS_Y - 1));
+	int slice = clamp(int(log(clip_pos.w / u_light_clusters_near_plane) * u_light_clusters_slices_per_log_depth), 0, LIGHT_CLUSTERS_Z - 1);
+	return uint((slice * LIGHT_CLUSTERS_Y + tile.y) * LIGHT_CLUSTERS_X + tile.x);
+}
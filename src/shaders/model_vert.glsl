@@ -7,7 +7,11 @@ layout (location = 3) in vec2 v_tex_coord;
 
 out vec2 f_tex_coord;
 
-uniform mat4 VP;
+layout(std140, binding = 0) uniform Camera_Block // see Camera_Std140 in camera.h
+{
+	mat4 VP;
+	vec3 u_camera_world_position;
+};
 
 void main()
 {
@@ -0,0 +1,65 @@
+// per draw data of the multi draw path, see Multi_Draw in multi_draw.h. included right after #version,
+// the vertex shader reads the draw id (= the command's base instance) and passes the material on as a flat input.
+// MULTI_DRAW_BINDLESS is defined with GL_ARB_bindless_texture, otherwise the textures are layers of texture arrays
+#ifdef MULTI_DRAW_BINDLESS
+#extension GL_ARB_bindless_texture : require
+#endif
+#define MULTI_DRAW_MAX_TEXTURE_ARRAYS 8 // see MULTI_DRAW_MAX_TEXTURE_ARRAYS in multi_draw.h
+
+struct Multi_Draw_Data // see Multi_Draw::Draw_Std430
+{
+	mat4 M;
+	mat4 N;
+	uint material;
+};
+
+struct Multi_Draw_Material // see Multi_Draw::Material_Std430, same names as the Material uniform
+{
+	vec3 Ka;
+	float Ns;
+	vec3 Kd;
+	float d;
+	vec3 Ks;
+	float Ni;
+	vec3 Ke;
+	uvec2 map_Ka; // bindless handle, or (texture array, layer)
+	uvec2 map_Kd;
+	uvec2 map_Ks;
+	uvec2 map_Ke;
+	uvec2 map_bump;
+};
+
+layout(std430, binding = 4) readonly buffer Multi_Draw_Block // see MULTI_DRAW_BINDING in multi_draw.h
+{
+	Multi_Draw_Data u_draws[];
+};
+
+layout(std430, binding = 5) readonly buffer Multi_Draw_Materials_Block
+{
+	Multi_Draw_Material u_materials[];
+};
+
+#ifdef MULTI_DRAW_BINDLESS
+vec4 material_texture(uvec2 map, vec2 tex_coords)
+{
+	return texture(sampler2D(map), tex_coords);
+}
+#else
+layout(binding = 8) uniform sampler2DArray u_material_textures[MULTI_DRAW_MAX_TEXTURE_ARRAYS]; // see MULTI_DRAW_TEXTURE_ARRAY_UNIT
+
+// sampler arrays can only be indexed with dynamically uniform values, map.x isn't one. the textures have no mipmaps
+vec4 material_texture(uvec2 map, vec2 tex_coords)
+{
+	vec3 p = vec3(tex_coords, float(map.y));
+	switch (map.x) {
+		case 0: return textureLod(u_material_textures[0], p, 0.0f);
+		case 1: return textureLod(u_material_textures[1], p, 0.0f);
+		case 2: return textureLod(u_material_textures[2], p, 0.0f);
+		case 3: return textureLod(u_material_textures[3], p, 0.0f);
+		case 4: return textureLod(u_material_textures[4], p, 0.0f);
+		case 5: return textureLod(u_material_textures[5], p, 0.0f);
+		case 6: return textureLod(u_material_textures[6], p, 0.0f);
+		default: return textureLod(u_material_textures[7], p, 0.0f);
+	}
+}
+#endif
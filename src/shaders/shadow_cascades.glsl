@@ -0,0 +1,46 @@
+// shadow maps of the directional lights, see Shadow_Map and Shadow_Atlas in opengl.h. each light has a range of layers in
+// the atlas: the cascades fitted to the camera come first, the last one covers the whole scene. a point is shadowed by the
+// finest layer it's inside of, which is usually the first one, but the far cascades of a small scene can be coarser than
+// the whole scene layer. the including shader defines MAX_DIRECTIONAL_LIGHTS
+#define MAX_SHADOW_ATLAS_LAYERS 20 // see MAX_SHADOW_ATLAS_LAYERS in opengl.h
+
+uniform sampler2DArrayShadow u_tex_shadowmap;
+uniform mat4 u_shadowmap_mvp[MAX_SHADOW_ATLAS_LAYERS]; // world -> [0, 1] of its light's map, per layer
+uniform ivec2 u_shadowmap_light_layers[MAX_DIRECTIONAL_LIGHTS]; // first layer, total layers. 0 layers = not shadowed
+uniform float u_shadowmap_atlas_scale[MAX_DIRECTIONAL_LIGHTS]; // its resolution / the atlas', smaller maps are in the lower left corner
+
+float get_shadowmap_texel_world_size(int layer, float resolution)
+{
+	// orthographic, the world space length of one texel is the same everywhere in the layer
+	return 1.0f / (length(vec3(u_shadowmap_mvp[layer][0].x, u_shadowmap_mvp[layer][1].x, u_shadowmap_mvp[layer][2].x)) * resolution);
+}
+
+float sample_shadow_cascades(int light, vec3 world_pos, float bias)
+{
+	int first_layer = u_shadowmap_light_layers[light].x;
+	int total_layers = u_shadowmap_light_layers[light].y;
+	if (total_layers == 0)
+		return 1.0f;
+
+	float scale = u_shadowmap_atlas_scale[light];
+	float resolution = float(textureSize(u_tex_shadowmap, 0).x) * scale;
+	float margin = 1.0f / resolution; // the comparison mustn't read past the edge of a layer
+
+	int layer = first_layer + total_layers - 1; // whole scene
+	float texel_world_size = get_shadowmap_texel_world_size(layer, resolution);
+
+	for (int i = first_layer; i < layer; i++)
+	{
+		vec4 coord = u_shadowmap_mvp[i] * vec4(world_pos, 1.0f);
+		bool is_inside = all(greaterThan(coord.xyz, vec3(margin, margin, 0.0f))) && all(lessThan(coord.xyz, vec3(1.0f - margin, 1.0f - margin, 1.0f)));
+
+		float layer_texel_world_size = get_shadowmap_texel_world_size(i, resolution);
+		if (is_inside && layer_texel_world_size < texel_world_size) {
+			layer = i;
+			texel_world_size = layer_texel_world_size;
+		}
+	}
+
+	vec4 coord = u_shadowmap_mvp[layer] * vec4(world_pos, 1.0f);
+	return texture(u_tex_shadowmap, vec4(coord.xy * scale, float(layer), coord.z - bias));
+}
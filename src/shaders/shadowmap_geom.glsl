@@ -0,0 +1,39 @@
+#version 450 core
+#define MAX_SHADOW_ATLAS_LAYERS 20 // see MAX_SHADOW_ATLAS_LAYERS in opengl.h
+
+// all layers of the shadow atlas in one pass, one invocation per layer. the invocations past the atlas' layers exit first thing
+layout(triangles, invocations = MAX_SHADOW_ATLAS_LAYERS) in;
+layout(triangle_strip, max_vertices = 3) out;
+
+uniform mat4 VP_shadow[MAX_SHADOW_ATLAS_LAYERS];
+uniform int u_shadowmap_layer_light[MAX_SHADOW_ATLAS_LAYERS]; // its viewport, sized to the light's shadow map
+uniform int u_total_shadowmap_layers;
+
+in vec4 g_world_pos[];
+
+void main()
+{
+	if (gl_InvocationID >= u_total_shadowmap_layers)
+		return;
+	int layer = gl_InvocationID;
+
+	vec4 positions[3];
+	for (int i = 0; i < 3; i++)
+		positions[i] = VP_shadow[layer] * g_world_pos[i];
+
+	// most triangles are outside the small cascades, skip the ones that are entirely beyond one side of it
+	for (int axis = 0; axis < 2; axis++) {
+		if (positions[0][axis] < -positions[0].w && positions[1][axis] < -positions[1].w && positions[2][axis] < -positions[2].w) return;
+		if (positions[0][axis] >  positions[0].w && positions[1][axis] >  positions[1].w && positions[2][axis] >  positions[2].w) return;
+	}
+
+	for (int i = 0; i < 3; i++)
+	{
+		gl_Layer = layer;
+		gl_ViewportIndex = u_shadowmap_layer_light[layer];
+		gl_Position = positions[i];
+		EmitVertex();
+	}
+
+	EndPrimitive();
+}
@@ -1,11 +1,21 @@
 #version 450 core
 
+#ifdef MULTI_DRAW
+#include "multi_draw.glsl"
+layout (location = 6) in uint v_draw_id; // see MULTI_DRAW_ID_ATTRIBUTE in multi_draw.h
+#else
+uniform mat4 M;
+#endif
+
 layout (location = 0) in vec3 v_position;
 
-uniform mat4 M;
-uniform mat4 VP_shadow;
+out vec4 g_world_pos;
 
 void main()
 {
-	gl_Position = VP_shadow * M * vec4(v_position, 1.0f);
+#ifdef MULTI_DRAW
+	mat4 M = u_draws[v_draw_id].M;
+#endif
+	g_world_pos = M * vec4(v_position, 1.0f);
+	gl_Position = g_world_pos; // projected per layer in shadowmap_geom.glsl
 }
\ No newline at end of file
@@ -1,12 +1,15 @@
 #version 450 core
 
-uniform sampler2D u_tex_shadowmap;
+uniform sampler2DArray u_tex_shadowmap;
+uniform int u_total_shadowmap_layers;
 
 in vec2 f_tex_coords;
 out vec4 o_color;
 
 void main()
 {
-	float d = texture(u_tex_shadowmap, f_tex_coords).r;
+	// layers side by side, the first light's finest cascade on the left
+	float x = f_tex_coords.x * float(u_total_shadowmap_layers);
+	float d = texture(u_tex_shadowmap, vec3(fract(x), f_tex_coords.y, floor(x))).r;
 	o_color = vec4(d, d, d, 1.0f);
 }
\ No newline at end of file
@@ -0,0 +1,87 @@
+#version 450 core
+
+#define MAX_DIRECTIONAL_LIGHTS 4
+#define TILE_SIZE 16
+#define TOTAL_TILE_CLASSES 4
+
+// see Tile_Classification in voxel_cone_tracing.h
+#define TILE_FEATURE_GEOMETRY     1u
+#define TILE_FEATURE_SPECULAR     2u
+#define TILE_FEATURE_SOFT_SHADOWS 4u
+
+#include "gbuffer_encoding.glsl"
+
+// one work group per screen tile, each invocation looks at one pixel of the g-buffer
+layout(local_size_x = TILE_SIZE, local_size_y = TILE_SIZE) in;
+
+struct Directional_Light
+{
+	float strength;
+	vec3 direction;
+	vec3 color;
+	vec3 attenuation;
+};
+
+struct Draw_Command
+{
+	uint count;
+	uint instance_count;
+	uint first;
+	uint base_instance;
+};
+
+layout(std430, binding = 0) buffer Tiles
+{
+	Draw_Command u_commands[TOTAL_TILE_CLASSES];
+	uint u_tiles[]; // [class * u_max_tiles + i] = x | (y << 16)
+};
+
+uniform int u_max_tiles;
+layout(std140, binding = 1) uniform Lights_Block // see Scene_Lights_Std140 in scene.h
+{
+	vec3 u_ambient_light;
+	int u_total_directional_lights;
+	Directional_Light u_directional_lights[MAX_DIRECTIONAL_LIGHTS];
+};
+
+uniform sampler2D g_normal; // see gbuffer_encoding.glsl
+uniform sampler2D g_specular;
+uniform sampler2D g_depth;
+
+shared uint s_features;
+
+void main()
+{
+	if (gl_LocalInvocationIndex == 0)
+		s_features = 0u;
+	barrier();
+
+	ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+
+	if (all(lessThan(pixel, textureSize(g_depth, 0))) && texelFetch(g_depth, pixel, 0).r < 1.0f)
+	{
+		uint features = TILE_FEATURE_GEOMETRY;
+
+		// specular is scaled by g_specular for both the indirect cone and the direct light,
+		// and the latter isn't clamped by n.l so it still needs the shadow cone
+		vec3 specular = texelFetch(g_specular, pixel, 0).rgb;
+		if (any(greaterThan(specular, vec3(0.0f))))
+			features |= TILE_FEATURE_SPECULAR | TILE_FEATURE_SOFT_SHADOWS;
+
+		vec3 normal = decode_octahedral(texelFetch(g_normal, pixel, 0).xy);
+		for (int i = 0; i < u_total_directional_lights; i++)
+			if (dot(normal, normalize(u_directional_lights[i].direction)) > 0.0f)
+				features |= TILE_FEATURE_SOFT_SHADOWS;
+
+		atomicOr(s_features, features);
+	}
+
+	barrier();
+
+	if (gl_LocalInvocationIndex == 0 && (s_features & TILE_FEATURE_GEOMETRY) != 0u)
+	{
+		uint tile_class = s_features >> 1;
+		uint index = atomicAdd(u_commands[tile_class].instance_count, 1u);
+		u_tiles[tile_class * u_max_tiles + index] = gl_WorkGroupID.x | (gl_WorkGroupID.y << 16);
+	}
+}
@@ -0,0 +1,530 @@
+// shared by voxelconetracing_frag.glsl and voxelconetracing_comp.glsl, pulled in with #include (see shader::read_source)
+// the including shader defines #version, the FEATURE_* permutation and TILE_FAR_FIELD (compute only)
+
+#define PI 3.14159265f
+#define MAX_DIRECTIONAL_LIGHTS 4
+
+// permutations, the renderer defines these from Cone_Tracing_Shader_Settings (see CONE_TRACING_FEATURE in voxel_cone_tracing.h)
+// FEATURE_DIRECT_LIGHT, FEATURE_DIFFUSE, FEATURE_SPECULAR, FEATURE_SOFT_SHADOWS, FEATURE_AO,
+// FEATURE_TRACE_AO_SEPARATELY, FEATURE_HARD_SHADOWS, FEATURE_TEMPORAL, FEATURE_EMPTY_SPACE_SKIPPING, FEATURE_STEP_COUNTERS
+#if !defined(FEATURE_DIRECT_LIGHT) && !defined(FEATURE_DIFFUSE) && !defined(FEATURE_SPECULAR)
+#define ONLY_RENDER_AO
+#endif
+#if defined(FEATURE_DIFFUSE) || (defined(ONLY_RENDER_AO) && !defined(FEATURE_TRACE_AO_SEPARATELY))
+#define TRACES_DIFFUSE_CONES
+#endif
+
+#include "shadow_cascades.glsl"
+#include "local_lights.glsl"
+#include "gbuffer_encoding.glsl"
+
+// the renderer defines the DIFFUSE_CONE_SET_* from the selected cone set, see Diffuse_Cone_Set in voxel_cone_tracing.h
+// directions are around the normal with y along it, weights sum to PI
+// See http://simonstechblog.blogspot.com/2013/01/implementing-voxel-cone-tracing.html
+const int TOTAL_DIFFUSE_CONES = DIFFUSE_CONE_SET_SIZE;
+const vec3 DIFFUSE_CONE_DIRECTIONS[TOTAL_DIFFUSE_CONES] = vec3[](DIFFUSE_CONE_SET_DIRECTIONS);
+const float DIFFUSE_CONE_WEIGHTS[TOTAL_DIFFUSE_CONES] = float[](DIFFUSE_CONE_SET_WEIGHTS);
+
+struct Directional_Light
+{
+	float strength;
+	vec3 direction;
+	vec3 color;
+	vec3 attenuation;
+};
+
+struct Cone_Settings
+{
+	float aperture;
+	float sampling_factor;
+	float distance_offset;
+	float max_distance;
+	float result_intensity;
+	int is_enabled;
+};
+
+struct Temporal_Settings
+{
+	int is_enabled;
+	int cones_per_frame;
+	float history_weight;
+	float depth_tolerance;
+	float normal_tolerance;
+};
+
+struct Settings
+{
+	Cone_Settings diffuse;
+	Cone_Settings specular;
+	Cone_Settings softshadows;
+	Cone_Settings ao;
+	int trace_ao_separately;
+	float gamma;
+	float hard_shadow_bias;
+	float voxel_size;
+	float direct_light_intensity;
+	int voxel_grid_resolution;
+	int max_mipmap_level;
+	int enable_direct_light;
+	int enable_hard_shadows;
+	int diffuse_cone_set; // compiled in as DIFFUSE_CONE_SET_*, only read by the cpu reference
+	Temporal_Settings temporal;
+};
+
+layout(std140, binding = 2) uniform Cone_Tracing_Block // see Cone_Tracing_Settings_Std140 in voxel_cone_tracing.h
+{
+	Settings settings;
+};
+
+layout(std140, binding = 0) uniform Camera_Block // see Camera_Std140 in camera.h
+{
+	mat4 VP;
+	vec3 u_camera_world_position;
+	mat4 u_inverse_VP;
+};
+
+layout(std140, binding = 1) uniform Lights_Block // see Scene_Lights_Std140 in scene.h
+{
+	vec3 u_ambient_light;
+	int u_total_directional_lights;
+	Directional_Light u_directional_lights[MAX_DIRECTIONAL_LIGHTS];
+};
+
+uniform vec3 u_scene_voxel_scale;
+uniform int u_temporal_has_history;
+uniform int u_temporal_frame_index;
+uniform mat4 u_previous_VP;
+uniform vec3 u_previous_camera_world_position;
+uniform int u_is_tiled; // drawn per tile class instead of as a full screen quad
+
+uniform sampler3D u_tex_voxelgrid; 
+uniform sampler2D g_normal; // see gbuffer_encoding.glsl
+uniform sampler2D g_albedo;
+uniform sampler2D g_specular;
+uniform sampler2D g_depth;
+uniform sampler2D u_tex_history_indirect_diffuse;
+uniform sampler2D u_tex_history_geometry;
+#ifdef FEATURE_EMPTY_SPACE_SKIPPING
+uniform usampler3D u_tex_empty_space; // chebyshev distance in cells to the nearest non-empty voxel, see emptyspace_comp.glsl
+#endif
+
+#ifdef FEATURE_STEP_COUNTERS
+layout(std430, binding = 1) buffer Cone_Step_Counters // see Cone_Step_Counters in voxel_cone_tracing.h
+{
+	uint u_total_cones;
+	uint u_total_steps;
+	uint u_total_leaps;
+};
+#endif
+
+ivec2 f_pixel = ivec2(0);
+vec3 f_voxel_pos = vec3(0.0f); // -1.0 ... 1.0
+vec3 f_world_pos = vec3(0.0f);
+vec3 f_normal = vec3(0.0f);
+vec3 f_bump = vec3(0.0f);
+vec4 f_albedo = vec4(0.0f);
+vec4 f_specular = vec4(0.0f); // a = shininess
+//vec3 f_emission = vec3(0.0f);
+vec4 f_history_indirect_diffuse = vec4(0.0f); // written to the history targets when temporal accumulation is enabled
+vec4 f_history_geometry = vec4(0.0f);
+
+#ifdef TILE_FAR_FIELD
+bool get_far_field(int cone, out vec4 far_field, out float far_field_distance); // traced once per tile, see voxelconetracing_comp.glsl
+#endif
+
+float attenuate(float dist, float strength, vec3 attenuation) { 
+	return strength / (attenuation.x + attenuation.y * dist + attenuation.z * dist * dist);
+}
+
+bool is_inside_clipspace(const vec3 p, float e) {
+	return abs(p.x) < 1 + e && abs(p.y) < 1 + e && abs(p.z) < 1 + e;
+}
+
+//
+// CONE TRACE FUNCTION
+// note: aperture = tan(radians * 0.5)
+//
+vec4 trace_cone(const vec3 start_clip_pos, vec3 direction, float aperture, float distance_offset, float distance_max, float sampling_factor)
+{
+	aperture = max(0.1f, aperture); // inf loop if 0
+	direction = normalize(direction);
+	float distance = distance_offset; // avoid self-collision
+	vec3 accumulated_color = vec3(0.0f);
+	float accumulated_occlusion = 0.0f;
+#ifdef FEATURE_STEP_COUNTERS
+	uint total_steps = 0u;
+	uint total_leaps = 0u;
+#endif
+	
+	while (distance <= distance_max && accumulated_occlusion < 1.0f)
+	{
+		vec3 cone_clip_pos = start_clip_pos + (direction * distance);
+		vec3 cone_voxelgrid_pos = 0.5f * cone_clip_pos + vec3(0.5f); // from clipspace -1.0...1.0 to texcoords 0.0...1.0
+
+#ifdef FEATURE_EMPTY_SPACE_SKIPPING
+		// cells less than empty_cells away from this one (and everything outside the grid) are empty, so the steps
+		// whose sample footprint stays inside that box can be taken without sampling. the distances are the same
+		// as the regular steps below. the footprint is the whole trilinear support: the two texels per axis around
+		// the sample on the coarser of the two mip levels, 1.5 of its texels to either side
+		if (all(greaterThanEqual(cone_voxelgrid_pos, vec3(0.0f))) && all(lessThan(cone_voxelgrid_pos, vec3(1.0f))))
+		{
+			vec3 cells = vec3(textureSize(u_tex_empty_space, 0));
+			vec3 cell = floor(cone_voxelgrid_pos * cells);
+			uint empty_cells = texelFetch(u_tex_empty_space, ivec3(cell), 0).r;
+
+			if (empty_cells > 1u)
+			{
+				vec3 empty_min = (cell - float(empty_cells - 1u)) / cells;
+				vec3 empty_max = (cell + float(empty_cells)) / cells;
+				float texel_size = 1.0f / float(settings.voxel_grid_resolution);
+				bool has_leaped = false;
+
+				while (distance <= distance_max)
+				{
+					vec3 leap_voxelgrid_pos = 0.5f * (start_clip_pos + (direction * distance)) + vec3(0.5f);
+					float diameter = 2.0f * aperture * distance;
+					float mipmap_level = log2(diameter * settings.voxel_grid_resolution);
+
+					float reach = 1.5f * texel_size * exp2(ceil(clamp(mipmap_level, 0.0f, float(settings.max_mipmap_level))));
+					if (any(lessThan(leap_voxelgrid_pos - reach, empty_min)) || any(greaterThan(leap_voxelgrid_pos + reach, empty_max)))
+						break;
+
+					distance += diameter * sampling_factor;
+					has_leaped = true;
+				}
+
+				if (has_leaped) {
+#ifdef FEATURE_STEP_COUNTERS
+					total_leaps++;
+#endif
+					continue;
+				}
+			}
+		}
+#endif
+
+		float diameter = 2.0f * aperture * distance; 
+		float mipmap_level = log2(diameter * settings.voxel_grid_resolution);
+		vec4 voxel_sample = textureLod(u_tex_voxelgrid, cone_voxelgrid_pos, min(mipmap_level, settings.max_mipmap_level));
+
+		// front to back composition
+		accumulated_color += (1.0f - accumulated_occlusion) * voxel_sample.rgb; 
+		accumulated_occlusion += (1.0f - accumulated_occlusion) * voxel_sample.a; 
+
+		distance += diameter * sampling_factor;
+#ifdef FEATURE_STEP_COUNTERS
+		total_steps++;
+#endif
+	}
+
+#ifdef FEATURE_STEP_COUNTERS
+	atomicAdd(u_total_cones, 1u);
+	atomicAdd(u_total_steps, total_steps);
+	atomicAdd(u_total_leaps, total_leaps);
+#endif
+
+	accumulated_occlusion = min(accumulated_occlusion, 1.0f);
+	return vec4(accumulated_color, accumulated_occlusion);
+}
+
+float trace_shadow_cone(vec3 from, vec3 direction, float distance)
+{
+	vec4 s = trace_cone(from, direction, settings.softshadows.aperture, settings.softshadows.distance_offset, settings.softshadows.max_distance * distance, settings.softshadows.sampling_factor);
+	return 1.0f - s.a;
+}
+
+vec4 calc_indirect_specular()
+{
+	vec3 viewDirection = normalize(f_world_pos - u_camera_world_position);
+	vec3 coneDirection = normalize(reflect(viewDirection, f_normal));
+  	vec4 specularIntensity = vec4(1.0f);
+
+	float aperture = settings.specular.aperture;
+
+	vec3 start_clip_pos = f_voxel_pos + (f_normal * settings.specular.distance_offset);
+	
+	vec4 specular = trace_cone(start_clip_pos, coneDirection, aperture, settings.specular.distance_offset, settings.specular.max_distance, settings.specular.sampling_factor);
+	specular.rgb *= f_specular.rgb;
+
+	return specular;
+}
+
+// cone frame around the normal, the diffuse cone directions are in it
+void get_cone_frame(vec3 normal, out vec3 right, out vec3 up)
+{
+	// rotate cone around the normal
+	vec3 guide = vec3(0.0f, 1.0f, 0.0f);
+	if (abs(dot(normal, guide)) == 1.0f)
+	  guide = vec3(0.0f, 0.0f, 1.0f);
+
+	// find a tangent and a bitangent
+	right = normalize(guide - dot(normal, guide) * normal);
+	up = cross(right, normal);
+}
+
+vec3 get_diffuse_cone_direction(int i, vec3 normal, vec3 right, vec3 up)
+{
+	return normalize(DIFFUSE_CONE_DIRECTIONS[i].x * right + DIFFUSE_CONE_DIRECTIONS[i].y * normal + DIFFUSE_CONE_DIRECTIONS[i].z * up);
+}
+
+// traces `count` diffuse cones starting from cone index `first` (wrapping around).
+// indirect diffuse and ambient occlusion only differ in the cone settings
+vec4 trace_diffuse_cones(int first, int count, Cone_Settings cone, bool shares_far_field)
+{
+	vec4 accumulated_color = vec4(0.0f);
+
+	vec3 right, up;
+	get_cone_frame(f_normal, right, up);
+
+	vec3 start_clip_pos = f_voxel_pos + (f_normal * cone.distance_offset);
+
+	for (int c = 0; c < count; c++)
+	{
+		int i = (first + c) % TOTAL_DIFFUSE_CONES;
+		vec3 coneDirection = get_diffuse_cone_direction(i, f_normal, right, up);
+
+#ifdef TILE_FAR_FIELD
+		// only trace up to where the tile's shared far field starts and composite it behind
+		vec4 far_field;
+		float far_field_distance;
+		if (shares_far_field && get_far_field(i, far_field, far_field_distance)) {
+			vec4 near_field = trace_cone(start_clip_pos, coneDirection, cone.aperture, cone.distance_offset, far_field_distance, cone.sampling_factor);
+			near_field.rgb += (1.0f - near_field.a) * far_field.rgb;
+			near_field.a += (1.0f - near_field.a) * far_field.a;
+			accumulated_color += near_field * DIFFUSE_CONE_WEIGHTS[i];
+			continue;
+		}
+#endif
+
+		accumulated_color += trace_cone(start_clip_pos, coneDirection, cone.aperture, cone.distance_offset, cone.max_distance, cone.sampling_factor) * DIFFUSE_CONE_WEIGHTS[i];
+	}
+
+	return accumulated_color;
+}
+
+vec4 calc_indirect_diffuse()
+{
+	return trace_diffuse_cones(0, TOTAL_DIFFUSE_CONES, settings.diffuse, true);
+}
+
+//
+// TEMPORAL ACCUMULATION
+// each frame traces a rotating subset of the diffuse cones (interleaved over 2x2 pixels)
+// and blends it with last frame's result reprojected with the previous view-projection.
+//
+bool fetch_history(out vec4 history)
+{
+	history = vec4(0.0f);
+
+	if (u_temporal_has_history == 0)
+		return false;
+
+	vec4 previous_clip_pos = u_previous_VP * vec4(f_world_pos, 1.0f);
+	if (previous_clip_pos.w <= 0.0f)
+		return false;
+
+	vec2 previous_tex_coords = 0.5f * (previous_clip_pos.xy / previous_clip_pos.w) + vec2(0.5f);
+	if (any(lessThan(previous_tex_coords, vec2(0.0f))) || any(greaterThan(previous_tex_coords, vec2(1.0f))))
+		return false;
+
+	vec4 previous_geometry = texture(u_tex_history_geometry, previous_tex_coords);
+	float previous_distance = distance(f_world_pos, u_previous_camera_world_position);
+
+	if (dot(previous_geometry.xyz, f_normal) < settings.temporal.normal_tolerance)
+		return false;
+	if (abs(previous_geometry.w - previous_distance) > settings.temporal.depth_tolerance * previous_distance)
+		return false;
+
+	history = texture(u_tex_history_indirect_diffuse, previous_tex_coords);
+	return true;
+}
+
+vec4 calc_accumulated_indirect_diffuse()
+{
+#ifndef FEATURE_TEMPORAL
+	return calc_indirect_diffuse();
+#else
+	vec4 history;
+	if (!fetch_history(history))
+		return calc_indirect_diffuse(); // disoccluded, trace everything so there's no noise to converge from
+
+	int rotation = u_temporal_frame_index + (f_pixel.x & 1) + 2 * (f_pixel.y & 1);
+	int first = (rotation * settings.temporal.cones_per_frame) % TOTAL_DIFFUSE_CONES;
+
+	vec4 current = trace_diffuse_cones(first, settings.temporal.cones_per_frame, settings.diffuse, true) * (float(TOTAL_DIFFUSE_CONES) / float(settings.temporal.cones_per_frame));
+	return mix(current, history, settings.temporal.history_weight);
+#endif
+}
+
+float calc_ambient_occlusion() // this is also calculated during diffuse tracing, but we can do it separately with different settings too
+{
+	return trace_diffuse_cones(0, TOTAL_DIFFUSE_CONES, settings.ao, false).a;
+}
+
+#if 0 // cook-torrance
+vec3 BRDF(vec3 light_direction, float light_distance, vec3 light_color, float strength, vec3 attenuation) 
+{
+	float attenuation_factor = attenuate(light_distance, strength, attenuation);
+
+	float mean = 0.7; // mean value of microfacet distribution
+	float scale = 0.2; // constant factor C
+
+	vec3 N = f_bump;
+	vec3 L = light_direction - f_world_pos; // to light
+	vec3 V = u_camera_world_position - f_world_pos; // to eye
+	vec3 H = normalize(L + V); // half way 
+	float n_h = dot(N,H);
+	float n_v = dot(N,V);
+	float v_h = dot(V,H);
+	float n_l = dot(N,L);
+
+	vec3 diffuse = f_albedo.rgb * max(n_l, 0);
+	diffuse *= attenuation_factor;
+
+	float fresnel = pow(1.0f + v_h, 4.0f);
+	float delta = acos(n_h);
+	float exponent = -pow((delta / mean), 2.0f);
+	float microfacets = scale * exp(exponent);
+	float term1 = 2 * n_h * n_v / v_h;
+	float term2 = 2 * n_h * n_l / v_h;
+	float selfshadow = min(1.0f, min(term1, term2));
+
+	vec3 specular = f_specular.rgb * fresnel * microfacets * selfshadow / n_v;
+	specular *= attenuation_factor;
+
+	return light_color * (diffuse + specular);
+}
+#else // blinn-phong
+vec3 BRDF(vec3 light_direction, float light_distance, vec3 light_color, float strength, vec3 attenuation)
+{
+	float attenuationFactor = attenuate(light_distance, strength, attenuation);
+
+	// diffuse
+	float diffuseFactor = max(dot(f_normal, light_direction), 0.0f);
+	vec3 diffuse = light_color * diffuseFactor * attenuationFactor;
+
+	vec3 toLight = light_direction - f_world_pos;
+	vec3 toEye = u_camera_world_position - f_world_pos;
+	vec3 halfwayUnit = normalize(toLight + toEye);
+	float shininess = f_specular.a;
+	float cosRefAngle = clamp(dot(f_normal, halfwayUnit), 0.0, 1.0);
+	cosRefAngle = pow(cosRefAngle, shininess);
+	vec3 specular = f_specular.rgb * light_color * cosRefAngle * attenuationFactor;
+
+	return (diffuse + specular);
+}
+#endif
+
+vec4 calc_direct_light()
+{
+	vec3 totalColor = vec3(0.0f);
+
+	for (int i=0; i < u_total_directional_lights; i++)
+	{
+		Directional_Light light = u_directional_lights[i];
+
+		vec3 light_direction = light.direction;
+		float light_distance = length(light_direction);
+		light_direction = normalize(light_direction);
+
+		float visibility = 1.0f; 
+#ifdef FEATURE_HARD_SHADOWS
+		visibility = sample_shadow_cascades(i, f_world_pos, settings.hard_shadow_bias);
+#endif
+#ifdef FEATURE_SOFT_SHADOWS
+		vec3 start_clip_pos = f_voxel_pos + (f_normal * settings.softshadows.distance_offset);
+		visibility *= max(0.0f, trace_shadow_cone(start_clip_pos, light_direction, 2.0f));
+#endif
+
+		totalColor += visibility * BRDF(light_direction, light_distance, light.color, light.strength, light.attenuation);
+	}
+
+	// point and spot lights, only the ones binned into this pixel's cluster. not shadowed
+	if (u_total_local_lights > 0)
+	{
+		uvec2 range = u_light_cluster_ranges[get_light_cluster(VP * vec4(f_world_pos, 1.0f))];
+		for (uint i = 0; i < range.y; i++)
+		{
+			Local_Light light = u_local_lights[u_light_indices[range.x + i]];
+
+			vec3 light_direction;
+			float intensity = get_local_light_intensity(light, f_world_pos, light_direction);
+			totalColor += BRDF(light_direction, 0.0f, light.color, intensity, vec3(1.0f, 0.0f, 0.0f)); // falloff is in the intensity
+		}
+	}
+
+	return vec4(totalColor, 1.0f);
+}
+
+void load_gbuffer(vec2 tex_coords, ivec2 pixel)
+{
+	f_pixel = pixel;
+	f_world_pos = reconstruct_world_pos(tex_coords, texture(g_depth, tex_coords).r, u_inverse_VP);
+	f_voxel_pos = (f_world_pos * u_scene_voxel_scale);
+	vec4 normals = texture(g_normal, tex_coords);
+	f_normal = decode_octahedral(normals.xy);
+	f_bump = decode_octahedral(normals.zw);
+	f_albedo = texture(g_albedo, tex_coords);
+	f_albedo.a *= GBUFFER_ALBEDO_ALPHA_SCALE;
+	f_specular = texture(g_specular, tex_coords);
+	f_specular.a = decode_shininess(f_specular.a);
+}
+
+vec4 shade() // the pixel loaded with load_gbuffer
+{
+	f_history_indirect_diffuse = vec4(0.0f);
+	f_history_geometry = vec4(f_normal, distance(f_world_pos, u_camera_world_position));
+
+	vec4 direct_diffuse_color = vec4(0.0f);
+	vec4 indirect_specular_color = vec4(0.0f);
+	vec4 indirect_diffuse_color = vec4(0.0f);
+	vec4 indirect_light = vec4(0.0f, 0.0f, 0.0f, 1.0f); // alpha component == ambient occlusion
+
+#ifdef ONLY_RENDER_AO
+#ifdef FEATURE_TRACE_AO_SEPARATELY
+	indirect_light.a = clamp(1.0f - calc_ambient_occlusion(), 0.0f, 1.0f);
+#else
+	indirect_light = calc_accumulated_indirect_diffuse();
+	f_history_indirect_diffuse = indirect_light;
+	indirect_light.a = clamp(1.0f - indirect_light.a, 0.0f, 1.0f);
+	indirect_light *= f_albedo;
+#endif
+
+	indirect_light.rgb = vec3(1.0f);
+	return vec4(indirect_light.a,indirect_light.a,indirect_light.a, 1.0f);
+#else
+#ifdef FEATURE_DIRECT_LIGHT
+	direct_diffuse_color = f_albedo * calc_direct_light();
+#endif
+
+	float ao = 0.0f;
+
+#ifdef FEATURE_DIFFUSE
+	indirect_diffuse_color = calc_accumulated_indirect_diffuse();
+	f_history_indirect_diffuse = indirect_diffuse_color;
+	ao = indirect_diffuse_color.a;
+	indirect_diffuse_color = f_albedo * settings.diffuse.result_intensity * indirect_diffuse_color;
+#endif
+
+#ifdef FEATURE_SPECULAR
+	indirect_specular_color = f_albedo * settings.specular.result_intensity * calc_indirect_specular();
+#endif
+
+	indirect_light = indirect_specular_color + indirect_diffuse_color;
+	indirect_light.a = f_albedo.a * 1.0f;
+
+#ifdef FEATURE_AO
+#if defined(FEATURE_TRACE_AO_SEPARATELY) || !defined(FEATURE_DIFFUSE)
+	indirect_light.a = clamp(1.0f - calc_ambient_occlusion(), 0.0f, 1.0f);
+#else
+	indirect_light.a = clamp(1.0f - ao, 0.0f, 1.0f);
+#endif
+#endif
+
+	vec4 ambient_light = f_albedo * vec4(u_ambient_light, 1.0f) * indirect_light.a;
+	vec3 total_light = ambient_light.rgb + (settings.direct_light_intensity * direct_diffuse_color.rgb) + indirect_light.rgb;
+
+	total_light = pow(total_light, vec3(1.0f / settings.gamma));
+	return vec4(total_light, 1.0f);
+#endif
+}
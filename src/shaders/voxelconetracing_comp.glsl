@@ -0,0 +1,128 @@
+#version 450 core
+
+#define TILE_SIZE 8 // see COMPUTE_CONE_TRACING_TILE_SIZE in voxel_cone_tracing.h
+#define TILE_PIXELS (TILE_SIZE * TILE_SIZE)
+#define TILE_FAR_FIELD
+
+// voxelconetracing_frag.glsl as a compute pass, one work group per 8x8 pixel tile.
+// neighbouring pixels trace nearly the same diffuse cones, and once a cone is wider than the tile its samples come from
+// the same coarse mips, so a coherent tile traces that far part once (one invocation per cone, from the tile's average
+// position and normal) and shares it through shared memory. each pixel only traces its own cones up to there.
+layout(local_size_x = TILE_SIZE, local_size_y = TILE_SIZE) in;
+
+#include "voxelconetracing_common.glsl"
+
+layout(rgba16f, binding = 0) uniform writeonly image2D u_output; // main color texture
+layout(rgba16f, binding = 1) uniform writeonly image2D u_output_history_indirect_diffuse; // only bound with FEATURE_TEMPORAL
+layout(rgba16f, binding = 2) uniform writeonly image2D u_output_history_geometry;
+
+uniform float u_far_field_footprint; // the far field starts where a cone is this many tiles wide, 0 = not shared
+uniform float u_far_field_normal_tolerance; // min dot(normal, tile normal) of every pixel for the tile to share
+
+shared vec4 s_voxel_pos[TILE_PIXELS]; // w = 1 if the pixel has geometry
+shared vec3 s_normal[TILE_PIXELS];
+shared vec3 s_tile_voxel_pos;
+shared vec3 s_tile_normal;
+shared float s_far_field_distance; // < 0 if the tile doesn't share
+shared vec4 s_far_field[TOTAL_DIFFUSE_CONES];
+
+bool get_far_field(int cone, out vec4 far_field, out float far_field_distance)
+{
+	far_field = s_far_field[cone];
+	far_field_distance = s_far_field_distance;
+	return s_far_field_distance >= 0.0f;
+}
+
+void setup_far_field() // first invocation of the tile
+{
+	s_far_field_distance = -1.0f;
+
+	vec3 voxel_pos_sum = vec3(0.0f);
+	vec3 normal_sum = vec3(0.0f);
+	float total_pixels = 0.0f;
+	for (int i = 0; i < TILE_PIXELS; i++) {
+		voxel_pos_sum += s_voxel_pos[i].xyz * s_voxel_pos[i].w;
+		normal_sum += s_normal[i] * s_voxel_pos[i].w;
+		total_pixels += s_voxel_pos[i].w;
+	}
+
+	if (total_pixels == 0.0f || u_far_field_footprint <= 0.0f || dot(normal_sum, normal_sum) == 0.0f)
+		return;
+
+	vec3 tile_voxel_pos = voxel_pos_sum / total_pixels;
+	vec3 tile_normal = normalize(normal_sum);
+
+	float extent = 0.0f;
+	for (int i = 0; i < TILE_PIXELS; i++) {
+		if (s_voxel_pos[i].w == 0.0f)
+			continue;
+		if (dot(s_normal[i], tile_normal) < u_far_field_normal_tolerance)
+			return; // edges and corners, every pixel traces its whole cones
+		extent = max(extent, distance(s_voxel_pos[i].xyz, tile_voxel_pos));
+	}
+
+	// diameter = 2 * aperture * distance, same clamp as trace_cone
+	float far_field_distance = u_far_field_footprint * 2.0f * extent / (2.0f * max(0.1f, settings.diffuse.aperture));
+	far_field_distance = max(far_field_distance, settings.diffuse.distance_offset);
+	if (far_field_distance >= settings.diffuse.max_distance)
+		return;
+
+	s_tile_voxel_pos = tile_voxel_pos;
+	s_tile_normal = tile_normal;
+	s_far_field_distance = far_field_distance;
+}
+
+vec4 trace_far_field(int cone)
+{
+	vec3 right, up;
+	get_cone_frame(s_tile_normal, right, up);
+	vec3 coneDirection = get_diffuse_cone_direction(cone, s_tile_normal, right, up);
+
+	vec3 start_clip_pos = s_tile_voxel_pos + (s_tile_normal * settings.diffuse.distance_offset);
+	return trace_cone(start_clip_pos, coneDirection, settings.diffuse.aperture, s_far_field_distance, settings.diffuse.max_distance, settings.diffuse.sampling_factor);
+}
+
+void main()
+{
+	ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+	ivec2 size = imageSize(u_output);
+	uint index = gl_LocalInvocationIndex;
+
+	bool has_geometry = all(lessThan(pixel, size)) && texelFetch(g_depth, pixel, 0).r < 1.0f;
+	if (has_geometry)
+		load_gbuffer((vec2(pixel) + vec2(0.5f)) / vec2(size), pixel);
+
+	s_voxel_pos[index] = vec4(f_voxel_pos, has_geometry ? 1.0f : 0.0f);
+	s_normal[index] = f_normal;
+	barrier();
+
+#ifdef TRACES_DIFFUSE_CONES
+	if (index == 0)
+		setup_far_field();
+	barrier();
+
+	if (s_far_field_distance >= 0.0f && index < TOTAL_DIFFUSE_CONES)
+		s_far_field[index] = trace_far_field(int(index));
+	barrier();
+#else
+	if (index == 0)
+		s_far_field_distance = -1.0f;
+	barrier();
+#endif
+
+	if (any(greaterThanEqual(pixel, size)))
+		return;
+
+	// background matches the tiled fragment pass, which clears to black and no history geometry
+	vec4 color = vec4(0.0f, 0.0f, 0.0f, 1.0f);
+	f_history_indirect_diffuse = vec4(0.0f);
+	f_history_geometry = vec4(0.0f);
+	if (has_geometry)
+		color = shade();
+
+	imageStore(u_output, pixel, color);
+#ifdef FEATURE_TEMPORAL
+	imageStore(u_output_history_indirect_diffuse, pixel, f_history_indirect_diffuse);
+	imageStore(u_output_history_geometry, pixel, f_history_geometry);
+#endif
+}
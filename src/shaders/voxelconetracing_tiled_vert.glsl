@@ -0,0 +1,39 @@
+#version 450 core
+
+#define TOTAL_TILE_CLASSES 4
+
+// input is a full screen unit quad, instanced once per tile of the current class (see tileclassification_comp.glsl)
+layout (location = 0) in vec3 v_position;
+layout (location = 1) in vec3 v_normal;
+layout (location = 2) in vec3 v_color;
+layout (location = 3) in vec2 v_tex_coords;
+
+struct Draw_Command
+{
+	uint count;
+	uint instance_count;
+	uint first;
+	uint base_instance;
+};
+
+layout(std430, binding = 0) readonly buffer Tiles
+{
+	Draw_Command u_commands[TOTAL_TILE_CLASSES];
+	uint u_tiles[];
+};
+
+uniform int u_tile_class;
+uniform int u_max_tiles;
+uniform vec2 u_tile_scale; // tile size in texture coordinates
+
+out vec2 f_tex_coords;
+
+void main()
+{
+	uint tile = u_tiles[u_tile_class * u_max_tiles + gl_InstanceID];
+	vec2 tile_origin = vec2(tile & 0xffffu, tile >> 16);
+
+	// edge tiles are cut at the screen border
+	f_tex_coords = min((tile_origin + v_tex_coords) * u_tile_scale, vec2(1.0f));
+	gl_Position = vec4(f_tex_coords * 2.0f - 1.0f, v_position.z, 1.0f);
+}
@@ -1,5 +1,7 @@
 #version 450 core
-#define MAX_POINT_LIGHTS 4
+#ifdef MULTI_DRAW
+#include "multi_draw.glsl"
+#endif
 #define MAX_DIRECTIONAL_LIGHTS 4
 
 struct Voxelization_Settings
@@ -23,28 +25,47 @@ struct Material
 	vec3 Ke;
 };
 
+#include "shadow_cascades.glsl"
+#include "local_lights.glsl"
+
 layout(RGBA8) uniform image3D u_tex_voxelgrid;
-uniform sampler2DShadow u_tex_shadowmap;
 
-uniform Voxelization_Settings u_settings;
+layout(std140, binding = 3) uniform Voxelization_Block // see Voxelization_Settings_Std140 in voxel_cone_tracing.h
+{
+	Voxelization_Settings u_settings;
+};
+
+#ifdef MULTI_DRAW
+flat in uint f_material;
+#define u_material u_materials[f_material]
+#define u_tex_diffuse u_material.map_Kd
+#else
 uniform Material u_material;
 uniform sampler2D u_tex_ambient;
 uniform sampler2D u_tex_diffuse;
+
+vec4 material_texture(sampler2D tex, vec2 tex_coords)
+{
+	return texture(tex, tex_coords);
+}
+#endif
 //uniform sampler2D u_tex_emission;
 
-uniform	vec3 u_ambient_light;
-uniform int u_total_directional_lights;
-uniform Directional_Light u_directional_lights[MAX_DIRECTIONAL_LIGHTS];
+layout(std140, binding = 1) uniform Lights_Block // see Scene_Lights_Std140 in scene.h
+{
+	vec3 u_ambient_light;
+	int u_total_directional_lights;
+	Directional_Light u_directional_lights[MAX_DIRECTIONAL_LIGHTS];
+};
 
 uniform vec3 u_scene_voxel_scale;
 
 in vec3 f_normal;
 in vec2 f_tex_coords;
 in vec3 f_voxel_pos;
-in vec4 f_shadow_coords;
+in vec3 f_world_pos;
 
 vec4  f_albedo = vec4(0.0f);
-float f_visibility = 1.0f; // calculated from shadow map
 
 float attenuate(float dist, float strength, vec3 attenuation) {
 	return strength / (attenuation.x + attenuation.y * dist + attenuation.z * dist * dist);
@@ -58,10 +79,10 @@ vec3 from_clipspace_to_texcoords(vec3 p) {
 	return 0.5f * p + vec3(0.5f); 
 }
 
-float calc_visibility()
+float calc_visibility(int light)
 {
 	const float bias = 0.005f;
-	return texture(u_tex_shadowmap, vec3(f_shadow_coords.xy, (f_shadow_coords.z - bias) / f_shadow_coords.w));
+	return sample_shadow_cascades(light, f_world_pos, bias);
 }
 
 vec3 BRDF(vec3 lightDir, vec3 color, float strength, vec3 attenuation)
@@ -80,7 +101,14 @@ vec3 calc_direct_light()
 	
 	for (int i=0; i < u_total_directional_lights; i++) {
 		Directional_Light light = u_directional_lights[i];
-		color += (f_visibility * BRDF(normalize(light.direction), light.color, light.strength, light.attenuation));
+		color += (calc_visibility(i) * BRDF(normalize(light.direction), light.color, light.strength, light.attenuation));
+	}
+
+	// every point and spot light, the voxel grid isn't clustered. injected here so they bounce like the sun
+	for (uint i = 0; i < u_total_local_lights; i++) {
+		vec3 light_direction;
+		float intensity = get_local_light_intensity(u_local_lights[i], f_world_pos, light_direction);
+		color += BRDF(light_direction, u_local_lights[i].color, intensity, vec3(1.0f, 0.0f, 0.0f));
 	}
 
 	return color;
@@ -91,8 +119,7 @@ void main()
 	if (!is_inside_clipspace(f_voxel_pos))
 		return;
 
-	f_visibility = calc_visibility();
-	f_albedo = vec4(u_material.Kd, 1.0) * texture(u_tex_diffuse, f_tex_coords);
+	f_albedo = vec4(u_material.Kd, 1.0) * material_texture(u_tex_diffuse, f_tex_coords);
 
 	vec4 color = f_albedo * vec4(calc_direct_light(), 1.0f);
 	color.a = 1.0;
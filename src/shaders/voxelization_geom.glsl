@@ -3,15 +3,17 @@
 layout(triangles) in;
 layout(triangle_strip, max_vertices = 3) out;
 
-uniform mat4 u_shadowmap_mvp;
-
 in vec4 g_world_pos[];
 in vec3 g_normal[];
 in vec2 g_tex_coords[];
+#ifdef MULTI_DRAW
+flat in uint g_material[];
+flat out uint f_material;
+#endif
 out vec3 f_normal;
 out vec2 f_tex_coords;
 out vec3 f_voxel_pos; // world coordinates scaled to clip space (-1...1)
-out vec4 f_shadow_coords;
+out vec3 f_world_pos; // the shadow cascade is picked per fragment
 
 void main()
 {
@@ -48,9 +50,12 @@ void main()
 		gl_Position = vec4(gl_in[i].gl_Position.xyz * swizzle_mat, 1.0f);
 
 		f_voxel_pos = gl_in[i].gl_Position.xyz;	
-		f_shadow_coords = u_shadowmap_mvp * g_world_pos[i];
+		f_world_pos = g_world_pos[i].xyz;
 		f_normal = g_normal[i];
 		f_tex_coords = g_tex_coords[i];
+#ifdef MULTI_DRAW
+		f_material = g_material[i];
+#endif
 
 		EmitVertex();
 	}
@@ -1,7 +1,13 @@
 #version 450 core
 
+#ifdef MULTI_DRAW
+#include "multi_draw.glsl"
+layout (location = 6) in uint v_draw_id; // see MULTI_DRAW_ID_ATTRIBUTE in multi_draw.h
+flat out uint g_material;
+#else
 uniform mat4 M;
 uniform mat4 N; // (normal matrix)
+#endif
 uniform vec3 u_scene_voxel_scale;
 
 layout (location = 0) in vec3 v_position;
@@ -16,6 +22,12 @@ out vec2 g_tex_coords;
 
 void main()
 {
+#ifdef MULTI_DRAW
+	mat4 M = u_draws[v_draw_id].M;
+	mat4 N = u_draws[v_draw_id].N;
+	g_material = u_draws[v_draw_id].material;
+#endif
+
 	g_world_pos = M * vec4(v_position, 1.0f);
 	g_normal = normalize(vec3(N * vec4(v_normal, 0.0)));
 	g_color = v_color;
@@ -6,11 +6,20 @@ struct Voxelization_Settings
 	int visualize_mipmap_level;
 };
 
-uniform Voxelization_Settings u_settings;
+layout(std140, binding = 3) uniform Voxelization_Block // see Voxelization_Settings_Std140 in voxel_cone_tracing.h
+{
+	Voxelization_Settings u_settings;
+};
+
 uniform sampler3D u_tex_voxelgrid;
 uniform sampler2D u_tex_cube_back;
 uniform sampler2D u_tex_cube_front;
-uniform vec3 u_camera_world_position;
+
+layout(std140, binding = 0) uniform Camera_Block // see Camera_Std140 in camera.h
+{
+	mat4 VP;
+	vec3 u_camera_world_position;
+};
 
 in vec2 f_tex_coords;
 in vec3 f_world_pos;
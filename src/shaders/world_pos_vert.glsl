@@ -3,7 +3,12 @@
 layout(location = 0) in vec3 v_position;
 
 uniform mat4 M;
-uniform mat4 VP;
+
+layout(std140, binding = 0) uniform Camera_Block // see Camera_Std140 in camera.h
+{
+	mat4 VP;
+	vec3 u_camera_world_position;
+};
 
 out vec3 f_world_pos;
 
@@ -27,6 +27,7 @@ namespace vxgi {
 using glm::vec2;
 using glm::vec3;
 using glm::vec4;
+using glm::ivec2;
 using glm::mat4;
 
 typedef unsigned char       u8;
@@ -113,6 +114,7 @@ namespace vxgi
 	struct Texture2D;
 	struct Scene;
 	struct Scene_Lights;
+	struct Scene_Lights_Std140;
 	struct Material;
 	struct Mesh;
 	struct Camera;
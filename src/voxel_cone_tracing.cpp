@@ -6,43 +6,382 @@ namespace vxgi
 {
 	namespace
 	{
-		void ApertureSlider(float* output, float min = 1.0f, float max = 179.0f);
-		void VoxelDistanceSlider(const char* title, float* output, int voxel_grid_resolution, float min = 1.0f);
+		bool ApertureSlider(float* output, float min = 1.0f, float max = 179.0f);
+		bool VoxelDistanceSlider(const char* title, float* output, int voxel_grid_resolution, float min = 1.0f);
 	}
 
 	namespace vct
 	{
-		void upload_voxelization_settings(GLuint shader_id, Voxelization_Settings& settings)
+		void upload_voxelization_settings(Uniform_Buffer& ubo, Voxelization_Settings& settings)
 		{
-			glUniform1i(glGetUniformLocation(shader_id, "u_settings.use_ambient_light"), settings.use_ambient_light);
-			glUniform1i(glGetUniformLocation(shader_id, "u_settings.visualize_mipmap_level"), settings.visualize_mipmap_level);
+			Voxelization_Settings_Std140 block = {};
+			block.use_ambient_light = settings.use_ambient_light;
+			block.visualize_mipmap_level = settings.visualize_mipmap_level;
+
+			uniformbuffer::upload(ubo, &block, sizeof(block));
+		}
+
+		void upload_cone_tracing_settings(Uniform_Buffer& ubo, Cone_Tracing_Shader_Settings& settings, int voxel_grid_resolution)
+		{
+			Cone_Tracing_Settings_Std140 block = {};
+			pack_cone_tracing_settings(block, settings, voxel_grid_resolution);
+
+			uniformbuffer::upload(ubo, &block, sizeof(block));
 		}
 
-		void upload_cone_tracing_settings(GLuint shader_id, Cone_Tracing_Shader_Settings& settings, int voxel_grid_resolution)
+		void pack_cone_tracing_settings(Cone_Tracing_Settings_Std140& block, Cone_Tracing_Shader_Settings& settings, int voxel_grid_resolution)
 		{
-			auto upload_cone_settings = [shader_id](const std::string& name, Cone_Settings& settings) {
-				glUniform1f(glGetUniformLocation(shader_id, (name + ".aperture").c_str()), settings.aperture);
-				glUniform1f(glGetUniformLocation(shader_id, (name + ".sampling_factor").c_str()), settings.sampling_factor);
-				glUniform1f(glGetUniformLocation(shader_id, (name + ".distance_offset").c_str()), settings.distance_offset);
-				glUniform1f(glGetUniformLocation(shader_id, (name + ".max_distance").c_str()), settings.max_distance);
-				glUniform1f(glGetUniformLocation(shader_id, (name + ".result_intensity").c_str()), settings.result_intensity);
-				glUniform1i(glGetUniformLocation(shader_id, (name + ".is_enabled").c_str()), settings.is_enabled);
+			auto pack_cone_settings = [](Cone_Settings_Std140& out, Cone_Settings& settings) {
+				out.aperture = settings.aperture;
+				out.sampling_factor = settings.sampling_factor;
+				out.distance_offset = settings.distance_offset;
+				out.max_distance = settings.max_distance;
+				out.result_intensity = settings.result_intensity;
+				out.is_enabled = settings.is_enabled;
 			};
 
-			upload_cone_settings("settings.diffuse", settings.diffuse_settings);
-			upload_cone_settings("settings.specular", settings.specular_settings);
-			upload_cone_settings("settings.softshadows", settings.soft_shadows_settings);
-			upload_cone_settings("settings.ao", settings.ao_settings);
+			pack_cone_settings(block.diffuse, settings.diffuse_settings);
+			pack_cone_settings(block.specular, settings.specular_settings);
+			pack_cone_settings(block.softshadows, settings.soft_shadows_settings);
+			pack_cone_settings(block.ao, settings.ao_settings);
+
+			block.direct_light_intensity = settings.direct_light_intensity;
+			block.trace_ao_separately = settings.trace_ao_separately;
+			block.voxel_grid_resolution = voxel_grid_resolution;
+			block.voxel_size = 1.0f / float(voxel_grid_resolution);
+			block.max_mipmap_level = log2(voxel_grid_resolution);
+			block.gamma = settings.gamma;
+			block.hard_shadow_bias = settings.hard_shadow_bias;
+			block.enable_direct_light = settings.enable_direct_light;
+			block.enable_hard_shadows = settings.enable_hard_shadows;
+			block.diffuse_cone_set = s32(settings.diffuse_cone_set);
+
+			Temporal_Settings& temporal = settings.temporal_settings;
+			block.temporal.is_enabled = temporal.is_enabled;
+			block.temporal.cones_per_frame = glm::clamp(temporal.cones_per_frame, 1, DIFFUSE_CONE_SETS[settings.diffuse_cone_set].total_cones);
+			block.temporal.history_weight = temporal.history_weight;
+			block.temporal.depth_tolerance = temporal.depth_tolerance;
+			block.temporal.normal_tolerance = temporal.normal_tolerance;
+		}
+
+		void upload_temporal_settings(GLuint shader_id, Temporal_Settings& settings, Cone_Tracing_History& history, int total_diffuse_cones, int texture_location_offset)
+		{
+			int read_index = 1 - history.current;
+
+			// always bound, samplers left on unit 0 would clash with the voxel grid
+			texture::activate(history.textures[read_index][Cone_Tracing_History::INDIRECT_DIFFUSE], shader_id, SHADER_UNIFORM_TEX_HISTORY_INDIRECT_DIFFUSE, texture_location_offset + 0);
+			texture::activate(history.textures[read_index][Cone_Tracing_History::GEOMETRY], shader_id, SHADER_UNIFORM_TEX_HISTORY_GEOMETRY, texture_location_offset + 1);
+
+			// the settings themselves are in the cone tracing uniform buffer, this is the per-frame state
+			if (!settings.is_enabled)
+				return;
+
+			glUniform1i(shader::uniform_location(shader_id, SHADER_UNIFORM_TEMPORAL_HAS_HISTORY), history.is_valid);
+			glUniform1i(shader::uniform_location(shader_id, SHADER_UNIFORM_TEMPORAL_FRAME_INDEX), int(history.frame_index % u32(total_diffuse_cones)));
+			glUniformMatrix4fv(shader::uniform_location(shader_id, SHADER_UNIFORM_PREVIOUS_VP), 1, GL_FALSE, glm::value_ptr(history.previous_VP));
+			glUniform3fv(shader::uniform_location(shader_id, SHADER_UNIFORM_PREVIOUS_CAMERA_WORLD_POSITION), 1, glm::value_ptr(history.previous_camera_position));
+		}
+
+		void init_history(Cone_Tracing_History& history, GLuint color_texture_id, int w, int h)
+		{
+			GLenum drawBuffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2 };
+
+			for (int i = 0; i < 2; i++)
+			{
+				glGenFramebuffers(1, &history.fbos[i]);
+				glBindFramebuffer(GL_FRAMEBUFFER, history.fbos[i]);
+				glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, color_texture_id, 0);
+
+				// bilinear for the reprojected lighting, nearest for the rejection data
+				texture::init(history.textures[i][Cone_Tracing_History::INDIRECT_DIFFUSE], NULL, w,h, GL_RGBA16F,GL_RGBA,GL_FLOAT, GL_LINEAR,GL_LINEAR, GL_CLAMP_TO_EDGE,GL_CLAMP_TO_EDGE, false, true, GL_COLOR_ATTACHMENT1, 0);
+				texture::init(history.textures[i][Cone_Tracing_History::GEOMETRY], NULL, w,h, GL_RGBA16F,GL_RGBA,GL_FLOAT, GL_NEAREST,GL_NEAREST, GL_CLAMP_TO_EDGE,GL_CLAMP_TO_EDGE, false, true, GL_COLOR_ATTACHMENT2, 0);
+
+				glDrawBuffers(SIZE_OF_STATIC_ARRAY(drawBuffers), drawBuffers);
+				ASSERT(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE, "vct", "failed to initialize history fbo");
+			}
+
+			glBindFramebuffer(GL_FRAMEBUFFER, 0);
+			check_gl_error();
+
+			history.current = 0;
+			history.is_valid = false;
+		}
+
+		void uninit_history(Cone_Tracing_History& history)
+		{
+			for (int i = 0; i < 2; i++) {
+				for (int t = 0; t < Cone_Tracing_History::TOTAL_HISTORY_TEXTURES; t++)
+					texture::uninit(history.textures[i][t]);
+				glDeleteFramebuffers(1, &history.fbos[i]);
+			}
+		}
+
+		void advance_history(Cone_Tracing_History& history, Camera& camera)
+		{
+			history.previous_VP = camera.VP;
+			history.previous_camera_position = camera.position;
+			history.current = 1 - history.current;
+			history.frame_index++;
+			history.is_valid = true;
+		}
+
+		void init_tiles(Tile_Classification& tiles, int w, int h)
+		{
+			tiles.tiles_x = (w + TILE_SIZE - 1) / TILE_SIZE;
+			tiles.tiles_y = (h + TILE_SIZE - 1) / TILE_SIZE;
+
+			// every class can hold every tile, so the compute pass never has to bounds check
+			umm max_tiles = umm(tiles.tiles_x * tiles.tiles_y);
+			umm size = sizeof(Tile_Classification::Draw_Command) * Tile_Classification::TOTAL_TILE_CLASSES + sizeof(u32) * max_tiles * Tile_Classification::TOTAL_TILE_CLASSES;
+
+			glGenBuffers(1, &tiles.ssbo);
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, tiles.ssbo);
+			glBufferData(GL_SHADER_STORAGE_BUFFER, size, NULL, GL_DYNAMIC_DRAW);
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+			check_gl_error();
+
+			LOG("vct", "tile classification %dx%d tiles (%dpx)", tiles.tiles_x, tiles.tiles_y, TILE_SIZE);
+		}
+
+		void uninit_tiles(Tile_Classification& tiles)
+		{
+			glDeleteBuffers(1, &tiles.ssbo);
+			tiles.ssbo = 0;
+		}
+
+		void reset_tiles(Tile_Classification& tiles, int vertices_per_tile)
+		{
+			Tile_Classification::Draw_Command commands[Tile_Classification::TOTAL_TILE_CLASSES];
+			for (Tile_Classification::Draw_Command& c : commands)
+				c = { u32(vertices_per_tile), 0, 0, 0 };
+
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, tiles.ssbo);
+			glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(commands), commands);
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+		}
+
+		void upload_tile_settings(GLuint shader_id, Tile_Classification& tiles, int w, int h)
+		{
+			glUniform1i(shader::uniform_location(shader_id, SHADER_UNIFORM_MAX_TILES), tiles.tiles_x * tiles.tiles_y);
+			glUniform2f(shader::uniform_location(shader_id, SHADER_UNIFORM_TILE_SCALE), float(TILE_SIZE) / float(w), float(TILE_SIZE) / float(h));
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, tiles.ssbo);
+		}
+
+		void draw_tiles(GLuint shader_id, Tile_Classification& tiles, Mesh& tile_mesh, int tile_class)
+		{
+			glBindVertexArray(tile_mesh.vao);
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, tiles.ssbo);
+
+			// instanced, the instance count was written by the classification pass
+			glUniform1i(shader::uniform_location(shader_id, SHADER_UNIFORM_TILE_CLASS), tile_class);
+			glDrawArraysIndirect(GL_TRIANGLES, (const void*) (sizeof(Tile_Classification::Draw_Command) * tile_class));
+
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+			glBindVertexArray(0);
+		}
+
+		u32 get_tile_class_mask(u32 feature_mask, int tile_class)
+		{
+			u32 features = u32(tile_class) << 1; // see Tile_Classification::TOTAL_TILE_CLASSES
+			if (!(features & Tile_Classification::TILE_FEATURE_SOFT_SHADOWS))
+				feature_mask &= ~CONE_TRACING_FEATURE_SOFT_SHADOWS;
+
+			// unless that makes it the ao only variant, which shades differently. then the specular cones are traced on
+			// tiles that don't need them, they add nothing there
+			u32 without_specular = feature_mask & ~CONE_TRACING_FEATURE_SPECULAR;
+			if (!(features & Tile_Classification::TILE_FEATURE_SPECULAR) && !is_only_ao(without_specular))
+				feature_mask = without_specular;
+			return feature_mask;
+		}
+
+		void read_tile_stats(Tile_Classification& tiles)
+		{
+			Tile_Classification::Draw_Command commands[Tile_Classification::TOTAL_TILE_CLASSES];
+
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, tiles.ssbo);
+			glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(commands), commands);
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+			for (int i = 0; i < Tile_Classification::TOTAL_TILE_CLASSES; i++)
+				tiles.tiles_per_class[i] = commands[i].instance_count;
+		}
+
+		void init_empty_space(Empty_Space_Field& field, int voxel_grid_resolution)
+		{
+			int dimensions = voxel_grid_resolution / EMPTY_SPACE_CELL_SIZE;
+			if (field.dimensions == dimensions)
+				return;
+
+			uninit_empty_space(field);
+			field.dimensions = dimensions;
+
+			glGenTextures(2, field.textures);
+			for (GLuint texture : field.textures)
+			{
+				glBindTexture(GL_TEXTURE_3D, texture);
+				glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+				glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+				glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+				glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+				glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+				glTexStorage3D(GL_TEXTURE_3D, 1, GL_R8UI, dimensions, dimensions, dimensions);
+			}
+			glBindTexture(GL_TEXTURE_3D, 0);
+			check_gl_error();
+
+			LOG("vct", "empty space field %d^3 cells (%d^3 voxels each)", dimensions, EMPTY_SPACE_CELL_SIZE);
+		}
+
+		void uninit_empty_space(Empty_Space_Field& field)
+		{
+			if (field.dimensions == 0)
+				return;
+
+			glDeleteTextures(2, field.textures);
+			field.textures[0] = field.textures[1] = 0;
+			field.dimensions = 0;
+		}
+
+		void build_empty_space(Empty_Space_Field& field, Shader_Program& shader, Texture3D& voxel_grid)
+		{
+			init_empty_space(field, voxel_grid.dimensions);
+
+			glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT); // voxelization image stores
+
+			GLuint shader_id = shader::activate(shader);
+			texture3D::activate(voxel_grid, shader_id, SHADER_UNIFORM_TEX_VOXELGRID, 0);
+
+			// occupancy into [1], then x: [1] -> [0], y: [0] -> [1], z: [1] -> [0]
+			int groups = (field.dimensions + 3) / 4;
+			for (int pass = 0; pass < 4; pass++)
+			{
+				GLuint output = field.textures[(pass + 1) % 2];
+				GLuint input = field.textures[pass % 2];
+
+				glUniform1i(shader::uniform_location(shader_id, SHADER_UNIFORM_EMPTY_SPACE_PASS), pass);
+				glBindImageTexture(0, input, 0, GL_TRUE, 0, GL_READ_ONLY, GL_R8UI);
+				glBindImageTexture(1, output, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_R8UI);
+				glDispatchCompute(groups, groups, groups);
+				glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+			}
 
-			glUniform1f(glGetUniformLocation(shader_id, "settings.direct_light_intensity"), settings.direct_light_intensity);
-			glUniform1i(glGetUniformLocation(shader_id, "settings.trace_ao_separately"), settings.trace_ao_separately);
-			glUniform1i(glGetUniformLocation(shader_id, "settings.voxel_grid_resolution"), voxel_grid_resolution);
-			glUniform1f(glGetUniformLocation(shader_id, "settings.voxel_size"), 1.0f / float(voxel_grid_resolution));
-			glUniform1i(glGetUniformLocation(shader_id, "settings.max_mipmap_level"), log2(voxel_grid_resolution));
-			glUniform1f(glGetUniformLocation(shader_id, "settings.gamma"), settings.gamma);
-			glUniform1f(glGetUniformLocation(shader_id, "settings.hard_shadow_bias"), settings.hard_shadow_bias);
-			glUniform1i(glGetUniformLocation(shader_id, "settings.enable_direct_light"), settings.enable_direct_light);
-			glUniform1i(glGetUniformLocation(shader_id, "settings.enable_hard_shadows"), settings.enable_hard_shadows);
+			glBindImageTexture(0, 0, 0, GL_TRUE, 0, GL_READ_ONLY, GL_R8UI);
+			glBindImageTexture(1, 0, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_R8UI);
+			texture3D::deactivate();
+			shader::deactivate();
+			check_gl_error();
+		}
+
+		void upload_empty_space(GLuint shader_id, Empty_Space_Field& field, int texture_location)
+		{
+			glUniform1i(shader::uniform_location(shader_id, SHADER_UNIFORM_TEX_EMPTY_SPACE), texture_location);
+			glActiveTexture(GL_TEXTURE0 + texture_location);
+			glBindTexture(GL_TEXTURE_3D, field.textures[0]);
+		}
+
+		void init_step_counters(Cone_Step_Counters& counters)
+		{
+			glGenBuffers(1, &counters.ssbo);
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, counters.ssbo);
+			glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(Cone_Step_Counters::Counters), NULL, GL_DYNAMIC_READ);
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+		}
+
+		void uninit_step_counters(Cone_Step_Counters& counters)
+		{
+			glDeleteBuffers(1, &counters.ssbo);
+			counters.ssbo = 0;
+		}
+
+		void reset_step_counters(Cone_Step_Counters& counters)
+		{
+			Cone_Step_Counters::Counters zero = {};
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, counters.ssbo);
+			glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(zero), &zero);
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, counters.ssbo);
+		}
+
+		void read_step_counters(Cone_Step_Counters& counters)
+		{
+			glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, counters.ssbo);
+			glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(counters.last_frame), &counters.last_frame);
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+		}
+
+		void upload_compute_settings(GLuint shader_id, Compute_Cone_Tracing& compute)
+		{
+			glUniform1f(shader::uniform_location(shader_id, SHADER_UNIFORM_FAR_FIELD_FOOTPRINT), compute.share_far_field ? compute.far_field_footprint : 0.0f);
+			glUniform1f(shader::uniform_location(shader_id, SHADER_UNIFORM_FAR_FIELD_NORMAL_TOLERANCE), compute.far_field_normal_tolerance);
+		}
+
+		void dispatch_compute(GLuint color_texture_id, Cone_Tracing_History& history, bool writes_history, int w, int h)
+		{
+			glBindImageTexture(0, color_texture_id, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+			if (writes_history) {
+				glBindImageTexture(1, history.textures[history.current][Cone_Tracing_History::INDIRECT_DIFFUSE].id, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+				glBindImageTexture(2, history.textures[history.current][Cone_Tracing_History::GEOMETRY].id, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+			}
+
+			int tiles_x = (w + COMPUTE_CONE_TRACING_TILE_SIZE - 1) / COMPUTE_CONE_TRACING_TILE_SIZE;
+			int tiles_y = (h + COMPUTE_CONE_TRACING_TILE_SIZE - 1) / COMPUTE_CONE_TRACING_TILE_SIZE;
+			glDispatchCompute(tiles_x, tiles_y, 1);
+
+			// the color is blitted to the window, the history is sampled next frame
+			glMemoryBarrier(GL_FRAMEBUFFER_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+
+			for (GLuint unit = 0; unit < 3; unit++)
+				glBindImageTexture(unit, 0, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+		}
+
+		u32 get_feature_mask(Cone_Tracing_Shader_Settings& settings)
+		{
+			u32 mask = 0;
+			if (settings.enable_direct_light)                mask |= CONE_TRACING_FEATURE_DIRECT_LIGHT;
+			if (settings.diffuse_settings.is_enabled)        mask |= CONE_TRACING_FEATURE_DIFFUSE;
+			if (settings.specular_settings.is_enabled)       mask |= CONE_TRACING_FEATURE_SPECULAR;
+			if (settings.soft_shadows_settings.is_enabled)   mask |= CONE_TRACING_FEATURE_SOFT_SHADOWS;
+			if (settings.ao_settings.is_enabled)             mask |= CONE_TRACING_FEATURE_AO;
+			if (settings.trace_ao_separately)                mask |= CONE_TRACING_FEATURE_TRACE_AO_SEPARATELY;
+			if (settings.enable_hard_shadows)                mask |= CONE_TRACING_FEATURE_HARD_SHADOWS;
+			if (settings.temporal_settings.is_enabled)       mask |= CONE_TRACING_FEATURE_TEMPORAL;
+			mask |= u32(settings.diffuse_cone_set) << CONE_TRACING_CONE_SET_SHIFT;
+			return mask;
+		}
+		u32 get_feature_mask(Cone_Tracing_Shader_Settings& settings, Empty_Space_Field& field, Cone_Step_Counters& counters)
+		{
+			u32 mask = get_feature_mask(settings);
+			if (field.is_enabled)                            mask |= CONE_TRACING_FEATURE_EMPTY_SPACE_SKIPPING;
+			if (counters.is_enabled)                         mask |= CONE_TRACING_FEATURE_STEP_COUNTERS;
+			return mask;
+		}
+		bool is_only_ao(u32 feature_mask)
+		{
+			return (feature_mask & (CONE_TRACING_FEATURE_DIRECT_LIGHT | CONE_TRACING_FEATURE_DIFFUSE | CONE_TRACING_FEATURE_SPECULAR)) == 0;
+		}
+
+		void append_cone_set_defines(u32 feature_mask, std::string& defines)
+		{
+			u32 cone_set = glm::min(feature_mask >> CONE_TRACING_CONE_SET_SHIFT, u32(TOTAL_DIFFUSE_CONE_SETS - 1));
+			const Diffuse_Cone_Set& set = DIFFUSE_CONE_SETS[cone_set];
+
+			// array initializer lists for DIFFUSE_CONE_DIRECTIONS and DIFFUSE_CONE_WEIGHTS in voxelconetracing_common.glsl
+			char buffer[128];
+			std::string directions;
+			std::string weights;
+			for (int i = 0; i < set.total_cones; i++) {
+				const char* separator = (i + 1 < set.total_cones) ? ", " : "";
+				snprintf(buffer, sizeof(buffer), "vec3(%.9g, %.9g, %.9g)%s", set.directions[i][0], set.directions[i][1], set.directions[i][2], separator);
+				directions += buffer;
+				snprintf(buffer, sizeof(buffer), "%.9g%s", set.weights[i], separator);
+				weights += buffer;
+			}
+
+			snprintf(buffer, sizeof(buffer), "#define DIFFUSE_CONE_SET_SIZE %d\n", set.total_cones);
+			defines += buffer;
+			defines += "#define DIFFUSE_CONE_SET_DIRECTIONS " + directions + "\n";
+			defines += "#define DIFFUSE_CONE_SET_WEIGHTS " + weights + "\n";
 		}
 
 		float get_aperture(float degrees) {
@@ -57,6 +396,9 @@ namespace vxgi
 			if (Checkbox("use ambient light", &settings.use_ambient_light)) was_clicked = true;
 			if (SliderInt("visualization mipmap level", &settings.visualize_mipmap_level, 0, log2(VOXELGRID_RESOLUTIONS[TOTAL_VOXELGRID_RESOLUTIONS - 1]))) was_clicked = true;
 
+			if (was_clicked)
+				settings.is_dirty = true;
+
 			return was_clicked;
 		}
 
@@ -64,64 +406,99 @@ namespace vxgi
 		{
 			using namespace ImGui;
 
+			bool changed = false;
+
 			auto draw_cone_settings = [voxel_grid_resolution](const char* name, Cone_Settings& settings) {
+				bool changed = false;
 				PushID(name);
 
 				Text("%s", name);
-				Checkbox("is_enabled", &settings.is_enabled);
-				ApertureSlider(&settings.aperture, 1.0f, 179.0f);
-				SliderFloat("sampling_factor", &settings.sampling_factor, 0.1f, 2.0f);
-				VoxelDistanceSlider("distance_offset", &settings.distance_offset, voxel_grid_resolution);
-				SliderFloat("max_distance", &settings.max_distance, 0.00001f, 2.0f);
-				SliderFloat("result_intensity", &settings.result_intensity, 0.0f, 10.0f);
+				changed |= Checkbox("is_enabled", &settings.is_enabled);
+				changed |= ApertureSlider(&settings.aperture, 1.0f, 179.0f);
+				changed |= SliderFloat("sampling_factor", &settings.sampling_factor, 0.1f, 2.0f);
+				changed |= VoxelDistanceSlider("distance_offset", &settings.distance_offset, voxel_grid_resolution);
+				changed |= SliderFloat("max_distance", &settings.max_distance, 0.00001f, 2.0f);
+				changed |= SliderFloat("result_intensity", &settings.result_intensity, 0.0f, 10.0f);
 				//SliderInt("direction mode", &diffuseConeDirectionMode, 1, 4);
 				//SliderInt("weight mode", &diffuseConeWeightMode, 1, 2);
 
 				PopID();
+				return changed;
 			};
 
-			draw_cone_settings("Indirect diffuse", settings.diffuse_settings);
-			draw_cone_settings("Indirect specular", settings.specular_settings);
-			draw_cone_settings("Soft shadows", settings.soft_shadows_settings);
+			// the apertures follow the cone count, they can still be tweaked afterwards
+			const char* cone_set_names[TOTAL_DIFFUSE_CONE_SETS] = { "3", "4", "5", "6", "9", "16" };
+			int cone_set = int(settings.diffuse_cone_set);
+			if (Combo("diffuse cones", &cone_set, cone_set_names, TOTAL_DIFFUSE_CONE_SETS)) {
+				settings.diffuse_cone_set = DIFFUSE_CONE_SET(cone_set);
+				settings.diffuse_settings.aperture = DIFFUSE_CONE_SETS[cone_set].aperture;
+				settings.ao_settings.aperture = DIFFUSE_CONE_SETS[cone_set].aperture;
+				changed = true;
+			}
+			if (IsItemHovered())
+				SetTooltip("%d cones, %.1f degrees", DIFFUSE_CONE_SETS[cone_set].total_cones, 2.0f * RADIANS_TO_DEGREES * atanf(DIFFUSE_CONE_SETS[cone_set].aperture));
+
+			changed |= draw_cone_settings("Indirect diffuse", settings.diffuse_settings);
+			changed |= draw_cone_settings("Indirect specular", settings.specular_settings);
+			changed |= draw_cone_settings("Soft shadows", settings.soft_shadows_settings);
 
 			if (settings.trace_ao_separately) 
-				draw_cone_settings("Ambient occlusion", settings.ao_settings);
+				changed |= draw_cone_settings("Ambient occlusion", settings.ao_settings);
 			else
 				Text("Ambient occlusion");
-			Checkbox("trace ao separately", &settings.trace_ao_separately);
+			changed |= Checkbox("trace ao separately", &settings.trace_ao_separately);
+
+			PushID("Temporal accumulation");
+			Text("Temporal accumulation");
+			Temporal_Settings& temporal = settings.temporal_settings;
+			changed |= Checkbox("is_enabled", &temporal.is_enabled);
+			changed |= SliderInt("diffuse cones per frame", &temporal.cones_per_frame, 1, DIFFUSE_CONE_SETS[settings.diffuse_cone_set].total_cones);
+			changed |= SliderFloat("history weight", &temporal.history_weight, 0.0f, 0.98f);
+			changed |= SliderFloat("depth tolerance", &temporal.depth_tolerance, 0.001f, 0.5f);
+			changed |= SliderFloat("normal tolerance", &temporal.normal_tolerance, 0.0f, 1.0f);
+			PopID();
 
 			PushID("Post processing");
 			Text("Post processing");
-			Checkbox("enable direct light", &settings.enable_direct_light);
-			Checkbox("enable hard shadows", &settings.enable_hard_shadows);
-			SliderFloat("direct light intensity", &settings.direct_light_intensity, 0.0f, 2.0f);
-			SliderFloat("hard shadow bias", &settings.hard_shadow_bias, 0.0f, 0.01f, "%.6f");
-			SliderFloat("gamma", &settings.gamma, 1.0f, 10.0f);
+			changed |= Checkbox("enable direct light", &settings.enable_direct_light);
+			changed |= Checkbox("enable hard shadows", &settings.enable_hard_shadows);
+			changed |= SliderFloat("direct light intensity", &settings.direct_light_intensity, 0.0f, 2.0f);
+			changed |= SliderFloat("hard shadow bias", &settings.hard_shadow_bias, 0.0f, 0.01f, "%.6f");
+			changed |= SliderFloat("gamma", &settings.gamma, 1.0f, 10.0f);
 			PopID();
+
+			if (changed)
+				settings.is_dirty = true;
 		}
 	}
 
 	namespace
 	{
-		void ApertureSlider(float* output, float min, float max) {
+		bool ApertureSlider(float* output, float min, float max) {
 			float apertureDegrees = RADIANS_TO_DEGREES * atan(*output) * 2.0f; // inverse from output
 
-			if (ImGui::SliderFloat("aperture (deg)", &apertureDegrees, min, max))
+			bool changed = ImGui::SliderFloat("aperture (deg)", &apertureDegrees, min, max);
+			if (changed)
 				*output = vct::get_aperture(apertureDegrees);
 
 			if (ImGui::IsItemHovered())
 				ImGui::SetTooltip("%.2f", *output);
+
+			return changed;
 		}
 
-		void VoxelDistanceSlider(const char* title, float* output, int voxel_grid_resolution, float min) {
+		bool VoxelDistanceSlider(const char* title, float* output, int voxel_grid_resolution, float min) {
 			float voxelSize = 1.0f / voxel_grid_resolution;
 			float voxels = *output * voxel_grid_resolution;
 
-			if (ImGui::SliderFloat(title, &voxels, min, 256.0f))
+			bool changed = ImGui::SliderFloat(title, &voxels, min, 256.0f);
+			if (changed)
 				*output = voxels * voxelSize;
 
 			if (ImGui::IsItemHovered())
 				ImGui::SetTooltip("%.2f", *output);
+
+			return changed;
 		}
 	}
 }
\ No newline at end of file
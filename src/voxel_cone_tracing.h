@@ -1,6 +1,7 @@
 #pragma once
 
 #include "camera.h"
+#include "geometry.h"
 #include "opengl.h"
 
 namespace vxgi
@@ -8,6 +9,119 @@ namespace vxgi
 	const int TOTAL_VOXELGRID_RESOLUTIONS = 4;
 	const int VOXELGRID_RESOLUTIONS[TOTAL_VOXELGRID_RESOLUTIONS] = { 64, 128, 256, 512 };
 	const int DEFAULT_VOXELGRID_RESOLUTION_INDEX = 2;
+	const int MAX_DIFFUSE_CONES = 16; // largest DIFFUSE_CONE_SET
+	const int TILE_SIZE = 16; // see tileclassification_comp.glsl
+	const int COMPUTE_CONE_TRACING_TILE_SIZE = 8; // see voxelconetracing_comp.glsl
+	const int EMPTY_SPACE_CELL_SIZE = 4; // voxels per side of a distance field cell, see emptyspace_comp.glsl
+	const int MAX_EMPTY_SPACE_DISTANCE = 15; // in cells, farther is stored as this
+
+	enum DIFFUSE_CONE_SET : u32 // cones traced per pixel for indirect diffuse and ao, fewer cones = wider and cheaper
+	{
+		DIFFUSE_CONE_SET_3,
+		DIFFUSE_CONE_SET_4,
+		DIFFUSE_CONE_SET_5,
+		DIFFUSE_CONE_SET_6, // the original set
+		DIFFUSE_CONE_SET_9,
+		DIFFUSE_CONE_SET_16,
+		TOTAL_DIFFUSE_CONE_SETS
+	};
+
+	struct Diffuse_Cone_Set // generated at compile time, see vct::make_diffuse_cone_set
+	{
+		int total_cones = 0;
+		float aperture = 0.0f; // tan(half angle)
+		float directions[MAX_DIFFUSE_CONES][3] = {}; // around the normal, y = along the normal
+		float weights[MAX_DIFFUSE_CONES] = {}; // cosine weighted, sum to PI
+	};
+
+	namespace vct
+	{
+		// std:: math isn't constexpr, these are only evaluated at compile time
+		constexpr double CONSTEXPR_PI = 3.14159265358979323846;
+		constexpr double constexpr_sin(double x)
+		{
+			while (x > CONSTEXPR_PI) x -= 2.0 * CONSTEXPR_PI;
+			while (x < -CONSTEXPR_PI) x += 2.0 * CONSTEXPR_PI;
+
+			double term = x;
+			double sum = x;
+			for (int i = 1; i < 12; i++) {
+				term *= -x * x / double((2 * i) * (2 * i + 1));
+				sum += term;
+			}
+			return sum;
+		}
+		constexpr double constexpr_cos(double x) { return constexpr_sin(x + 0.5 * CONSTEXPR_PI); }
+		constexpr double constexpr_sqrt(double x)
+		{
+			double r = (x > 1.0) ? x : 1.0;
+			for (int i = 0; i < 64; i++)
+				r = 0.5 * (r + x / r);
+			return r;
+		}
+
+		// an optional cone along the normal plus one or two rings of cones around it.
+		// the center cone covers the cap inside its own aperture, the rings split the rest of the hemisphere into bands
+		// of equal angle and sit in the middle of theirs. a cone's weight is the cosine weighted solid angle of its share
+		// of the band. apertures shrink with the cone count so the cones cover as much solid angle as the original 6
+		// (30 degree half angle, ring at 60 degrees, weights PI/4 and 3PI/20, which the 6 cone set reproduces)
+		constexpr Diffuse_Cone_Set make_diffuse_cone_set(bool has_center_cone, int inner_ring, int outer_ring = 0)
+		{
+			Diffuse_Cone_Set set = {};
+			set.total_cones = (has_center_cone ? 1 : 0) + inner_ring + outer_ring;
+
+			double half_angle = (CONSTEXPR_PI / 6.0) * constexpr_sqrt(6.0 / double(set.total_cones));
+			set.aperture = float(constexpr_sin(half_angle) / constexpr_cos(half_angle));
+
+			int cone = 0;
+			double band_start = 0.0;
+			if (has_center_cone) {
+				double sin_half_angle = constexpr_sin(half_angle);
+				set.directions[cone][1] = 1.0f;
+				set.weights[cone] = float(CONSTEXPR_PI * sin_half_angle * sin_half_angle);
+				band_start = half_angle;
+				cone++;
+			}
+
+			int rings[2] = { inner_ring, outer_ring };
+			int total_rings = (outer_ring > 0) ? 2 : 1;
+			double band_width = (0.5 * CONSTEXPR_PI - band_start) / double(total_rings);
+
+			for (int r = 0; r < total_rings; r++)
+			{
+				double band_min = band_start + band_width * double(r);
+				double band_max = band_min + band_width;
+				double sin_min = constexpr_sin(band_min);
+				double sin_max = constexpr_sin(band_max);
+				double weight = CONSTEXPR_PI * (sin_max * sin_max - sin_min * sin_min) / double(rings[r]);
+
+				double polar = 0.5 * (band_min + band_max);
+				for (int i = 0; i < rings[r]; i++, cone++)
+				{
+					double azimuth = 0.5 * CONSTEXPR_PI - 2.0 * CONSTEXPR_PI * (double(i) + 0.5 * double(r)) / double(rings[r]); // outer ring in the gaps of the inner one
+					set.directions[cone][0] = float(constexpr_sin(polar) * constexpr_cos(azimuth));
+					set.directions[cone][1] = float(constexpr_cos(polar));
+					set.directions[cone][2] = float(constexpr_sin(polar) * constexpr_sin(azimuth));
+					set.weights[cone] = float(weight);
+				}
+			}
+
+			return set;
+		}
+	}
+
+	constexpr Diffuse_Cone_Set DIFFUSE_CONE_SETS[TOTAL_DIFFUSE_CONE_SETS] = {
+		vct::make_diffuse_cone_set(false, 3),
+		vct::make_diffuse_cone_set(true, 3),
+		vct::make_diffuse_cone_set(true, 4),
+		vct::make_diffuse_cone_set(true, 5),
+		vct::make_diffuse_cone_set(true, 8),
+		vct::make_diffuse_cone_set(true, 5, 10)
+	};
+	static_assert(DIFFUSE_CONE_SETS[DIFFUSE_CONE_SET_6].total_cones == 6, "DIFFUSE_CONE_SETS doesn't match DIFFUSE_CONE_SET");
+	static_assert(DIFFUSE_CONE_SETS[DIFFUSE_CONE_SET_16].total_cones == MAX_DIFFUSE_CONES, "DIFFUSE_CONE_SETS doesn't match DIFFUSE_CONE_SET");
+	static_assert(DIFFUSE_CONE_SETS[DIFFUSE_CONE_SET_6].weights[0] > 0.785f && DIFFUSE_CONE_SETS[DIFFUSE_CONE_SET_6].weights[0] < 0.786f, "the 6 cone set should be the original one (PI / 4)");
+	static_assert(DIFFUSE_CONE_SETS[DIFFUSE_CONE_SET_6].weights[1] > 0.471f && DIFFUSE_CONE_SETS[DIFFUSE_CONE_SET_6].weights[1] < 0.472f, "the 6 cone set should be the original one (3 * PI / 20)");
 
 	struct Voxelization
 	{
@@ -25,8 +139,18 @@ namespace vxgi
 	{
 		bool use_ambient_light = true;
 		int visualize_mipmap_level = 0;
+
+		bool is_dirty = true; // re-upload uniform buffer
 	};
 
+	struct Voxelization_Settings_Std140 // mirrors Voxelization_Block in the shaders
+	{
+		s32 use_ambient_light;
+		s32 visualize_mipmap_level;
+		s32 _pad0[2];
+	};
+	static_assert(sizeof(Voxelization_Settings_Std140) == 16, "Voxelization_Settings_Std140 doesn't match the std140 layout");
+
 	struct Cone_Settings
 	{
 		float aperture; // aperture = tan(degrees * 0.5)
@@ -37,6 +161,119 @@ namespace vxgi
 		bool is_enabled;
 	};
 
+	struct Temporal_Settings // trace a rotating subset of the diffuse cones each frame and accumulate the rest over time
+	{
+		bool is_enabled = false;
+		int cones_per_frame = 2; // 1...total cones of the diffuse cone set
+		float history_weight = 0.9f; // 0.0 = no accumulation
+		float depth_tolerance = 0.05f; // max relative difference in distance to camera before history is rejected
+		float normal_tolerance = 0.9f; // min dot(normal, history normal) before history is rejected
+	};
+
+	struct Cone_Tracing_History // ping-ponged indirect diffuse history, see Temporal_Settings
+	{
+		enum Texture_Type : int
+		{
+			INDIRECT_DIFFUSE = 0, // rgb = indirect diffuse, a = occlusion
+			GEOMETRY, // xyz = normal, w = distance to camera (for history rejection)
+			TOTAL_HISTORY_TEXTURES
+		};
+
+		GLuint fbos[2] = { 0, 0 }; // color attachment 0 is the main fbo's color texture
+		Texture2D textures[2][TOTAL_HISTORY_TEXTURES];
+		int current = 0; // fbo written this frame, the other one is read
+
+		u32 frame_index = 0;
+		mat4 previous_VP = mat4(1.0f);
+		vec3 previous_camera_position = vec3(0.0f);
+		bool is_valid = false; // false after revoxelizing or when temporal accumulation was off last frame
+	};
+
+	struct Tile_Classification // screen tiles sorted by the cone tracing features they need, see tileclassification_comp.glsl
+	{
+		enum Tile_Feature : u32
+		{
+			TILE_FEATURE_GEOMETRY     = 1 << 0, // tiles without geometry aren't shaded at all
+			TILE_FEATURE_SPECULAR     = 1 << 1,
+			TILE_FEATURE_SOFT_SHADOWS = 1 << 2
+		};
+		static const int TOTAL_TILE_CLASSES = 4; // specular x soft shadows, class index = (features >> 1)
+
+		struct Draw_Command // glDrawArraysIndirect layout
+		{
+			u32 count;
+			u32 instance_count;
+			u32 first;
+			u32 base_instance;
+		};
+
+		GLuint ssbo = 0; // Draw_Command[TOTAL_TILE_CLASSES] followed by a tile list per class
+		int tiles_x = 0;
+		int tiles_y = 0;
+
+		u32 tiles_per_class[TOTAL_TILE_CLASSES] = {}; // only read back when show_stats is set (stalls)
+		bool is_enabled = true;
+		bool show_stats = false;
+	};
+
+	struct Empty_Space_Field // coarse chebyshev distance from each cell to the nearest non-empty voxel, rebuilt after voxelizing
+	{
+		GLuint textures[2] = { 0, 0 }; // r8ui 3D, [0] is the field, [1] is scratch for the separable passes
+		int dimensions = 0; // cells per side, voxel grid resolution / EMPTY_SPACE_CELL_SIZE
+		bool is_enabled = true; // cone tracing leaps over the empty cells
+	};
+
+	struct Cone_Step_Counters // how far the cones got, only counted and read back when is_enabled is set (stalls)
+	{
+		struct Counters // mirrors Cone_Step_Counters in voxelconetracing_common.glsl
+		{
+			u32 total_cones;
+			u32 total_steps; // voxel grid samples
+			u32 total_leaps; // over empty space
+		};
+
+		GLuint ssbo = 0;
+		Counters last_frame = {};
+		bool is_enabled = false;
+	};
+
+	struct Compute_Cone_Tracing // cone tracing as a compute pass on 8x8 tiles instead of the fragment pass, see voxelconetracing_comp.glsl
+	{
+		bool is_enabled = false;
+		bool share_far_field = true; // the diffuse cones of coherent tiles share their far part
+		float far_field_footprint = 2.0f; // the far field starts where a cone is this many tiles wide
+		float far_field_normal_tolerance = 0.9f; // min dot(normal, tile normal) of every pixel in a tile that shares
+	};
+
+	enum CONE_TRACING_FEATURE : u32 // compile-time toggles of voxelconetracing_common.glsl, one program variant per combination in use
+	{
+		CONE_TRACING_FEATURE_DIRECT_LIGHT         = 1 << 0,
+		CONE_TRACING_FEATURE_DIFFUSE              = 1 << 1,
+		CONE_TRACING_FEATURE_SPECULAR             = 1 << 2,
+		CONE_TRACING_FEATURE_SOFT_SHADOWS         = 1 << 3,
+		CONE_TRACING_FEATURE_AO                   = 1 << 4,
+		CONE_TRACING_FEATURE_TRACE_AO_SEPARATELY  = 1 << 5,
+		CONE_TRACING_FEATURE_HARD_SHADOWS         = 1 << 6,
+		CONE_TRACING_FEATURE_TEMPORAL             = 1 << 7,
+		CONE_TRACING_FEATURE_EMPTY_SPACE_SKIPPING = 1 << 8,
+		CONE_TRACING_FEATURE_STEP_COUNTERS        = 1 << 9,
+		TOTAL_CONE_TRACING_FEATURES = 10
+	};
+	const u32 CONE_TRACING_CONE_SET_SHIFT = TOTAL_CONE_TRACING_FEATURES; // the DIFFUSE_CONE_SET goes above the feature bits of the mask
+
+	const char* const CONE_TRACING_FEATURE_DEFINES[TOTAL_CONE_TRACING_FEATURES] = {
+		"FEATURE_DIRECT_LIGHT",
+		"FEATURE_DIFFUSE",
+		"FEATURE_SPECULAR",
+		"FEATURE_SOFT_SHADOWS",
+		"FEATURE_AO",
+		"FEATURE_TRACE_AO_SEPARATELY",
+		"FEATURE_HARD_SHADOWS",
+		"FEATURE_TEMPORAL",
+		"FEATURE_EMPTY_SPACE_SKIPPING",
+		"FEATURE_STEP_COUNTERS"
+	};
+
 	struct Cone_Tracing_Shader_Settings
 	{
 		Cone_Settings diffuse_settings      = { 0.577f, 0.119f, 0.081f, 2.0f, 1.0f, true };
@@ -44,19 +281,101 @@ namespace vxgi
 		Cone_Settings soft_shadows_settings = { 0.017f, 0.200f, 0.120f, 2.0f, 1.0f, true };
 		Cone_Settings ao_settings           = { 0.577f, 1.000f, 0.500f, 1.0f, 1.0f, true };
 		bool trace_ao_separately = false; // otherwise use diffuse cone opacity
+		DIFFUSE_CONE_SET diffuse_cone_set = DIFFUSE_CONE_SET_6; // diffuse + ao cones, compiled into the shader permutation
 
 		float gamma = 2.2f;
 		float hard_shadow_bias = 0.005f;
 		float direct_light_intensity = 1.0f;
 		bool enable_direct_light = true;
 		bool enable_hard_shadows = false; // shadow mapped
+
+		Temporal_Settings temporal_settings;
+
+		bool is_dirty = true; // re-upload uniform buffer, set by the ui
+	};
+
+	struct Cone_Settings_Std140 // mirrors Cone_Settings in voxelconetracing_common.glsl
+	{
+		float aperture;
+		float sampling_factor;
+		float distance_offset;
+		float max_distance;
+		float result_intensity;
+		s32 is_enabled;
+		float _pad0[2];
+	};
+	static_assert(sizeof(Cone_Settings_Std140) == 32, "Cone_Settings_Std140 doesn't match the std140 layout");
+
+	struct Temporal_Settings_Std140 // mirrors Temporal_Settings in voxelconetracing_common.glsl
+	{
+		s32 is_enabled;
+		s32 cones_per_frame;
+		float history_weight;
+		float depth_tolerance;
+		float normal_tolerance;
+		float _pad0[3];
 	};
+	static_assert(sizeof(Temporal_Settings_Std140) == 32, "Temporal_Settings_Std140 doesn't match the std140 layout");
+
+	struct Cone_Tracing_Settings_Std140 // mirrors Cone_Tracing_Block in voxelconetracing_common.glsl
+	{
+		Cone_Settings_Std140 diffuse;
+		Cone_Settings_Std140 specular;
+		Cone_Settings_Std140 softshadows;
+		Cone_Settings_Std140 ao;
+		s32 trace_ao_separately;
+		float gamma;
+		float hard_shadow_bias;
+		float voxel_size;
+		float direct_light_intensity;
+		s32 voxel_grid_resolution;
+		s32 max_mipmap_level;
+		s32 enable_direct_light;
+		s32 enable_hard_shadows;
+		s32 diffuse_cone_set; // DIFFUSE_CONE_SET, the shader has it compiled in, the cpu reference reads it from here
+		float _pad0[2];
+		Temporal_Settings_Std140 temporal;
+	};
+	static_assert(offsetof(Cone_Tracing_Settings_Std140, trace_ao_separately) == 128, "Cone_Tracing_Settings_Std140 doesn't match the std140 layout");
+	static_assert(offsetof(Cone_Tracing_Settings_Std140, temporal) == 176, "Cone_Tracing_Settings_Std140 doesn't match the std140 layout");
+	static_assert(sizeof(Cone_Tracing_Settings_Std140) == 208, "Cone_Tracing_Settings_Std140 doesn't match the std140 layout");
 
 	namespace vct
 	{
-		void upload_voxelization_settings(GLuint shader_id, Voxelization_Settings& settings);
-		void upload_cone_tracing_settings(GLuint shader_id, Cone_Tracing_Shader_Settings& settings, int voxel_grid_resolution);
+		void upload_voxelization_settings(Uniform_Buffer& ubo, Voxelization_Settings& settings);
+		void upload_cone_tracing_settings(Uniform_Buffer& ubo, Cone_Tracing_Shader_Settings& settings, int voxel_grid_resolution);
+		void pack_cone_tracing_settings(Cone_Tracing_Settings_Std140& block, Cone_Tracing_Shader_Settings& settings, int voxel_grid_resolution); // also used by the cpu reference dumps
+		void upload_temporal_settings(GLuint shader_id, Temporal_Settings& settings, Cone_Tracing_History& history, int total_diffuse_cones, int texture_location_offset);
+
+		void init_history(Cone_Tracing_History& history, GLuint color_texture_id, int w, int h);
+		void uninit_history(Cone_Tracing_History& history);
+		void advance_history(Cone_Tracing_History& history, Camera& camera);
+
+		void init_tiles(Tile_Classification& tiles, int w, int h);
+		void uninit_tiles(Tile_Classification& tiles);
+		void reset_tiles(Tile_Classification& tiles, int vertices_per_tile);
+		void upload_tile_settings(GLuint shader_id, Tile_Classification& tiles, int w, int h);
+		void draw_tiles(GLuint shader_id, Tile_Classification& tiles, Mesh& tile_mesh, int tile_class);
+		u32 get_tile_class_mask(u32 feature_mask, int tile_class); // the permutation for the class, without the features its tiles don't need
+		void read_tile_stats(Tile_Classification& tiles);
+
+		void init_empty_space(Empty_Space_Field& field, int voxel_grid_resolution); // reallocates if the resolution changed
+		void uninit_empty_space(Empty_Space_Field& field);
+		void build_empty_space(Empty_Space_Field& field, Shader_Program& shader, Texture3D& voxel_grid); // after the mipmaps are generated
+		void upload_empty_space(GLuint shader_id, Empty_Space_Field& field, int texture_location);
+
+		void init_step_counters(Cone_Step_Counters& counters);
+		void uninit_step_counters(Cone_Step_Counters& counters);
+		void reset_step_counters(Cone_Step_Counters& counters);
+		void read_step_counters(Cone_Step_Counters& counters);
+
+		void upload_compute_settings(GLuint shader_id, Compute_Cone_Tracing& compute);
+		void dispatch_compute(GLuint color_texture_id, Cone_Tracing_History& history, bool writes_history, int w, int h);
 
+		u32 get_feature_mask(Cone_Tracing_Shader_Settings& settings); // CONE_TRACING_FEATURE_* and the cone set, selects the shader permutation
+		u32 get_feature_mask(Cone_Tracing_Shader_Settings& settings, Empty_Space_Field& field, Cone_Step_Counters& counters);
+		bool is_only_ao(u32 feature_mask); // ONLY_RENDER_AO in voxelconetracing_common.glsl
+		void append_cone_set_defines(u32 feature_mask, std::string& defines); // Shader_Permutations::append_defines
 		float get_aperture(float degrees);
 
 		bool render_ui(Voxelization_Settings& settings);
@@ -0,0 +1,23 @@
+#include "tests.h"
+
+namespace vxgi
+{
+	namespace tests
+	{
+		int total_checks = 0;
+		int failed_checks = 0;
+	}
+}
+
+int main(int argc, const char* argv[])
+{
+	using namespace vxgi;
+
+	LOG("test", "render queue");
+	tests::render_queue();
+	LOG("test", "occlusion culling");
+	tests::occlusion_culling();
+
+	LOG("test", "%d of %d checks failed", tests::failed_checks, tests::total_checks);
+	return tests::failed_checks > 0 ? 1 : 0;
+}
@@ -0,0 +1,57 @@
+#include "tests.h"
+
+#include "occlusion_culling.h"
+
+namespace vxgi
+{
+	namespace
+	{
+		Bounding_Box make_box(vec3 center, vec3 half_size)
+		{
+			return { center - half_size, center + half_size, center };
+		}
+
+		// a camera at the origin looking down -z at a wall 5 units away, counter clockwise towards the camera. at that
+		// distance the view is about 11.5 wide and 5.8 high, the wall covers its middle and all of its height
+		void test_wall()
+		{
+			const vec3 wall[] = {
+				{ -4.0f, -4.0f, -5.0f }, {  4.0f, -4.0f, -5.0f }, {  4.0f,  4.0f, -5.0f },
+				{ -4.0f, -4.0f, -5.0f }, {  4.0f,  4.0f, -5.0f }, { -4.0f,  4.0f, -5.0f },
+			};
+			mat4 VP = glm::perspective(glm::radians(60.0f), float(OCCLUSION_WIDTH) / float(OCCLUSION_HEIGHT), 0.1f, 100.0f) *
+				glm::lookAt(vec3(0.0f), vec3(0.0f, 0.0f, -1.0f), vec3(0.0f, 1.0f, 0.0f));
+
+			Occlusion_Culling occ;
+			defer { occlusionculling::uninit(occ); };
+			occlusionculling::set_occluders(occ, wall, 2);
+			occlusionculling::rasterize_occluders(occ, VP);
+			CHECK_EQUAL(occ.rasterized_triangles, 2);
+			CHECK(occ.depth[(OCCLUSION_HEIGHT / 2) * OCCLUSION_WIDTH + OCCLUSION_WIDTH / 2] < 1.0f);
+
+			CHECK(occlusionculling::is_occluded(occ, make_box(vec3(0.0f, 0.0f, -10.0f), vec3(0.5f)), VP)); // behind
+			CHECK(occlusionculling::is_occluded(occ, make_box(vec3(2.0f, 1.0f, -20.0f), vec3(1.0f)), VP)); // behind, off center
+
+			CHECK(!occlusionculling::is_occluded(occ, make_box(vec3(12.0f, 0.0f, -10.0f), vec3(0.5f)), VP)); // beside, in view
+			CHECK(!occlusionculling::is_occluded(occ, make_box(vec3(8.0f, 0.0f, -10.0f), vec3(1.0f)), VP)); // partly beside
+			CHECK(!occlusionculling::is_occluded(occ, make_box(vec3(0.0f, 0.0f, -3.0f), vec3(0.5f)), VP)); // in front
+			CHECK(!occlusionculling::is_occluded(occ, make_box(vec3(0.0f, 0.0f, -5.0f), vec3(0.5f)), VP)); // through the wall
+			CHECK(!occlusionculling::is_occluded(occ, make_box(vec3(0.0f, 0.0f, 0.0f), vec3(0.5f, 0.5f, 1.0f)), VP)); // straddles the camera plane
+			CHECK(!occlusionculling::is_occluded(occ, make_box(vec3(0.0f, 0.0f, 10.0f), vec3(0.5f)), VP)); // behind the camera
+
+			// seen from behind the wall faces away and doesn't occlude
+			mat4 VP_behind = glm::perspective(glm::radians(60.0f), float(OCCLUSION_WIDTH) / float(OCCLUSION_HEIGHT), 0.1f, 100.0f) *
+				glm::lookAt(vec3(0.0f, 0.0f, -10.0f), vec3(0.0f, 0.0f, 0.0f), vec3(0.0f, 1.0f, 0.0f));
+			occlusionculling::rasterize_occluders(occ, VP_behind);
+			CHECK(!occlusionculling::is_occluded(occ, make_box(vec3(0.0f), vec3(0.5f)), VP_behind));
+		}
+	}
+
+	namespace tests
+	{
+		void occlusion_culling()
+		{
+			test_wall();
+		}
+	}
+}
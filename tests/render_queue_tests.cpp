@@ -0,0 +1,185 @@
+#include "tests.h"
+
+#include "render_queue.h"
+
+namespace vxgi
+{
+	namespace
+	{
+		struct Gl_Recording // what the mock Render_Queue_Gl was called with
+		{
+			Array<GLuint> programs;
+			Array<GLuint> vaos;
+			Array<GLint> draws; // first vertex
+			int uniform_calls = 0;
+		};
+
+		Gl_Recording recording;
+
+		GLuint mock_use_program(Shader_Program& program) { array::add(recording.programs, program.id); return program.id; }
+		GLint  mock_uniform_location(GLuint program_id, SHADER_UNIFORM uniform) { return GLint(uniform); }
+		void   mock_bind_vertex_array(GLuint vao) { array::add(recording.vaos, vao); }
+		void   mock_bind_texture(GLuint unit, GLuint texture) {}
+		void   mock_uniform_1i(GLint location, GLint value) { recording.uniform_calls++; }
+		void   mock_uniform_1f(GLint location, GLfloat value) { recording.uniform_calls++; }
+		void   mock_uniform_3fv(GLint location, const GLfloat* value) { recording.uniform_calls++; }
+		void   mock_uniform_matrix_4fv(GLint location, const GLfloat* value) { recording.uniform_calls++; }
+		void   mock_draw_arrays(GLint first, GLsizei count) { array::add(recording.draws, first); }
+
+		void reset_recording()
+		{
+			array::set_length(recording.programs, 0);
+			array::set_length(recording.vaos, 0);
+			array::set_length(recording.draws, 0);
+			recording.uniform_calls = 0;
+		}
+
+		void init_mock(Render_Queue& q)
+		{
+			renderqueue::init(q);
+			q.gl.use_program = mock_use_program;
+			q.gl.uniform_location = mock_uniform_location;
+			q.gl.bind_vertex_array = mock_bind_vertex_array;
+			q.gl.bind_texture = mock_bind_texture;
+			q.gl.uniform_1i = mock_uniform_1i;
+			q.gl.uniform_1f = mock_uniform_1f;
+			q.gl.uniform_3fv = mock_uniform_3fv;
+			q.gl.uniform_matrix_4fv = mock_uniform_matrix_4fv;
+			q.gl.draw_arrays = mock_draw_arrays;
+		}
+
+		void test_keys()
+		{
+			// program, then material, then vao, then depth with the nearer first
+			CHECK(renderqueue::make_key(1, 9, 9, 9.0f) < renderqueue::make_key(2, 0, 0, 0.0f));
+			CHECK(renderqueue::make_key(1, 0, 9, 9.0f) < renderqueue::make_key(1, 1, 0, 0.0f));
+			CHECK(renderqueue::make_key(1, -1, 9, 9.0f) < renderqueue::make_key(1, 0, 0, 0.0f)); // no material
+			CHECK(renderqueue::make_key(1, 0, 1, 9.0f) < renderqueue::make_key(1, 0, 2, 0.0f));
+			CHECK(renderqueue::make_key(1, 0, 1, 0.5f) < renderqueue::make_key(1, 0, 1, 2.0f));
+			CHECK(renderqueue::make_key(1, 0, 1, -1.0f) == renderqueue::make_key(1, 0, 1, 0.0f));
+		}
+
+		// the shadow map case, no materials: three models in front of the origin, the last with two sub meshes, drawn
+		// with two programs. the first vertex of a sub mesh tells the draws apart
+		void test_submit()
+		{
+			Mesh far_mesh, middle_mesh, near_mesh;
+			far_mesh.vao = 7;
+			middle_mesh.vao = 3;
+			near_mesh.vao = 7;
+			array::add(far_mesh.sub_meshes, Sub_Mesh { 0, 3, 0 });
+			array::add(middle_mesh.sub_meshes, Sub_Mesh { 10, 3, 0 });
+			array::add(near_mesh.sub_meshes, Sub_Mesh { 20, 3, 0 });
+			array::add(near_mesh.sub_meshes, Sub_Mesh { 30, 3, 0 });
+
+			Model far_model, middle_model, near_model;
+			far_model.bounding_box.center = vec3(0.0f, 0.0f, -5.0f);
+			middle_model.bounding_box.center = vec3(0.0f, 0.0f, -2.0f);
+			near_model.bounding_box.center = vec3(0.0f, 0.0f, -1.0f);
+			array::add(far_model.meshes, &far_mesh);
+			array::add(middle_model.meshes, &middle_mesh);
+			array::add(near_model.meshes, &near_mesh);
+
+			Scene scene;
+			array::add(scene.models, &far_model);
+			array::add(scene.models, &middle_model);
+			array::add(scene.models, &near_model);
+
+			Shader_Program first_program, second_program;
+			first_program.id = 4;
+			second_program.id = 9;
+
+			Render_Queue q;
+			init_mock(q);
+			defer {
+				renderqueue::uninit(q);
+				array::uninit(scene.models);
+				for (Model* model : { &far_model, &middle_model, &near_model })
+					array::uninit(model->meshes);
+				for (Mesh* mesh : { &far_mesh, &middle_mesh, &near_mesh })
+					array::uninit(mesh->sub_meshes);
+				array::uninit(recording.programs);
+				array::uninit(recording.vaos);
+				array::uninit(recording.draws);
+			};
+
+			// sorted: by program, then vao, then depth
+			reset_recording();
+			renderqueue::begin(q, DRAW_MATERIAL_NONE);
+			renderqueue::add_scene(q, scene, second_program, vec3(0.0f));
+			renderqueue::add_scene(q, scene, first_program, vec3(0.0f));
+			CHECK_EQUAL(renderqueue::submit(q, 0), 8);
+
+			CHECK_EQUAL(array::size(recording.programs), 2);
+			CHECK_EQUAL(recording.programs[0], 4);
+			CHECK_EQUAL(recording.programs[1], 9);
+
+			CHECK_EQUAL(array::size(recording.draws), 8);
+			for (int i = 0; i < 8; i += 4) { // the near model's sub meshes have the same key, either goes first
+				CHECK_EQUAL(recording.draws[i + 0], 10);
+				CHECK_EQUAL(recording.draws[i + 1] + recording.draws[i + 2], 20 + 30);
+				CHECK_EQUAL(recording.draws[i + 3], 0);
+			}
+
+			// per program: the vao is bound twice and elided twice, M and N are uploaded per model and elided for the
+			// near model's second sub mesh
+			CHECK_EQUAL(array::size(recording.vaos), 4);
+			CHECK_EQUAL(recording.uniform_calls, 12);
+
+			renderqueue::end_frame(q);
+			CHECK_EQUAL(q.draws, 8);
+			CHECK_EQUAL(q.state_calls, 2 + 4 + 12);
+			CHECK_EQUAL(q.elided_calls, 4 + 4);
+			CHECK_EQUAL(q.frame_draws, 0);
+			CHECK_EQUAL(q.frame_state_calls, 0);
+			CHECK_EQUAL(q.frame_elided_calls, 0);
+
+			// unsorted: in load order, the vao switches back and forth
+			reset_recording();
+			q.is_sorted = false;
+			renderqueue::begin(q, DRAW_MATERIAL_NONE);
+			renderqueue::add_scene(q, scene, second_program, vec3(0.0f));
+			renderqueue::add_scene(q, scene, first_program, vec3(0.0f));
+			renderqueue::submit(q, 0);
+
+			CHECK_EQUAL(recording.programs[0], 9);
+			CHECK_EQUAL(recording.draws[0], 0);
+			CHECK_EQUAL(recording.draws[1], 10);
+			CHECK_EQUAL(recording.draws[2], 20);
+			CHECK_EQUAL(recording.draws[3], 30);
+			CHECK_EQUAL(array::size(recording.vaos), 5);
+
+			renderqueue::end_frame(q);
+			CHECK_EQUAL(q.state_calls, 2 + 5 + 12);
+			CHECK_EQUAL(q.elided_calls, 4 + 3);
+
+			// the program that's already active isn't activated again
+			reset_recording();
+			q.is_sorted = true;
+			renderqueue::begin(q, DRAW_MATERIAL_NONE);
+			renderqueue::add_scene(q, scene, first_program, vec3(0.0f));
+			renderqueue::submit(q, first_program.id);
+			CHECK_EQUAL(array::size(recording.programs), 0);
+			CHECK_EQUAL(array::size(recording.draws), 4);
+
+			// the invisible sub meshes aren't queued, one per sub mesh in scene order
+			reset_recording();
+			const u8 is_visible[] = { 1, 0, 0, 1 };
+			renderqueue::begin(q, DRAW_MATERIAL_NONE);
+			renderqueue::add_scene(q, scene, first_program, vec3(0.0f), is_visible);
+			renderqueue::submit(q, 0);
+			CHECK_EQUAL(array::size(recording.draws), 2);
+			CHECK_EQUAL(recording.draws[0], 30);
+			CHECK_EQUAL(recording.draws[1], 0);
+		}
+	}
+
+	namespace tests
+	{
+		void render_queue()
+		{
+			test_keys();
+			test_submit();
+		}
+	}
+}
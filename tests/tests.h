@@ -0,0 +1,37 @@
+#pragma once
+
+#include "types.h"
+
+// The tests, one function per module, without a framework: a check that fails is logged with its line and counted, and
+// the binary exits with 1 if any did. There's no GL context, the code under test reaches gl through its mock seams.
+
+namespace vxgi
+{
+	namespace tests
+	{
+		extern int total_checks;
+		extern int failed_checks;
+
+		void render_queue();
+		void occlusion_culling();
+	}
+}
+
+#define CHECK(expr) \
+	do { \
+		vxgi::tests::total_checks++; \
+		if (!(expr)) { \
+			vxgi::tests::failed_checks++; \
+			LOG("test", "%s:%d: CHECK(%s) failed", __FILE__, __LINE__, #expr); \
+		} \
+	} while(0)
+
+#define CHECK_EQUAL(actual, expected) \
+	do { \
+		vxgi::tests::total_checks++; \
+		long long _actual = (long long)(actual), _expected = (long long)(expected); \
+		if (_actual != _expected) { \
+			vxgi::tests::failed_checks++; \
+			LOG("test", "%s:%d: CHECK_EQUAL(%s, %s) failed, %lld != %lld", __FILE__, __LINE__, #actual, #expected, _actual, _expected); \
+		} \
+	} while(0)